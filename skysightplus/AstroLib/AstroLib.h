@@ -125,6 +125,16 @@ MODIFICATION HISTORY:
 	Also be sure to include the source file "MathEx.c", which contains the
 	actual definitions of the C9X math extension functions used by AstroLib.
 
+	#define SSE2 [ TRUE | FALSE ]
+
+	This optional constant controls whether AstroLib uses the Intel SSE2
+	instruction set (via the compiler intrinsics declared in <emmintrin.h>)
+	in its performance-critical inner loops, such as the conversion of raw
+	FITS image data.  If you leave it undefined, AstroLib turns SSE2 on when
+	the compiler indicates that it is generating SSE2 code for an x86 target,
+	and off otherwise.  The scalar versions of these loops always produce
+	the same results as the SSE2 versions.
+
 *******************************************************************************/
 
 #include "target.h"
@@ -133,6 +143,18 @@ MODIFICATION HISTORY:
 #include MATHEX
 #endif
 
+#ifndef SSE2
+#if defined ( __SSE2__ ) || defined ( _M_X64 ) || ( defined ( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define SSE2	TRUE
+#else
+#define SSE2	FALSE
+#endif
+#endif
+
+#if SSE2
+#include <emmintrin.h>
+#endif
+
 #ifndef BITPIX
 #define BITPIX	-32
 #endif
@@ -256,6 +278,7 @@ typedef struct FITSImage
 	double			bscale;		/* image data scaling parameter */
 	FITSHeader		header;		/* matrix containing FITS header information */
 	PIXEL			***data;	/* matrix containing image data */
+	void			*mapping;	/* private record for memory-mapped image data */
 }
 FITSImage;
 
@@ -3046,6 +3069,61 @@ double *, double * );
 
 void ByteSwap ( void *, long, short );
 
+/************************  DecodeFITSImageData  *****************************
+
+	Converts raw FITS image data values into native pixel values.
+
+	void DecodeFITSImageData ( void *buffer, long bitpix, long num,
+	double bzero, double bscale, PIXEL *data )
+
+	(buffer): pointer to raw image data, exactly as stored in a FITS file.
+	(bitpix): bits/pixel of the raw image data.
+	(num):    number of values to convert.
+	(bzero):  offset added to raw image data values.
+	(bscale): scaling applied to raw image data values.
+	(data):   pointer to buffer to receive (num) output pixel values.
+
+	This function performs the byte-swapping (if any), offset, scaling,
+	and type conversion which ReadFITSImageDataRow() applies to data it
+	reads from a file, in a single pass over the raw data.  The raw data
+	buffer is not modified.  Each combination of (bitpix) and presence or
+	absence of scaling has its own conversion loop; where SSE2 is enabled,
+	these loops process several pixels per instruction.
+
+	Output values are computed exactly as described for
+	ReadFITSImageDataRow(), i.e. in double precision before conversion
+	to the PIXEL type.  If (bitpix) is not a legal FITS value, the output
+	buffer is left unchanged.
+
+*****************************************************************************/
+
+void DecodeFITSImageData ( void *, long, long, double, double, PIXEL * );
+
+/************************  EncodeFITSImageData  *****************************
+
+	Converts native pixel values into raw FITS image data values.
+
+	void EncodeFITSImageData ( PIXEL *data, long bitpix, long num,
+	double bzero, double bscale, void *buffer )
+
+	(data):   pointer to input pixel values.
+	(bitpix): desired bits/pixel of the raw image data.
+	(num):    number of values to convert.
+	(bzero):  offset subtracted from pixel values.
+	(bscale): scaling applied to pixel values.
+	(buffer): pointer to buffer to receive raw image data; must be able to
+	          hold (num) values of the size indicated by (bitpix).
+
+	This is the inverse of DecodeFITSImageData(): it applies the offset,
+	scaling, type conversion and byte-swapping (if any) which
+	WriteFITSImageDataRow() applies to data before writing it to a file.
+	Integer output values which overflow the range of the output type are
+	clipped to the nearest representable value.
+
+*****************************************************************************/
+
+void EncodeFITSImageData ( PIXEL *, long, long, double, double, void * );
+
 /************************  NewFITSImageDataMatrix  **************************
 
 	Allocates memory for a matrix of FITS image data.
@@ -3067,9 +3145,7 @@ void ByteSwap ( void *, long, short );
 	
 	If successful, this function returns an array of pointers to the individual
 	frames of the image data matrix.  Each frame, in turn, consists of an array
-	of pointers to the rows of image data which make up that frame.  Memory for
-	each row of image data is allocated separately, but data within a particular
-	row is contiguous in memory.
+	of pointers to the rows of image data which make up that frame.
 	
 	To reference the ith frame of the matrix, use the notation matrix[i];
 	to reference the jth row within the ith frame, use matrix[i][j].  This
@@ -3077,10 +3153,42 @@ void ByteSwap ( void *, long, short );
 	within that row, use the notation matrix[i][j][k].  Here the integers
 	i, j, and k are all counted from zero as per the C language standard.
 	
+	The pointer tables and all of the image data are allocated as a single
+	block of memory.  The image data is stored frame after frame, and row
+	after row within each frame, starting on a FITS_DATA_ALIGNMENT-byte
+	boundary.  Each row is padded with zeros to a multiple of that many bytes,
+	so every row starts on an aligned boundary as well.  The distance from one
+	row to the next, in pixels, is the matrix's row stride; you can obtain it
+	with GetFITSImageDataStride().  Hence matrix[i][j] is always the same as
+	matrix[0][0] + ( i * naxis2 + j ) * stride, and code which processes
+	whole frames can walk through memory linearly from matrix[i][0] instead
+	of looking up each row pointer.  Pixels in the padding at the end of
+	each row are not part of the image, and are never read from or written
+	to FITS files, so such code may safely modify them.
+	
 ******************************************************************************/
 
+#define FITS_DATA_ALIGNMENT		64
+
 PIXEL ***NewFITSImageDataMatrix ( long, long, long );
 
+/************************  GetFITSImageDataStride  **************************
+
+	Returns the row stride of a FITS image data matrix.
+	
+	long GetFITSImageDataStride ( PIXEL ***matrix )
+	
+	(matrix): pointer to matrix allocated by NewFITSImageDataMatrix().
+	
+	The function returns the number of pixels between the start of one row
+	of the image data matrix and the start of the next, which is at least
+	the number of columns in the matrix.  See NewFITSImageDataMatrix() for
+	a description of the matrix's layout in memory.
+	
+******************************************************************************/
+
+long GetFITSImageDataStride ( PIXEL *** );
+
 /************************  FreeFITSImageDataMatrix  **************************
 
 	Frees memory for a matrix of FITS image data.
@@ -3289,6 +3397,67 @@ int ReadFITSImageDataRow ( FILE *, long, long, double, double, PIXEL * );
 
 int WriteFITSImageDataRow ( FILE *, long, long, double, double, PIXEL * );
 
+/************************  ReadFITSImageDataBlock  **************************
+
+	Reads several consecutive rows of image data from a FITS image file.
+
+	int ReadFITSImageDataBlock ( FILE *file, long bitpix, long naxis1,
+	long nrows, double bzero, double bscale, PIXEL **rows, void *buffer )
+
+	(file):   pointer to the FITS image file, opened for reading in binary mode.
+	(bitpix): bits/pixel for data in the input image file.
+	(naxis1): number of pixels in an image row.
+	(nrows):  number of rows to read.
+	(bzero):  offset added to raw image data values.
+	(bscale): scaling applied to raw image data values.
+	(rows):   array of (nrows) pointers to buffers to receive output rows.
+	(buffer): pointer to raw data buffer, or NULL.
+
+	This function returns TRUE if successful, or FALSE on failure.
+
+	This function is equivalent to calling ReadFITSImageDataRow() (nrows)
+	times, but reads all of the raw data with a single call to fread(),
+	and converts it with DecodeFITSImageData().  The output rows need not
+	be contiguous in memory.
+
+	If (buffer) is non-NULL, it must point to a buffer of at least
+	( nrows * naxis1 * abs ( bitpix ) / 8 ) bytes, which will be used to
+	hold the raw data; callers which read an image in many blocks should
+	allocate this buffer once and reuse it.  If (buffer) is NULL, the
+	function allocates and frees a temporary buffer itself.
+
+******************************************************************************/
+
+int ReadFITSImageDataBlock ( FILE *, long, long, long, double, double, PIXEL **, void * );
+
+/************************  WriteFITSImageDataBlock  *************************
+
+	Writes several consecutive rows of image data to a FITS image file.
+
+	int WriteFITSImageDataBlock ( FILE *file, long bitpix, long naxis1,
+	long nrows, double bzero, double bscale, PIXEL **rows, void *buffer )
+
+	(file):   pointer to the FITS image file, opened for writing in binary mode.
+	(bitpix): desired bits/pixel for data in output image file.
+	(naxis1): number of pixels in an image row.
+	(nrows):  number of rows to write.
+	(bzero):  offset subtracted from pixel values before writing.
+	(bscale): scaling applied to pixel values before writing.
+	(rows):   array of (nrows) pointers to rows of pixel values to write.
+	(buffer): pointer to raw data buffer, or NULL.
+
+	This function returns TRUE if successful, or FALSE on failure.
+
+	This is the output counterpart of ReadFITSImageDataBlock(): the rows
+	are converted with EncodeFITSImageData() into the raw data buffer,
+	which is then written to the file with a single call to fwrite().
+	The (buffer) parameter has the same meaning as for
+	ReadFITSImageDataBlock().
+
+******************************************************************************/
+
+int WriteFITSImageDataBlock ( FILE *, long, long, long, double, double, PIXEL **, void * );
+
 /***********************  ReadFITSImageDataPadding  **************************
 
 	Reads the padding at the end of a FITS image file.
@@ -3426,7 +3595,8 @@ FITSImage *NewFITSImage ( long, long, long, long, long, double, double );
 	a FITS header and/or image data matrix, memory for those matrices
 	will also be deallocated; if you wish to prevent this, you should
 	set the FITSImage's "header" and "data" structure members to point
-	to NULL before calling this function.
+	to NULL before calling this function.  If the image was opened with
+	MapFITSImage(), its mapping and row cache are released as well.
 	
 ******************************************************************************/
 
@@ -3500,6 +3670,68 @@ FITSImage *ReadFITSImage ( FILE * );
 
 PIXEL ***ReadFITSImageData ( FILE *, FITSImage * );
 
+/*****************************  MapFITSImage  *********************************
+
+	Allocates and initializes a new FITSImage, reads a FITS file's header
+	into it, and maps the file's image data for read-only access on demand.
+	
+	FITSImage *MapFITSImage ( FILE *file, long cache )
+	
+	(file):  pointer to FITS file, opened for reading in binary mode.
+	(cache): maximum number of decoded image data rows to keep in memory;
+	         if zero or negative, a default of about 16 MB worth of rows.
+	
+	If successful, this function returns a pointer to the new FITSImage
+	structure; on failure, it returns NULL.  Use the function FreeFITSImage()
+	to release memory allocated by this function.
+	
+	This function is an alternative to ReadFITSImage() for very large files,
+	or for when only a few rows or a small region of the image is needed.
+	It reads the file's header exactly as ReadFITSImageHeader() does, but
+	instead of reading the whole image data matrix into memory, it maps the
+	image data in the file into the program's address space, a window of the
+	file at a time, so files larger than the address space can be opened (on
+	platforms which support memory-mapped files; elsewhere, or if the file
+	can't be mapped, rows are read from the file as they are needed).  The
+	structure's "data" member is set to NULL; use GetFITSImageDataRow() to
+	access the image data.  Opening a file this way takes almost no time or
+	memory, regardless of the size of the file.
+	
+	The file must remain open, and must not be modified, until the FITSImage
+	is freed with FreeFITSImage().  The caller remains responsible for closing
+	the file afterwards.
+	
+******************************************************************************/
+
+FITSImage *MapFITSImage ( FILE *, long );
+
+/**************************  GetFITSImageDataRow  *****************************
+
+	Returns a pointer to one row of a FITSImage's image data.
+	
+	PIXEL *GetFITSImageDataRow ( FITSImage *image, long frame, long row )
+	
+	(image): pointer to FITSImage structure.
+	(frame): zero-based index of frame in image data matrix.
+	(row):   zero-based index of row in frame.
+	
+	The function returns a pointer to an array of (naxis1) pixel values,
+	or NULL if the frame or row is outside the image data matrix, or if the
+	row could not be read.
+	
+	For images whose data matrix is in memory (i.e. the "data" member is not
+	NULL) this simply returns image->data[frame][row].  For images opened
+	with MapFITSImage(), the row is decoded from the file the first time
+	it is requested, and kept in a cache from which the least-recently-used
+	rows are discarded when it is full.  A pointer returned for a mapped
+	image remains valid until at least (cache - 1) other rows have been
+	requested, and must be treated as read-only.  This function is not
+	safe to call on the same mapped image from more than one thread at once.
+	
+******************************************************************************/
+
+PIXEL *GetFITSImageDataRow ( FITSImage *, long, long );
+
 /****************************  WriteFITSImage  *******************************
 
 	Writes image header and/or data information from a FITSImage record
@@ -3553,7 +3785,8 @@ int WriteFITSImage ( FILE *, FITSImage * );
 	in the existing FITS image data matrix into corresponding locations in the
 	new FITS image data matrix.  Pixels in the new image data matrix which have
 	no corresponding location in the previous matrix (e.g. if the new image is
-	larger than the old one) will be initialized with zeros.
+	larger than the old one) will be initialized with zeros.  The old image may
+	be one opened with MapFITSImage(); the new image's data is always in memory.
 	
 	If (copy) is FALSE, image data values are NOT copied from the old FITS image
 	into the new one; the new FITS image's data matrix contains uninitialized
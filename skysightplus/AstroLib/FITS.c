@@ -30,6 +30,48 @@ MODIFICATION HISTORY:
 
 #include "AstroLib.h"
 
+/*** Approximate size, in bytes, of the buffer used for reading and writing
+     FITS image data matrices in multi-row blocks. ***/
+
+#define FITS_BUFFER_SIZE	1048576L
+
+/*** Default size, in bytes, of the decoded row cache used for FITS images
+     opened with MapFITSImage(). ***/
+
+#define FITS_CACHE_SIZE		16777216L
+
+/*** Approximate size, in bytes, of the window of the file which is mapped
+     into memory at once by MapFITSImage().  Only this much address space is
+     used, however large the file. ***/
+
+#define FITS_MAP_WINDOW		67108864L
+
+/*** Platform headers for memory-mapped file access.  On platforms other
+     than these, MapFITSImage() reads rows from the file as needed.  File
+     positions are 64-bit where the platform allows, so that files larger
+     than 2 GB can be mapped. ***/
+
+#if defined ( _WIN32 )
+#define FITS_WIN32_MAPPING
+#include <windows.h>
+#include <io.h>
+typedef __int64		FITSFileOffset;
+#define FITSSeek	_fseeki64
+#define FITSTell	_ftelli64
+#elif defined ( unix ) || defined ( __unix__ ) || defined ( __APPLE__ )
+#define FITS_POSIX_MAPPING
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <unistd.h>
+typedef off_t		FITSFileOffset;
+#define FITSSeek	fseeko
+#define FITSTell	ftello
+#else
+typedef long		FITSFileOffset;
+#define FITSSeek	fseek
+#define FITSTell	ftell
+#endif
+
 /***********************  NewFITSHeader  *************************/
 
 int NewFITSHeader ( char ***header )
@@ -539,222 +581,701 @@ long *naxis1, long *naxis2, long *naxis3, double *bzero, double *bscale )
 
 void ByteSwap ( void *buffer, long num, short size )
 {
-	short	i;
-	char	temp, *ptr1, *ptr2;
-	
-	for ( i = 0; i < num; i++ )
+	long			i;
+	unsigned char	temp, *ptr1, *ptr2;
+
+	/*** The common sizes get their own loops, which swap one whole value
+	     per iteration instead of walking pointers through each one. ***/
+
+	ptr1 = (unsigned char *) buffer;
+
+	if ( size == 2 )
+	{
+		for ( i = 0; i < num; i++, ptr1 += 2 )
+		{
+			temp = ptr1[0]; ptr1[0] = ptr1[1]; ptr1[1] = temp;
+		}
+	}
+	else if ( size == 4 )
+	{
+		for ( i = 0; i < num; i++, ptr1 += 4 )
+		{
+			temp = ptr1[0]; ptr1[0] = ptr1[3]; ptr1[3] = temp;
+			temp = ptr1[1]; ptr1[1] = ptr1[2]; ptr1[2] = temp;
+		}
+	}
+	else if ( size == 8 )
 	{
-		ptr1 = (char *) buffer + size * i;
-		for ( ptr2 = ptr1 + size - 1; ptr1 < ptr2; ptr1++, ptr2-- )
+		for ( i = 0; i < num; i++, ptr1 += 8 )
 		{
-			temp = *ptr1;
-			*ptr1 = *ptr2;
-			*ptr2 = temp;
+			temp = ptr1[0]; ptr1[0] = ptr1[7]; ptr1[7] = temp;
+			temp = ptr1[1]; ptr1[1] = ptr1[6]; ptr1[6] = temp;
+			temp = ptr1[2]; ptr1[2] = ptr1[5]; ptr1[5] = temp;
+			temp = ptr1[3]; ptr1[3] = ptr1[4]; ptr1[4] = temp;
+		}
+	}
+	else
+	{
+		for ( i = 0; i < num; i++ )
+		{
+			ptr1 = (unsigned char *) buffer + size * i;
+			for ( ptr2 = ptr1 + size - 1; ptr1 < ptr2; ptr1++, ptr2-- )
+			{
+				temp = *ptr1;
+				*ptr1 = *ptr2;
+				*ptr2 = temp;
+			}
 		}
 	}
 }
 
-/************************  ReadFITSImageDataRow  ************************/
+/*** Raw FITS data is always big-endian.  These read and write a single
+     raw value regardless of the native byte order; the conversion loops
+     below use them for the pixels the SSE2 code doesn't handle. ***/
 
-int ReadFITSImageDataRow ( FILE *file, long bitpix, long naxis1, double bzero,
-double bscale, PIXEL *data )
+typedef union FITSValue32 { unsigned int u; int i; float f; } FITSValue32;
+typedef union FITSValue64 { unsigned char b[8]; DOUBLE d; } FITSValue64;
+
+static short GetFITSInt16 ( unsigned char *raw )
 {
-	int				result = FALSE;
-	long			col, size;
-	char			*buffer;
-	unsigned char	*buffer8;
-	short			*buffer16;
-	long			*buffer32;
-	float			*buffer32f;
-	DOUBLE			*buffer64f;
-	
-	/*** Compute the number of bytes occupied by a raw image data row.
-	     Allocate memory to hold the raw image data; on failure,
-	     return an error code. ***/
-	     
-	size = naxis1 * abs ( bitpix / 8 );
-	buffer = malloc ( size );
-	if ( buffer == NULL )
-		return ( FALSE );
-	
-	/*** Read the image data row into the buffer allocated above;
-	     on failure, return an error code. ***/
-		
-	if ( fread ( buffer, size, 1, file ) != 1 )
+	return ( (short) ( ( raw[0] << 8 ) | raw[1] ) );
+}
+
+static unsigned int GetFITSInt32 ( unsigned char *raw )
+{
+	return ( ( (unsigned int) raw[0] << 24 ) | ( (unsigned int) raw[1] << 16 )
+	       | ( (unsigned int) raw[2] << 8 ) | (unsigned int) raw[3] );
+}
+
+static DOUBLE GetFITSFloat64 ( unsigned char *raw )
+{
+	FITSValue64	value;
+	short		k;
+
+	for ( k = 0; k < 8; k++ )
+#if BYTESWAP
+		value.b[k] = raw[7 - k];
+#else
+		value.b[k] = raw[k];
+#endif
+
+	return ( value.d );
+}
+
+static void PutFITSInt16 ( unsigned char *raw, short value )
+{
+	raw[0] = (unsigned char) ( ( value >> 8 ) & 0xFF );
+	raw[1] = (unsigned char) ( value & 0xFF );
+}
+
+static void PutFITSInt32 ( unsigned char *raw, unsigned int value )
+{
+	raw[0] = (unsigned char) ( value >> 24 );
+	raw[1] = (unsigned char) ( value >> 16 );
+	raw[2] = (unsigned char) ( value >> 8 );
+	raw[3] = (unsigned char) value;
+}
+
+static void PutFITSFloat64 ( unsigned char *raw, DOUBLE d )
+{
+	FITSValue64	value;
+	short		k;
+
+	value.d = d;
+	for ( k = 0; k < 8; k++ )
+#if BYTESWAP
+		raw[k] = value.b[7 - k];
+#else
+		raw[k] = value.b[k];
+#endif
+}
+
+/*** Clipping applied when converting pixel values to integer raw data.
+     The C language leaves out-of-range conversions undefined; clipping
+     here makes the scalar code agree with the saturating SSE2 code.
+     Undefined (NaN) values are clipped to the minimum, as in SSE2. ***/
+
+static double ClipFITSValue ( double value, double min, double max )
+{
+	if ( ! ( value >= min ) )
+		return ( min );
+
+	if ( value > max )
+		return ( max );
+
+	return ( value );
+}
+
+/*** The SSE2 conversion loops below only apply when pixels are stored
+     internally as single-precision floating point values, which is by
+     far the most common configuration.  Intel processors are all little-
+     endian, so these loops always byte-swap. ***/
+
+#if SSE2 && BITPIX == -32
+#define FITS_SSE2	TRUE
+#else
+#define FITS_SSE2	FALSE
+#endif
+
+#if FITS_SSE2
+
+static __m128i SwapFITSInt32x4 ( __m128i v )
+{
+	v = _mm_or_si128 ( _mm_slli_epi16 ( v, 8 ), _mm_srli_epi16 ( v, 8 ) );
+	return ( _mm_shufflehi_epi16 ( _mm_shufflelo_epi16 ( v, 0xB1 ), 0xB1 ) );
+}
+
+static __m128i SwapFITSFloat64x2 ( __m128i v )
+{
+	return ( SwapFITSInt32x4 ( _mm_shuffle_epi32 ( v, 0xB1 ) ) );
+}
+
+static __m128 ScaleFITSInt32x4 ( __m128i v, __m128d scale, __m128d zero )
+{
+	__m128d lo = _mm_add_pd ( _mm_mul_pd ( _mm_cvtepi32_pd ( v ), scale ), zero );
+	__m128d hi = _mm_add_pd ( _mm_mul_pd ( _mm_cvtepi32_pd ( _mm_srli_si128 ( v, 8 ) ), scale ), zero );
+
+	return ( _mm_movelh_ps ( _mm_cvtpd_ps ( lo ), _mm_cvtpd_ps ( hi ) ) );
+}
+
+static __m128i UnscaleFITSInt32x4 ( __m128 v, __m128d zero, __m128d scale, __m128d min, __m128d max )
+{
+	__m128d lo = _mm_div_pd ( _mm_sub_pd ( _mm_cvtps_pd ( v ), zero ), scale );
+	__m128d hi = _mm_div_pd ( _mm_sub_pd ( _mm_cvtps_pd ( _mm_movehl_ps ( v, v ) ), zero ), scale );
+
+	lo = _mm_min_pd ( _mm_max_pd ( lo, min ), max );
+	hi = _mm_min_pd ( _mm_max_pd ( hi, min ), max );
+
+	return ( _mm_unpacklo_epi64 ( _mm_cvttpd_epi32 ( lo ), _mm_cvttpd_epi32 ( hi ) ) );
+}
+
+#endif
+
+/*** DecodeFITSInt8 ***/
+
+static void DecodeFITSInt8 ( unsigned char *raw, long n, double bzero, double bscale, PIXEL *data )
+{
+	long	col = 0;
+#if FITS_SSE2
+	__m128i	zero = _mm_setzero_si128(), v, lo, hi;
+	__m128d	scale = _mm_set1_pd ( bscale ), offset = _mm_set1_pd ( bzero );
+#endif
+
+	if ( bzero != 0.0 || bscale != 1.0 )
 	{
-		free ( buffer );
-		return ( FALSE );
+#if FITS_SSE2
+		for ( ; col + 16 <= n; col += 16 )
+		{
+			v  = _mm_loadu_si128 ( (__m128i *) ( raw + col ) );
+			lo = _mm_unpacklo_epi8 ( v, zero );
+			hi = _mm_unpackhi_epi8 ( v, zero );
+			_mm_storeu_ps ( data + col,      ScaleFITSInt32x4 ( _mm_unpacklo_epi16 ( lo, zero ), scale, offset ) );
+			_mm_storeu_ps ( data + col + 4,  ScaleFITSInt32x4 ( _mm_unpackhi_epi16 ( lo, zero ), scale, offset ) );
+			_mm_storeu_ps ( data + col + 8,  ScaleFITSInt32x4 ( _mm_unpacklo_epi16 ( hi, zero ), scale, offset ) );
+			_mm_storeu_ps ( data + col + 12, ScaleFITSInt32x4 ( _mm_unpackhi_epi16 ( hi, zero ), scale, offset ) );
+		}
+#endif
+		for ( ; col < n; col++ )
+			data[col] = raw[col] * bscale + bzero;
 	}
-	
-	/*** If necessary, byte-swap the raw image data. ***/
-			
-#if BYTESWAP
-	ByteSwap ( buffer, naxis1, abs ( bitpix / 8 ) );
+	else
+	{
+#if FITS_SSE2
+		for ( ; col + 16 <= n; col += 16 )
+		{
+			v  = _mm_loadu_si128 ( (__m128i *) ( raw + col ) );
+			lo = _mm_unpacklo_epi8 ( v, zero );
+			hi = _mm_unpackhi_epi8 ( v, zero );
+			_mm_storeu_ps ( data + col,      _mm_cvtepi32_ps ( _mm_unpacklo_epi16 ( lo, zero ) ) );
+			_mm_storeu_ps ( data + col + 4,  _mm_cvtepi32_ps ( _mm_unpackhi_epi16 ( lo, zero ) ) );
+			_mm_storeu_ps ( data + col + 8,  _mm_cvtepi32_ps ( _mm_unpacklo_epi16 ( hi, zero ) ) );
+			_mm_storeu_ps ( data + col + 12, _mm_cvtepi32_ps ( _mm_unpackhi_epi16 ( hi, zero ) ) );
+		}
 #endif
+		for ( ; col < n; col++ )
+			data[col] = raw[col];
+	}
+}
+
+/*** DecodeFITSInt16 ***/
+
+static void DecodeFITSInt16 ( unsigned char *raw, long n, double bzero, double bscale, PIXEL *data )
+{
+	long	col = 0;
+#if FITS_SSE2
+	__m128i	v, lo, hi;
+	__m128d	scale = _mm_set1_pd ( bscale ), offset = _mm_set1_pd ( bzero );
+#endif
+
+	if ( bzero != 0.0 || bscale != 1.0 )
+	{
+#if FITS_SSE2
+		for ( ; col + 8 <= n; col += 8 )
+		{
+			v  = _mm_loadu_si128 ( (__m128i *) ( raw + 2 * col ) );
+			v  = _mm_or_si128 ( _mm_slli_epi16 ( v, 8 ), _mm_srli_epi16 ( v, 8 ) );
+			lo = _mm_srai_epi32 ( _mm_unpacklo_epi16 ( v, v ), 16 );
+			hi = _mm_srai_epi32 ( _mm_unpackhi_epi16 ( v, v ), 16 );
+			_mm_storeu_ps ( data + col,     ScaleFITSInt32x4 ( lo, scale, offset ) );
+			_mm_storeu_ps ( data + col + 4, ScaleFITSInt32x4 ( hi, scale, offset ) );
+		}
+#endif
+		for ( ; col < n; col++ )
+			data[col] = GetFITSInt16 ( raw + 2 * col ) * bscale + bzero;
+	}
+	else
+	{
+#if FITS_SSE2
+		for ( ; col + 8 <= n; col += 8 )
+		{
+			v  = _mm_loadu_si128 ( (__m128i *) ( raw + 2 * col ) );
+			v  = _mm_or_si128 ( _mm_slli_epi16 ( v, 8 ), _mm_srli_epi16 ( v, 8 ) );
+			lo = _mm_srai_epi32 ( _mm_unpacklo_epi16 ( v, v ), 16 );
+			hi = _mm_srai_epi32 ( _mm_unpackhi_epi16 ( v, v ), 16 );
+			_mm_storeu_ps ( data + col,     _mm_cvtepi32_ps ( lo ) );
+			_mm_storeu_ps ( data + col + 4, _mm_cvtepi32_ps ( hi ) );
+		}
+#endif
+		for ( ; col < n; col++ )
+			data[col] = GetFITSInt16 ( raw + 2 * col );
+	}
+}
+
+/*** DecodeFITSInt32 ***/
+
+static void DecodeFITSInt32 ( unsigned char *raw, long n, double bzero, double bscale, PIXEL *data )
+{
+	long		col = 0;
+	FITSValue32	value;
+#if FITS_SSE2
+	__m128i		v;
+	__m128d		scale = _mm_set1_pd ( bscale ), offset = _mm_set1_pd ( bzero );
+#endif
+
+	if ( bzero != 0.0 || bscale != 1.0 )
+	{
+#if FITS_SSE2
+		for ( ; col + 4 <= n; col += 4 )
+		{
+			v = SwapFITSInt32x4 ( _mm_loadu_si128 ( (__m128i *) ( raw + 4 * col ) ) );
+			_mm_storeu_ps ( data + col, ScaleFITSInt32x4 ( v, scale, offset ) );
+		}
+#endif
+		for ( ; col < n; col++ )
+		{
+			value.u = GetFITSInt32 ( raw + 4 * col );
+			data[col] = value.i * bscale + bzero;
+		}
+	}
+	else
+	{
+#if FITS_SSE2
+		for ( ; col + 4 <= n; col += 4 )
+		{
+			v = SwapFITSInt32x4 ( _mm_loadu_si128 ( (__m128i *) ( raw + 4 * col ) ) );
+			_mm_storeu_ps ( data + col, _mm_cvtepi32_ps ( v ) );
+		}
+#endif
+		for ( ; col < n; col++ )
+		{
+			value.u = GetFITSInt32 ( raw + 4 * col );
+			data[col] = value.i;
+		}
+	}
+}
+
+/*** DecodeFITSFloat32 ***/
+
+static void DecodeFITSFloat32 ( unsigned char *raw, long n, double bzero, double bscale, PIXEL *data )
+{
+	long		col = 0;
+	FITSValue32	value;
+#if FITS_SSE2
+	__m128		v;
+	__m128d		lo, hi, scale = _mm_set1_pd ( bscale ), offset = _mm_set1_pd ( bzero );
+#endif
+
+	if ( bzero != 0.0 || bscale != 1.0 )
+	{
+#if FITS_SSE2
+		for ( ; col + 4 <= n; col += 4 )
+		{
+			v  = _mm_castsi128_ps ( SwapFITSInt32x4 ( _mm_loadu_si128 ( (__m128i *) ( raw + 4 * col ) ) ) );
+			lo = _mm_add_pd ( _mm_mul_pd ( _mm_cvtps_pd ( v ), scale ), offset );
+			hi = _mm_add_pd ( _mm_mul_pd ( _mm_cvtps_pd ( _mm_movehl_ps ( v, v ) ), scale ), offset );
+			_mm_storeu_ps ( data + col, _mm_movelh_ps ( _mm_cvtpd_ps ( lo ), _mm_cvtpd_ps ( hi ) ) );
+		}
+#endif
+		for ( ; col < n; col++ )
+		{
+			value.u = GetFITSInt32 ( raw + 4 * col );
+			data[col] = value.f * bscale + bzero;
+		}
+	}
+	else
+	{
+#if FITS_SSE2
+		for ( ; col + 4 <= n; col += 4 )
+		{
+			v = _mm_castsi128_ps ( SwapFITSInt32x4 ( _mm_loadu_si128 ( (__m128i *) ( raw + 4 * col ) ) ) );
+			_mm_storeu_ps ( data + col, v );
+		}
+#endif
+		for ( ; col < n; col++ )
+		{
+			value.u = GetFITSInt32 ( raw + 4 * col );
+			data[col] = value.f;
+		}
+	}
+}
+
+/*** DecodeFITSFloat64 ***/
+
+static void DecodeFITSFloat64 ( unsigned char *raw, long n, double bzero, double bscale, PIXEL *data )
+{
+	long	col = 0;
+#if FITS_SSE2
+	__m128d	lo, hi, scale = _mm_set1_pd ( bscale ), offset = _mm_set1_pd ( bzero );
+#endif
+
+	if ( bzero != 0.0 || bscale != 1.0 )
+	{
+#if FITS_SSE2
+		for ( ; col + 4 <= n; col += 4 )
+		{
+			lo = _mm_castsi128_pd ( SwapFITSFloat64x2 ( _mm_loadu_si128 ( (__m128i *) ( raw + 8 * col ) ) ) );
+			hi = _mm_castsi128_pd ( SwapFITSFloat64x2 ( _mm_loadu_si128 ( (__m128i *) ( raw + 8 * col + 16 ) ) ) );
+			lo = _mm_add_pd ( _mm_mul_pd ( lo, scale ), offset );
+			hi = _mm_add_pd ( _mm_mul_pd ( hi, scale ), offset );
+			_mm_storeu_ps ( data + col, _mm_movelh_ps ( _mm_cvtpd_ps ( lo ), _mm_cvtpd_ps ( hi ) ) );
+		}
+#endif
+		for ( ; col < n; col++ )
+			data[col] = GetFITSFloat64 ( raw + 8 * col ) * bscale + bzero;
+	}
+	else
+	{
+#if FITS_SSE2
+		for ( ; col + 4 <= n; col += 4 )
+		{
+			lo = _mm_castsi128_pd ( SwapFITSFloat64x2 ( _mm_loadu_si128 ( (__m128i *) ( raw + 8 * col ) ) ) );
+			hi = _mm_castsi128_pd ( SwapFITSFloat64x2 ( _mm_loadu_si128 ( (__m128i *) ( raw + 8 * col + 16 ) ) ) );
+			_mm_storeu_ps ( data + col, _mm_movelh_ps ( _mm_cvtpd_ps ( lo ), _mm_cvtpd_ps ( hi ) ) );
+		}
+#endif
+		for ( ; col < n; col++ )
+			data[col] = GetFITSFloat64 ( raw + 8 * col );
+	}
+}
+
+/************************  DecodeFITSImageData  *************************/
+
+void DecodeFITSImageData ( void *buffer, long bitpix, long num, double bzero,
+double bscale, PIXEL *data )
+{
+	unsigned char *raw = (unsigned char *) buffer;
 
-	/*** Now copy the raw image data into the output image data row
-	     buffer, applying offset, scaling and casting to the correct
-	     data type. ***/
-	     
 	switch ( bitpix )
 	{
 		case 8:
-			buffer8 = (unsigned char *) buffer;
-			if ( bzero != 0.0 || bscale != 1.0 )
-				for ( col = 0; col < naxis1; col++ )
-					data[col] = buffer8[col] * bscale + bzero;
-			else		
-				for ( col = 0; col < naxis1; col++ )
-					data[col] = buffer8[col];
+			DecodeFITSInt8 ( raw, num, bzero, bscale, data );
 			break;
-		
+
 		case 16:
-			buffer16 = (signed short *) buffer;
-			if ( bzero != 0.0 || bscale != 1.0 )
-				for ( col = 0; col < naxis1; col++ )
-					data[col] = buffer16[col] * bscale + bzero;
-			else
-				for ( col = 0; col < naxis1; col++ )
-					data[col] = buffer16[col];
+			DecodeFITSInt16 ( raw, num, bzero, bscale, data );
 			break;
 
 		case 32:
-			buffer32 = (signed long *) buffer;
-			if ( bzero != 0.0 || bscale != 1.0 )
-				for ( col = 0; col < naxis1; col++ )
-					data[col] = buffer32[col] * bscale + bzero;
-			else
-				for ( col = 0; col < naxis1; col++ )
-					data[col] = buffer32[col];
+			DecodeFITSInt32 ( raw, num, bzero, bscale, data );
 			break;
 
 		case -32:
-			buffer32f = (float *) buffer;
-			if ( bzero != 0.0 || bscale != 1.0 )
-				for ( col = 0; col < naxis1; col++ )
-					data[col] = buffer32f[col] * bscale + bzero;
-			else
-				for ( col = 0; col < naxis1; col++ )
-					data[col] = buffer32f[col];
+			DecodeFITSFloat32 ( raw, num, bzero, bscale, data );
 			break;
 
 		case -64:
-			buffer64f = (DOUBLE *) buffer;
-			if ( bzero != 0.0 || bscale != 1.0 )
-				for ( col = 0; col < naxis1; col++ )
-					data[col] = buffer64f[col] * bscale + bzero;
-			else
-				for ( col = 0; col < naxis1; col++ )
-					data[col] = buffer64f[col];
+			DecodeFITSFloat64 ( raw, num, bzero, bscale, data );
 			break;
 	}
+}
 
-	/*** Free the raw image data buffer; return a successul
-	     result code. ***/
-	     					
-	free ( buffer );
-	return ( TRUE );
+/*** EncodeFITSInt8 ***/
+
+static void EncodeFITSInt8 ( PIXEL *data, long n, double bzero, double bscale, unsigned char *raw )
+{
+	long	col = 0;
+#if FITS_SSE2
+	__m128i	v0, v1, v2, v3;
+	__m128d	scale = _mm_set1_pd ( bscale ), offset = _mm_set1_pd ( bzero );
+	__m128d	min = _mm_set1_pd ( 0.0 ), max = _mm_set1_pd ( UCHAR_MAX );
+
+	for ( ; col + 16 <= n; col += 16 )
+	{
+		v0 = UnscaleFITSInt32x4 ( _mm_loadu_ps ( data + col ),      offset, scale, min, max );
+		v1 = UnscaleFITSInt32x4 ( _mm_loadu_ps ( data + col + 4 ),  offset, scale, min, max );
+		v2 = UnscaleFITSInt32x4 ( _mm_loadu_ps ( data + col + 8 ),  offset, scale, min, max );
+		v3 = UnscaleFITSInt32x4 ( _mm_loadu_ps ( data + col + 12 ), offset, scale, min, max );
+		v0 = _mm_packus_epi16 ( _mm_packs_epi32 ( v0, v1 ), _mm_packs_epi32 ( v2, v3 ) );
+		_mm_storeu_si128 ( (__m128i *) ( raw + col ), v0 );
+	}
+#endif
+	for ( ; col < n; col++ )
+		raw[col] = (unsigned char) ClipFITSValue ( ( data[col] - bzero ) / bscale, 0.0, UCHAR_MAX );
 }
 
-/***********************  WriteFITSImageDataRow  ***********************/
+/*** EncodeFITSInt16 ***/
 
-int WriteFITSImageDataRow ( FILE *file, long bitpix, long naxis1, double bzero,
-double bscale, PIXEL *data )
+static void EncodeFITSInt16 ( PIXEL *data, long n, double bzero, double bscale, unsigned char *raw )
 {
-	int				result = FALSE;
-	long			col, size;
-	char			*buffer;
-	unsigned char	*buffer8;
-	short			*buffer16;
-	long			*buffer32;
-	float			*buffer32f;
-	DOUBLE			*buffer64f;
-	
-	/*** Compute the number of bytes occupied by a raw image data row.
-	     Allocate memory to hold the raw image data; on failure,
-	     return an error code. ***/
-	     
-	size = naxis1 * abs ( bitpix / 8 );
-	buffer = malloc ( size );
-	if ( buffer == NULL )
-		return ( FALSE );
-		
-	/*** Now copy the image data row into the raw image datya buffer,
-	     buffer, applying offset, scaling and casting to the correct
-	     data type. ***/
+	long	col = 0;
+#if FITS_SSE2
+	__m128i	v0, v1;
+	__m128d	scale = _mm_set1_pd ( bscale ), offset = _mm_set1_pd ( bzero );
+	__m128d	min = _mm_set1_pd ( SHRT_MIN ), max = _mm_set1_pd ( SHRT_MAX );
+
+	for ( ; col + 8 <= n; col += 8 )
+	{
+		v0 = UnscaleFITSInt32x4 ( _mm_loadu_ps ( data + col ),     offset, scale, min, max );
+		v1 = UnscaleFITSInt32x4 ( _mm_loadu_ps ( data + col + 4 ), offset, scale, min, max );
+		v0 = _mm_packs_epi32 ( v0, v1 );
+		v0 = _mm_or_si128 ( _mm_slli_epi16 ( v0, 8 ), _mm_srli_epi16 ( v0, 8 ) );
+		_mm_storeu_si128 ( (__m128i *) ( raw + 2 * col ), v0 );
+	}
+#endif
+	for ( ; col < n; col++ )
+		PutFITSInt16 ( raw + 2 * col, (short) ClipFITSValue ( ( data[col] - bzero ) / bscale, SHRT_MIN, SHRT_MAX ) );
+}
+
+/*** EncodeFITSInt32 ***/
+
+static void EncodeFITSInt32 ( PIXEL *data, long n, double bzero, double bscale, unsigned char *raw )
+{
+	long		col = 0;
+	FITSValue32	value;
+#if FITS_SSE2
+	__m128i		v;
+	__m128d		scale = _mm_set1_pd ( bscale ), offset = _mm_set1_pd ( bzero );
+	__m128d		min = _mm_set1_pd ( -2147483648.0 ), max = _mm_set1_pd ( 2147483647.0 );
+
+	for ( ; col + 4 <= n; col += 4 )
+	{
+		v = UnscaleFITSInt32x4 ( _mm_loadu_ps ( data + col ), offset, scale, min, max );
+		_mm_storeu_si128 ( (__m128i *) ( raw + 4 * col ), SwapFITSInt32x4 ( v ) );
+	}
+#endif
+	for ( ; col < n; col++ )
+	{
+		value.i = (int) ClipFITSValue ( ( data[col] - bzero ) / bscale, -2147483648.0, 2147483647.0 );
+		PutFITSInt32 ( raw + 4 * col, value.u );
+	}
+}
+
+/*** EncodeFITSFloat32 ***/
+
+static void EncodeFITSFloat32 ( PIXEL *data, long n, double bzero, double bscale, unsigned char *raw )
+{
+	long		col = 0;
+	FITSValue32	value;
+#if FITS_SSE2
+	__m128		v;
+	__m128d		lo, hi, scale = _mm_set1_pd ( bscale ), offset = _mm_set1_pd ( bzero );
+#endif
+
+	if ( bzero != 0.0 || bscale != 1.0 )
+	{
+#if FITS_SSE2
+		for ( ; col + 4 <= n; col += 4 )
+		{
+			v  = _mm_loadu_ps ( data + col );
+			lo = _mm_div_pd ( _mm_sub_pd ( _mm_cvtps_pd ( v ), offset ), scale );
+			hi = _mm_div_pd ( _mm_sub_pd ( _mm_cvtps_pd ( _mm_movehl_ps ( v, v ) ), offset ), scale );
+			v  = _mm_movelh_ps ( _mm_cvtpd_ps ( lo ), _mm_cvtpd_ps ( hi ) );
+			_mm_storeu_si128 ( (__m128i *) ( raw + 4 * col ), SwapFITSInt32x4 ( _mm_castps_si128 ( v ) ) );
+		}
+#endif
+		for ( ; col < n; col++ )
+		{
+			value.f = (float) ( ( data[col] - bzero ) / bscale );
+			PutFITSInt32 ( raw + 4 * col, value.u );
+		}
+	}
+	else
+	{
+#if FITS_SSE2
+		for ( ; col + 4 <= n; col += 4 )
+		{
+			v = _mm_loadu_ps ( data + col );
+			_mm_storeu_si128 ( (__m128i *) ( raw + 4 * col ), SwapFITSInt32x4 ( _mm_castps_si128 ( v ) ) );
+		}
+#endif
+		for ( ; col < n; col++ )
+		{
+			value.f = data[col];
+			PutFITSInt32 ( raw + 4 * col, value.u );
+		}
+	}
+}
+
+/*** EncodeFITSFloat64 ***/
+
+static void EncodeFITSFloat64 ( PIXEL *data, long n, double bzero, double bscale, unsigned char *raw )
+{
+	long	col = 0;
+#if FITS_SSE2
+	__m128	v;
+	__m128d	lo, hi, scale = _mm_set1_pd ( bscale ), offset = _mm_set1_pd ( bzero );
+#endif
+
+	if ( bzero != 0.0 || bscale != 1.0 )
+	{
+#if FITS_SSE2
+		for ( ; col + 4 <= n; col += 4 )
+		{
+			v  = _mm_loadu_ps ( data + col );
+			lo = _mm_div_pd ( _mm_sub_pd ( _mm_cvtps_pd ( v ), offset ), scale );
+			hi = _mm_div_pd ( _mm_sub_pd ( _mm_cvtps_pd ( _mm_movehl_ps ( v, v ) ), offset ), scale );
+			_mm_storeu_si128 ( (__m128i *) ( raw + 8 * col ),      SwapFITSFloat64x2 ( _mm_castpd_si128 ( lo ) ) );
+			_mm_storeu_si128 ( (__m128i *) ( raw + 8 * col + 16 ), SwapFITSFloat64x2 ( _mm_castpd_si128 ( hi ) ) );
+		}
+#endif
+		for ( ; col < n; col++ )
+			PutFITSFloat64 ( raw + 8 * col, ( data[col] - bzero ) / bscale );
+	}
+	else
+	{
+#if FITS_SSE2
+		for ( ; col + 4 <= n; col += 4 )
+		{
+			v  = _mm_loadu_ps ( data + col );
+			lo = _mm_cvtps_pd ( v );
+			hi = _mm_cvtps_pd ( _mm_movehl_ps ( v, v ) );
+			_mm_storeu_si128 ( (__m128i *) ( raw + 8 * col ),      SwapFITSFloat64x2 ( _mm_castpd_si128 ( lo ) ) );
+			_mm_storeu_si128 ( (__m128i *) ( raw + 8 * col + 16 ), SwapFITSFloat64x2 ( _mm_castpd_si128 ( hi ) ) );
+		}
+#endif
+		for ( ; col < n; col++ )
+			PutFITSFloat64 ( raw + 8 * col, data[col] );
+	}
+}
+
+/************************  EncodeFITSImageData  *************************/
+
+void EncodeFITSImageData ( PIXEL *data, long bitpix, long num, double bzero,
+double bscale, void *buffer )
+{
+	unsigned char *raw = (unsigned char *) buffer;
 
 	switch ( bitpix )
 	{
 		case 8:
-			buffer8 = (unsigned char *) buffer;
-			if ( bzero != 0.0 || bscale != 1.0 )
-				for ( col = 0; col < naxis1; col++ )
-					buffer8[col] = ( data[col] - bzero ) / bscale;
-			else
-				for ( col = 0; col < naxis1; col++ )
-					buffer8[col] = data[col];
+			EncodeFITSInt8 ( data, num, bzero, bscale, raw );
 			break;
-		
+
 		case 16:
-			buffer16 = (signed short *) buffer;
-			if ( bzero != 0.0 || bscale != 1.0 )
-				for ( col = 0; col < naxis1; col++ )
-					buffer16[col] = ( data[col] - bzero ) / bscale;
-			else
-				for ( col = 0; col < naxis1; col++ )
-					buffer16[col] = data[col];
+			EncodeFITSInt16 ( data, num, bzero, bscale, raw );
 			break;
 
 		case 32:
-			buffer32 = (signed long *) buffer;
-			if ( bzero != 0.0 || bscale != 1.0 )
-				for ( col = 0; col < naxis1; col++ )
-					buffer32[col] = ( data[col] - bzero ) / bscale;
-			else
-				for ( col = 0; col < naxis1; col++ )
-					buffer32[col] = data[col];
+			EncodeFITSInt32 ( data, num, bzero, bscale, raw );
 			break;
 
 		case -32:
-			buffer32f = (float *) buffer;
-			if ( bzero != 0.0 || bscale != 1.0 )
-				for ( col = 0; col < naxis1; col++ )
-					buffer32f[col] = ( data[col] - bzero ) / bscale;
-			else
-				for ( col = 0; col < naxis1; col++ )
-					buffer32f[col] = data[col];
+			EncodeFITSFloat32 ( data, num, bzero, bscale, raw );
 			break;
 
 		case -64:
-			buffer64f = (DOUBLE *) buffer;
-			if ( bzero != 0.0 || bscale != 1.0 )
-				for ( col = 0; col < naxis1; col++ )
-					buffer64f[col] = ( data[col] - bzero ) / bscale;
-			else
-				for ( col = 0; col < naxis1; col++ )
-					buffer64f[col] = data[col];
+			EncodeFITSFloat64 ( data, num, bzero, bscale, raw );
 			break;
 	}
+}
+
+/************************  ReadFITSImageDataBlock  *********************/
+
+int ReadFITSImageDataBlock ( FILE *file, long bitpix, long naxis1, long nrows,
+double bzero, double bscale, PIXEL **rows, void *buffer )
+{
+	long	row, size;
+	char	*raw = (char *) buffer;
+
+	/*** Compute the number of bytes occupied by a raw image data row.
+	     If the caller did not supply a buffer to hold all of the rows,
+	     allocate one now; on failure, return an error code. ***/
+
+	size = naxis1 * abs ( bitpix / 8 );
+	if ( raw == NULL )
+	{
+		raw = malloc ( size * nrows );
+		if ( raw == NULL )
+			return ( FALSE );
+	}
+
+	/*** Read all of the raw image data rows into the buffer at once;
+	     then decode each row into its place in the output. ***/
+
+	if ( fread ( raw, size, nrows, file ) != (size_t) nrows )
+	{
+		if ( buffer == NULL )
+			free ( raw );
+		return ( FALSE );
+	}
+
+	for ( row = 0; row < nrows; row++ )
+		DecodeFITSImageData ( raw + row * size, bitpix, naxis1, bzero, bscale, rows[row] );
+
+	if ( buffer == NULL )
+		free ( raw );
+
+	return ( TRUE );
+}
+
+/************************  WriteFITSImageDataBlock  ********************/
+
+int WriteFITSImageDataBlock ( FILE *file, long bitpix, long naxis1, long nrows,
+double bzero, double bscale, PIXEL **rows, void *buffer )
+{
+	int		result = FALSE;
+	long	row, size;
+	char	*raw = (char *) buffer;
+
+	size = naxis1 * abs ( bitpix / 8 );
+	if ( raw == NULL )
+	{
+		raw = malloc ( size * nrows );
+		if ( raw == NULL )
+			return ( FALSE );
+	}
 
-	/*** If necessary, byte-swap the raw image data. ***/
+	/*** Encode each row into the raw data buffer, then write all of
+	     the rows to the file at once. ***/
 
-#if BYTESWAP
-	ByteSwap ( buffer, naxis1, abs ( bitpix ) / 8 );
-#endif
-	
-	/*** Write the image data into the output file; if successful,
-	     set a successful result code. ***/
+	for ( row = 0; row < nrows; row++ )
+		EncodeFITSImageData ( rows[row], bitpix, naxis1, bzero, bscale, raw + row * size );
 
-	if ( fwrite ( buffer, size, 1, file ) == 1 )
+	if ( fwrite ( raw, size, nrows, file ) == (size_t) nrows )
 		result = TRUE;
 
-	/*** Free the raw image data buffer; return
-	     the result code. ***/
+	if ( buffer == NULL )
+		free ( raw );
 
-	free ( buffer );
 	return ( result );
 }
 
+/************************  ReadFITSImageDataRow  ************************/
+
+int ReadFITSImageDataRow ( FILE *file, long bitpix, long naxis1, double bzero,
+double bscale, PIXEL *data )
+{
+	return ( ReadFITSImageDataBlock ( file, bitpix, naxis1, 1, bzero, bscale, &data, NULL ) );
+}
+
+/***********************  WriteFITSImageDataRow  ***********************/
+
+int WriteFITSImageDataRow ( FILE *file, long bitpix, long naxis1, double bzero,
+double bscale, PIXEL *data )
+{
+	return ( WriteFITSImageDataBlock ( file, bitpix, naxis1, 1, bzero, bscale, &data, NULL ) );
+}
+
 /********************  ReadFITSImageDataPadding  **********************/
 
 int ReadFITSImageDataPadding ( FILE *file, long bitpix, long naxis,
@@ -836,27 +1357,67 @@ long naxis1, long naxis2, long naxis3 )
 	return ( result );
 }
 
+/*** FITSImageDataInfo ***********************************************************
+
+	Private record stored at the start of the memory block allocated for a FITS
+	image data matrix, immediately before the matrix's table of frame pointers.
+	Its size is a multiple of 16 bytes so the pointer table which follows is
+	properly aligned.
+
+*********************************************************************************/
+
+typedef struct FITSImageDataInfo
+{
+	long	stride;		/* number of pixels from one row to the next */
+}
+FITSImageDataInfo;
+
+#define FITS_DATA_INFO_SIZE	( ( sizeof ( FITSImageDataInfo ) + 15 ) & ~15 )
+
 /*************************  NewFITSImageDataMatrix  ****************************/
 
 PIXEL ***NewFITSImageDataMatrix ( long naxis1, long naxis2, long naxis3 )
 {
-	PIXEL ***matrix;
-	long j, k;
+	PIXEL				***matrix, **rows, *data;
+	FITSImageDataInfo	*info;
+	char				*block;
+	long				j, k, stride;
+	size_t				tables, pixels;
 	
-	matrix = (PIXEL ***) malloc ( sizeof ( PIXEL ** ) * ( naxis3 + 1 ) );
-	if ( matrix == NULL )
+	if ( naxis1 < 1 || naxis2 < 1 || naxis3 < 0 )
 		return ( NULL );
-		
-	for ( j = 0; j < naxis3; j++ )
+	
+	/*** Round the row length up to a whole number of aligned blocks.
+	     Then work out the size of the pointer tables, which come first,
+	     and the size of the image data, which follows them. ***/
+	
+	stride = ( ( naxis1 * sizeof ( PIXEL ) + FITS_DATA_ALIGNMENT - 1 ) / FITS_DATA_ALIGNMENT ) * FITS_DATA_ALIGNMENT / sizeof ( PIXEL );
+	tables = FITS_DATA_INFO_SIZE + sizeof ( PIXEL ** ) * ( naxis3 + 1 ) + sizeof ( PIXEL * ) * naxis2 * naxis3;
+	pixels = sizeof ( PIXEL ) * stride * naxis2 * naxis3;
+	
+	/*** Allocate the whole block, with enough room left over to align the
+	     start of the image data.  Clear all of the image data to zero. ***/
+	
+	block = (char *) malloc ( tables + FITS_DATA_ALIGNMENT + pixels );
+	if ( block == NULL )
+		return ( NULL );
+	
+	info = (FITSImageDataInfo *) block;
+	info->stride = stride;
+	
+	matrix = (PIXEL ***) ( block + FITS_DATA_INFO_SIZE );
+	rows = (PIXEL **) ( matrix + naxis3 + 1 );
+	data = (PIXEL *) ( block + tables + FITS_DATA_ALIGNMENT - ( (size_t) ( block + tables ) % FITS_DATA_ALIGNMENT ) );
+	memset ( data, 0, pixels );
+	
+	/*** Fill in the frame and row pointer tables.  As before, the table of
+	     frame pointers is terminated with a NULL pointer. ***/
+	
+	for ( k = 0; k < naxis3; k++ )
 	{
-		matrix[j] = (PIXEL **) NCreateMatrix ( sizeof ( PIXEL ), naxis2, naxis1 );
-		if ( matrix[j] == NULL )
-		{
-			for ( k = 0; k < j; k++ )
-				NDestroyMatrix ( matrix[k] );
-			free ( matrix );
-			return ( NULL );
-		}
+		matrix[k] = rows + k * naxis2;
+		for ( j = 0; j < naxis2; j++ )
+			matrix[k][j] = data + ( k * naxis2 + j ) * stride;
 	}
 	
 	matrix[naxis3] = NULL;
@@ -867,12 +1428,16 @@ PIXEL ***NewFITSImageDataMatrix ( long naxis1, long naxis2, long naxis3 )
 
 void FreeFITSImageDataMatrix ( PIXEL ***matrix )
 {
-	long k;
+	free ( (char *) matrix - FITS_DATA_INFO_SIZE );
+}
+
+/*************************  GetFITSImageDataStride  ****************************/
+
+long GetFITSImageDataStride ( PIXEL ***matrix )
+{
+	FITSImageDataInfo *info = (FITSImageDataInfo *) ( (char *) matrix - FITS_DATA_INFO_SIZE );
 	
-	for ( k = 0; matrix[k] != NULL; k++ )
-		NDestroyMatrix ( matrix[k] );
-		
-	free ( matrix );
+	return ( info->stride );
 }
 
 /*************************  ReadFITSImageDataMatrix  *****************************/
@@ -880,14 +1445,40 @@ void FreeFITSImageDataMatrix ( PIXEL ***matrix )
 int ReadFITSImageDataMatrix ( FILE *file, PIXEL ***matrix, long bitpix, long naxis,
 long naxis1, long naxis2, long naxis3, double bzero, double bscale )
 {
-	long	i, j;
+	int		result = TRUE;
+	long	i, j, m, n, size;
+	char	*buffer;
 		
-	for ( i = 0; i < naxis3; i++ )
-		for ( j = 0; j < naxis2; j++ )
-			if ( ReadFITSImageDataRow ( file, bitpix, naxis1, bzero, bscale, matrix[i][j] ) == FALSE )
-				return ( FALSE );
+	/*** Read the image data in blocks of several rows at a time, using a
+	     single buffer for the whole matrix.  This turns thousands of small
+	     reads and allocations into a few large ones. ***/
 
-	return ( TRUE );
+	size = naxis1 * abs ( bitpix / 8 );
+	if ( size < 1 || naxis2 < 1 )
+		return ( TRUE );
+
+	m = FITS_BUFFER_SIZE / size;
+	if ( m < 1 )
+		m = 1;
+	if ( m > naxis2 )
+		m = naxis2;
+
+	buffer = malloc ( m * size );
+	if ( buffer == NULL )
+		return ( FALSE );
+
+	for ( i = 0; i < naxis3 && result; i++ )
+	{
+		for ( j = 0; j < naxis2 && result; j += n )
+		{
+			n = naxis2 - j < m ? naxis2 - j : m;
+
+			result = ReadFITSImageDataBlock ( file, bitpix, naxis1, n, bzero, bscale, &matrix[i][j], buffer );
+		}
+	}
+
+	free ( buffer );
+	return ( result );
 }
 
 /*************************  WriteFITSImageDataMatrix  ****************************/
@@ -895,14 +1486,36 @@ long naxis1, long naxis2, long naxis3, double bzero, double bscale )
 int WriteFITSImageDataMatrix ( FILE *file, PIXEL ***matrix, long bitpix, long naxis,
 long naxis1, long naxis2, long naxis3, double bzero, double bscale )
 {
-	int i, j;
+	int		result = TRUE;
+	long	i, j, m, n, size;
+	char	*buffer;
 	
-	for ( i = 0; i < naxis3; i++ )
-		for ( j = 0; j < naxis2; j++ )
-			if ( WriteFITSImageDataRow ( file, bitpix, naxis1, bzero, bscale, matrix[i][j] ) == FALSE )
-				return ( FALSE );
-			
-	return ( TRUE );
+	size = naxis1 * abs ( bitpix / 8 );
+	if ( size < 1 || naxis2 < 1 )
+		return ( TRUE );
+
+	m = FITS_BUFFER_SIZE / size;
+	if ( m < 1 )
+		m = 1;
+	if ( m > naxis2 )
+		m = naxis2;
+
+	buffer = malloc ( m * size );
+	if ( buffer == NULL )
+		return ( FALSE );
+
+	for ( i = 0; i < naxis3 && result; i++ )
+	{
+		for ( j = 0; j < naxis2 && result; j += n )
+		{
+			n = naxis2 - j < m ? naxis2 - j : m;
+
+			result = WriteFITSImageDataBlock ( file, bitpix, naxis1, n, bzero, bscale, &matrix[i][j], buffer );
+		}
+	}
+
+	free ( buffer );
+	return ( result );
 }
 
 /****************************  SetFITSTableHeaderInfo  ******************************/
@@ -1265,6 +1878,365 @@ int WriteFITSTableDataMatrix ( FILE *file, long naxis1, long naxis2, char **matr
 	return ( TRUE );
 }
 
+/*** FITSImageMapping ***********************************************************
+
+	Private record describing the image data of a FITS file opened with
+	MapFITSImage().  Decoded rows are kept in a fixed number of cache entries,
+	linked into a list from the most- to the least-recently-used; the "slot"
+	array gives the cache entry holding each row of the image, or -1.  Raw
+	rows are found in a window of the file mapped into memory, which is moved
+	along the file as needed; the window starts on a multiple of the system's
+	allocation granularity, as the file position of a mapped view must.
+
+*********************************************************************************/
+
+typedef struct FITSRowCacheEntry
+{
+	long			row;		/* index of cached row, i.e. frame * naxis2 + row */
+	long			prev;		/* next more-recently-used entry, or -1 */
+	long			next;		/* next less-recently-used entry, or -1 */
+	PIXEL			*data;		/* decoded image data row */
+}
+FITSRowCacheEntry;
+
+typedef struct FITSImageMapping
+{
+	FILE				*file;		/* file containing image data */
+	FITSFileOffset		offset;		/* file position of start of image data */
+	FITSFileOffset		length;		/* length of file in bytes */
+	long				size;		/* number of bytes per raw image data row */
+	unsigned char		*view;		/* mapped window of file, or NULL if none */
+	FITSFileOffset		viewStart;	/* file position of start of mapped window */
+	size_t				viewLength;	/* length of mapped window in bytes */
+	size_t				granularity;	/* file positions of windows are multiples of this */
+	int					mappable;	/* FALSE if file can't be mapped */
+#ifdef FITS_WIN32_MAPPING
+	HANDLE				handle;		/* Win32 file-mapping object handle */
+#endif
+	void				*buffer;	/* raw data row buffer, if file is not mapped */
+	long				*slot;		/* cache entry index for each image data row */
+	FITSRowCacheEntry	*cache;		/* array of cache entries */
+	long				cacheSize;	/* total number of cache entries */
+	long				cacheUsed;	/* number of cache entries in use */
+	long				head;		/* most-recently-used cache entry, or -1 */
+	long				tail;		/* least-recently-used cache entry, or -1 */
+}
+FITSImageMapping;
+
+/*** UnmapFITSImageWindow *******************************************************/
+
+static void UnmapFITSImageWindow ( FITSImageMapping *mapping )
+{
+#if defined ( FITS_WIN32_MAPPING )
+	if ( mapping->view != NULL )
+		UnmapViewOfFile ( mapping->view );
+#elif defined ( FITS_POSIX_MAPPING )
+	if ( mapping->view != NULL )
+		munmap ( mapping->view, mapping->viewLength );
+#endif
+
+	mapping->view = NULL;
+	mapping->viewStart = 0;
+	mapping->viewLength = 0;
+}
+
+/*** MapFITSImageWindow *********************************************************
+
+	Maps the window of the file which holds the (size) bytes at file position
+	(pos), unless the current window already holds them.  The window is
+	FITS_MAP_WINDOW bytes long, or as long as it must be to hold them, but no
+	longer than the rest of the file.  Returns a pointer to the bytes, or NULL
+	if the file can't be mapped; in that case, no further attempts are made.
+
+*********************************************************************************/
+
+static unsigned char *MapFITSImageWindow ( FITSImageMapping *mapping, FITSFileOffset pos, long size )
+{
+	FITSFileOffset	start, end;
+	
+	if ( mapping->view != NULL && pos >= mapping->viewStart
+	&& pos + size <= mapping->viewStart + (FITSFileOffset) mapping->viewLength )
+		return ( mapping->view + (size_t) ( pos - mapping->viewStart ) );
+
+	if ( mapping->mappable == FALSE )
+		return ( NULL );
+
+	UnmapFITSImageWindow ( mapping );
+
+	start = pos - pos % (FITSFileOffset) mapping->granularity;
+	end = start + FITS_MAP_WINDOW;
+	if ( end < pos + size )
+		end = pos + size;
+	if ( end > mapping->length )
+		end = mapping->length;
+	
+#if defined ( FITS_WIN32_MAPPING )
+	mapping->view = (unsigned char *) MapViewOfFile ( mapping->handle, FILE_MAP_READ,
+	                (DWORD) ( (unsigned __int64) start >> 32 ), (DWORD) start, (size_t) ( end - start ) );
+#elif defined ( FITS_POSIX_MAPPING )
+	mapping->view = (unsigned char *) mmap ( NULL, (size_t) ( end - start ), PROT_READ, MAP_SHARED, fileno ( mapping->file ), start );
+	if ( mapping->view == (unsigned char *) MAP_FAILED )
+		mapping->view = NULL;
+#endif
+	
+	if ( mapping->view == NULL )
+	{
+		mapping->mappable = FALSE;
+		return ( NULL );
+	}
+	
+	mapping->viewStart = start;
+	mapping->viewLength = (size_t) ( end - start );
+	
+	return ( mapping->view + (size_t) ( pos - start ) );
+}
+
+/*** UnmapFITSImageData *********************************************************/
+
+static void UnmapFITSImageData ( FITSImageMapping *mapping )
+{
+	long	i;
+	
+	if ( mapping->cache != NULL )
+	{
+		for ( i = 0; i < mapping->cacheUsed; i++ )
+			free ( mapping->cache[i].data );
+
+		free ( mapping->cache );
+	}
+	
+	if ( mapping->slot != NULL )
+		free ( mapping->slot );
+
+	if ( mapping->buffer != NULL )
+		free ( mapping->buffer );
+
+	UnmapFITSImageWindow ( mapping );
+
+#if defined ( FITS_WIN32_MAPPING )
+	if ( mapping->handle != NULL )
+		CloseHandle ( mapping->handle );
+#endif
+
+	free ( mapping );
+}
+
+/*** MapFITSImageData ***********************************************************
+
+	Maps the image data of a FITS file whose header has just been read into
+	the FITS image record (image).  If the file can't be memory-mapped, rows
+	will instead be read with fseek() and fread() when they are needed.
+	Returns a pointer to the mapping record, or NULL on failure.
+
+*********************************************************************************/
+
+static FITSImageMapping *MapFITSImageData ( FILE *file, FITSImage *image, long cache )
+{
+	long				i, rows;
+	FITSImageMapping	*mapping;
+#ifdef FITS_WIN32_MAPPING
+	SYSTEM_INFO			info;
+#endif
+	
+	mapping = (FITSImageMapping *) calloc ( 1, sizeof ( FITSImageMapping ) );
+	if ( mapping == NULL )
+		return ( NULL );
+	
+	mapping->file = file;
+	mapping->offset = FITSTell ( file );
+	mapping->size = image->naxis1 * abs ( image->bitpix / 8 );
+	rows = image->naxis2 * image->naxis3;
+
+	/*** Make sure that the file actually contains all of the image data,
+	     so that we never try to touch mapped memory past its end. ***/
+
+	if ( mapping->offset < 0 || mapping->size < 1 || rows < 1 || FITSSeek ( file, 0, SEEK_END ) != 0 )
+	{
+		free ( mapping );
+		return ( NULL );
+	}
+	
+	mapping->length = FITSTell ( file );
+	FITSSeek ( file, mapping->offset, SEEK_SET );
+	
+	if ( mapping->length - mapping->offset < (FITSFileOffset) mapping->size * rows )
+	{
+		free ( mapping );
+		return ( NULL );
+	}
+	
+	/*** Prepare to map the file read-only, a window at a time; the first
+	     window is mapped when the first row is needed.  If the file can't
+	     be mapped, or later if a window can't be (e.g. if there isn't enough
+	     free address space), we'll fall back to reading rows from the file
+	     into the row buffer. ***/
+	
+#if defined ( FITS_WIN32_MAPPING )
+	GetSystemInfo ( &info );
+	mapping->granularity = info.dwAllocationGranularity;
+	mapping->handle = CreateFileMapping ( (HANDLE) _get_osfhandle ( _fileno ( file ) ), NULL, PAGE_READONLY, 0, 0, NULL );
+	mapping->mappable = mapping->handle != NULL;
+#elif defined ( FITS_POSIX_MAPPING )
+	mapping->granularity = sysconf ( _SC_PAGESIZE );
+	mapping->mappable = TRUE;
+#else
+	mapping->granularity = 1;
+	mapping->mappable = FALSE;
+#endif
+
+	mapping->buffer = malloc ( mapping->size );
+
+	/*** Allocate the row cache.  The decoded rows themselves are allocated
+	     as the cache fills up, so a small cutout costs only a few rows. ***/
+	     
+	if ( cache < 1 )
+		cache = FITS_CACHE_SIZE / ( image->naxis1 * sizeof ( PIXEL ) );
+	
+	if ( cache < 1 )
+		cache = 1;
+	
+	if ( cache > rows )
+		cache = rows;
+	
+	mapping->slot = (long *) malloc ( rows * sizeof ( long ) );
+	mapping->cache = (FITSRowCacheEntry *) malloc ( cache * sizeof ( FITSRowCacheEntry ) );
+	mapping->cacheSize = cache;
+	mapping->cacheUsed = 0;
+	mapping->head = mapping->tail = -1;
+	
+	if ( mapping->slot == NULL || mapping->cache == NULL || mapping->buffer == NULL )
+	{
+		UnmapFITSImageData ( mapping );
+		return ( NULL );
+	}
+	
+	for ( i = 0; i < rows; i++ )
+		mapping->slot[i] = -1;
+	
+	return ( mapping );
+}
+
+/*** MapFITSImage ***************************************************************/
+
+FITSImage *MapFITSImage ( FILE *file, long cache )
+{
+	FITSImage	*image;
+
+	image = ReadFITSImageHeader ( file );
+	if ( image == NULL )
+		return ( NULL );
+	
+	image->mapping = MapFITSImageData ( file, image, cache );
+	if ( image->mapping == NULL )
+	{
+		FreeFITSImage ( image );
+		return ( NULL );
+	}
+	
+	return ( image );
+}
+
+/*** GetFITSImageDataRow ********************************************************/
+
+PIXEL *GetFITSImageDataRow ( FITSImage *image, long frame, long row )
+{
+	long				i, index;
+	unsigned char		*raw;
+	FITSFileOffset		pos;
+	FITSImageMapping	*mapping = (FITSImageMapping *) image->mapping;
+	FITSRowCacheEntry	*entry;
+	
+	if ( frame < 0 || frame >= image->naxis3 || row < 0 || row >= image->naxis2 )
+		return ( NULL );
+
+	if ( image->data != NULL )
+		return ( image->data[frame][row] );
+	
+	if ( mapping == NULL )
+		return ( NULL );
+	
+	index = frame * image->naxis2 + row;
+	i = mapping->slot[index];
+	
+	/*** If the row is not in the cache, find its raw data: straight from the
+	     mapped window of the file if possible, otherwise read it into the row
+	     buffer.  Then take an unused cache entry if there is one, or else take
+	     back the least-recently-used entry, and decode the row into it. ***/
+	
+	if ( i < 0 )
+	{
+		pos = mapping->offset + (FITSFileOffset) index * mapping->size;
+		raw = MapFITSImageWindow ( mapping, pos, mapping->size );
+		if ( raw == NULL )
+		{
+			raw = (unsigned char *) mapping->buffer;
+			if ( FITSSeek ( mapping->file, pos, SEEK_SET ) != 0
+			|| fread ( raw, mapping->size, 1, mapping->file ) != 1 )
+				return ( NULL );
+		}
+		
+		entry = NULL;
+		if ( mapping->cacheUsed < mapping->cacheSize )
+		{
+			i = mapping->cacheUsed;
+			entry = &mapping->cache[i];
+			entry->data = (PIXEL *) malloc ( image->naxis1 * sizeof ( PIXEL ) );
+			if ( entry->data != NULL )
+			{
+				entry->prev = entry->next = -1;
+				mapping->cacheUsed++;
+			}
+			else
+			{
+				entry = NULL;
+			}
+		}
+		
+		if ( entry == NULL )
+		{
+			i = mapping->tail;
+			if ( i < 0 )
+				return ( NULL );
+
+			entry = &mapping->cache[i];
+			mapping->slot[entry->row] = -1;
+		}
+
+		DecodeFITSImageData ( raw, image->bitpix, image->naxis1, image->bzero, image->bscale, entry->data );
+		entry->row = index;
+		mapping->slot[index] = i;
+	}
+
+	/*** Move the entry to the front of the most-recently-used list,
+	     unlinking it first if it is already in the list. ***/
+	
+	entry = &mapping->cache[i];
+	if ( mapping->head != i )
+	{
+		if ( entry->prev >= 0 )
+			mapping->cache[entry->prev].next = entry->next;
+
+		if ( entry->next >= 0 )
+			mapping->cache[entry->next].prev = entry->prev;
+		
+		if ( mapping->tail == i )
+			mapping->tail = entry->prev;
+		
+		entry->prev = -1;
+		entry->next = mapping->head;
+		
+		if ( mapping->head >= 0 )
+			mapping->cache[mapping->head].prev = i;
+		
+		mapping->head = i;
+		
+		if ( mapping->tail < 0 )
+			mapping->tail = i;
+	}
+	
+	return ( entry->data );
+}
+
 /**************************  NewFITSImageHeader  *****************************/
 
 FITSImage *NewFITSImageHeader ( long bitpix, long naxis, long naxis1, long naxis2, long naxis3,
@@ -1304,6 +2276,7 @@ double bzero, double bscale )
 	image->bscale = bscale;
 	image->header = header;
 	image->data   = NULL;
+	image->mapping = NULL;
 	
 	/*** Return a pointer to the new FITS image record. ***/
 	
@@ -1353,6 +2326,9 @@ void FreeFITSImage ( FITSImage *image )
 	if ( image->data != NULL )
 		FreeFITSImageDataMatrix ( image->data );
 		
+	if ( image->mapping != NULL )
+		UnmapFITSImageData ( (FITSImageMapping *) image->mapping );
+
 	free ( image );
 }
 
@@ -1402,6 +2378,7 @@ FITSImage *ReadFITSImageHeader ( FILE *file )
 	image->bscale = bscale;
 	image->header = header;
 	image->data = NULL;
+	image->mapping = NULL;
 	
 	return ( image );
 }
@@ -1485,12 +2462,32 @@ int WriteFITSImage ( FILE *file, FITSImage *image )
 	double	bscale   = image->bscale;
 	char	**header = image->header;
 	PIXEL	***data  = image->data;
+	PIXEL	*row;
+	long	i, j;
 		
 	if ( WriteFITSHeader ( file, header ) == FALSE )
 		return ( FALSE );
-		
-	if ( WriteFITSImageDataMatrix ( file, data, bitpix, naxis, naxis1, naxis2, naxis3, bzero, bscale ) == FALSE )
-		return ( FALSE );
+	
+	/*** An image opened with MapFITSImage() has no data matrix in memory,
+	     so write its rows one at a time, as they come out of the cache. ***/
+	
+	if ( data == NULL )
+	{
+		for ( i = 0; i < naxis3; i++ )
+		{
+			for ( j = 0; j < naxis2; j++ )
+			{
+				row = GetFITSImageDataRow ( image, i, j );
+				if ( row == NULL || WriteFITSImageDataRow ( file, bitpix, naxis1, bzero, bscale, row ) == FALSE )
+					return ( FALSE );
+			}
+		}
+	}
+	else
+	{
+		if ( WriteFITSImageDataMatrix ( file, data, bitpix, naxis, naxis1, naxis2, naxis3, bzero, bscale ) == FALSE )
+			return ( FALSE );
+	}
 	
 	if ( WriteFITSImageDataPadding ( file, bitpix, naxis, naxis1, naxis2, naxis3 ) == FALSE )
 		return ( FALSE );
@@ -1504,6 +2501,7 @@ FITSImage *ResizeFITSImage ( FITSImage *oldFITS, short naxis1, short naxis2, sho
 int copy )
 {
 	long			frame, col, row, line = 0;
+	PIXEL			*data;
 	FITSImage		*newFITS = NULL;
 	
 	/*** Create a new FITS image record.  On failure, return a NULL pointer.
@@ -1521,6 +2519,7 @@ int copy )
 	     free the FITS image record, and return a NULL pointer. ***/
 	
 	newFITS->data = NewFITSImageDataMatrix ( naxis1, naxis2, naxis3 );
+	newFITS->mapping = NULL;
 	if ( newFITS->data == NULL )
 	{
 		free ( newFITS );
@@ -1539,34 +2538,26 @@ int copy )
 	
 	if ( copy )
 	{
-		for ( frame = 0; frame < newFITS->naxis3 && frame < oldFITS->naxis3; frame++ )
+		for ( frame = 0; frame < newFITS->naxis3; frame++ )
 		{
-			if ( frame < oldFITS->naxis3 )
+			for ( row = 0; row < newFITS->naxis2; row++ )
 			{
-				for ( row = 0; row < newFITS->naxis2; row++ )
+				data = GetFITSImageDataRow ( oldFITS, frame, row );
+				if ( data != NULL )
 				{
-					if ( row < newFITS->naxis2 )
-					{
-						for ( col = 0; col < newFITS->naxis1; col++ )
-						{
-							if ( col < oldFITS->naxis1 )
-								newFITS->data[frame][row][col] = oldFITS->data[frame][row][col];
-							else
-								newFITS->data[frame][row][col] = 0;
-						}
-					}
-					else
+					for ( col = 0; col < newFITS->naxis1; col++ )
 					{
-						for ( col = 0; col < newFITS->naxis1; col++ )
+						if ( col < oldFITS->naxis1 )
+							newFITS->data[frame][row][col] = data[col];
+						else
 							newFITS->data[frame][row][col] = 0;
 					}
 				}
-			}
-			else
-			{
-				for ( row = 0; row < newFITS->naxis2; row++ )
+				else
+				{
 					for ( col = 0; col < newFITS->naxis1; col++ )
 						newFITS->data[frame][row][col] = 0;
+				}
 			}
 		}
 	}
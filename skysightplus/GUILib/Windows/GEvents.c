@@ -75,6 +75,10 @@ int GUILibInitialize ( GHandle hInstance )
 	RegisterCom32s ( hInstance );
 #endif
 
+	/*** Start the worker threads used by GDoParallelTasks(). ***/
+	
+	GCreateThreadPool();
+	
 	return ( TRUE );
 }
 
@@ -89,6 +93,8 @@ void GUILibCleanUp ( void )
 #ifdef GWINCOM32S
 	UnRegisterCom32s ( sInstance );
 #endif
+
+	GDeleteThreadPool();
 }
 
 /****************************  GEnterMainLoop  *************************************/
@@ -378,6 +378,108 @@ LPSTR GDoOpenFileDialog ( char *lpszPrompt, char *lpszFilter, short *lpwFormat )
 	return ( lpszPath );
 }
 
+/***************************  GDoOpenFilesDialog  ***************************/
+
+long GDoOpenFilesDialog ( char *lpszPrompt, char *lpszFilter, short *lpwFormat, LPSTR **lplpszPaths )
+{
+#ifdef GWIN16
+	LPSTR			lpszPath = GDoOpenFileDialog ( lpszPrompt, lpszFilter, lpwFormat );
+	
+	*lplpszPaths = NULL;
+	if ( lpszPath == NULL )
+		return ( 0 );
+		
+	if ( ( *lplpszPaths = malloc ( sizeof ( LPSTR ) ) ) == NULL )
+	{
+		GDeletePath ( lpszPath );
+		return ( 0 );
+	}
+	
+	(*lplpszPaths)[0] = lpszPath;
+	return ( 1 );
+#endif
+
+#ifdef GWIN32
+	OPENFILENAME	ofn;
+	LPSTR			lpszFiles, lpszName;
+	LPSTR			*lpszPaths = NULL;
+	int				i, nLength;
+	long			lNumFiles = 0, lFile;
+	
+	*lplpszPaths = NULL;
+	
+	/*** The names of all of the selected files are returned in one buffer:
+	     the directory, then each file name, separated by null characters,
+	     with an extra null character after the last; or just the complete
+	     path, if only one file is selected. ***/
+	     
+	if ( ( lpszFiles = malloc ( 32768 ) ) == NULL )
+		return ( 0 );
+		
+	lpszFiles[0] = '\0';
+	
+	for ( i = 0; lpszFilter[i]; i++ )
+		if ( lpszFilter[i] == '|' )
+			lpszFilter[i] = 0;
+
+	nLength = i;
+
+	memset ( &ofn, 0, sizeof ( OPENFILENAME ) );
+	ofn.lStructSize = sizeof ( OPENFILENAME );
+	ofn.hwndOwner = GetActiveWindow();
+	ofn.lpstrFilter = lpszFilter;
+	ofn.nFilterIndex = *lpwFormat;
+	ofn.lpstrFile = lpszFiles;
+	ofn.nMaxFile = 32767;
+	ofn.lpstrTitle = lpszPrompt;
+	ofn.Flags = OFN_ALLOWMULTISELECT | OFN_EXPLORER | OFN_FILEMUSTEXIST;
+
+	if ( GetOpenFileName ( &ofn ) )
+	{
+		*lpwFormat = ofn.nFilterIndex;
+		
+		/*** If only one file was selected, the buffer holds its complete
+		     path, which isn't followed by an extra null character. ***/
+		     
+		if ( lpszFiles[ ofn.nFileOffset - 1 ] != '\0' )
+			lNumFiles = 1;
+		else
+			for ( lpszName = lpszFiles + ofn.nFileOffset; *lpszName; lpszName += lstrlen ( lpszName ) + 1 )
+				lNumFiles++;
+			
+		if ( ( lpszPaths = calloc ( lNumFiles, sizeof ( LPSTR ) ) ) == NULL )
+			lNumFiles = 0;
+		
+		for ( lFile = 0, lpszName = lpszFiles + ofn.nFileOffset; lFile < lNumFiles; lFile++, lpszName += lstrlen ( lpszName ) + 1 )
+		{
+			if ( ( lpszPaths[lFile] = GCreatePath ( NULL ) ) == NULL )
+			{
+				while ( lFile > 0 )
+					GDeletePath ( lpszPaths[--lFile] );
+					
+				free ( lpszPaths );
+				lpszPaths = NULL;
+				lNumFiles = 0;
+				break;
+			}
+			
+			lstrcpyn ( lpszPaths[lFile], lpszFiles, MAX_PATH );
+			if ( lpszFiles[ ofn.nFileOffset - 1 ] == '\0' )
+				GAppendPathName ( lpszPaths[lFile], lpszName );
+		}
+	}
+
+	for ( i = 0; i < nLength; i++ )
+		if ( lpszFilter[i] == 0 )
+			lpszFilter[i] = '|';
+
+	free ( lpszFiles );
+	
+	*lplpszPaths = lpszPaths;
+	return ( lNumFiles );
+#endif
+}
+
 /******************************  GDoSaveFileDialog  **************************/
 
 GPathPtr GDoSaveFileDialog ( char *lpszPrompt, char *lpszFilter, char *lpszFileName, short *lpwFormat )
@@ -545,6 +647,43 @@ long GGetFileSize ( LPSTR lpszPath )
 	return ( lSize );
 }
 
+/********************  GGetFileModificationTime  ********************/
+
+unsigned long GGetFileModificationTime ( LPSTR lpszPath )
+{
+#ifdef GWIN16
+	unsigned		uDate, uTime;
+	int				hFile;
+	unsigned long	ulTime = 0;
+	
+	if ( _dos_open ( lpszPath, 0, &hFile ) == 0 )
+	{
+		if ( _dos_getftime ( hFile, &uDate, &uTime ) == 0 )
+			ulTime = ( (unsigned long) uDate << 16 ) | uTime;
+			
+		_dos_close ( hFile );
+	}
+	
+	return ( ulTime );
+#endif
+
+#ifdef GWIN32
+	WIN32_FIND_DATA	data;
+	HANDLE			hFind = FindFirstFile ( lpszPath, &data );
+	unsigned __int64	qwTime;
+	
+	if ( hFind == INVALID_HANDLE_VALUE )
+		return ( 0 );
+		
+	FindClose ( hFind );
+	
+	/*** Convert from 100-nanosecond intervals since 1 Jan 1601. ***/
+	
+	qwTime = ( (unsigned __int64) data.ftLastWriteTime.dwHighDateTime << 32 ) | data.ftLastWriteTime.dwLowDateTime;
+	return ( (unsigned long) ( ( qwTime - 116444736000000000 ) / 10000000 ) );
+#endif
+}
+
 /*****************************  GOpenFile  ***************************/
 
 FILE *GOpenFile ( LPSTR lpszPath, char *mode, char *type, char *creator )
@@ -0,0 +1,341 @@
+/*** COPYRIGHT NOTICE AND PUBLIC SOURCE LICENSE *********************************
+
+Portions Copyright (c) 1992-2001 Southern Stars Systems.  All Rights Reserved.
+
+This file contains Original Code and/or Modifications of Original Code as defined
+in and that are subject to the Southern Stars Systems Public Source License
+Version 1.0 (the 'License').  You may not use this file except in compliance with
+the License.  Please obtain a copy of the License at
+
+http://www.southernstars.com/opensource/
+
+and read it before using this file.
+
+The Original Code and all software distributed under the License are distributed
+on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER EXPRESS OR IMPLIED, AND
+SOUTHERN STARS SYSTEMS HEREBY DISCLAIMS ALL SUCH WARRANTIES, INCLUDING WITHOUT
+LIMITATION, ANY WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE,
+QUIET ENJOYMENT, OR NON-INFRINGEMENT.  Please see the License for the specific
+language governing rights and limitations under the License.
+
+MODIFICATION HISTORY:
+
+1.0.0 - 17 Oct 2026 - Original code: worker threads, semaphores and parallel tasks.
+
+*********************************************************************************/
+
+/*****************************  header files  ********************************/
+
+#include "GUILib.h"
+#define GLOBAL extern
+#include "GUIPriv.h"
+#undef GLOBAL
+
+#include <process.h>
+
+/*** Thread pool private data.  The pool's worker threads are created by
+     GCreateThreadPool(), and spend their lives waiting for a start signal.
+     When GDoParallelTasks() hands them a job, each one repeatedly claims
+     the next unclaimed task number until there are none left, then goes
+     back to sleep; the last one to finish signals the calling thread. ***/
+
+#define G_MAX_WORKER_THREADS	31
+
+static long				sNumWorkers = 0;
+static HANDLE			sWorkers[G_MAX_WORKER_THREADS];
+static HANDLE			sStartEvents[G_MAX_WORKER_THREADS];
+static HANDLE			sDoneEvent = NULL;
+static CRITICAL_SECTION	sPoolLock;
+static DWORD			sPoolTlsIndex = 0xFFFFFFFF;
+static int				sQuit = FALSE;
+
+static GTaskProcPtr		sTaskProc = NULL;
+static void				*sTaskData = NULL;
+static LONG				sNumTasks = 0;
+static LONG				sNextTask = 0;
+static LONG				sBusyWorkers = 0;
+
+/*** GThreadStartData is passed from GCreateThread() to the new thread. ***/
+
+typedef struct GThreadStartData
+{
+	GThreadProcPtr	proc;
+	void			*data;
+}
+GThreadStartData;
+
+/*******************************  GThreadStart  ******************************/
+
+static unsigned __stdcall GThreadStart ( void *param )
+{
+	GThreadStartData	start = *(GThreadStartData *) param;
+	
+	free ( param );
+	start.proc ( start.data );
+
+	return ( 0 );
+}
+
+/*******************************  GCreateThread  *****************************/
+
+GThreadPtr GCreateThread ( GThreadProcPtr proc, void *data )
+{
+	GThreadStartData	*start;
+	unsigned			id;
+	HANDLE				thread;
+	
+	start = (GThreadStartData *) malloc ( sizeof ( GThreadStartData ) );
+	if ( start == NULL )
+		return ( NULL );
+	
+	start->proc = proc;
+	start->data = data;
+	
+	/*** Use _beginthreadex() rather than CreateThread(), so that the C run-time
+	     library sets up its per-thread data for the new thread. ***/
+	
+	thread = (HANDLE) _beginthreadex ( NULL, 0, GThreadStart, start, 0, &id );
+	if ( thread == NULL )
+		free ( start );
+	
+	return ( thread );
+}
+
+/*******************************  GWaitThread  *******************************/
+
+void GWaitThread ( GThreadPtr thread )
+{
+	WaitForSingleObject ( thread, INFINITE );
+	CloseHandle ( thread );
+}
+
+/*******************************  GCreateMutex  ******************************/
+
+GMutexPtr GCreateMutex ( void )
+{
+	GMutexPtr	mutex;
+	
+	mutex = (GMutexPtr) malloc ( sizeof ( CRITICAL_SECTION ) );
+	if ( mutex != NULL )
+		InitializeCriticalSection ( mutex );
+	
+	return ( mutex );
+}
+
+/*******************************  GLockMutex  ********************************/
+
+void GLockMutex ( GMutexPtr mutex )
+{
+	EnterCriticalSection ( mutex );
+}
+
+/******************************  GUnlockMutex  *******************************/
+
+void GUnlockMutex ( GMutexPtr mutex )
+{
+	LeaveCriticalSection ( mutex );
+}
+
+/******************************  GDeleteMutex  *******************************/
+
+void GDeleteMutex ( GMutexPtr mutex )
+{
+	DeleteCriticalSection ( mutex );
+	free ( mutex );
+}
+
+/****************************  GCreateSemaphore  *****************************/
+
+GSemaphorePtr GCreateSemaphore ( long count, long maxCount )
+{
+	return ( CreateSemaphore ( NULL, count, maxCount, NULL ) );
+}
+
+/*****************************  GWaitSemaphore  ******************************/
+
+int GWaitSemaphore ( GSemaphorePtr semaphore, long timeout )
+{
+	if ( WaitForSingleObject ( semaphore, timeout < 0 ? INFINITE : timeout ) == WAIT_OBJECT_0 )
+		return ( TRUE );
+	
+	return ( FALSE );
+}
+
+/****************************  GSignalSemaphore  *****************************/
+
+void GSignalSemaphore ( GSemaphorePtr semaphore )
+{
+	ReleaseSemaphore ( semaphore, 1, NULL );
+}
+
+/****************************  GDeleteSemaphore  *****************************/
+
+void GDeleteSemaphore ( GSemaphorePtr semaphore )
+{
+	CloseHandle ( semaphore );
+}
+
+/***************************  GGetProcessorCount  ****************************/
+
+long GGetProcessorCount ( void )
+{
+	SYSTEM_INFO	info;
+	
+	GetSystemInfo ( &info );
+	
+	if ( info.dwNumberOfProcessors < 1 )
+		return ( 1 );
+	
+	return ( info.dwNumberOfProcessors );
+}
+
+/*******************************  GRunTasks  *********************************/
+
+static void GRunTasks ( void )
+{
+	LONG	task;
+	
+	while ( ( task = InterlockedIncrement ( &sNextTask ) - 1 ) < sNumTasks )
+		sTaskProc ( sTaskData, task );
+}
+
+/*****************************  GWorkerThread  *******************************/
+
+static unsigned __stdcall GWorkerThread ( void *param )
+{
+	long	worker = (long) param;
+	
+	/*** Mark this as a pool thread, so that GDoParallelTasks() calls made
+	     from inside a task run on this thread instead of deadlocking. ***/
+	
+	TlsSetValue ( sPoolTlsIndex, (LPVOID) 1 );
+	
+	while ( TRUE )
+	{
+		WaitForSingleObject ( sStartEvents[worker], INFINITE );
+		if ( sQuit )
+			break;
+		
+		GRunTasks();
+		
+		if ( InterlockedDecrement ( &sBusyWorkers ) == 0 )
+			SetEvent ( sDoneEvent );
+	}
+	
+	return ( 0 );
+}
+
+/***************************  GCreateThreadPool  *****************************/
+
+void GCreateThreadPool ( void )
+{
+	long		i, n;
+	unsigned	id;
+	
+	InitializeCriticalSection ( &sPoolLock );
+	sPoolTlsIndex = TlsAlloc();
+	sDoneEvent = CreateEvent ( NULL, FALSE, FALSE, NULL );
+	sQuit = FALSE;
+	
+	/*** Create one worker thread for each processor other than the one
+	     the calling thread runs on, since that one joins in as well. ***/
+	
+	n = GGetProcessorCount() - 1;
+	if ( n > G_MAX_WORKER_THREADS )
+		n = G_MAX_WORKER_THREADS;
+	
+	if ( sPoolTlsIndex == 0xFFFFFFFF || sDoneEvent == NULL )
+		n = 0;
+	
+	for ( sNumWorkers = i = 0; i < n; i++ )
+	{
+		sStartEvents[i] = CreateEvent ( NULL, FALSE, FALSE, NULL );
+		if ( sStartEvents[i] == NULL )
+			break;
+		
+		sWorkers[i] = (HANDLE) _beginthreadex ( NULL, 0, GWorkerThread, (void *) i, 0, &id );
+		if ( sWorkers[i] == NULL )
+		{
+			CloseHandle ( sStartEvents[i] );
+			break;
+		}
+		
+		sNumWorkers++;
+	}
+}
+
+/***************************  GDeleteThreadPool  *****************************/
+
+void GDeleteThreadPool ( void )
+{
+	long	i;
+	
+	sQuit = TRUE;
+	
+	for ( i = 0; i < sNumWorkers; i++ )
+		SetEvent ( sStartEvents[i] );
+	
+	for ( i = 0; i < sNumWorkers; i++ )
+	{
+		WaitForSingleObject ( sWorkers[i], INFINITE );
+		CloseHandle ( sWorkers[i] );
+		CloseHandle ( sStartEvents[i] );
+	}
+	
+	sNumWorkers = 0;
+	
+	if ( sDoneEvent != NULL )
+		CloseHandle ( sDoneEvent );
+	
+	if ( sPoolTlsIndex != 0xFFFFFFFF )
+		TlsFree ( sPoolTlsIndex );
+	
+	sDoneEvent = NULL;
+	sPoolTlsIndex = 0xFFFFFFFF;
+	DeleteCriticalSection ( &sPoolLock );
+}
+
+/***************************  GDoParallelTasks  ******************************/
+
+void GDoParallelTasks ( GTaskProcPtr proc, void *data, long numTasks )
+{
+	long	i, workers;
+	
+	/*** With only one task, or no worker threads, or if we are already
+	     running inside a parallel task, just do all the tasks here. ***/
+	
+	if ( numTasks < 2 || sNumWorkers < 1 || TlsGetValue ( sPoolTlsIndex ) != NULL )
+	{
+		for ( i = 0; i < numTasks; i++ )
+			proc ( data, i );
+		
+		return;
+	}
+	
+	/*** Only one job can use the pool at a time; any other thread which
+	     wants it waits here until the current job is done. ***/
+	
+	EnterCriticalSection ( &sPoolLock );
+	TlsSetValue ( sPoolTlsIndex, (LPVOID) 1 );
+	
+	sTaskProc = proc;
+	sTaskData = data;
+	sNumTasks = numTasks;
+	sNextTask = 0;
+	
+	/*** Wake up as many workers as can be kept busy, then work on the
+	     tasks ourselves until none are left, and wait for the workers
+	     to finish theirs. ***/
+	
+	workers = numTasks - 1 < sNumWorkers ? numTasks - 1 : sNumWorkers;
+	sBusyWorkers = workers;
+	
+	for ( i = 0; i < workers; i++ )
+		SetEvent ( sStartEvents[i] );
+	
+	GRunTasks();
+	WaitForSingleObject ( sDoneEvent, INFINITE );
+	
+	TlsSetValue ( sPoolTlsIndex, NULL );
+	LeaveCriticalSection ( &sPoolLock );
+}
@@ -297,6 +297,10 @@ typedef HCURSOR			GCursorPtr;
 typedef HANDLE			GPortPtr;
 typedef HINSTANCE		GInstancePtr;
 
+typedef HANDLE				GThreadPtr;
+typedef CRITICAL_SECTION	*GMutexPtr;
+typedef HANDLE				GSemaphorePtr;
+
 #endif
 
 /****************************  Event types  **********************************
@@ -7041,6 +7045,32 @@ int GPathIsReadOnly ( GPathPtr );
 
 GPathPtr GDoOpenFileDialog ( char *, char *, short * );
 
+/*************************  GDoOpenFilesDialog  ******************************
+
+	Displays the standard "Open..." dialog and lets the user select one or
+	more files to open.
+	
+	long GDoOpenFilesDialog ( char *prompt, char *filter, short *format,
+	     GPathPtr **paths )
+
+	(prompt): string containing prompt to display in the dialog.
+	(filter): string containing file filters; see GDoOpenFileDialog().
+	(format): initial/selected file filter; see GDoOpenFileDialog().
+	(paths):  receives a pointer to an array of path specification records.
+
+	The function returns the number of files the user selected, or zero if
+	the user canceled the dialog (or if memory for the paths could not be
+	allocated), in which case the value placed in (paths) is NULL.
+
+	Use GDeletePath() to free memory for each of the path specification
+	records, and then free() to release the array itself.  On platforms
+	whose "Open" dialog can't select several files, this function lets
+	the user select just one, as GDoOpenFileDialog() does.
+	
+******************************************************************************/
+
+long GDoOpenFilesDialog ( char *, char *, short *, GPathPtr ** );
+
 /*************************  GDoSaveFileDialog  *******************************
 
 	Displays the standard "Save..." dialog and prompts the user for the
@@ -7369,6 +7399,37 @@ int GDeleteDirectory ( GPathPtr );
 
 int GDeleteFile ( GPathPtr );
 
+/**************************  GGetFileSize  ***********************************
+
+	Returns the size of a file, in bytes.
+
+	long GGetFileSize ( GPathPtr path )
+
+	(path): complete path specification of file.
+
+	The function returns zero if the file does not exist or can't be opened.
+
+******************************************************************************/
+
+long GGetFileSize ( GPathPtr );
+
+/**********************  GGetFileModificationTime  ***************************
+
+	Returns the time at which a file was last modified.
+
+	unsigned long GGetFileModificationTime ( GPathPtr path )
+
+	(path): complete path specification of file.
+
+	The function returns the time as a number which increases with time (in
+	Win32, the number of seconds since 1 Jan 1970), or zero if the file does
+	not exist.  It is meant for telling whether a file has changed since
+	it was last read, e.g. to decide whether to use results cached from it.
+
+******************************************************************************/
+
+unsigned long GGetFileModificationTime ( GPathPtr );
+
 /**************************  GGetFileType  ***********************************
 
 	Obtains a file's Mac file type code or DOS file extension.
@@ -9144,6 +9205,151 @@ void GSetDialogDefaultButton ( GWindowPtr, short );
 
 short GGetDialogDefaultButton ( GWindowPtr );
 
+/*******************************************************************************
+*
+* FUNCTIONS IN GThreads.c
+*  
+********************************************************************************/
+
+typedef void (*GThreadProcPtr) ( void * );
+typedef void (*GTaskProcPtr) ( void *, long );
+
+/****************************  GCreateThread  *******************************
+
+	Starts a new thread of execution.
+
+	GThreadPtr GCreateThread ( GThreadProcPtr proc, void *data )
+
+	(proc): pointer to the function the new thread should execute.
+	(data): pointer to data passed to that function.
+
+	If successful, the function returns a pointer to the new thread; on
+	failure, it returns NULL.  The new thread starts by calling proc ( data ),
+	and ends when that function returns.  You must eventually pass the
+	thread pointer to GWaitThread(), which waits for the thread to end and
+	releases the system resources associated with it.
+	
+	GUILib's windowing functions are not thread-safe, and should only be
+	called from your application's main thread.
+	
+****************************************************************************/
+
+GThreadPtr GCreateThread ( GThreadProcPtr, void * );
+
+/*****************************  GWaitThread  ********************************
+
+	Waits for a thread to end, then releases it.
+
+	void GWaitThread ( GThreadPtr thread )
+
+	(thread): pointer to a thread returned by GCreateThread().
+	
+	The function does not return until the thread has finished.  Afterwards,
+	the thread pointer is no longer valid.
+	
+****************************************************************************/
+
+void GWaitThread ( GThreadPtr );
+
+/*****************************  GCreateMutex  *******************************
+
+	Functions for creating, locking, unlocking, and destroying mutual-
+	exclusion locks (mutexes), used to protect data shared between threads.
+
+	GMutexPtr GCreateMutex ( void )
+	void GLockMutex ( GMutexPtr mutex )
+	void GUnlockMutex ( GMutexPtr mutex )
+	void GDeleteMutex ( GMutexPtr mutex )
+
+	(mutex): pointer to a mutex returned by GCreateMutex().
+	
+	GCreateMutex() returns a pointer to a new, unlocked mutex, or NULL on
+	failure.  GLockMutex() waits until no other thread holds the mutex, then
+	locks it; a thread which already holds the mutex may lock it again, but
+	must then unlock it the same number of times.  GUnlockMutex() releases
+	the mutex.  GDeleteMutex() destroys a mutex, which must not be locked.
+	
+****************************************************************************/
+
+GMutexPtr	GCreateMutex ( void );
+void		GLockMutex ( GMutexPtr );
+void		GUnlockMutex ( GMutexPtr );
+void		GDeleteMutex ( GMutexPtr );
+
+/***************************  GCreateSemaphore  *****************************
+
+	Functions for creating, waiting on, signalling, and destroying counting
+	semaphores, used to pass work between threads.
+
+	GSemaphorePtr GCreateSemaphore ( long count, long maxCount )
+	int GWaitSemaphore ( GSemaphorePtr semaphore, long timeout )
+	void GSignalSemaphore ( GSemaphorePtr semaphore )
+	void GDeleteSemaphore ( GSemaphorePtr semaphore )
+
+	(count):     semaphore's initial count.
+	(maxCount):  largest count the semaphore may ever reach.
+	(semaphore): pointer to a semaphore returned by GCreateSemaphore().
+	(timeout):   longest time to wait, in milliseconds; pass -1 to wait for
+	             as long as it takes.
+	
+	GCreateSemaphore() returns a pointer to a new semaphore, or NULL on
+	failure.  GWaitSemaphore() waits until the semaphore's count is above
+	zero, then decrements it and returns TRUE; if that doesn't happen within
+	the timeout, it returns FALSE.  GSignalSemaphore() increments the count,
+	releasing one waiting thread.  GDeleteSemaphore() destroys a semaphore,
+	which no thread may be waiting on.
+	
+****************************************************************************/
+
+GSemaphorePtr	GCreateSemaphore ( long, long );
+int				GWaitSemaphore ( GSemaphorePtr, long );
+void			GSignalSemaphore ( GSemaphorePtr );
+void			GDeleteSemaphore ( GSemaphorePtr );
+
+/**************************  GGetProcessorCount  ****************************
+
+	Returns the number of processors in the system.
+
+	long GGetProcessorCount ( void )
+	
+****************************************************************************/
+
+long GGetProcessorCount ( void );
+
+/***************************  GDoParallelTasks  *****************************
+
+	Performs a number of independent tasks in parallel, using all of the
+	system's processors.
+
+	void GDoParallelTasks ( GTaskProcPtr proc, void *data, long numTasks )
+
+	(proc):     pointer to function which performs one task.
+	(data):     pointer to data passed to that function.
+	(numTasks): number of tasks to perform.
+	
+	This function calls proc ( data, task ) once for each task number from
+	zero to (numTasks - 1), and returns when all of the tasks are finished.
+	The calls are made from a pool of worker threads which GUILib keeps for
+	the purpose (one per processor), as well as from the calling thread, in
+	no particular order.  Your task function therefore must not depend on
+	the order in which tasks are performed, and tasks which run at the same
+	time must not write to the same data.  A simple way to achieve this is
+	to have each task work on its own band of rows of an image, and write
+	any results into its own slot of an array indexed by task number.
+	
+	Because the calling thread takes part, it is safe to use this function
+	on a system with only one processor; the tasks are then simply performed
+	one after another.  If a task function itself calls GDoParallelTasks(),
+	the inner call performs its tasks on the calling thread.  Only one set of
+	tasks uses the pool at a time; if two threads call this function at
+	once, the second waits for the first set of tasks to finish.
+	
+	Task functions must not call GUILib's windowing functions.
+	
+****************************************************************************/
+
+void GDoParallelTasks ( GTaskProcPtr, void *, long );
+
 GBitmapPtr		GCreateBitmapFromImage ( GImagePtr );
 GImagePtr		GCreateImageFromBitmap ( GBitmapPtr );
 void			GBitmapToImageDataRow ( GBitmapPtr, short, GImagePtr, short );
@@ -92,6 +92,11 @@ HGLOBAL	GBitmapToDIB ( HBITMAP, long * );
 
 void	GDoDialogControlClick ( HWND, short );
 
+/*** functions in GThreads.c ***/
+
+void	GCreateThreadPool ( void );
+void	GDeleteThreadPool ( void );
+
 /*** functions in Graphics.c ***/
 
 GPicturePtr GCreatePicture ( GRectPtr );
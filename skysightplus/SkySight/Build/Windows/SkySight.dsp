@@ -200,6 +200,10 @@ SOURCE=..\..\Source\CameraTypes.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\Source\Convolution.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\Source\DemoCameraInterface.c
 # End Source File
 # Begin Source File
@@ -244,6 +248,18 @@ SOURCE=..\..\Source\ImageAnalysisDialog.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\Source\ImageBackground.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\Source\ImageCalibration.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\Source\ImageDetection.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\Source\ImageDisplay.c
 # End Source File
 # Begin Source File
@@ -256,10 +272,18 @@ SOURCE=..\..\Source\ImageHistogram.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\Source\ImageMatch.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\Source\ImageObject.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\Source\ImageObjectIndex.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\Source\ImageProcessing.c
 # End Source File
 # Begin Source File
@@ -268,6 +292,10 @@ SOURCE=..\..\Source\ImageRegion.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\Source\ImageStack.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\Source\ImageWindow.c
 # End Source File
 # Begin Source File
@@ -288,6 +316,10 @@ SOURCE=..\..\Source\ProcessMenu.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\Source\Resampling.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\Source\SXUSBCameraInterface.c
 # End Source File
 # Begin Source File
@@ -364,6 +396,10 @@ SOURCE=..\..\..\GUILib\Windows\GSound.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\..\GUILib\Windows\GThreads.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\..\GUILib\Windows\GWindows.c
 # End Source File
 # End Group
@@ -836,6 +872,10 @@ SOURCE=..\..\..\esource\FILEIO.C
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\..\esource\FILEMAP.C
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\..\esource\FITSUTIL.C
 # End Source File
 # Begin Source File
@@ -880,6 +920,10 @@ SOURCE=..\..\..\esource\SCAN.C
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\..\esource\SEXLIB.C
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\..\esource\SEXTRACT.C
 # End Source File
 # End Group
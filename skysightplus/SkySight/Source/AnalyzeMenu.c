@@ -58,6 +58,10 @@ void DoAnalyzeMenuItem ( long item )
 			FindImageWindowImageObjects ( window, PIXEL_MIN, PIXEL_MAX, 1.3 );
 			break;
 			
+		case ANALYZE_FIND_PEAKS:
+			FindImageWindowImagePeaks ( window, PIXEL_MIN, PIXEL_MAX, 1.3 );
+			break;
+			
 		case ANALYZE_DELETE_OBJECTS:
 			DeleteImageWindowImageObjects ( window );
 			break;
@@ -71,7 +75,7 @@ void DefineImageWindowImageObjectPSF ( GWindowPtr window )
 	ImageRegionPtr	region;
 	ImageObjectPtr	object;
 	PIXEL			**matrix;
-	double			min, max, params[5], errors[5];
+	double			min, max, level, params[5], errors[5];
 	
 	image = GetImageWindowImage ( window );
 	matrix = GetImageDataFrame ( image, 0 );
@@ -94,6 +98,14 @@ void DefineImageWindowImageObjectPSF ( GWindowPtr window )
 	min = GetImageRegionMin ( region );
 	max = GetImageRegionMax ( region );
 	
+	/*** The image's background level under the object is a better estimate
+	     than the region's minimum, which is biased low by noise.  Only the
+	     background around the object is computed, unless the image already
+	     has a background map. ***/
+	     
+	if ( EstimateImageBackground ( image, 0, GetImageRegionMaxCol ( region ), GetImageRegionMaxRow ( region ), &level, NULL ) )
+		min = level;
+	
 	SetImageObjectBackground ( region, min );
 	SetImageObjectAmplitude ( region, max - min );
 	
@@ -150,333 +162,149 @@ void DefineImageWindowImageObjectPSF ( GWindowPtr window )
 	}
 }
 
-#if 1
-
-#define		OBJ_CROWDED	0x0001
-#define		OBJ_MERGED	0x0002
-#define		OBJ_SATUR	0x0004
-#define		OBJ_TRUNC	0x0008
-#define		OBJ_APERT_PB	0x0010
-#define		OBJ_ISO_PB	0x0020
-#define		OBJ_DOVERFLOW	0x0040
-#define		OBJ_OVERFLOW	0x0080
-
-void compute_myotherparams(objstruct *obj, float isomag)
-  {
-	char linbuf[256];
-	ImagePtr		image;
-	ImageObjectPtr	object;
-	double			min, max, background = obj->bkg, amplitude = obj->apermag, maxcol = obj->mx, maxrow = obj->my;
-	double radius = sqrt(pow(obj->xmax-obj->xmin,2.0)+pow(obj->ymax-obj->ymin,2.0))/2.0;
-
-	GWindowPtr saved_window = GetActiveImageWindow();
+/*** FindImageWindowImageObjects **************************************************
 
-	image = GetImageWindowImage ( saved_window );
-			
-	/*** Create an image object centered on the best-fit centroid position,
-	     with a size equal to the best-fit radius. ***/
-	     
-	object = CreateImageObject ( image, maxcol, maxrow, radius );
-	if ( object != NULL )
-	{
-		SetImageObjectBackground ( object, background );
-		SetImageObjectAmplitude  ( object, amplitude );
-		SetImageObjectCentroidX  ( object, maxcol );
-		SetImageObjectCentroidY  ( object, maxrow );
-		SetImageObjectRadius     ( object, radius );
+	Finds the stars and other objects in the first frame of an image window's
+	image with SExtractor, and adds an image object for each one.
 	
-		AddImageObject ( image, object );
-		GInvalidateWindow ( saved_window, NULL );
-		
-			sImageObjectRadius = GetImageObjectRadius ( object );
-	}
-  sprintf(linbuf, "%8d %6.1f %6.1f %5.1f %5.1f %7.3f "
-			"%c%c%c%c%c%c%c%c\n",
-	obj->number, obj->mx, obj->my,
-	obj->a, obj->b,
-	isomag,
-	obj->flag&OBJ_CROWDED?'C':'_',
-	obj->flag&OBJ_MERGED?'M':'_',
-	obj->flag&OBJ_SATUR?'S':'_',
-	obj->flag&OBJ_TRUNC?'T':'_',
-	obj->flag&OBJ_APERT_PB?'A':'_',
-	obj->flag&OBJ_ISO_PB?'I':'_',
-	obj->flag&OBJ_DOVERFLOW?'D':'_',
-	obj->flag&OBJ_OVERFLOW?'O':'_');
-  }
+	void FindImageWindowImageObjects ( GWindowPtr window, PIXEL minlimit,
+	     PIXEL maxlimit, double sigma )
+	
+	(window):   pointer to image window.
+	(minlimit): not used.
+	(maxlimit): not used.
+	(sigma):    not used.
+	
+	SExtractor works straight on the image data in memory, so the image need not
+	have been saved.  Each object is placed at its barycenter, with SExtractor's
+	local background and peak value above it as its background and amplitude,
+	and the geometric mean of its RMS major and minor axes as its radius.
+	
+************************************************************************************/
 
 void FindImageWindowImageObjects ( GWindowPtr window, PIXEL minlimit, PIXEL maxlimit, double sigma )
 {
-	short			rows, cols, frames, row, col, frame;
-	PIXEL			**data, min, max;
-	ImagePtr		imageptr;
-	ImageRegionPtr	region;
-	double			params[5], errors[5];
-
-	imageptr  = GetImageWindowImage ( window );
-
-#if 0
-	frames = GetImageFrames ( imageptr );
-	rows   = GetImageRows ( imageptr );
-	cols   = GetImageColumns ( imageptr );
-	for ( frame = 0; frame < frames; frame++ )
-	{
-		min = HUGE_VAL;
-		max = -HUGE_VAL;
-		data = GetImageDataFrame ( imageptr, frame );
-
-		for ( row = 0; row < rows; row++ )
-		{
-			for ( col = 0; col < cols; col++ )
-			{
-				if ( data[row][col] > max )
-					max = data[row][col];
-				if ( data[row][col] < min )
-					min = data[row][col];
-
-			}
-		}
-	}
-	fprintf(stderr, "Min %f\n", min);
-	fprintf(stderr, "Max %f\n", max);
+	ImagePtr		image = GetImageWindowImage ( window );
+	ImageObjectPtr	object;
+	sexstruct		*sex;
+	objstruct		*obj;
+	PIXTYPE			**data;
+	short			rows = GetImageRows ( image ), cols = GetImageColumns ( image );
+	long			i, numObjects;
+#if BITPIX != -32
+	PIXEL			**frame = GetImageDataFrame ( image, 0 );
+	short			row, col;
 #endif
-	protected_sextract_main(imageptr->imagePath);
-}
 
-#else
-
-void FindImageWindowImageObjects ( GWindowPtr window, PIXEL min, PIXEL max, double sigma )
-{
-	short			rows, cols, frames, row, col, frame;
-	short			radius, left, top, right, bottom;
-	PIXEL			***oldMatrix, *data;
-	ImagePtr		image;
-	ImageRegionPtr	region;
-	double			params[5], errors[5];
-	
-	image  = GetImageWindowImage ( window );
-	frames = GetImageFrames ( image );
-	rows   = GetImageRows ( image );
-	cols   = GetImageColumns ( image );
-	
-	/*** Re-allocate the image window's image data matrix, and save a pointer
-	     to the previous image data matrix.  On failure, return. ***/
-
-	oldMatrix = ResizeImageWindowImage ( window, cols, rows, TRUE );
-	if ( oldMatrix == NULL )
+	sex = sexnew();
+	if ( sex == NULL )
+	{
+		WarningMessage ( G_OK_ALERT, CANT_ALLOCATE_MEMORY_STRING );
 		return;
+	}
 	
-	/*** Compute the radius of the region around each pixel to which we will
-	     try to fit the stellar model function.  The value of this radius
-	     should be 3 times the expected one-sigma stellar profile radius;
-	     if stellar profiles are reasonably Gaussian, then 95% of the light
-	     should fall within this radius. ***/
+	/*** SExtractor works with floating-point pixels.  If that's what the image
+	     has, it reads the image data frame in place; otherwise, it gets a
+	     floating-point copy. ***/
 	     
-	radius = 4.0 * sigma + 0.5;
-	
-	left = radius;
-	top = radius;
-	right = cols - radius;
-	bottom = rows - radius;
+#if BITPIX == -32
+	data = GetImageDataFrame ( image, 0 );
+#else
+	data = (PIXTYPE **) malloc ( rows * ( sizeof ( PIXTYPE * ) + sizeof ( PIXTYPE ) * cols ) );
+	if ( data == NULL )
+	{
+		sexdelete ( sex );
+		WarningMessage ( G_OK_ALERT, CANT_ALLOCATE_MEMORY_STRING );
+		return;
+	}
 	
-	for ( frame = 0; frame < frames; frame++ )
+	for ( row = 0; row < rows; row++ )
 	{
-		for ( row = radius; row < rows - radius; row++ )
-		{
-			top = row - radius;
-			bottom = row + radius;
-			
-			data = GetImageDataRow ( image, frame, row );
-			
-			for ( col = radius; col < cols - radius; col++ )
-			{
-				data[col] = 0;
-
-				/*** Create a temporary image region surrounding the pixel we are trying to fit
-				     the stellar model function to.  If we succeed, fit the surface function
-				     to that region of the image. ***/
-				 
-				left = col - radius;
-				right = col + radius;
-				region = NewImageRegion ( IMAGE_REGION_TYPE_RECTANGULAR, left, top, right, bottom );
-
-				if ( region != NULL )
-				{
-					/*** We are fitting only the first two terms (background and amplitude) in the
-					     stellar model function, but we need to pass in values for the other terms
-					     in the equation so that the first two can be evaluated. ***/
-					
-					params[2] = col;
-					params[3] = row;
-					params[4] = sigma;
-					
-					/*** If we can fit the background and amplitude, set the image data value at the
-					     corresponding position to the amplitude.  Then delete the temporary image region. ***/
-						
-					if ( FitImageSurface ( oldMatrix[ frame ], region, min, max, GaussianSurface, 2, params, errors ) )
-					{
-						data[col] = params[0];
-						DeleteImageRegion ( region );
-					}
-				}
-			}
-		}
+		data[row] = (PIXTYPE *) ( data + rows ) + (long) row * cols;
+		for ( col = 0; col < cols; col++ )
+			data[row][col] = frame[row][col];
 	}
+#endif
 
-	/*** Draw the image window's offscreen bitmap, resize the image's window
-	     to fit the image, then invalidate the window so it gets redrawn. ***/
-
-	ComputeImageDisplayRange ( window );
-	DrawImageWindowBitmap ( window );
-	GInvalidateWindow ( window, NULL );
-}
-
-void FindImageWindowImageObjects ( GWindowPtr window, PIXEL min, PIXEL max, double sigma )
-{
-	short			rows, cols, frames, row, col, frame;
-	short			radius, left, top, right, bottom;
-	PIXEL			**data, ***oldMatrix;
-	ImagePtr		image;
-	ImageRegionPtr	region;
-	ImageObjectPtr	object;
-	double			threshold, background, noise;
-	
-	image  = GetImageWindowImage ( window );
-	frames = GetImageFrames ( image );
-	rows   = GetImageRows ( image );
-	cols   = GetImageColumns ( image );
+	numObjects = sexextract ( sex, data, cols, rows );
+	if ( numObjects < 0 )
+	{
+		if ( sex->errmsg[0] )
+			GDoAlert ( G_WARNING_ALERT, G_OK_ALERT, sex->errmsg );
+		else
+			WarningMessage ( G_OK_ALERT, CANT_ALLOCATE_MEMORY_STRING );
+	}
 	
-	/*** Re-allocate the image window's image data matrix, and save a pointer
-	     to the previous image data matrix.  On failure, return. ***/
-
-	oldMatrix = ResizeImageWindowImage ( window, cols, rows, TRUE );
-	if ( oldMatrix == NULL )
-		return;
-
-	/*** Compute the radius of the region around each pixel to which we will
-	     try to fit the stellar model function.  The value of this radius
-	     should be 3 times the expected one-sigma stellar profile radius;
-	     if stellar profiles are reasonably Gaussian, then 95% of the light
-	     should fall within this radius. ***/
+	/*** SExtractor's positions are FITS pixel coordinates, which start at 1
+	     rather than 0. ***/
 	     
-	radius = 4.0 * sigma + 0.5;
-	
-	left = radius;
-	top = radius;
-	right = cols - radius;
-	bottom = rows - radius;
-	
-	for ( frame = 0; frame < frames; frame++ )
+	for ( i = 0; i < numObjects; i++ )
 	{
-		data = GetImageDataFrame ( image, frame );
-			
-		for ( row = radius; row < rows - radius; row++ )
+		obj = &sex->obj[i];
+		object = CreateImageObject ( image, obj->mx - 1.0, obj->my - 1.0, sqrt ( obj->a * obj->b ) );
+		if ( object != NULL )
 		{
-			bottom = row + 5 * sigma;
-			if ( bottom >= rows )
-				bottom = rows - 1;
-				
-			top = row - 5 * sigma;
-			if ( top < 0 )
-				top = 0;
-				
-			for ( col = radius; col < cols - radius; col++ )
-			{
-				left = col - 5 * sigma;
-				if ( left < 0 )
-					left = 0;
-					
-				right = col + 5 * sigma;
-				if ( right >= cols )
-					right = cols - 1;
-				
-				region = NewImageRegion ( IMAGE_REGION_TYPE_RECTANGULAR, left, top, right, bottom );
-				if ( region != NULL )
-				{
-					ComputeImageRegionBackground ( oldMatrix[0], region, 3, &background, &noise );
-					DeleteImageRegion ( region );
-					
-					threshold = background + 3 * noise;
-					
-					if ( data[row][col] > threshold && IsLocalMaximum ( data, rows, cols, row, col ) )
-					{
-						object = CreateImageObject ( image, col, row, sigma );
-						if ( object != NULL )
-							AddImageObject ( image, object );
-					}
-					
-					data[row][col] = background;
-				}
-			}
+			SetImageObjectBackground ( object, obj->bkg );
+			SetImageObjectAmplitude  ( object, obj->maxflux );
+			AddImageObject ( image, object );
 		}
 	}
-
-	FreeFITSImageDataMatrix ( oldMatrix );
 	
-	/*** Draw the image window's offscreen bitmap, resize the image's window
-	     to fit the image, then invalidate the window so it gets redrawn. ***/
-
-	ComputeImageDisplayRange ( window );
-	DrawImageWindowBitmap ( window );
+#if BITPIX != -32
+	free ( data );
+#endif
+	sexdelete ( sex );
 	GInvalidateWindow ( window, NULL );
 }
 
-void FindImageWindowImageObjects ( GWindowPtr window, PIXEL min, PIXEL max, double sigma )
-{
-	short			rows, cols, frames, row, col, frame;
-	short			radius, left, top, right, bottom;
-	PIXEL			**data, ***oldMatrix;
-	ImagePtr		image;
-	ImageObjectPtr	object;
-	double			threshold, background, noise;
+/*** FindImageWindowImagePeaks ****************************************************
+
+	Finds the stars in the first frame of an image window's image as local peaks,
+	and adds an image object for each one.  This is quicker than, but not as
+	thorough as, FindImageWindowImageObjects().
+	
+	void FindImageWindowImagePeaks ( GWindowPtr window, PIXEL minlimit,
+	     PIXEL maxlimit, double sigma )
+	
+	(window):   pointer to image window.
+	(minlimit): image data values below this are ignored when fitting objects.
+	(maxlimit): image data values above this are ignored when fitting objects.
+	(sigma):    expected one-sigma radius of the stars, in pixels.
 	
-	image  = GetImageWindowImage ( window );
-	frames = GetImageFrames ( image );
-	rows   = GetImageRows ( image );
-	cols   = GetImageColumns ( image );
+	The stars are found with DetectImageObjects(), as peaks more than 3 standard
+	deviations above the local background, then refined by fitting the Gaussian
+	star model to each with FitImageObjects().  If a typical star profile has been
+	defined with DefineImageWindowImageObjectPSF(), its radius is used in place
+	of (sigma).
 	
-	/*** Re-allocate the image window's image data matrix, and save a pointer
-	     to the previous image data matrix.  On failure, return. ***/
+************************************************************************************/
 
-	oldMatrix = ResizeImageWindowImage ( window, cols, rows, TRUE );
-	if ( oldMatrix == NULL )
-		return;
+void FindImageWindowImagePeaks ( GWindowPtr window, PIXEL minlimit, PIXEL maxlimit, double sigma )
+{
+	ImagePtr		image = GetImageWindowImage ( window );
+	ImageObjectPtr	*objects = NULL;
+	long			numObjects;
 
-	for ( frame = 0; frame < frames; frame++ )
+	if ( sImageObjectRadius > 0.0 )
+		sigma = sImageObjectRadius;
+		
+	numObjects = DetectImageObjects ( image, 0, sigma, 3.0, &objects );
+	if ( numObjects < 0 )
 	{
-		data = oldMatrix[frame];
-			
-		for ( row = 0; row < rows; row++ )
-		{
-			for ( col = 0; col < cols; col++ )
-			{
-				if ( IsLocalMaximum ( data, rows, cols, row, col ) )
-				{
-					ComputePixelBackground ( data, cols, rows, col, row, 3.0 * sigma + 0.5, 5.0 * sigma + 0.5, 3.0, &background, &noise );
-					threshold = background + 3 * noise;
-					if ( data[row][col] > threshold )
-					{
-						object = CreateImageObject ( image, col, row, sigma );
-						if ( object != NULL )
-							AddImageObject ( image, object );
-					}
-				}
-			}
-		}
+		WarningMessage ( G_OK_ALERT, CANT_ALLOCATE_MEMORY_STRING );
+		return;
+	}
+	
+	if ( objects != NULL )
+	{
+		FitImageObjects ( GetImageDataFrame ( image, 0 ), objects, numObjects, minlimit, maxlimit, 0.0001, 100 );
+		InvalidateImageObjectIndex ( image );
+		free ( objects );
 	}
-
-	FreeFITSImageDataMatrix ( oldMatrix );
 	
-	/*** Draw the image window's offscreen bitmap, resize the image's window
-	     to fit the image, then invalidate the window so it gets redrawn. ***/
-
-	ComputeImageDisplayRange ( window );
-	DrawImageWindowBitmap ( window );
 	GInvalidateWindow ( window, NULL );
 }
 
-#endif
-
 /*** DeleteImageWindowImageObjects *************************************************************
 
 	Deletes all objects in an image window's selected region; or, if the window has no selected
@@ -491,9 +319,10 @@ void FindImageWindowImageObjects ( GWindowPtr window, PIXEL min, PIXEL max, doub
 void DeleteImageWindowImageObjects ( GWindowPtr window )
 {
 	short			col, row;
+	long			i, n, numObjects;
 	ImagePtr		image;
 	ImageRegionPtr	region;
-	ImageObjectPtr	object;
+	ImageObjectPtr	*objects;
 	
 	image = GetImageWindowImage ( window );
 	region = GetImageWindowSelectedRegion ( window );
@@ -504,17 +333,35 @@ void DeleteImageWindowImageObjects ( GWindowPtr window )
 	}
 	else
 	{
-		for ( object = GetImageObjectList ( image ); object != NULL; object = GetNextImageObject ( object ) )
+		/*** Find the objects whose centroids round to pixels inside the region's
+		     bounding rectangle, then keep only those actually in the region. ***/
+		     
+		numObjects = FindImageObjectsInRect ( image,
+		             GetImageRegionLeft ( region ) - 0.5, GetImageRegionTop ( region ) - 0.5,
+		             GetImageRegionRight ( region ) + 0.5, GetImageRegionBottom ( region ) + 0.5, &objects );
+		
+		if ( numObjects < 0 )
 		{
-			col = GetImageObjectCentroidX ( object ) + 0.5;
-			row = GetImageObjectCentroidY ( object ) + 0.5;
+			WarningMessage ( G_OK_ALERT, CANT_ALLOCATE_MEMORY_STRING );
+			return;
+		}
+		
+		for ( n = i = 0; i < numObjects; i++ )
+		{
+			col = GetImageObjectCentroidX ( objects[i] ) + 0.5;
+			row = GetImageObjectCentroidY ( objects[i] ) + 0.5;
 			
 			if ( IsPixelInImageRegion ( region, col, row ) )
-			{
-				RemoveImageObject ( image, object );
-				DeleteImageObject ( object );
-			}
+				objects[n++] = objects[i];
 		}
+		
+		RemoveImageObjects ( image, objects, n );
+		
+		for ( i = 0; i < n; i++ )
+			DeleteImageObject ( objects[i] );
+			
+		if ( objects != NULL )
+			free ( objects );
 	}
 	
 	GInvalidateWindow ( window, NULL );
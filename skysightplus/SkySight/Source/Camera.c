@@ -49,6 +49,7 @@ struct Camera
 	ExposurePtr				cameraCurrentExposure;
 	FITSImagePtr			cameraDarkFrame;
 	short					cameraDarkFrameMode;
+	ImageCalibrationPtr		cameraCalibration;
 	short					cameraStatus;
 	long					cameraExposureStartTime;
 	short					cameraDownloadRow;
@@ -121,6 +122,7 @@ CameraPtr NewCameraConnection ( short cameraType, short filterType, short port )
 	
 	camera->cameraDarkFrame = NULL;
 	camera->cameraDarkFrameMode = DARK_FRAME_NEVER;
+	camera->cameraCalibration = NULL;
 	camera->cameraExposureMode = EXPOSURE_MODE_IMAGE;
 	camera->cameraExposureFilter = FILTER_CLEAR;
 	camera->cameraExposureWindow = NULL;
@@ -161,6 +163,16 @@ CameraPtr NewCameraConnection ( short cameraType, short filterType, short port )
     	return ( NULL );
     }
     
+    /*** Ask the camera how many rows it can download at once.  If the
+         interface procedure doesn't know, it can only download one. ***/
+         
+	camera->cameraInterfaceData.cameraDownloadRowsMax = 1;
+	if ( (*proc) ( CAMERA_GET_DOWNLOAD_INFO, &camera->cameraInterfaceData ) != TRUE )
+		camera->cameraInterfaceData.cameraDownloadRowsMax = 1;
+	
+	if ( camera->cameraInterfaceData.cameraDownloadRowsMax < 1 )
+		camera->cameraInterfaceData.cameraDownloadRowsMax = 1;
+		
 	/*** If there is as yet no active camera, make the camera record we just
 	     allocated the active one.  Finally, return a pointer to the new camera
 	     record. ***/
@@ -201,6 +213,9 @@ void DeleteCameraConnection ( CameraPtr camera )
 	if ( camera->cameraDarkFrame != NULL )
 		FreeFITSImage ( camera->cameraDarkFrame );
 	
+	if ( camera->cameraCalibration != NULL )
+		DeleteImageCalibration ( camera->cameraCalibration );
+	
 	if ( camera->cameraExposureWindow != NULL )
 		SetImageWindowCamera ( camera->cameraExposureWindow, NULL );
 	
@@ -554,6 +569,49 @@ short GetCameraDarkFrameMode ( CameraPtr camera )
 	return ( camera->cameraDarkFrameMode );
 }
 
+/*** SetCameraCalibration *********************************************************
+
+	Gives a camera a set of master calibration frames to apply to its light image
+	exposures as they are downloaded.
+
+	void SetCameraCalibration ( CameraPtr camera, ImageCalibrationPtr calibration )
+
+	(camera):      pointer to camera record.
+	(calibration): pointer to calibration record, or NULL for none.
+	
+	The camera takes over the calibration record, and deletes it when it is replaced
+	or when the camera is closed.  Calibration is only applied when the camera's dark
+	frame mode is DARK_FRAME_NEVER, since otherwise the camera's own dark frames take
+	care of the bias and thermal signal, and to images of the same size as the master
+	frames; the master frames must therefore have been taken at the binning in use.
+	The "Calibrate..." command in the Process menu sets them; see CalibrateImageWindow().
+	
+**************************************************************************************/
+
+void SetCameraCalibration ( CameraPtr camera, ImageCalibrationPtr calibration )
+{
+	if ( camera->cameraCalibration != NULL && camera->cameraCalibration != calibration )
+		DeleteImageCalibration ( camera->cameraCalibration );
+		
+	camera->cameraCalibration = calibration;
+}
+
+/*** GetCameraCalibration *********************************************************
+
+	Returns a pointer to a camera's set of master calibration frames, or NULL if it
+	has none.  See SetCameraCalibration() for more information.
+
+	ImageCalibrationPtr GetCameraCalibration ( CameraPtr camera )
+
+	(camera): pointer to camera record.
+	
+**************************************************************************************/
+
+ImageCalibrationPtr GetCameraCalibration ( CameraPtr camera )
+{
+	return ( camera->cameraCalibration );
+}
+
 /*** SetCameraExposureMode ******************************************************
 
 	Changes the camera's exposure mode.
@@ -1722,11 +1780,6 @@ short DownloadCameraImageRow ( CameraPtr camera, short left, short right, PIXEL
 	short					width, col, result = FALSE;
 	unsigned short			*buffer = NULL;
 
-	/*** If we haven't yet begun downloading image data, fail. ***/
-	
-	if ( camera->cameraStatus != CAMERA_STATUS_DOWNLOADING )
-		return ( FALSE );
-
 	/*** Allocate a temporary buffer of short integers into which
 	     data will be copied from the camera driver.  If we can't,
 	     return a memory allocation error code. ***/
@@ -1736,24 +1789,16 @@ short DownloadCameraImageRow ( CameraPtr camera, short left, short right, PIXEL
 	if ( buffer == NULL )
 		return ( FALSE );
 
-	/*** Now download one row of image data from the camera. ***/
-
-	camera->cameraInterfaceData.cameraDownloadStart = left;
-	camera->cameraInterfaceData.cameraDownloadWidth = width;
-	camera->cameraInterfaceData.cameraDownloadBuffer = buffer;
-	
-	result = (*camera->cameraInterfaceProc) ( CAMERA_DOWNLOAD_ROW, &camera->cameraInterfaceData );
-
-	/*** If we successfully downloaded a row of image data from the camera,
+	/*** Now download one row of image data from the camera.  If we succeed,
 	     copy data from the buffer into the corresponding FITS image matrix
-	     row, then update the row download counter. ***/
+	     row. ***/
+
+	result = DownloadCameraImageRowData ( camera, left, right, buffer );
 	     
 	if ( result == TRUE )
 	{
     	for ( col = left; col <= right; col++ )
     		data[col] = buffer[ col - left ];
-		
-		camera->cameraDownloadRow++;
     }
 
 	/*** Finally, free the buffer and return the result code. ***/
@@ -1761,3 +1806,99 @@ short DownloadCameraImageRow ( CameraPtr camera, short left, short right, PIXEL
 	free ( buffer );
     return ( result );
 }
+
+/*** DownloadCameraImageRowData ************************************************
+
+	Reads out all or a portion of one row of raw image data from the camera.
+
+	short DownloadCameraImageRowData ( CameraPtr camera, short left, short right,
+	      unsigned short *buffer )
+
+	(camera): pointer to camera record.
+    (left):   column from which to start reading data.
+    (right):  column at which to finish reading data.
+    (buffer): buffer to receive data.
+
+	The function returns TRUE if can complete the command successfully, or FALSE
+	if it fails.
+
+	This is the same as DownloadCameraImageRow(), except that the camera
+	driver's values are left in their original form, and are stored starting
+	at buffer[0] rather than buffer[left].  The buffer must have room for
+	(right - left + 1) values.  No memory is allocated, so this is the one to
+	use when downloading many rows into buffers which you allocate once.
+	
+	Camera drivers are not thread-safe; while a download is in progress, call
+	this function from only one thread.
+
+***********************************************************************************/
+
+short DownloadCameraImageRowData ( CameraPtr camera, short left, short right, unsigned short *buffer )
+{
+	return ( DownloadCameraImageRowsData ( camera, left, right, 1, buffer ) );
+}
+
+/*** DownloadCameraImageRowsData ***********************************************
+
+	Reads out all or the same portion of a block of consecutive rows of raw
+	image data from the camera.
+
+	short DownloadCameraImageRowsData ( CameraPtr camera, short left, short right,
+	      short rows, unsigned short *buffer )
+
+	(camera): pointer to camera record.
+    (left):   column from which to start reading data.
+    (right):  column at which to finish reading data.
+    (rows):   number of rows to read.
+    (buffer): buffer to receive data.
+
+	The function returns TRUE if can complete the command successfully, or FALSE
+	if it fails.
+
+	The rows are stored one after another in the buffer, each taking up
+	(right - left + 1) values, so the buffer must have room for (rows) times
+	that many.  If the camera interface can download blocks of rows, they are
+	requested with as few CAMERA_DOWNLOAD_ROWS calls as possible; otherwise,
+	this function falls back on one CAMERA_DOWNLOAD_ROW call per row.
+
+***********************************************************************************/
+
+short DownloadCameraImageRowsData ( CameraPtr camera, short left, short right, short rows, unsigned short *buffer )
+{
+	short					result = TRUE, count, width = right - left + 1;
+	short					maxRows = camera->cameraInterfaceData.cameraDownloadRowsMax;
+
+	/*** If we haven't yet begun downloading image data, fail. ***/
+	
+	if ( camera->cameraStatus != CAMERA_STATUS_DOWNLOADING )
+		return ( FALSE );
+
+	/*** Now download the rows of image data from the camera, as many
+	     at a time as it can manage.  Each time we succeed, update the
+	     row download counter. ***/
+
+	camera->cameraInterfaceData.cameraDownloadStart = left;
+	camera->cameraInterfaceData.cameraDownloadWidth = width;
+	
+	while ( rows > 0 && result == TRUE )
+	{
+		count = rows < maxRows ? rows : maxRows;
+		
+		camera->cameraInterfaceData.cameraDownloadRows = count;
+		camera->cameraInterfaceData.cameraDownloadBuffer = buffer;
+		
+		if ( maxRows > 1 )
+			result = (*camera->cameraInterfaceProc) ( CAMERA_DOWNLOAD_ROWS, &camera->cameraInterfaceData );
+		else
+			result = (*camera->cameraInterfaceProc) ( CAMERA_DOWNLOAD_ROW, &camera->cameraInterfaceData );
+	
+		if ( result == TRUE )
+		{
+			camera->cameraDownloadRow += count;
+			buffer += (long) count * width;
+			rows -= count;
+		}
+	}
+
+    return ( result );
+}
@@ -45,6 +45,65 @@
 #define CAMERA_EXPOSURE_STATUS_TEXT			19
 #define CAMERA_EXPOSURE_STATUS_BAR			20
 
+/*** local data types ***/
+
+/*** A DownloadPipeline carries image data from the camera into an image.
+     A reader thread downloads rows of raw camera data into a ring of
+     DOWNLOAD_RING_ROWS preallocated row buffers, while the main thread
+     takes the filled buffers in batches, has them converted, dark-frame
+     corrected, and stored into the image by parallel tasks, and handles
+     user-interface events.  Two semaphores count the free and filled
+     buffers.  Runs of up to DOWNLOAD_BLOCK_ROWS consecutive rows are read
+     from the camera with one call, into adjacent ring buffers.  That is half
+     the ring, so the reader can fill one half while the main thread stores
+     the other; downloadbench.c measures the effect of the block size.  The
+     reader ends the download by filling in one more ring entry with a row
+     number of -1. ***/
+
+#define DOWNLOAD_RING_ROWS		16
+#define DOWNLOAD_BLOCK_ROWS		( DOWNLOAD_RING_ROWS / 2 )
+
+typedef struct DownloadRow
+{
+	short			row;
+	short			left;
+	short			right;
+	short			result;
+	unsigned short	*data;
+}
+DownloadRow, *DownloadRowPtr;
+
+typedef struct DownloadPipeline
+{
+	CameraPtr		camera;
+	long			numSegments;
+	short			*segments;
+	short			width;
+	unsigned short	*buffer;
+	DownloadRow		ring[DOWNLOAD_RING_ROWS];
+	GSemaphorePtr	freeRows;
+	GSemaphorePtr	readyRows;
+	volatile int	cancel;
+	ImagePtr		image;
+	FITSImagePtr	dark;
+	ImageCalibrationPtr	calibration;
+	double			exposure;
+	PIXEL			*calibrated;
+	short			frame;
+	int				copyFrames;
+	int				shutterClosed;
+	int				darkFrameOnly;
+	int				combine;
+	long			first;
+}
+DownloadPipeline, *DownloadPipelinePtr;
+
+/*** The pipeline of the download in progress, if any, and its reader thread.
+     The reader is set to NULL once it has been waited for. ***/
+
+static DownloadPipelinePtr	sDownloadPipeline = NULL;
+static GThreadPtr			sDownloadReader = NULL;
+
 /*** local functions ***/
 
 static void			BuildReadoutMenu ( GWindowPtr, CameraPtr );
@@ -55,7 +114,10 @@ static float		ExposureControlValueToTime ( short );
 static short		ExposureTimeToControlValue ( float );
 static int			DownloadImage ( CameraPtr, ImagePtr, ImageRegionPtr );
 static int			DoDownloadEvent ( CameraPtr, long, short, short, short );
-static void			DarkFrameImageDataRow ( CameraPtr, short, short, short, PIXEL * );
+static void			ReadDownloadRows ( void * );
+static void			StopDownloadReader ( void );
+static void			StoreDownloadRow ( void *, long );
+static void			DeleteDownloadPipeline ( DownloadPipelinePtr );
 static ExposureList	NewCameraExposureList ( CameraPtr camera );
 static void			DeleteCameraExposureList ( CameraPtr camera );
 
@@ -1077,6 +1139,12 @@ void CancelExposure ( CameraPtr camera )
 {
 	GWindowPtr	window;
 	
+	/*** If we are called while an image is being downloaded, stop the download
+	     pipeline's reader thread first, so that it is no longer calling the
+	     camera interface when we do. ***/
+	     
+	StopDownloadReader();
+	
 	/*** Return the camera to its idle state, delete the camera's exposure list,
 	     move the camera's filter back to its default position,
 	     and update the exposure status display in the "camera control" dialog. ***/
@@ -1134,9 +1202,12 @@ void CancelExposure ( CameraPtr camera )
 
 int DownloadImage ( CameraPtr camera, ImagePtr image, ImageRegionPtr region )
 {
-	int		result = TRUE, deleteRegion = FALSE;
-	short	left, top, right, bottom, width, height, mode, filter, row, col;
-	PIXEL	*data, *data1, *data2, *dark, *buffer;
+	int					result = TRUE, deleteRegion = FALSE, done;
+	short				left, top, right, bottom, width, height, mode, filter, row, frame;
+	long				i, count;
+	DownloadPipeline	pipeline;
+	DownloadRowPtr		entry;
+	GThreadPtr			reader;
 	
 	/*** Determine the dimensions of the image we will download. ***/
 	
@@ -1188,153 +1259,398 @@ int DownloadImage ( CameraPtr camera, ImagePtr image, ImageRegionPtr region )
         }
 	}
 
-	/*** Allocate a temporary buffer big enough to hold one row of pixels,
-	     into which data will be copied from the camera driver.  If we can't,
-	     display a memory allocation warning and return an error code. ***/
+	/*** Make a list of the row segments we will download, so that the
+	     reader thread doesn't need to look at the region while the user
+	     interface is running.  If we can't, display a memory allocation
+	     warning and return an error code. ***/
 
-	buffer = (PIXEL *) malloc ( sizeof ( PIXEL ) * width );
-	if ( buffer == NULL )
+	memset ( &pipeline, 0, sizeof ( pipeline ) );
+	
+    for ( row = -1; GetImageRegionSegment ( region, &row, &left, &right ); row = row )
+		pipeline.numSegments++;
+		
+	pipeline.segments = (short *) malloc ( sizeof ( short ) * 3 * ( pipeline.numSegments + 1 ) );
+	pipeline.buffer = (unsigned short *) malloc ( sizeof ( unsigned short ) * width * DOWNLOAD_RING_ROWS );
+	pipeline.freeRows = GCreateSemaphore ( DOWNLOAD_RING_ROWS, 2 * DOWNLOAD_RING_ROWS );
+	pipeline.readyRows = GCreateSemaphore ( 0, 2 * DOWNLOAD_RING_ROWS );
+	
+	if ( pipeline.segments == NULL || pipeline.buffer == NULL || pipeline.freeRows == NULL || pipeline.readyRows == NULL )
 	{
+		DeleteDownloadPipeline ( &pipeline );
 		if ( deleteRegion )
 			DeleteImageRegion ( region );
         GDoAlert ( G_WARNING_ALERT, G_OK_ALERT, GString ( CANT_ALLOCATE_MEMORY_STRING ) );
 		return ( FALSE );
 	}
 	
-    /*** Now read the rows of the inage which lie within the specified
-         region.  If we fail at any point, delete the region (if necessary)
-         and return an error code.  If the user cancels the download,
-         return a successful result code. ***/
+	for ( i = 0, row = -1; GetImageRegionSegment ( region, &row, &left, &right ); i++ )
+	{
+		pipeline.segments[ i * 3 ] = row;
+		pipeline.segments[ i * 3 + 1 ] = left;
+		pipeline.segments[ i * 3 + 2 ] = right;
+	}
+	
+	pipeline.width = width;
+	
+	/*** Tell the program which part of the image is about to change, so that
+	     only that part need be redrawn and have its statistics recomputed when
+	     the download is finished.  A color image with a non-color filter is
+	     copied into all three frames. ***/
+	
+	if ( mode == EXPOSURE_MODE_COLOR_IMAGE )
+		frame = filter == FILTER_RED ? 0 : filter == FILTER_GREEN ? 1 : filter == FILTER_BLUE ? 2 : -1;
+	else
+		frame = 0;
+		
+	BeginImageChange ( image, frame, GetImageRegionLeft ( region ), top,
+	                   GetImageRegionRight ( region ), GetImageRegionBottom ( region ) );
+	
+	/*** Work out once what needs to be done with each row of data, depending
+	     on whether we are taking a dark or light image, and on the camera's
+	     current exposure and dark-frame behavior. ***/
+	     
+	pipeline.camera = camera;
+	pipeline.image = image;
+	pipeline.frame = frame < 0 ? 0 : frame;
+	pipeline.copyFrames = frame < 0;
+	pipeline.shutterClosed = GetCameraExposureShutter ( camera ) == SHUTTER_CLOSED;
+	pipeline.darkFrameOnly = GetCameraDarkFrameMode ( camera ) == DARK_FRAME_ONLY;
+	pipeline.combine = mode == EXPOSURE_MODE_COMBINED_IMAGE && GetCameraExposureNumber ( camera ) > 1;
+	
+	if ( pipeline.shutterClosed )
+		pipeline.dark = GetCameraDarkFrame ( camera );
+	
+	/*** Light exposures are calibrated as they are stored, if the camera has
+	     master calibration frames and isn't taking its own dark frames.  In
+	     combined-image mode each exposure is calibrated before it is added, in
+	     a buffer which parallels the ring. ***/
+	     
+	if ( ! pipeline.shutterClosed && GetCameraDarkFrameMode ( camera ) == DARK_FRAME_NEVER )
+	{
+		pipeline.calibration = GetCameraCalibration ( camera );
+		pipeline.exposure = GetCameraExposureLength ( camera );
+		
+		if ( pipeline.calibration != NULL && pipeline.combine )
+		{
+			pipeline.calibrated = (PIXEL *) malloc ( sizeof ( PIXEL ) * width * DOWNLOAD_RING_ROWS );
+			if ( pipeline.calibrated == NULL )
+				pipeline.calibration = NULL;
+		}
+	}
+	
+	/*** Start the reader thread.  If we can't, display a warning and return
+	     an error code. ***/
+	     
+	reader = GCreateThread ( ReadDownloadRows, &pipeline );
+	if ( reader == NULL )
+	{
+		DeleteDownloadPipeline ( &pipeline );
+		if ( deleteRegion )
+			DeleteImageRegion ( region );
+		GDoAlert ( G_WARNING_ALERT, G_OK_ALERT, "Can't download image from camera!" );
+		return ( FALSE );
+	}
+	
+	sDownloadPipeline = &pipeline;
+	sDownloadReader = reader;
+	
+    /*** Now take the rows from the ring as they arrive, waiting no more than
+         a tenth of a second at a time so that we can handle background events.
+         Take all of the rows which are ready at once, and store them into the
+         image in parallel; then hand their buffers back to the reader thread.
+         Stop at the end marker, or at a row which the camera failed to
+         download. ***/
 
     bottom = GetImageRegionBottom ( region );
-    for ( row = -1; GetImageRegionSegment ( region, &row, &left, &right ); row = row )
+    row = top;
+	done = FALSE;
+	
+    while ( ! done )
     {
-		/*** Obtain a pointer to the image row which should receive the
-		     data downloaded from the camera. ***/
-		
-		if ( mode == EXPOSURE_MODE_COLOR_IMAGE )
+		if ( GWaitSemaphore ( pipeline.readyRows, 100 ) )
 		{
-			/*** If we're exposing a color image, make sure we place the image data
-			     into the proper frame of the image, depending on which filter the
-			     image has been taken with. ***/
+			for ( count = 1; count < DOWNLOAD_RING_ROWS; count++ )
+				if ( ! GWaitSemaphore ( pipeline.readyRows, 0 ) )
+					break;
+			
+			for ( i = 0; i < count; i++ )
+			{
+				entry = &pipeline.ring[ ( pipeline.first + i ) % DOWNLOAD_RING_ROWS ];
+				if ( entry->row < 0 || entry->result == FALSE )
+				{
+					result = entry->row < 0;
+					done = TRUE;
+					break;
+				}
+				
+				row = entry->row;
+			}
+				
+			GDoParallelTasks ( StoreDownloadRow, &pipeline, i );
+			
+			pipeline.first += count;
+			for ( i = 0; i < count; i++ )
+				GSignalSemaphore ( pipeline.freeRows );
+				
+			if ( done )
+				break;
+		}
+		
+    	/*** Allow background event handling ten times per second.  If the user cancels
+    	     the download at this point, break out of the download loop; the reader
+    	     thread will already have been stopped by CancelExposure(). ***/
+    	     
+    	if ( DoDownloadEvent ( camera, G_TICKS_PER_SECOND / 10, row, bottom, filter ) == FALSE || pipeline.cancel )
+    		break;
+	}
+
+	/*** If we're stopping early, tell the reader thread to stop too; otherwise
+	     it has already ended.  Either way, wait for it, and free the pipeline. ***/
+	     
+	if ( done && sDownloadReader != NULL )
+	{
+		GWaitThread ( sDownloadReader );
+		sDownloadReader = NULL;
+	}
+	
+	StopDownloadReader();
+	sDownloadPipeline = NULL;
+	DeleteDownloadPipeline ( &pipeline );
+	
+    /*** Delete the image region (if necessary).  If we failed to download a row,
+         display a warning and return an error code; otherwise (including when
+         the user cancelled the download) return a successful result code. ***/
+    
+    if ( deleteRegion )
+    	DeleteImageRegion ( region );
+    
+	if ( result == FALSE )
+	{
+		GDoAlert ( G_WARNING_ALERT, G_OK_ALERT, "Can't download image from camera!" );
+		return ( FALSE );
+	}
+	
+	return ( TRUE );
+}
+
+/*** ReadDownloadRows ***************************************************************
+
+	The reader thread of the download pipeline.  Downloads each row segment into the
+	next free ring buffer, and passes it on to the main thread; then adds the end
+	marker.  Stops early if the camera fails, or if the main thread cancels.
+	
+	Runs of consecutive rows with the same left and right columns are downloaded
+	as a block, into ring buffers which are adjacent in memory, with one call to
+	the camera; the rows are packed together in those buffers.
+	
+*************************************************************************************/
+
+void ReadDownloadRows ( void *data )
+{
+	DownloadPipelinePtr	pipeline = (DownloadPipelinePtr) data;
+	DownloadRowPtr		entry;
+	short				*segment, row, left, right, result;
+	long				i, j, count;
+	
+	for ( i = 0; i <= pipeline->numSegments; i += count )
+	{
+		/*** Count the rows we can download in one block.  A block must not
+		     wrap around the end of the ring. ***/
 		     
-			if ( filter == FILTER_RED )
-				data = GetImageDataRow ( image, 0, row );
-			else if ( filter == FILTER_GREEN )
-				data = GetImageDataRow ( image, 1, row );
-			else if ( filter == FILTER_BLUE )
-				data = GetImageDataRow ( image, 2, row );
-			else
-				data = GetImageDataRow ( image, 0, row );
+		segment = &pipeline->segments[ i * 3 ];
+		row = segment[0];
+		left = segment[1];
+		right = segment[2];
+		
+		count = 1;
+		if ( i < pipeline->numSegments )
+		{
+			while ( i + count < pipeline->numSegments && count < DOWNLOAD_BLOCK_ROWS
+			&& ( i + count ) % DOWNLOAD_RING_ROWS != 0
+			&& segment[ count * 3 ] == row + count && segment[ count * 3 + 1 ] == left
+			&& segment[ count * 3 + 2 ] == right )
+				count++;
+		}
+		
+		for ( j = 0; j < count; j++ )
+			GWaitSemaphore ( pipeline->freeRows, -1 );
+			
+		if ( pipeline->cancel )
+			return;
+		
+		if ( i == pipeline->numSegments )
+		{
+			entry = &pipeline->ring[ i % DOWNLOAD_RING_ROWS ];
+			entry->row = -1;
+			entry->result = TRUE;
+			result = TRUE;
 		}
 		else
 		{
-			/*** For monochrome images, we always insert the data into the first
-			     image frame. ***/
-			     
-			data = GetImageDataRow ( image, 0, row );
+			result = DownloadCameraImageRowsData ( pipeline->camera, left, right, count,
+			         pipeline->buffer + (long) pipeline->width * ( i % DOWNLOAD_RING_ROWS ) );
+			
+			for ( j = 0; j < count; j++ )
+			{
+				entry = &pipeline->ring[ ( i + j ) % DOWNLOAD_RING_ROWS ];
+				entry->row = row + j;
+				entry->left = left;
+				entry->right = right;
+				entry->result = result;
+				entry->data = pipeline->buffer + (long) pipeline->width * ( i % DOWNLOAD_RING_ROWS )
+				            + (long) ( right - left + 1 ) * j;
+			}
 		}
 		
-		/*** Obtain a pointer to the corresponding row in the camera's dark-frame
-		     buffer. ***/
+		for ( j = 0; j < count; j++ )
+			GSignalSemaphore ( pipeline->readyRows );
 		
-		dark = GetCameraDarkFrame ( camera )->data[0][row];
+		if ( result == FALSE )
+			return;
+	}
+}
+
+/*** StopDownloadReader *************************************************************
 
-		/*** Download the image data into the temporary buffer.  If we failed to
-		     download the image data row, display a warning and return an error code. ***/
+	Stops the reader thread of the download in progress, if there is one, and waits
+	for it to end.  The reader is told to stop, and given enough free buffers that it
+	can't be left waiting for one; it checks for this before each call to the camera,
+	so once this function returns, the camera interface is no longer in use by the
+	reader thread.  The main thread's download loop sees the pipeline's cancel flag,
+	and stops too.
+	
+*************************************************************************************/
+
+void StopDownloadReader ( void )
+{
+	long	i;
+	
+	if ( sDownloadReader == NULL )
+		return;
 		
-		result = DownloadCameraImageRow ( camera, left, right, buffer );
-		if ( result == FALSE )
-        {
-            free ( buffer );
-            if ( deleteRegion )
-            	DeleteImageRegion ( region );
-        	GDoAlert ( G_WARNING_ALERT, G_OK_ALERT, "Can't download image from camera!" );
-        	return ( FALSE );
-    	}
+	sDownloadPipeline->cancel = TRUE;
+	for ( i = 0; i < DOWNLOAD_RING_ROWS; i++ )
+		GSignalSemaphore ( sDownloadPipeline->freeRows );
+		
+	GWaitThread ( sDownloadReader );
+	sDownloadReader = NULL;
+}
+
+/*** StoreDownloadRow ***************************************************************
+
+	Stores one downloaded row from the ring into the image; each of the main thread's
+	parallel tasks does one row.  What happens to the row depends on whether we are
+	taking a dark or light image, and on the camera's current exposure and dark-frame
+	behavior.
+	
+*************************************************************************************/
 
-		/*** What we do next with the data we just downloaded depends on whether we
-		     are taking a dark or light image, and on the camera's current exposure
-		     and dark-frame behavior. ***/
+void StoreDownloadRow ( void *data, long task )
+{
+	DownloadPipelinePtr	pipeline = (DownloadPipelinePtr) data;
+	DownloadRowPtr		entry = &pipeline->ring[ ( pipeline->first + task ) % DOWNLOAD_RING_ROWS ];
+	short				row = entry->row, left = entry->left, right = entry->right, col;
+	unsigned short		*buffer = entry->data;
+	PIXEL				*image, *image1, *image2, *dark, *calibrated;
+	
+	image = GetImageDataRow ( pipeline->image, pipeline->frame, row );
+	
+	if ( pipeline->shutterClosed )
+	{
+		dark = pipeline->dark->data[0][row];
+
+		/*** If we're taking dark frames only, and we're past the first exposure
+		     of an image in combined-image mode, add the data in the buffer to the
+		     data in the dark image.  Otherwise, just copy the data from the buffer
+		     into the dark image.  If instead we're subtracting dark frames from
+		     light image frames, copy the camera data into the dark image and then
+		     subtract it from light image. ***/
 		     
-		if ( GetCameraExposureShutter ( camera ) == SHUTTER_CLOSED )
+		if ( pipeline->darkFrameOnly )
 		{
-			/*** If we're taking dark frames only, and we're past the first exposure
-			     of an image in combined-image mode, add the data in the buffer to the
-			     data in the dark image.  Otherwise, just copy the data from the buffer
-			     into the dark image. ***/
-			     
-			if ( GetCameraDarkFrameMode ( camera ) == DARK_FRAME_ONLY )
+			if ( pipeline->combine )
 			{
-				if ( GetCameraExposureMode ( camera ) == EXPOSURE_MODE_COMBINED_IMAGE && GetCameraExposureNumber ( camera ) > 1 )
-				{
-					for ( col = left; col <= right; col++ )
-						data[col] = dark[col] += buffer[col];
-				}
-				else
-				{
-					for ( col = left; col <= right; col++ )
-						data[col] = dark[col] = buffer[col];
-				}
+				for ( col = left; col <= right; col++ )
+					image[col] = dark[col] += buffer[ col - left ];
 			}
 			else
 			{
-				/*** Otherwise, we're subtracting dark frames from light image
-				     frames, so copy the camera data into the dark image and then
-				     subtract it from light image. ***/
-				     
 				for ( col = left; col <= right; col++ )
-					data[col] -= dark[col] = buffer[col];
+					image[col] = dark[col] = buffer[ col - left ];
 			}
 		}
 		else
 		{
-			/*** If we're taking a light exposure, and we're past the first exposure
-			     of an image in combined-image mode, add the data in the buffer to the
-			     data in the image.  Otherwise, just copy the data from the buffer
-			     into the dark image. ***/
+			for ( col = left; col <= right; col++ )
+				image[col] -= dark[col] = buffer[ col - left ];
+		}
+	}
+	else
+	{
+		/*** If we're taking a light exposure, and we're past the first exposure
+		     of an image in combined-image mode, add the data in the buffer to the
+		     data in the image, calibrating it first if necessary.  Otherwise, just
+		     copy the data from the buffer into the image, and calibrate it there. ***/
+		
+		if ( pipeline->combine && pipeline->calibration != NULL )
+		{
+			calibrated = pipeline->calibrated + (long) pipeline->width * ( ( pipeline->first + task ) % DOWNLOAD_RING_ROWS );
 			
-			if ( GetCameraExposureMode ( camera ) == EXPOSURE_MODE_COMBINED_IMAGE && GetCameraExposureNumber ( camera ) > 1 )
-			{
-				for ( col = left; col <= right; col++ )
-					data[col] += buffer[col];
-			}
-			else
-			{
-				for ( col = left; col <= right; col++ )
-					data[col] = buffer[col];
-			}
+			for ( col = left; col <= right; col++ )
+				calibrated[col] = buffer[ col - left ];
+				
+			CalibrateImageRow ( pipeline->calibration, pipeline->frame, row, left, right, calibrated, pipeline->exposure );
+			
+			for ( col = left; col <= right; col++ )
+				image[col] += calibrated[col];
+		}
+		else if ( pipeline->combine )
+		{
+			for ( col = left; col <= right; col++ )
+				image[col] += buffer[ col - left ];
+		}
+		else
+		{
+			for ( col = left; col <= right; col++ )
+				image[col] = buffer[ col - left ];
+				
+			if ( pipeline->calibration != NULL )
+				CalibrateImageRow ( pipeline->calibration, pipeline->frame, row, left, right, image, pipeline->exposure );
 		}
+	}
+	
+	/*** If we are exposing a color image, but the filter is neither red, green,
+	     nor blue, then copy the image data into the green and blue image frames,
+	     so that the image will appear monochrome. ***/
+	     
+	if ( pipeline->copyFrames )
+	{
+		image1 = GetImageDataRow ( pipeline->image, 1, row );
+		image2 = GetImageDataRow ( pipeline->image, 2, row );
 		
-		/*** If we are exposing a color image, but the filter is neither
-		     red, green, nor blue, then copy the image data into the green
-		     and blue image frames, so that the image will appear monochrome.  WHY IS THIS HERE? ***/
-		     
-    	if ( mode == EXPOSURE_MODE_COLOR_IMAGE && ( filter < FILTER_RED || filter > FILTER_BLUE ) )
-    	{
-    		data1 = GetImageDataRow ( image, 1, row );
-    		data2 = GetImageDataRow ( image, 2, row );
-    		
-    		for ( col = left; col < right; col++ )
-    			data1[col] = data2[col] = data[col];
-    	}
-    	
-    	/*** Allow background event handling ten times per second.  If the user cancels
-    	     the download at this point, break out of the download loop. ***/
-    	     
-    	if ( DoDownloadEvent ( camera, G_TICKS_PER_SECOND / 10, row, bottom, filter ) == FALSE )
-    		break;
+		for ( col = left; col <= right; col++ )
+			image1[col] = image2[col] = image[col];
 	}
+}
 
-    /*** Free the temporary download buffer, delete the image region (if necessary),
-         and return a successful result code. ***/
-    
-    free ( buffer );
-       
-    if ( deleteRegion )
-    	DeleteImageRegion ( region );
-    
-	return ( TRUE );
+/*** DeleteDownloadPipeline ***/
+
+void DeleteDownloadPipeline ( DownloadPipelinePtr pipeline )
+{
+	if ( pipeline->segments != NULL )
+		free ( pipeline->segments );
+		
+	if ( pipeline->buffer != NULL )
+		free ( pipeline->buffer );
+		
+	if ( pipeline->calibrated != NULL )
+		free ( pipeline->calibrated );
+		
+	if ( pipeline->freeRows != NULL )
+		GDeleteSemaphore ( pipeline->freeRows );
+		
+	if ( pipeline->readyRows != NULL )
+		GDeleteSemaphore ( pipeline->readyRows );
 }
 
 /*** DoDownloadEvent ****************************************************************
@@ -1422,38 +1738,3 @@ int DoDownloadEvent ( CameraPtr camera, long interval, short row, short numRows,
 	else
 		return ( FALSE );
 }
-
-/*** DarkFrameImageDataRow ***/
-
-void DarkFrameImageDataRow ( CameraPtr camera, short row, short left, short right, PIXEL *imageRow )
-{
-	short 	mode, col;
-	PIXEL	*darkRow = NULL;
-	
-	/*** Determine the camera's current dark frame mode, and get a pointer
-	     to the row in the dark frame which corresponds to the row in the
-	     image frame which we are currently processing. ***/
-	     
-	mode = GetCameraDarkFrameMode ( camera );
-	darkRow = GetCameraDarkFrame ( camera )->data[0][row];
-	
-	/*** If we are taking a dark frame, what we do next depends on whether
-	     we're taking dark frames only, or also subtracting them from the light
-	     image.  If we're taking taking dark frames only, copy the data from
-	     the dark frame buffer into the image buffer; otherwise, we should subtract
-	     the data in the dark frame buffer from the data in the image buffer. ***/
-	     
-	if ( GetCameraExposureShutter ( camera ) == SHUTTER_CLOSED )
-	{
-		if ( mode == DARK_FRAME_ONLY )
-		{
-			for ( col = left; col <= right; col++ )
-				imageRow[col] = darkRow[col];
-		}
-		else
-		{
-			for ( col = left; col <= right; col++ )
-				imageRow[col] -= darkRow[col];
-		}
-	}
-}
\ No newline at end of file
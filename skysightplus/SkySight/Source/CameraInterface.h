@@ -82,6 +82,7 @@
 #define CAMERA_END_DOWNLOAD			11
 #define CAMERA_DISCARD_ROWS			12
 #define CAMERA_DOWNLOAD_ROW			13
+#define CAMERA_DOWNLOAD_ROWS		14
 
 /*** Camera information request codes ***/
 
@@ -90,6 +91,7 @@
 #define CAMERA_GET_TEC_INFO				102
 #define CAMERA_GET_READOUT_INFO			103
 #define CAMERA_GET_ANTIBLOOMING_INFO	104
+#define CAMERA_GET_DOWNLOAD_INFO		105
 
 /*** Camera shutter type codes ***/
 
@@ -157,6 +159,8 @@ typedef struct CameraInterfaceData
 	short			cameraDownloadDiscard;			/* number of rows to discard */
 	short			cameraDownloadStart;			/* starting column to digitize */
 	short			cameraDownloadWidth;			/* number of pixels to digitize */
+	short			cameraDownloadRows;				/* number of rows to digitize */
+	short			cameraDownloadRowsMax;			/* most rows which can be digitized at once */
 	unsigned short	*cameraDownloadBuffer;			/* buffer to place downloaded data */
 	void			*cameraPrivateData;				/* pointer to private camera data */
 	char			cameraDescription[255];			/* buffer for textual description of camera items */
@@ -0,0 +1,657 @@
+/*** COPYRIGHT NOTICE AND PUBLIC SOURCE LICENSE ***************************************
+
+	Portions Copyright (c) 1992-2001 Southern Stars Systems.  All Rights Reserved.
+
+	This file contains Original Code and/or Modifications of Original Code as
+	defined in and that are subject to the Southern Stars Systems Public Source
+	License Version 1.0 (the 'License').  You may not use this file except in
+	compliance with the License.  Please obtain a copy of the License at
+
+	http://www.southernstars.com/opensource/
+
+	and read it before using this file.
+
+	The Original Code and all software distributed under the License are distributed
+	on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER EXPRESS OR IMPLIED, AND
+	SOUTHERN STARS SYSTEMS HEREBY DISCLAIMS ALL SUCH WARRANTIES, INCLUDING WITHOUT
+	LIMITATION, ANY WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE,
+	QUIET ENJOYMENT, OR NON-INFRINGEMENT.  Please see the License for the specific
+	language governing rights and limitations under the License.
+
+	MODIFICATION HISTORY:
+
+	1.0.0 - 17 Oct 2026 - Original code: separable and FFT image convolution.
+
+****************************************************************************************/
+
+#include "SkySight.h"
+
+/*** local constants ***/
+
+#define CONVOLVE_BAND_ROWS				64		/* rows of output per band */
+#define CONVOLVE_FFT_MIN_TAPS			225		/* use FFT for non-separable filters at least this big */
+#define CONVOLVE_FFT_MIN_SIZE			64		/* smallest FFT tile size */
+#define CONVOLVE_SEPARABLE_TOLERANCE	1.0e-6	/* relative error allowed in separable factors */
+
+/*** local data types ***/
+
+typedef struct ConvolutionJob
+{
+	PIXEL	**dest;				/* output frame rows */
+	PIXEL	**src;				/* input frame rows */
+	long	cols;				/* frame width */
+	long	rows;				/* frame height */
+	long	filterCols;			/* filter width */
+	long	filterRows;			/* filter height */
+	long	ctrCol;				/* filter center column */
+	long	ctrRow;				/* filter center row */
+	short	border;				/* border mode */
+	float	*kernel;			/* filter coefficients, row after row */
+	float	*rowKernel;			/* horizontal factor of separable filter, or NULL */
+	float	*colKernel;			/* vertical factor of separable filter */
+	long	numBands;			/* number of bands of output rows */
+	long	numTasks;			/* number of parallel tasks */
+	long	fftSize;			/* FFT tile width and height */
+	long	tilesAcross;		/* FFT tiles across output frame */
+	long	numTiles;			/* total number of FFT tiles */
+	double	*spectrum;			/* FFT of filter, as complex pairs */
+	double	*twiddle;			/* FFT sine/cosine table */
+	int		failed;				/* set if any task can't allocate memory */
+}
+ConvolutionJob;
+
+/*** local function prototypes ***/
+
+static long		MapConvolutionIndex ( long, long, short );
+static int		FactorConvolutionFilter ( ConvolutionJob * );
+static void		LoadConvolutionRow ( ConvolutionJob *, long, float * );
+static void		CorrelateConvolutionRow ( double *, float *, float *, long, long );
+static void		AccumulateConvolutionRow ( double *, float *, double, long );
+static void		ConvolveBandTask ( void *, long );
+static void		ComputeConvolutionFFT ( double *, long, long, double *, int );
+static void		ConvolveTileTask ( void *, long );
+static int		PrepareConvolutionFFT ( ConvolutionJob * );
+
+/*** MapConvolutionIndex ***********************************************************
+
+	Maps a row or column index which may lie outside a frame to the index of the
+	pixel whose value should be used there, according to the border mode.
+
+************************************************************************************/
+
+static long MapConvolutionIndex ( long i, long n, short border )
+{
+	long	period;
+
+	if ( i >= 0 && i < n )
+		return ( i );
+
+	if ( border == CONVOLVE_BORDER_WRAP )
+	{
+		i = i % n;
+		return ( i < 0 ? i + n : i );
+	}
+
+	if ( border == CONVOLVE_BORDER_EXTEND || n == 1 )
+		return ( i < 0 ? 0 : n - 1 );
+
+	/*** Mirror about the edge pixels, i.e. ... 2 1 | 0 1 2 ... n-2 n-1 | n-2 n-3 ... ***/
+
+	period = 2 * n - 2;
+	i = i % period;
+	if ( i < 0 )
+		i += period;
+
+	return ( i < n ? i : period - i );
+}
+
+/*** FactorConvolutionFilter *******************************************************
+
+	Determines whether a convolution filter is separable, i.e. whether it is the
+	product of a column vector and a row vector, as box and Gaussian filters are.
+	If so, the function stores the two factors in the job record and returns TRUE.
+	The factors are taken from the row and column through the filter's largest
+	coefficient, and the filter is accepted if their product reproduces every
+	coefficient to within a small fraction of that largest one.
+
+************************************************************************************/
+
+static int FactorConvolutionFilter ( ConvolutionJob *job )
+{
+	long	row, col, pivotRow = 0, pivotCol = 0;
+	double	value, pivot = 0.0;
+
+	for ( row = 0; row < job->filterRows; row++ )
+	{
+		for ( col = 0; col < job->filterCols; col++ )
+		{
+			value = job->kernel[ row * job->filterCols + col ];
+			if ( fabs ( value ) > fabs ( pivot ) )
+			{
+				pivot = value;
+				pivotRow = row;
+				pivotCol = col;
+			}
+		}
+	}
+
+	for ( row = 0; row < job->filterRows; row++ )
+		job->colKernel[row] = job->kernel[ row * job->filterCols + pivotCol ];
+
+	for ( col = 0; col < job->filterCols; col++ )
+		job->rowKernel[col] = pivot == 0.0 ? 0.0 : job->kernel[ pivotRow * job->filterCols + col ] / pivot;
+
+	for ( row = 0; row < job->filterRows; row++ )
+	{
+		for ( col = 0; col < job->filterCols; col++ )
+		{
+			value = (double) job->colKernel[row] * job->rowKernel[col] - job->kernel[ row * job->filterCols + col ];
+			if ( fabs ( value ) > CONVOLVE_SEPARABLE_TOLERANCE * fabs ( pivot ) )
+				return ( FALSE );
+		}
+	}
+
+	return ( TRUE );
+}
+
+/*** LoadConvolutionRow ************************************************************
+
+	Copies one row of the input frame into a buffer, extended on either side by
+	the filter's overhang according to the border mode.  The row index may lie
+	outside the frame; it is mapped according to the border mode too.
+
+************************************************************************************/
+
+static void LoadConvolutionRow ( ConvolutionJob *job, long row, float *pad )
+{
+	PIXEL	*data = job->src[ MapConvolutionIndex ( row, job->rows, job->border ) ];
+	long	col, n = job->cols + job->filterCols - 1;
+
+	for ( col = 0; col < job->ctrCol; col++ )
+		pad[col] = data[ MapConvolutionIndex ( col - job->ctrCol, job->cols, job->border ) ];
+
+	pad += job->ctrCol;
+	for ( col = 0; col < job->cols; col++ )
+		pad[col] = data[col];
+
+	for ( ; col < n - job->ctrCol; col++ )
+		pad[col] = data[ MapConvolutionIndex ( col, job->cols, job->border ) ];
+}
+
+/*** CorrelateConvolutionRow *******************************************************
+
+	Adds the correlation of one row of filter coefficients with a padded row of
+	input data to a row of double-precision accumulators; i.e. for each column,
+	sum[col] += kernel[0] * pad[col] + ... + kernel[taps-1] * pad[col+taps-1].
+	The SSE2 version handles four columns at a time, and gives the same results.
+
+************************************************************************************/
+
+static void CorrelateConvolutionRow ( double *sum, float *pad, float *kernel, long n, long taps )
+{
+	long	col = 0, tap;
+	double	value;
+#if SSE2
+	__m128	x;
+	__m128d	k, lo, hi;
+
+	for ( ; col + 4 <= n; col += 4 )
+	{
+		lo = _mm_loadu_pd ( sum + col );
+		hi = _mm_loadu_pd ( sum + col + 2 );
+
+		for ( tap = 0; tap < taps; tap++ )
+		{
+			k  = _mm_set1_pd ( kernel[tap] );
+			x  = _mm_loadu_ps ( pad + col + tap );
+			lo = _mm_add_pd ( lo, _mm_mul_pd ( k, _mm_cvtps_pd ( x ) ) );
+			hi = _mm_add_pd ( hi, _mm_mul_pd ( k, _mm_cvtps_pd ( _mm_movehl_ps ( x, x ) ) ) );
+		}
+
+		_mm_storeu_pd ( sum + col, lo );
+		_mm_storeu_pd ( sum + col + 2, hi );
+	}
+#endif
+
+	for ( ; col < n; col++ )
+	{
+		for ( value = sum[col], tap = 0; tap < taps; tap++ )
+			value += (double) kernel[tap] * pad[col + tap];
+
+		sum[col] = value;
+	}
+}
+
+/*** AccumulateConvolutionRow ******************************************************
+
+	Adds a weighted row of data to a row of double-precision accumulators.
+
+************************************************************************************/
+
+static void AccumulateConvolutionRow ( double *sum, float *data, double weight, long n )
+{
+	long	col = 0;
+#if SSE2
+	__m128	x;
+	__m128d	w = _mm_set1_pd ( weight );
+
+	for ( ; col + 4 <= n; col += 4 )
+	{
+		x = _mm_loadu_ps ( data + col );
+		_mm_storeu_pd ( sum + col,     _mm_add_pd ( _mm_loadu_pd ( sum + col ),     _mm_mul_pd ( w, _mm_cvtps_pd ( x ) ) ) );
+		_mm_storeu_pd ( sum + col + 2, _mm_add_pd ( _mm_loadu_pd ( sum + col + 2 ), _mm_mul_pd ( w, _mm_cvtps_pd ( _mm_movehl_ps ( x, x ) ) ) ) );
+	}
+#endif
+
+	for ( ; col < n; col++ )
+		sum[col] += weight * data[col];
+}
+
+/*** ConvolveBandTask **************************************************************
+
+	Performs one of the parallel tasks started by ConvolveImageFrame() for a
+	separable or small filter.  Each task works through every (numTasks)th band
+	of output rows.  For each band, it loads the input rows the band needs once,
+	extended at the borders; a separable filter is then applied as a horizontal
+	pass over those rows, followed by a vertical pass down the results, while
+	other filters are applied one filter row at a time.
+
+************************************************************************************/
+
+static void ConvolveBandTask ( void *data, long task )
+{
+	ConvolutionJob	*job = (ConvolutionJob *) data;
+	long			cols = job->cols, padCols = job->cols + job->filterCols - 1;
+	long			band, row, endRow, i, n, col;
+	float			*pad = NULL, *rows = NULL;
+	double			*sum = NULL;
+	PIXEL			*dest;
+
+	n = CONVOLVE_BAND_ROWS + job->filterRows - 1;
+
+	sum = (double *) malloc ( cols * sizeof ( double ) );
+	pad = (float *) malloc ( padCols * sizeof ( float ) );
+
+	if ( job->rowKernel != NULL )
+		rows = (float *) malloc ( n * cols * sizeof ( float ) );
+	else
+		rows = (float *) malloc ( n * padCols * sizeof ( float ) );
+
+	if ( sum == NULL || pad == NULL || rows == NULL )
+	{
+		job->failed = TRUE;
+		goto done;
+	}
+
+	for ( band = task; band < job->numBands; band += job->numTasks )
+	{
+		row = band * CONVOLVE_BAND_ROWS;
+		endRow = row + CONVOLVE_BAND_ROWS < job->rows ? row + CONVOLVE_BAND_ROWS : job->rows;
+		n = endRow - row + job->filterRows - 1;
+
+		if ( job->rowKernel != NULL )
+		{
+			/*** Horizontal pass over each input row the band needs. ***/
+
+			for ( i = 0; i < n; i++ )
+			{
+				LoadConvolutionRow ( job, row - job->ctrRow + i, pad );
+				memset ( sum, 0, cols * sizeof ( double ) );
+				CorrelateConvolutionRow ( sum, pad, job->rowKernel, cols, job->filterCols );
+
+				for ( col = 0; col < cols; col++ )
+					rows[ i * cols + col ] = sum[col];
+			}
+
+			/*** Vertical pass down the results. ***/
+
+			for ( ; row < endRow; row++ )
+			{
+				memset ( sum, 0, cols * sizeof ( double ) );
+				for ( i = 0; i < job->filterRows; i++ )
+					AccumulateConvolutionRow ( sum, rows + ( row % CONVOLVE_BAND_ROWS + i ) * cols, job->colKernel[i], cols );
+
+				dest = job->dest[row];
+				for ( col = 0; col < cols; col++ )
+					dest[col] = sum[col];
+			}
+		}
+		else
+		{
+			for ( i = 0; i < n; i++ )
+				LoadConvolutionRow ( job, row - job->ctrRow + i, rows + i * padCols );
+
+			for ( ; row < endRow; row++ )
+			{
+				memset ( sum, 0, cols * sizeof ( double ) );
+				for ( i = 0; i < job->filterRows; i++ )
+					CorrelateConvolutionRow ( sum, rows + ( row % CONVOLVE_BAND_ROWS + i ) * padCols, job->kernel + i * job->filterCols, cols, job->filterCols );
+
+				dest = job->dest[row];
+				for ( col = 0; col < cols; col++ )
+					dest[col] = sum[col];
+			}
+		}
+	}
+
+done:
+	if ( sum != NULL )
+		free ( sum );
+
+	if ( pad != NULL )
+		free ( pad );
+
+	if ( rows != NULL )
+		free ( rows );
+}
+
+/*** ComputeConvolutionFFT *********************************************************
+
+	Computes the discrete Fourier transform of (n) complex values, stored as
+	real and imaginary parts (stride) doubles apart, in place.  (n) must be a
+	power of two.  (twiddle) holds the cosines and sines of 2 * pi * k / n for
+	k from zero to n / 2 - 1; (inverse) selects the inverse transform, which
+	is not scaled by 1 / n.
+
+************************************************************************************/
+
+static void ComputeConvolutionFFT ( double *data, long n, long stride, double *twiddle, int inverse )
+{
+	long	i, j, k, len, half, step;
+	double	re, im, wr, wi, *a, *b;
+
+	/*** Put the data in bit-reversed order. ***/
+
+	for ( i = 0, j = 0; i < n; i++ )
+	{
+		if ( i < j )
+		{
+			a = data + i * stride;
+			b = data + j * stride;
+			re = a[0]; a[0] = b[0]; b[0] = re;
+			im = a[1]; a[1] = b[1]; b[1] = im;
+		}
+
+		for ( k = n >> 1; k > 0 && ( j & k ); k >>= 1 )
+			j ^= k;
+
+		j |= k;
+	}
+
+	/*** Radix-2 butterflies. ***/
+
+	for ( len = 2; len <= n; len <<= 1 )
+	{
+		half = len >> 1;
+		step = n / len;
+
+		for ( i = 0; i < n; i += len )
+		{
+			for ( j = 0; j < half; j++ )
+			{
+				wr = twiddle[ 2 * j * step ];
+				wi = inverse ? twiddle[ 2 * j * step + 1 ] : -twiddle[ 2 * j * step + 1 ];
+
+				a = data + ( i + j ) * stride;
+				b = data + ( i + j + half ) * stride;
+
+				re = b[0] * wr - b[1] * wi;
+				im = b[0] * wi + b[1] * wr;
+
+				b[0] = a[0] - re;
+				b[1] = a[1] - im;
+				a[0] += re;
+				a[1] += im;
+			}
+		}
+	}
+}
+
+/*** PrepareConvolutionFFT *********************************************************
+
+	Chooses the FFT tile size for a large filter, and computes the filter's
+	Fourier transform.  The filter is stored reversed and wrapped around the
+	tile's origin, so that multiplying transforms gives the same correlation
+	the direct method computes.  Returns FALSE if memory can't be allocated.
+
+************************************************************************************/
+
+static int PrepareConvolutionFFT ( ConvolutionJob *job )
+{
+	long	n, i, row, col, size;
+	double	*data;
+
+	/*** Use tiles at least four times the filter size, so that most of each
+	     tile's output is usable. ***/
+
+	size = job->filterCols > job->filterRows ? job->filterCols : job->filterRows;
+	for ( n = CONVOLVE_FFT_MIN_SIZE; n < 4 * size; n <<= 1 )
+		;
+
+	job->fftSize = n;
+	job->tilesAcross = ( job->cols + n - job->filterCols ) / ( n - job->filterCols + 1 );
+	job->numTiles = job->tilesAcross * ( ( job->rows + n - job->filterRows ) / ( n - job->filterRows + 1 ) );
+
+	job->twiddle = (double *) malloc ( n * sizeof ( double ) );
+	job->spectrum = (double *) calloc ( 2 * n * n, sizeof ( double ) );
+	if ( job->twiddle == NULL || job->spectrum == NULL )
+		return ( FALSE );
+
+	for ( i = 0; i < n / 2; i++ )
+	{
+		job->twiddle[ 2 * i ] = cos ( 2.0 * PI * i / n );
+		job->twiddle[ 2 * i + 1 ] = sin ( 2.0 * PI * i / n );
+	}
+
+	data = job->spectrum;
+	for ( row = 0; row < job->filterRows; row++ )
+		for ( col = 0; col < job->filterCols; col++ )
+			data[ 2 * ( ( ( n - row ) % n ) * n + ( n - col ) % n ) ] = job->kernel[ row * job->filterCols + col ];
+
+	for ( row = 0; row < n; row++ )
+		ComputeConvolutionFFT ( data + 2 * row * n, n, 2, job->twiddle, FALSE );
+
+	for ( col = 0; col < n; col++ )
+		ComputeConvolutionFFT ( data + 2 * col, n, 2 * n, job->twiddle, FALSE );
+
+	return ( TRUE );
+}
+
+/*** ConvolveTileTask **************************************************************
+
+	Performs one of the parallel tasks started by ConvolveImageFrame() for a
+	large, non-separable filter.  Each task works through every (numTasks)th
+	tile of the output frame, by the overlap-save method: it transforms a tile
+	of input data (extended at the borders), multiplies by the filter's
+	transform, and transforms back.  The parts of the result which did not wrap
+	around the tile's edges are the output.
+
+************************************************************************************/
+
+static void ConvolveTileTask ( void *data, long task )
+{
+	ConvolutionJob	*job = (ConvolutionJob *) data;
+	long			n = job->fftSize, tile, top, left, row, col, rows, cols;
+	double			*buffer, *a, *b, re, scale = 1.0 / ( (double) n * n );
+	PIXEL			*src, *dest;
+
+	buffer = (double *) malloc ( 2 * n * n * sizeof ( double ) );
+	if ( buffer == NULL )
+	{
+		job->failed = TRUE;
+		return;
+	}
+
+	for ( tile = task; tile < job->numTiles; tile += job->numTasks )
+	{
+		top = ( tile / job->tilesAcross ) * ( n - job->filterRows + 1 );
+		left = ( tile % job->tilesAcross ) * ( n - job->filterCols + 1 );
+
+		for ( row = 0; row < n; row++ )
+		{
+			src = job->src[ MapConvolutionIndex ( top - job->ctrRow + row, job->rows, job->border ) ];
+			a = buffer + 2 * row * n;
+
+			for ( col = 0; col < n; col++ )
+			{
+				a[ 2 * col ] = src[ MapConvolutionIndex ( left - job->ctrCol + col, job->cols, job->border ) ];
+				a[ 2 * col + 1 ] = 0.0;
+			}
+
+			ComputeConvolutionFFT ( a, n, 2, job->twiddle, FALSE );
+		}
+
+		for ( col = 0; col < n; col++ )
+			ComputeConvolutionFFT ( buffer + 2 * col, n, 2 * n, job->twiddle, FALSE );
+
+		for ( a = buffer, b = job->spectrum; a < buffer + 2 * n * n; a += 2, b += 2 )
+		{
+			re = a[0] * b[0] - a[1] * b[1];
+			a[1] = a[0] * b[1] + a[1] * b[0];
+			a[0] = re;
+		}
+
+		for ( col = 0; col < n; col++ )
+			ComputeConvolutionFFT ( buffer + 2 * col, n, 2 * n, job->twiddle, TRUE );
+
+		rows = n - job->filterRows + 1;
+		if ( top + rows > job->rows )
+			rows = job->rows - top;
+
+		cols = n - job->filterCols + 1;
+		if ( left + cols > job->cols )
+			cols = job->cols - left;
+
+		for ( row = 0; row < rows; row++ )
+		{
+			a = buffer + 2 * row * n;
+			ComputeConvolutionFFT ( a, n, 2, job->twiddle, TRUE );
+
+			dest = job->dest[ top + row ] + left;
+			for ( col = 0; col < cols; col++ )
+				dest[col] = a[ 2 * col ] * scale;
+		}
+	}
+
+	free ( buffer );
+}
+
+/*** ConvolveImageFrame ************************************************************
+
+	Convolves one frame of image data with a filter.
+
+	int ConvolveImageFrame ( PIXEL **dest, PIXEL **src, short cols, short rows,
+	    float **filter, short filterCols, short filterRows, short border )
+
+	(dest):       receives filtered image data.
+	(src):        image data to filter.
+	(cols):       width of image data, in pixels.
+	(rows):       height of image data, in pixels.
+	(filter):     matrix of filter coefficients.
+	(filterCols): width of filter matrix.
+	(filterRows): height of filter matrix.
+	(border):     border mode; see below.
+
+	The function returns TRUE if successful, or FALSE if it can't allocate the
+	memory it needs.  (dest) and (src) must not be the same data.
+
+	Each output pixel is the sum of the input pixels under the filter, centered
+	on the pixel at (filterCols / 2, filterRows / 2), each multiplied by the
+	corresponding filter coefficient.  Where the filter overhangs the edge of
+	the image, the value of the missing pixels depends on the border mode:
+
+	- CONVOLVE_BORDER_MIRROR: the image is reflected about its edge pixels.
+	- CONVOLVE_BORDER_EXTEND: the edge pixels are repeated.
+	- CONVOLVE_BORDER_WRAP:   the image wraps around to the opposite edge.
+
+	Sums are accumulated in double precision.  If the filter is separable (the
+	product of a row and a column, like a box or Gaussian filter), the image is
+	filtered in two one-dimensional passes.  Otherwise, smaller filters are
+	applied directly, and large ones in tiles by FFT.  The work is divided
+	among all processors with GDoParallelTasks().
+
+************************************************************************************/
+
+int ConvolveImageFrame ( PIXEL **dest, PIXEL **src, short cols, short rows,
+float **filter, short filterCols, short filterRows, short border )
+{
+	ConvolutionJob	job;
+	long			row, col;
+
+	memset ( &job, 0, sizeof ( job ) );
+
+	job.dest = dest;
+	job.src = src;
+	job.cols = cols;
+	job.rows = rows;
+	job.filterCols = filterCols;
+	job.filterRows = filterRows;
+	job.ctrCol = filterCols / 2;
+	job.ctrRow = filterRows / 2;
+	job.border = border;
+
+	job.kernel = (float *) malloc ( filterCols * filterRows * sizeof ( float ) );
+	job.rowKernel = (float *) malloc ( filterCols * sizeof ( float ) );
+	job.colKernel = (float *) malloc ( filterRows * sizeof ( float ) );
+	if ( job.kernel == NULL || job.rowKernel == NULL || job.colKernel == NULL )
+	{
+		job.failed = TRUE;
+		goto done;
+	}
+
+	for ( row = 0; row < filterRows; row++ )
+		for ( col = 0; col < filterCols; col++ )
+			job.kernel[ row * filterCols + col ] = filter[row][col];
+
+	/*** Choose the method: two passes for a separable filter, FFT for a large
+	     non-separable filter, or direct summation. ***/
+
+	if ( FactorConvolutionFilter ( &job ) == FALSE )
+	{
+		free ( job.rowKernel );
+		job.rowKernel = NULL;
+	}
+
+	if ( job.rowKernel == NULL && (long) filterCols * filterRows >= CONVOLVE_FFT_MIN_TAPS )
+	{
+		if ( PrepareConvolutionFFT ( &job ) == FALSE )
+		{
+			job.failed = TRUE;
+			goto done;
+		}
+
+		job.numTasks = GGetProcessorCount();
+		if ( job.numTasks > job.numTiles )
+			job.numTasks = job.numTiles;
+
+		GDoParallelTasks ( ConvolveTileTask, &job, job.numTasks );
+	}
+	else
+	{
+		job.numBands = ( rows + CONVOLVE_BAND_ROWS - 1 ) / CONVOLVE_BAND_ROWS;
+		job.numTasks = GGetProcessorCount();
+		if ( job.numTasks > job.numBands )
+			job.numTasks = job.numBands;
+
+
+		GDoParallelTasks ( ConvolveBandTask, &job, job.numTasks );
+	}
+
+done:
+	if ( job.kernel != NULL )
+		free ( job.kernel );
+
+	if ( job.rowKernel != NULL )
+		free ( job.rowKernel );
+
+	if ( job.colKernel != NULL )
+		free ( job.colKernel );
+
+	if ( job.spectrum != NULL )
+		free ( job.spectrum );
+
+	if ( job.twiddle != NULL )
+		free ( job.twiddle );
+
+	return ( ! job.failed );
+}
@@ -39,6 +39,7 @@ static short	GetCameraFilterInfo ( CameraInterfaceDataPtr );
 static short	GetCameraTECInfo ( CameraInterfaceDataPtr );
 static short	GetCameraReadoutInfo ( CameraInterfaceDataPtr );
 static short	GetCameraAntibloomingInfo ( CameraInterfaceDataPtr );
+static short	GetCameraDownloadInfo ( CameraInterfaceDataPtr );
 
 static short	OpenCameraConnection ( CameraInterfaceDataPtr );
 static short	CloseCameraConnection ( CameraInterfaceDataPtr );
@@ -51,6 +52,8 @@ static short	StartCameraDownload ( CameraInterfaceDataPtr );
 static short	EndCameraExposure ( CameraInterfaceDataPtr );
 static short	EndCameraDownload ( CameraInterfaceDataPtr );
 static short	DownloadCameraRow ( CameraInterfaceDataPtr );
+static short	DownloadCameraRows ( CameraInterfaceDataPtr );
+static short	ReadCameraRows ( CameraInterfaceDataPtr, short );
 static short	DiscardCameraRows ( CameraInterfaceDataPtr );
 
 /*** local data ***/
@@ -101,6 +104,10 @@ short DemoCameraInterface ( short function, CameraInterfaceDataPtr data )
 			result = GetCameraAntibloomingInfo ( data );
 			break;
 
+		case CAMERA_GET_DOWNLOAD_INFO:
+			result = GetCameraDownloadInfo ( data );
+			break;
+
 		case CAMERA_OPEN_CONNECTION:
 			result = OpenCameraConnection ( data );
 			break;
@@ -145,6 +152,10 @@ short DemoCameraInterface ( short function, CameraInterfaceDataPtr data )
 			result = DownloadCameraRow ( data );
 			break;
 			
+		case CAMERA_DOWNLOAD_ROWS:
+			result = DownloadCameraRows ( data );
+			break;
+			
 		case CAMERA_DISCARD_ROWS:
 			result = DiscardCameraRows ( data );
 			break;
@@ -330,6 +341,31 @@ short GetCameraAntibloomingInfo ( CameraInterfaceDataPtr data )
 	return ( result );
 }
 
+/*** GetCameraDownloadInfo **************************************************
+
+	Determines whether the camera can download more than one row at a time.
+
+	short GetCameraDownloadInfo ( CameraInterfaceDataPtr data )
+	
+	(data): pointer to camera interface data record.
+
+	The largest number of rows which the camera can download in one call of
+	DownloadCameraRows() should be returned in the cameraDownloadRowsMax
+	member of the camera interface data structure (data).
+	
+	The function should always return TRUE.  Camera interfaces which don't
+	handle this request, and so return FALSE, are sent one CAMERA_DOWNLOAD_ROW
+	request per row instead.
+	
+****************************************************************************/
+
+short GetCameraDownloadInfo ( CameraInterfaceDataPtr data )
+{
+	data->cameraDownloadRowsMax = 256;
+	
+	return ( TRUE );
+}
+
 /*** GetCameraReadoutInfo ***************************************************
 
 	Obtains information about a particular binning or readout mode supported
@@ -815,30 +851,69 @@ short DiscardCameraRows ( CameraInterfaceDataPtr data )
 
 short DownloadCameraRow ( CameraInterfaceDataPtr data )
 {
-	int			result = TRUE;
-	short		col;
-    long		ticks;
-    FITSImage	*image = (FITSImage *) data->cameraPrivateData;
+	return ( ReadCameraRows ( data, 1 ) );
+}
+
+/*** DownloadCameraRows ************************************************************
+
+	Reads out a block of consecutive image data rows, or the same portion of each
+	of a block of rows, from the camera.
+	
+	short DownloadCameraRows ( CameraInterfaceDataPtr data )
+
+	(data): pointer to camera interface data record.
+	
+	If successful, this function should return TRUE; on failure,
+	it should return FALSE.
+	
+	This is the same as DownloadCameraRow(), except that the "cameraDownloadRows"
+	member of the camera interface data record (data) gives the number of rows to
+	digitize, which will be no more than the number returned by
+	GetCameraDownloadInfo().  The rows' pixel values should be placed one row after
+	another in the "cameraDownloadBuffer" array, each taking up "cameraDownloadWidth"
+	values.
+
+************************************************************************************/
+
+short DownloadCameraRows ( CameraInterfaceDataPtr data )
+{
+	return ( ReadCameraRows ( data, data->cameraDownloadRows ) );
+}
+
+/*** ReadCameraRows ***/
+
+short ReadCameraRows ( CameraInterfaceDataPtr data, short rows )
+{
+	int				result = TRUE;
+	short			col, row;
+    long			ticks;
+    FITSImage		*image = (FITSImage *) data->cameraPrivateData;
+    unsigned short	*buffer = data->cameraDownloadBuffer;
     
-    /*** Simulate a delay equivalent to reading out 50,000 pixels/second ***/
+    /*** Simulate a delay equivalent to reading out 50,000 pixels/second,
+         plus one tick for each call, like a real driver's fixed per-call
+         overhead; so reading many rows per call is faster. ***/
     
-    ticks = G_TICKS_PER_SECOND * data->cameraDownloadWidth / 50000;
-    if ( ticks < 1 )
-    	ticks = 1;
+    ticks = 1 + G_TICKS_PER_SECOND * (long) data->cameraDownloadWidth * rows / 50000;
     GWait ( ticks );
 
-    if ( image != NULL )
-    {
-		for ( col = 0; col < data->cameraDownloadWidth; col++ )
-			data->cameraDownloadBuffer[ col ] = image->data[0][ sRow ][ data->cameraDownloadStart + col ];
+	for ( row = 0; row < rows; row++ )
+	{
+	    if ( image != NULL )
+	    {
+			for ( col = 0; col < data->cameraDownloadWidth; col++ )
+				buffer[ col ] = image->data[0][ sRow ][ data->cameraDownloadStart + col ];
+		}
+	    else
+	    {
+			for ( col = 0; col < data->cameraDownloadWidth; col++ )
+				buffer[ col ] = 0;
+	    }
+	
+	    buffer += data->cameraDownloadWidth;
+	    sRow++;
 	}
-    else
-    {
-		for ( col = 0; col < data->cameraDownloadWidth; col++ )
-			data->cameraDownloadBuffer[ col ] = 0;
-    }
-
-    sRow++;
-    
+	
     return ( result );
 }
+
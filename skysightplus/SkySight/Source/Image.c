@@ -33,8 +33,30 @@
 
 /*** local data types ***/
 
+#define IMAGE_STATISTICS_MAX_TASKS	32
+
+typedef struct ImageStatisticsTaskData
+{
+	ImagePtr	image;
+	long		numTasks;
+	long		**histograms;
+}
+ImageStatisticsTaskData;
+
 /*** local function prototypes ***/
 
+static long		ImageFineHistogramBin ( PIXEL );
+static double	ImageFineHistogramBinValue ( long );
+static void		GetImageFineHistogramBinRange ( ImagePtr, long, double *, double * );
+static void		MergeImageBandStatistics ( ImageBandStatisticsPtr, ImageBandStatisticsPtr );
+static void		ComputeImageBandStatistics ( ImagePtr, long, long * );
+static void		ImageStatisticsTask ( void *, long );
+static void		ComputeImageDisplayHistogram ( ImagePtr );
+static void		MergeImageStatistics ( ImagePtr );
+static void		CountImageChangedPixels ( ImagePtr, long );
+static void		ComputeImageChangedStatistics ( ImagePtr );
+static int		SelectImageDataValue ( ImagePtr, long, PIXEL *, PIXEL * );
+
 /*** NewImage *********************************************************************
 
 	Allocates memory for a new image record.
@@ -97,6 +119,8 @@ ImagePtr NewImage ( char *title, short type, short frames, short rows, short col
 	image->imageFileFormat    = FILE_TYPE_FITS;
 	image->imageObjectList    = NULL;
 	image->imageObjectCount   = 0;
+	image->imageObjectIndex   = NULL;
+	image->imageBackground    = NULL;
 	image->imagePreviousImage = NULL;
 	
 	/*** Return a pointer to the initialized image record. ***/
@@ -885,6 +909,13 @@ void DeleteImage ( ImagePtr image )
 	if ( image->imagePath != NULL )
 		GDeletePath ( image->imagePath );
 		
+	if ( image->imageFineHistogram != NULL )
+		free ( image->imageFineHistogram );
+		
+	if ( image->imageBandStatistics != NULL )
+		free ( image->imageBandStatistics );
+		
+	InvalidateImageBackground ( image );
 	DeleteImageObjectList ( image );
 	free ( image );
 }
@@ -1058,6 +1089,28 @@ PIXEL *GetImageDataRow ( ImagePtr image, short frame, short row )
 	return ( image->imageFITSImage->data[frame][row] );
 }
 
+/*** GetImageDataStride ***********************************************************
+
+	Returns the distance between successive rows of image data, in pixels.
+	
+	long GetImageDataStride ( ImagePtr image )
+
+	(image): pointer to image record.
+	
+	Rows of image data are stored one after another in memory, frame after
+	frame, but each row may be padded beyond the last column of the image so
+	that rows start on aligned boundaries.  Row (row + 1) of a frame starts
+	this many pixels after row (row), so loops which process a whole frame
+	can step through it from GetImageDataRow ( image, frame, 0 ) without
+	looking up each row.  Pixels in the padding are not part of the image.
+	
+************************************************************************************/
+
+long GetImageDataStride ( ImagePtr image )
+{
+	return ( GetFITSImageDataStride ( image->imageFITSImage->data ) );
+}
+
 /*** GetImageDataValue **************************************************************
 
 	Obtains the value of a single pixel of image data.
@@ -1138,6 +1191,8 @@ FITSImagePtr GetImageFITSImage ( ImagePtr image )
 void SetImageFITSImage ( ImagePtr image, FITSImagePtr fits )
 {
 	image->imageFITSImage = fits;
+	image->imageChangeState = IMAGE_CHANGED_ALL;
+	InvalidateImageBackground ( image );
 }
 
 /*** GetImageTitle *****************************************************************
@@ -1431,104 +1486,526 @@ void SetImageExposureLength ( ImagePtr image, float length )
 	image->imageExposureLength = length;
 }
 
-/*** ComputeImageStatistics *********************************************
+/*** ImageFineHistogramBin ********************************************************
 
-	Given a pointer to an image, computes the image's basic statistics
-	(minimum, maximum, mean, and standard deviation) and histogram.
+	Returns the bin of an image's fine histogram which contains a particular
+	data value.  The fine histogram's bins are ordered like the values they
+	contain: for floating-point images, the bin number is the top 16 bits of
+	the value's IEEE representation, with the bits flipped so that negative
+	values sort below positive ones; this gives each bin a width of 1/128 to
+	1/256 of the values it holds.  For integer images, the bins are the top
+	16 bits of the value, offset to make them unsigned.
+	
+************************************************************************************/
 
-	void ComputeImageStatistics ( ImagePtr image )
+static long ImageFineHistogramBin ( PIXEL value )
+{
+#if BITPIX == 8
+
+	return ( value );
+
+#elif BITPIX == 16
+
+	return ( (unsigned short) value ^ 0x8000 );
+
+#elif BITPIX == 32
+
+	return ( ( (unsigned int) value ^ 0x80000000 ) >> 16 );
+
+#else
+
+	union { float f; unsigned int u; } key;
 	
-	(image): pointer to image record.
+	key.f = value;
 	
-	The function returns nothing.
+	if ( key.u & 0x80000000 )
+		key.u = ~key.u;
+	else
+		key.u = key.u | 0x80000000;
+
+	return ( key.u >> 16 );
+
+#endif
+}
+
+/*** ImageFineHistogramBinValue ****************************************************
+
+	Returns the smallest data value which falls into a particular bin of an
+	image's fine histogram; this is the inverse of ImageFineHistogramBin().
 	
-***************************************************************************/
+************************************************************************************/
 
-void ComputeImageStatistics ( ImagePtr image )
+static double ImageFineHistogramBinValue ( long bin )
 {
-	short		numCols = GetImageColumns ( image );
-	short		numRows = GetImageRows ( image );
-	short		numFrames = GetImageFrames ( image );
-	short		col, row, frame;
-	double		sum, sum2, mean, stdev;
-	long		n;
-	PIXEL		min, max, value, *data;
-	long		*histogram, numBins, bin;
-	float		scale;
-	
-	/*** Pass through image data to find minimum, maximum,
-	     mean, and standard deviation of image data values. ***/
+#if BITPIX == 8
+
+	return ( bin );
+
+#elif BITPIX == 16
+
+	return ( (short) ( bin ^ 0x8000 ) );
+
+#elif BITPIX == 32
+
+	return ( (long) ( ( (unsigned int) bin << 16 ) ^ 0x80000000 ) );
+
+#else
+
+	union { float f; unsigned int u; } key;
+	
+	key.u = (unsigned int) bin << 16;
+	
+	if ( key.u & 0x80000000 )
+		key.u = key.u & 0x7FFFFFFF;
+	else
+		key.u = ~key.u;
+	
+	return ( key.f );
+
+#endif
+}
+
+/*** GetImageFineHistogramBinRange **************************************************
+
+	Finds the range of data values in a fine histogram bin, limited to the
+	image's minimum and maximum values.
+	
+************************************************************************************/
+
+static void GetImageFineHistogramBinRange ( ImagePtr image, long bin, double *lo, double *hi )
+{
+	*lo = ImageFineHistogramBinValue ( bin );
+	if ( bin < IMAGE_FINE_HISTOGRAM_BINS - 1 )
+		*hi = ImageFineHistogramBinValue ( bin + 1 );
+	else
+		*hi = image->imageMaximum;
+	
+	/*** The bins at either end of a floating-point fine histogram hold NaNs,
+	     which sort below or above all other values, so treat them that way. ***/
 	     
-	min = GetImageDataValue ( image, 0, 0, 0 );
-	max = min;
+	if ( *lo != *lo )
+		*lo = bin < IMAGE_FINE_HISTOGRAM_BINS / 2 ? -HUGE_VAL : HUGE_VAL;
+		
+	if ( *hi != *hi )
+		*hi = bin < IMAGE_FINE_HISTOGRAM_BINS / 2 ? -HUGE_VAL : HUGE_VAL;
+		
+	if ( *lo < image->imageMinimum )
+		*lo = image->imageMinimum;
+		
+	if ( *lo > image->imageMaximum )
+		*lo = image->imageMaximum;
+		
+	if ( *hi < image->imageMinimum )
+		*hi = image->imageMinimum;
+		
+	if ( *hi > image->imageMaximum )
+		*hi = image->imageMaximum;
+		
+	if ( *hi < *lo )
+		*hi = *lo;
+}
+
+/*** MergeImageBandStatistics *****************************************************
+
+	Merges the partial statistics (count, mean, sum of squared deviations
+	from the mean, minimum and maximum) of one set of pixels into those of
+	another, using Chan's pairwise formula.  Unlike summing values and their
+	squares, this does not lose precision when the mean is large compared to
+	the standard deviation.
 	
-	sum = sum2 = n = 0;
+************************************************************************************/
+
+static void MergeImageBandStatistics ( ImageBandStatisticsPtr stats, ImageBandStatisticsPtr other )
+{
+	double	delta;
+	long	n;
 	
-	for ( frame = 0; frame < numFrames; frame++ )
+	if ( other->count == 0 )
+		return;
+		
+	if ( stats->count == 0 )
 	{
-		for ( row = 0; row < numRows; row++ )
-		{
-			data = GetImageDataRow ( image, frame, row );
+		*stats = *other;
+		return;
+	}
+	
+	n = stats->count + other->count;
+	delta = other->mean - stats->mean;
+	
+	stats->m2 += other->m2 + delta * delta * stats->count / n * other->count;
+	stats->mean += delta * other->count / n;
+	stats->count = n;
+	
+	if ( other->minimum < stats->minimum )
+		stats->minimum = other->minimum;
 		
+	if ( other->maximum > stats->maximum )
+		stats->maximum = other->maximum;
+}
+
+/*** ComputeImageBandStatistics ****************************************************
+
+	Computes the partial statistics of one band of image rows, and adds the
+	band's values to a fine histogram (unless the histogram pointer is NULL,
+	as when only the band statistics need updating).  Each row is read only
+	once: its values are summed, and their squares summed, as deviations from
+	a shift value close to the mean (the band's mean so far, or the row's
+	first value), which keeps the precision of a separate pass over the
+	deviations; the row results are then merged into the band's.
+	
+************************************************************************************/
+
+static void ComputeImageBandStatistics ( ImagePtr image, long band, long *histogram )
+{
+	short					numCols = GetImageColumns ( image );
+	short					numRows = GetImageRows ( image );
+	long					bandsPerFrame = ( numRows + IMAGE_STATISTICS_BAND_ROWS - 1 ) / IMAGE_STATISTICS_BAND_ROWS;
+	short					frame = band / bandsPerFrame;
+	short					row = ( band % bandsPerFrame ) * IMAGE_STATISTICS_BAND_ROWS;
+	short					endRow = row + IMAGE_STATISTICS_BAND_ROWS;
+	short					col;
+	ImageBandStatisticsPtr	stats = &image->imageBandStatistics[band];
+	ImageBandStatistics		rowStats;
+	PIXEL					min, max, value, *data;
+	double					shift, sum, sum2, delta;
+	
+	if ( endRow > numRows )
+		endRow = numRows;
+		
+	stats->count = 0;
+	stats->mean = stats->m2 = 0.0;
+	stats->minimum = stats->maximum = 0;
+	
+	for ( ; row < endRow; row++ )
+	{
+		data = GetImageDataRow ( image, frame, row );
+		min = max = data[0];
+		shift = stats->count > 0 ? stats->mean : data[0];
+		sum = sum2 = 0.0;
+		
+		if ( histogram != NULL )
+		{
 			for ( col = 0; col < numCols; col++ )
 			{
 				value = data[col];
-			
+				
 				if ( value < min )
 					min = value;
-			
+					
 				if ( value > max )
 					max = value;
 				
-				sum += value;
-				sum2 += value * value;
-				n++;
+				delta = value - shift;
+				sum += delta;
+				sum2 += delta * delta;
+				
+				histogram[ ImageFineHistogramBin ( value ) ]++;
 			}
 		}
+		else
+		{
+			for ( col = 0; col < numCols; col++ )
+			{
+				value = data[col];
+				
+				if ( value < min )
+					min = value;
+					
+				if ( value > max )
+					max = value;
+				
+				delta = value - shift;
+				sum += delta;
+				sum2 += delta * delta;
+			}
+		}
+		
+		rowStats.count = numCols;
+		rowStats.mean = shift + sum / numCols;
+		rowStats.m2 = sum2 - sum * sum / numCols;
+		if ( rowStats.m2 < 0.0 )
+			rowStats.m2 = 0.0;
+		rowStats.minimum = min;
+		rowStats.maximum = max;
+		
+		MergeImageBandStatistics ( stats, &rowStats );
 	}
+}
+
+/*** ImageStatisticsTask **********************************************************
+
+	Performs one of the parallel tasks started by ComputeImageStatistics().
+	Each task computes the statistics of a contiguous range of bands, and
+	accumulates their histogram into its own fine histogram.
 	
-	mean = sum / n;
-	stdev = sqrt ( ( sum2 - 2.0 * sum * mean + n * mean * mean ) / ( n - 1 ) );
+************************************************************************************/
 
-	image->imageMinimum = min;
-	image->imageMaximum = max;
-	image->imageMean = mean;
-	image->imageStdDev = stdev;
+static void ImageStatisticsTask ( void *data, long task )
+{
+	ImageStatisticsTaskData	*taskData = (ImageStatisticsTaskData *) data;
+	long					band, endBand;
+	
+	band = task * taskData->image->imageBandCount / taskData->numTasks;
+	endBand = ( task + 1 ) * taskData->image->imageBandCount / taskData->numTasks;
+	
+	for ( ; band < endBand; band++ )
+		ComputeImageBandStatistics ( taskData->image, band, taskData->histograms[task] );
+}
+
+/*** ComputeImageDisplayHistogram **************************************************
 
-	/*** Pass through image data to generate histogram of image data values ***/
+	Derives an image's display histogram (IMAGE_HISTOGRAM_BINS bins between the
+	image minimum and maximum values) from its fine histogram.  Counts within
+	each fine bin are assumed to be spread evenly across the bin, so the
+	cumulative count at each display bin edge is interpolated; this keeps the
+	display histogram's total equal to the number of pixels in the image.
 	
-	histogram = GetImageHistogram ( image, &numBins );
+************************************************************************************/
+
+static void ComputeImageDisplayHistogram ( ImagePtr image )
+{
+	long	*fine = image->imageFineHistogram;
+	long	*histogram = image->imageHistogram;
+	long	bin, edge, cum, prev, total;
+	double	min = image->imageMinimum, max = image->imageMaximum;
+	double	lo, hi, value, count;
+	
+	for ( total = bin = 0; bin < IMAGE_FINE_HISTOGRAM_BINS; bin++ )
+		total += fine[bin];
+	
+	/*** If all values are equal, they all go in the first bin, as before. ***/
+	
+	for ( edge = 0; edge < IMAGE_HISTOGRAM_BINS; edge++ )
+		histogram[edge] = 0;
+
+	if ( max <= min )
+	{
+		histogram[0] = total;
+		return;
+	}
 	
-	for ( bin = 0; bin < numBins; bin++ )
-		histogram[bin] = 0;
+	bin = cum = prev = 0;
+	GetImageFineHistogramBinRange ( image, bin, &lo, &hi );
+	
+	for ( edge = 1; edge < IMAGE_HISTOGRAM_BINS; edge++ )
+	{
+		value = min + edge * ( max - min ) / IMAGE_HISTOGRAM_BINS;
+		
+		while ( bin < IMAGE_FINE_HISTOGRAM_BINS - 1 && hi <= value )
+		{
+			cum += fine[bin++];
+			GetImageFineHistogramBinRange ( image, bin, &lo, &hi );
+		}
 		
-	if ( max == min )
-		scale = 0.0;
+		count = cum;
+		if ( hi > lo && value > lo )
+			count += fine[bin] * ( value - lo ) / ( hi - lo );
+			
+		histogram[edge - 1] = (long) ( count + 0.5 ) - prev;
+		prev += histogram[edge - 1];
+	}
+
+	histogram[IMAGE_HISTOGRAM_BINS - 1] = total - prev;
+}
+
+/*** MergeImageStatistics *********************************************************
+
+	Merges an image's band statistics to find the statistics of the whole
+	image, then derives its display histogram from its fine histogram.
+	
+************************************************************************************/
+
+static void MergeImageStatistics ( ImagePtr image )
+{
+	ImageBandStatistics	stats;
+	long				band;
+	
+	stats = image->imageBandStatistics[0];
+	for ( band = 1; band < image->imageBandCount; band++ )
+		MergeImageBandStatistics ( &stats, &image->imageBandStatistics[band] );
+	
+	image->imageMinimum = stats.minimum;
+	image->imageMaximum = stats.maximum;
+	image->imageMean = stats.mean;
+	
+	if ( stats.count > 1 )
+		image->imageStdDev = sqrt ( stats.m2 / ( stats.count - 1 ) );
 	else
-		scale = numBins / ( max - min );
+		image->imageStdDev = 0.0;
+
+	ComputeImageDisplayHistogram ( image );
+}
+
+/*** CountImageChangedPixels *******************************************************
+
+	Adds (count = 1) or removes (count = -1) the values of the pixels in an
+	image's changed rectangle to or from the image's fine histogram.
 	
-	for ( frame = 0; frame < numFrames; frame++ )
+************************************************************************************/
+
+static void CountImageChangedPixels ( ImagePtr image, long count )
+{
+	long	*histogram = image->imageFineHistogram;
+	short	frame, row, col;
+	PIXEL	*data;
+	
+	for ( frame = image->imageChangeFirstFrame; frame <= image->imageChangeLastFrame; frame++ )
 	{
-		for ( row = 0; row < numRows; row++ )
+		for ( row = image->imageChangeTop; row <= image->imageChangeBottom; row++ )
 		{
 			data = GetImageDataRow ( image, frame, row );
-	
-			for ( col = 0; col < numCols; col++ )
-			{
-				bin = scale * ( data[col] - min );
-				
-				if ( bin < 0 )
-					bin = 0;
-					
-				if ( bin >= numBins )
-					bin = numBins - 1;
-					
-				histogram[ bin ]++;
-			}
+			
+			for ( col = image->imageChangeLeft; col <= image->imageChangeRight; col++ )
+				histogram[ ImageFineHistogramBin ( data[col] ) ] += count;
 		}
 	}
 }
 
+/*** ComputeImageChangedStatistics *************************************************
+
+	Updates an image's statistics after a rectangle of the image has changed.
+	BeginImageChange() has already removed the rectangle's old values from the
+	fine histogram, so we add its new values, recompute the statistics of the
+	bands which overlap the rectangle, and merge them with the others.
+	
+************************************************************************************/
+
+static void ComputeImageChangedStatistics ( ImagePtr image )
+{
+	short	numRows = GetImageRows ( image );
+	long	bandsPerFrame = ( numRows + IMAGE_STATISTICS_BAND_ROWS - 1 ) / IMAGE_STATISTICS_BAND_ROWS;
+	long	band, lastBand;
+	short	frame;
+	
+	CountImageChangedPixels ( image, 1 );
+	
+	for ( frame = image->imageChangeFirstFrame; frame <= image->imageChangeLastFrame; frame++ )
+	{
+		band = frame * bandsPerFrame + image->imageChangeTop / IMAGE_STATISTICS_BAND_ROWS;
+		lastBand = frame * bandsPerFrame + image->imageChangeBottom / IMAGE_STATISTICS_BAND_ROWS;
+		
+		for ( ; band <= lastBand; band++ )
+			ComputeImageBandStatistics ( image, band, NULL );
+	}
+	
+	MergeImageStatistics ( image );
+}
+
+/*** ComputeImageStatistics *********************************************
+
+	Given a pointer to an image, computes the image's basic statistics
+	(minimum, maximum, mean, and standard deviation) and histogram.
+
+	void ComputeImageStatistics ( ImagePtr image )
+	
+	(image): pointer to image record.
+	
+	The function returns nothing.
+	
+	The image data are read only once.  Each frame is divided into bands of
+	IMAGE_STATISTICS_BAND_ROWS rows, and the bands are shared out among
+	GDoParallelTasks()'s threads.  Each band's count, mean, sum of squared
+	deviations, minimum and maximum are kept in the image record, and merged
+	to give the image totals; each thread also builds its own fine histogram
+	(IMAGE_FINE_HISTOGRAM_BINS bins, spaced in proportion to the values they
+	hold), and these are summed into the image's fine histogram.  The display
+	histogram returned by GetImageHistogram() is then derived from that.
+	
+	If BeginImageChange() has been called since the statistics were last
+	computed, only the bands containing the changed rectangle are read again,
+	and only the changed pixels are recounted in the fine histogram.
+	
+***************************************************************************/
+
+void ComputeImageStatistics ( ImagePtr image )
+{
+	short					numRows = GetImageRows ( image );
+	short					numFrames = GetImageFrames ( image );
+	long					numBands, numTasks, task, bin;
+	long					*histograms[IMAGE_STATISTICS_MAX_TASKS];
+	ImageStatisticsTaskData	taskData;
+	
+	/*** Allocate the image's fine histogram, and reallocate its array of band
+	     statistics if the image dimensions have changed.  On failure, leave
+	     the statistics as they were. ***/
+	     
+	if ( image->imageFineHistogram == NULL )
+	{
+		image->imageFineHistogram = (long *) malloc ( IMAGE_FINE_HISTOGRAM_BINS * sizeof ( long ) );
+		if ( image->imageFineHistogram == NULL )
+			return;
+	}
+	
+	numBands = numFrames * ( ( numRows + IMAGE_STATISTICS_BAND_ROWS - 1 ) / IMAGE_STATISTICS_BAND_ROWS );
+	
+	/*** If only a rectangle of the image has changed since the statistics
+	     were last computed, just update the statistics for that. ***/
+	     
+	if ( image->imageChangeState == IMAGE_CHANGED_RECT && numBands == image->imageBandCount )
+	{
+		ComputeImageChangedStatistics ( image );
+		image->imageChangeState = IMAGE_CHANGED_NONE;
+		return;
+	}
+	
+	if ( numBands != image->imageBandCount || image->imageBandStatistics == NULL )
+	{
+		if ( image->imageBandStatistics != NULL )
+			free ( image->imageBandStatistics );
+			
+		image->imageBandCount = 0;
+		image->imageBandStatistics = (ImageBandStatisticsPtr) malloc ( numBands * sizeof ( ImageBandStatistics ) );
+		if ( image->imageBandStatistics == NULL )
+			return;
+		
+		image->imageBandCount = numBands;
+	}
+
+	/*** Use one task per processor, as long as there are enough bands to go
+	     around.  The first task accumulates into the image's fine histogram;
+	     the others get histograms of their own.  If we can't allocate those,
+	     use fewer tasks. ***/
+	
+	numTasks = GGetProcessorCount();
+	if ( numTasks > numBands )
+		numTasks = numBands;
+
+	if ( numTasks > IMAGE_STATISTICS_MAX_TASKS )
+		numTasks = IMAGE_STATISTICS_MAX_TASKS;
+			
+	histograms[0] = image->imageFineHistogram;
+	for ( task = 1; task < numTasks; task++ )
+	{
+		histograms[task] = (long *) malloc ( IMAGE_FINE_HISTOGRAM_BINS * sizeof ( long ) );
+		if ( histograms[task] == NULL )
+			break;
+	}
+	
+	numTasks = task;
+	
+	for ( task = 0; task < numTasks; task++ )
+		memset ( histograms[task], 0, IMAGE_FINE_HISTOGRAM_BINS * sizeof ( long ) );
+	
+	taskData.image = image;
+	taskData.numTasks = numTasks;
+	taskData.histograms = histograms;
+	
+	GDoParallelTasks ( ImageStatisticsTask, &taskData, numTasks );
+	
+	/*** Sum the other tasks' histograms into the image's fine histogram. ***/
+	
+	for ( task = 1; task < numTasks; task++ )
+	{
+		for ( bin = 0; bin < IMAGE_FINE_HISTOGRAM_BINS; bin++ )
+			histograms[0][bin] += histograms[task][bin];
+			
+		free ( histograms[task] );
+	}
+	
+	MergeImageStatistics ( image );
+	image->imageChangeState = IMAGE_CHANGED_NONE;
+}
+
 /*** GetImageMininumValue **********************************************************
 
 	Returns an image's minimum data value.
@@ -1637,13 +2114,19 @@ long *GetImageHistogram ( ImagePtr image, long *bins )
 	previously called ComputeImageStatistics().
 	
 	The percentile desired should be expressed as a number from 0.0 to 100.0.
+	
+	The value is found from the image's fine histogram, by interpolating within
+	the bin which contains the requested percentile; it is therefore accurate to
+	a fraction of that bin's width (better than 1% of the value itself, for
+	floating-point images).  If you need the exact value, use the slower
+	GetImageExactPercentile().
 	 
 ************************************************************************************/
 
 PIXEL GetImagePercentile ( ImagePtr image, double percentile )
 {
-	long		*histogram, numBins, bin, sum, rank;
-	PIXEL		min, max, value;
+	long		*histogram, bin, sum;
+	double		rank, lo, hi;
 	
 	/*** Find the rank which corresponds to the requested percentile (i.e.
 	     find the Nth brightest pixel in the image, which corresponds to the
@@ -1653,26 +2136,391 @@ PIXEL GetImagePercentile ( ImagePtr image, double percentile )
 	     * GetImageRows ( image ) * GetImageColumns ( image ) * GetImageFrames ( image )
 	     / 100.0;
 
+	histogram = image->imageFineHistogram;
+	if ( histogram == NULL )
+		return ( image->imageMinimum );
+		
 	/*** Now sum the numbers of pixels in the bins of the histogram, stopping
 	     when the sum exceeds the rank we computed above. ***/
 	     
-	histogram = GetImageHistogram ( image, &numBins );
+	for ( sum = bin = 0; bin < IMAGE_FINE_HISTOGRAM_BINS - 1; bin++ )
+	{
+		if ( sum + histogram[bin] > rank )
+			break;
+			
+		sum += histogram[bin];
+	}		
+	
+	/*** Compute and return the image data value which corresponds to the
+	     rank's position within that bin. ***/
+	
+	GetImageFineHistogramBinRange ( image, bin, &lo, &hi );
+	
+	if ( histogram[bin] > 0 )
+		lo += ( hi - lo ) * ( rank - sum ) / histogram[bin];
+	
+	if ( lo > hi )
+		lo = hi;
+		
+	return ( lo );
+}
+
+/*** SelectImageDataValue **********************************************************
+
+	Finds the data value of a particular rank in an image, i.e. the value which
+	would be at that index if all of the image's data values were sorted in
+	increasing order.
+	
+	int SelectImageDataValue ( ImagePtr image, long rank, PIXEL *value, PIXEL *next )
 
-	for ( sum = bin = 0; bin < numBins; bin++ )
+	(image): pointer to image record.
+	(rank):  rank of desired value, from zero to the number of pixels minus 1.
+	(value): receives value of that rank.
+	(next):  if non-NULL, receives value of the following rank.
+	
+	The function returns TRUE if successful, or FALSE if it can't allocate
+	memory.  The image's fine histogram tells us which bin holds the desired
+	rank, and how many pixels are in it; we copy just those pixels, then use
+	Wirth's selection algorithm on the copy.
+	
+************************************************************************************/
+
+static int SelectImageDataValue ( ImagePtr image, long rank, PIXEL *value, PIXEL *next )
+{
+	short	numCols = GetImageColumns ( image );
+	short	numRows = GetImageRows ( image );
+	short	numFrames = GetImageFrames ( image );
+	short	frame, row, col;
+	long	*histogram = image->imageFineHistogram;
+	long	bin, lastBin, sum, n, i, j, k, l, m;
+	PIXEL	*values, *data, x, t;
+	
+	/*** Find the bin which contains the value of the desired rank, and if
+	     the caller wants the following value, the bin which contains that. ***/
+	     
+	for ( sum = bin = 0; bin < IMAGE_FINE_HISTOGRAM_BINS - 1; bin++ )
 	{
+		if ( sum + histogram[bin] > rank )
+			break;
+			
 		sum += histogram[bin];
-		if ( sum > rank )
+	}
+	
+	for ( n = histogram[bin], lastBin = bin; next != NULL && sum + n <= rank + 1; n += histogram[lastBin] )
+		if ( ++lastBin >= IMAGE_FINE_HISTOGRAM_BINS )
 			break;
-	}		
 	
-	/*** Compute and return the image data value which corresponds to the bin
-	     number. ***/
+	if ( lastBin >= IMAGE_FINE_HISTOGRAM_BINS )
+		lastBin = IMAGE_FINE_HISTOGRAM_BINS - 1;
+		
+	/*** Copy the data values in those bins. ***/
 	
-	min   = GetImageMinimumValue ( image );
-	max   = GetImageMaximumValue ( image );
-	value = bin * ( max - min ) / numBins + min;
+	values = (PIXEL *) malloc ( ( n > 0 ? n : 1 ) * sizeof ( PIXEL ) );
+	if ( values == NULL )
+		return ( FALSE );
 	
-	return ( value );
+	for ( i = 0, frame = 0; frame < numFrames; frame++ )
+	{
+		for ( row = 0; row < numRows; row++ )
+		{
+			data = GetImageDataRow ( image, frame, row );
+			
+			for ( col = 0; col < numCols; col++ )
+			{
+				j = ImageFineHistogramBin ( data[col] );
+				if ( j >= bin && j <= lastBin && i < n )
+					values[i++] = data[col];
+			}
+		}
+	}
+	
+	n = i;
+	k = rank - sum;
+	if ( k >= n )
+		k = n - 1;
+	
+	/*** Partially sort the copied values until the one at index k is in
+	     its final position. ***/
+	     
+	for ( l = 0, m = n - 1; l < m; )
+	{
+		x = values[k];
+		i = l;
+		j = m;
+		
+		do
+		{
+			while ( values[i] < x )
+				i++;
+				
+			while ( x < values[j] )
+				j--;
+				
+			if ( i <= j )
+			{
+				t = values[i];
+				values[i] = values[j];
+				values[j] = t;
+				i++;
+				j--;
+			}
+		}
+		while ( i <= j );
+		
+		if ( j < k )
+			l = i;
+			
+		if ( k < i )
+			m = j;
+	}
+	
+	*value = values[k];
+	
+	/*** Everything after index k is now at least as large as the value there;
+	     the following value is the smallest of those. ***/
+	     
+	if ( next != NULL )
+	{
+		*next = *value;
+		
+		if ( k + 1 < n )
+			for ( *next = values[k + 1], i = k + 2; i < n; i++ )
+				if ( values[i] < *next )
+					*next = values[i];
+	}
+	
+	free ( values );
+	return ( TRUE );
+}
+
+/*** GetImageExactPercentile *******************************************************
+
+	Returns the exact value of a particular percentile of the image data.
+	
+	PIXEL GetImageExactPercentile ( ImagePtr image, double percentile )
+	
+	(image): pointer to image record.
+	(percentile): desired percentile of image data, from 0.0 to 100.0.
+	
+	The value returned by this function will be invalid unless you have
+	previously called ComputeImageStatistics().
+	
+	Unlike GetImagePercentile(), this function finds the percentile by selecting
+	the actual data values at the ranks on either side of it, and interpolating
+	between them.  Percentile 0.0 gives the image minimum, and 100.0 gives the
+	maximum.  This takes another pass through the image data, so it is much
+	slower than GetImagePercentile().  If it can't allocate the memory it needs,
+	the function returns the value from GetImagePercentile().
+	 
+************************************************************************************/
+
+PIXEL GetImageExactPercentile ( ImagePtr image, double percentile )
+{
+	long		n, rank;
+	double		position;
+	PIXEL		value, next;
+	
+	n = (long) GetImageRows ( image ) * GetImageColumns ( image ) * GetImageFrames ( image );
+	
+	if ( image->imageFineHistogram == NULL || n < 1 )
+		return ( GetImagePercentile ( image, percentile ) );
+		
+	if ( percentile < 0.0 )
+		percentile = 0.0;
+		
+	if ( percentile > 100.0 )
+		percentile = 100.0;
+		
+	position = percentile * ( n - 1 ) / 100.0;
+	rank = position;
+	position -= rank;
+	
+	if ( position > 0.0 && rank + 1 < n )
+	{
+		if ( ! SelectImageDataValue ( image, rank, &value, &next ) )
+			return ( GetImagePercentile ( image, percentile ) );
+			
+		return ( value + position * ( next - value ) );
+	}
+	else
+	{
+		if ( ! SelectImageDataValue ( image, rank, &value, NULL ) )
+			return ( GetImagePercentile ( image, percentile ) );
+			
+		return ( value );
+	}
+}
+
+/*** GetImageMedian ****************************************************************
+
+	Returns the exact median of the image data.
+	
+	PIXEL GetImageMedian ( ImagePtr image )
+	
+	(image): pointer to image record.
+	
+	The value returned by this function will be invalid unless you have
+	previously called ComputeImageStatistics().  If the image has an even
+	number of pixels, the median is the mean of the two middle values.
+	This is equivalent to GetImageExactPercentile ( image, 50.0 ).
+	 
+************************************************************************************/
+
+PIXEL GetImageMedian ( ImagePtr image )
+{
+	return ( GetImageExactPercentile ( image, 50.0 ) );
+}
+
+/*** BeginImageChange **************************************************************
+
+	Tells the program that a rectangle of an image's data is about to change.
+	
+	void BeginImageChange ( ImagePtr image, short frame, short left, short top,
+	     short right, short bottom )
+
+	(image):  pointer to an image.
+	(frame):  frame which will change, or -1 if all frames will change.
+	(left):   leftmost column which will change.
+	(top):    topmost row which will change.
+	(right):  rightmost column which will change.
+	(bottom): bottommost row which will change.
+	
+	This function returns nothing.
+	
+	Call this function before changing a portion of an image's data, then
+	change the data and call UpdateImage() as usual.  UpdateImage() will then
+	update the image's statistics, histogram, and offscreen bitmap from the
+	changed rectangle only, rather than from the entire image.  If you don't
+	call this function, UpdateImage() assumes that the whole image changed.
+	
+	The function removes the rectangle's current values from the image's
+	histogram, so it must be called before the data changes, and only once
+	for each pixel between calls to UpdateImage().  If it is called again
+	for a rectangle which lies outside the first, the whole image is treated
+	as changed.  Likewise, the image's statistics must have been computed
+	(by UpdateImage() or ComputeImageStatistics()) since its data last
+	changed in any way.
+	
+************************************************************************************/
+
+void BeginImageChange ( ImagePtr image, short frame, short left, short top, short right, short bottom )
+{
+	short	firstFrame, lastFrame;
+	
+	if ( left < 0 )
+		left = 0;
+		
+	if ( top < 0 )
+		top = 0;
+		
+	if ( right > GetImageColumns ( image ) - 1 )
+		right = GetImageColumns ( image ) - 1;
+		
+	if ( bottom > GetImageRows ( image ) - 1 )
+		bottom = GetImageRows ( image ) - 1;
+	
+	if ( frame < 0 )
+	{
+		firstFrame = 0;
+		lastFrame = GetImageFrames ( image ) - 1;
+	}
+	else
+	{
+		firstFrame = lastFrame = frame;
+	}
+	
+	if ( left > right || top > bottom )
+		return;
+		
+	/*** If a rectangle has already been marked as changing, and this one
+	     lies inside it, its old values have already been removed from the
+	     histogram, so there's nothing to do; otherwise, give up and treat
+	     the whole image as changed. ***/
+	     
+	if ( image->imageChangeState == IMAGE_CHANGED_RECT )
+	{
+		if ( left < image->imageChangeLeft || right > image->imageChangeRight
+		  || top < image->imageChangeTop || bottom > image->imageChangeBottom
+		  || firstFrame < image->imageChangeFirstFrame || lastFrame > image->imageChangeLastFrame )
+			image->imageChangeState = IMAGE_CHANGED_ALL;
+
+		return;
+	}
+	
+	/*** If the statistics are out of date anyway, they will be recomputed
+	     for the whole image. ***/
+	     
+	if ( image->imageChangeState != IMAGE_CHANGED_NONE || image->imageFineHistogram == NULL )
+		return;
+	
+	image->imageChangeState = IMAGE_CHANGED_RECT;
+	image->imageChangeFirstFrame = firstFrame;
+	image->imageChangeLastFrame = lastFrame;
+	image->imageChangeLeft = left;
+	image->imageChangeTop = top;
+	image->imageChangeRight = right;
+	image->imageChangeBottom = bottom;
+	
+	CountImageChangedPixels ( image, -1 );
+}
+
+/*** SetImageChanged ***************************************************************
+
+	Tells the program that all of an image's data has changed.
+	
+	void SetImageChanged ( ImagePtr image )
+
+	(image): pointer to an image.
+	
+	This function returns nothing.  Call it if you have called BeginImageChange(),
+	but then change more of the image than the rectangle you passed to it.
+	
+************************************************************************************/
+
+void SetImageChanged ( ImagePtr image )
+{
+	image->imageChangeState = IMAGE_CHANGED_ALL;
+}
+
+/*** GetImageChangedRect ***********************************************************
+
+	Determines which part of an image's data has changed.
+	
+	int GetImageChangedRect ( ImagePtr image, short *left, short *top,
+	    short *right, short *bottom )
+
+	(image):  pointer to an image.
+	(left):   receives leftmost changed column.
+	(top):    receives topmost changed row.
+	(right):  receives rightmost changed column.
+	(bottom): receives bottommost changed row.
+	
+	If only the rectangle passed to BeginImageChange() has changed since the
+	image's statistics were last computed, this function returns TRUE, and
+	returns the rectangle's boundaries in the other parameters.  If the whole
+	image may have changed, the function returns FALSE, and returns the whole
+	image's boundaries.
+	
+************************************************************************************/
+
+int GetImageChangedRect ( ImagePtr image, short *left, short *top, short *right, short *bottom )
+{
+	if ( image->imageChangeState == IMAGE_CHANGED_RECT )
+	{
+		*left = image->imageChangeLeft;
+		*top = image->imageChangeTop;
+		*right = image->imageChangeRight;
+		*bottom = image->imageChangeBottom;
+		
+		return ( TRUE );
+	}
+	
+	*left = 0;
+	*top = 0;
+	*right = GetImageColumns ( image ) - 1;
+	*bottom = GetImageRows ( image ) - 1;
+	
+	return ( FALSE );
 }
 
 /*** UpdateImage *******************************************************************
@@ -1696,23 +2544,78 @@ PIXEL GetImagePercentile ( ImagePtr image, double percentile )
 	5) recompute and redisplay the statics of the selected image region;
 	6) recompute and redisplay the image's histogram (if present).
 	
+	If you called BeginImageChange() before changing the image data, steps 1
+	and 2 only process the rectangle you passed to it, and steps 5 and 6 are
+	skipped if the selected region lies outside that rectangle.
+	
 ************************************************************************************/
 
 void UpdateImage ( ImagePtr image )
 {
 	ImageRegionPtr	region;
 	GWindowPtr		window;
+	GRect			rect;
+	PIXEL			min, max;
+	double			tolerance;
+	short			left, top, right, bottom;
+	int				changedRect, changedRegion = TRUE;
 	
-	/*** Compute the image's display range; draw the image's
-	     offscreen bitmap, and mark the image as needing to be saved
-	     since the image data has changed. ***/
+	/*** Find out whether only a rectangle of the image has changed, before
+	     the statistics are recomputed and the changed rectangle is forgotten.
+	     Also remember the display range the bitmap was last drawn with. ***/
 
 	window = GetImageWindow ( image );
 	
+	changedRect = GetImageChangedRect ( image, &left, &top, &right, &bottom );
+	min = GetImageWindowDisplayMin ( window );
+	max = GetImageWindowDisplayMax ( window );
+	
+	/*** The image's background map is out of date if any of its data changed. ***/
+	
+	InvalidateImageBackground ( image );
+	
+	/*** Compute the image's display range.  If only a rectangle changed, and
+	     the display range moved by less than one gray level as a result, keep
+	     the old range, so that only the changed rectangle has to be redrawn. ***/
+	
 	ComputeImageDisplayRange ( window );
-	DrawImageWindowBitmap ( window );
+	
+	if ( changedRect )
+	{
+		tolerance = ( (double) max - min ) / 256.0;
+		
+		if ( fabs ( (double) GetImageWindowDisplayMin ( window ) - min ) <= tolerance
+		  && fabs ( (double) GetImageWindowDisplayMax ( window ) - max ) <= tolerance )
+		{
+			SetImageWindowDisplayMin ( window, min );
+			SetImageWindowDisplayMax ( window, max );
+		}
+		else
+		{
+			changedRect = FALSE;
+		}
+	}
+	
+	/*** Draw the image's offscreen bitmap (or just the changed part of it),
+	     and mark the image as needing to be saved since the image data has
+	     changed. ***/
+
+	if ( changedRect )
+	{
+		DrawImageWindowBitmapRect ( window, left, top, right, bottom );
+		
+		GSetRect ( &rect, left, top, right + 1, bottom + 1 );
+		ImageToWindowRect ( window, &rect );
+		GInsetRect ( &rect, -1, -1 );
+		GInvalidateWindow ( window, &rect );
+	}
+	else
+	{
+		DrawImageWindowBitmap ( window );
+		GInvalidateWindow ( window, NULL );
+	}
+	
 	SetImageWindowNeedsSave ( window, TRUE );
-	GInvalidateWindow ( window, NULL );
 
 	/*** If the "Image Display" dialog panel is present, update the
 	     positions of the sliders since the image min and max might
@@ -1720,17 +2623,24 @@ void UpdateImage ( ImagePtr image )
 	
 	SetImageDisplayDialogItems ( window );
 	
-    /*** If the image window has a selected region, compute its
-         statistics.  If the image window is the active image window,
-         display those statistics. ***/
+    /*** If the image window has a selected region, and it overlaps the
+         part of the image which changed, compute its statistics.  If the
+         image window is the active image window, display those statistics. ***/
 
 	region = GetImageWindowSelectedRegion ( window );
     if ( region != NULL )
     {
-    	ComputeImageRegionStatistics ( window, region );
-
-        if ( window == GetActiveImageWindow() )
-        	ShowImageRegionStatistics ( region );
+		if ( changedRect )
+			changedRegion = GetImageRegionLeft ( region ) <= right && GetImageRegionRight ( region ) >= left
+			             && GetImageRegionTop ( region ) <= bottom && GetImageRegionBottom ( region ) >= top;
+		
+		if ( changedRegion )
+		{
+	    	ComputeImageRegionStatistics ( window, region );
+	
+	        if ( window == GetActiveImageWindow() )
+	        	ShowImageRegionStatistics ( region );
+		}
     }
 
 	/*** If the image has an associated histogram window, compute
@@ -1738,7 +2648,7 @@ void UpdateImage ( ImagePtr image )
 	     histogram window so the histogram gets redrawn. ***/
 	
 	window = GetImageHistogramWindow ( image );
-	if ( window != NULL )
+	if ( window != NULL && changedRegion )
 	{
 		ComputeHistogramWindowHistogram ( window );
 		GInvalidateWindow ( window, NULL );
@@ -1795,6 +2705,7 @@ void AddImageObject ( ImagePtr image, ImageObjectPtr object )
 	SetNextImageObject ( object, image->imageObjectList );
 	image->imageObjectList = object;
 	image->imageObjectCount++;
+	InvalidateImageObjectIndex ( image );
 }
 
 /*** RemoveImageObject **************************************************************
@@ -1834,6 +2745,56 @@ void RemoveImageObject ( ImagePtr image, ImageObjectPtr object )
 			}
 		}
 	}
+	
+	InvalidateImageObjectIndex ( image );
+}
+
+/*** RemoveImageObjects *************************************************************
+
+	Removes several object records from an image's linked list of object records.
+
+	void RemoveImageObjects ( ImagePtr image, ImageObjectPtr objects[], long numObjects )
+
+	(image): pointer to image record
+	(objects): array of pointers to object records to remove from the image.
+	(numObjects): number of object records in the array.
+	
+	This does the same thing as calling RemoveImageObject() for each object in
+	the array, but walks the image's object list only once.  Objects which are
+	not in the image's object list are ignored.
+	
+*************************************************************************************/
+
+void RemoveImageObjects ( ImagePtr image, ImageObjectPtr objects[], long numObjects )
+{
+	long			i;
+	ImageObjectPtr	object, nextObject, lastObject = NULL;
+	
+	for ( i = 0; i < numObjects; i++ )
+		SetImageRegionFlag ( objects[i], IMAGE_REGION_FLAG_MARKED, TRUE );
+		
+	for ( object = GetImageObjectList ( image ); object != NULL; object = nextObject )
+	{
+		nextObject = GetNextImageObject ( object );
+		if ( GetImageRegionFlag ( object, IMAGE_REGION_FLAG_MARKED ) )
+		{
+			if ( lastObject == NULL )
+				image->imageObjectList = nextObject;
+			else
+				SetNextImageObject ( lastObject, nextObject );
+				
+			image->imageObjectCount--;
+		}
+		else
+		{
+			lastObject = object;
+		}
+	}
+	
+	for ( i = 0; i < numObjects; i++ )
+		SetImageRegionFlag ( objects[i], IMAGE_REGION_FLAG_MARKED, FALSE );
+
+	InvalidateImageObjectIndex ( image );
 }
 
 /*** DeleteImageObjectList **********************************************************
@@ -1856,6 +2817,7 @@ void DeleteImageObjectList ( ImagePtr image )
 	
 	image->imageObjectList = NULL;
 	image->imageObjectCount = 0;
+	InvalidateImageObjectIndex ( image );
 }
 
 /*** GetImagePreviousImage ***********************************************************
@@ -1918,6 +2880,15 @@ ImagePtr PrepareImagePreviousImage ( ImagePtr image )
 	
 	*previousImage = *image;
 	
+	/*** The statistics arrays, object index and background map belong to
+	     the main image, and are recomputed whenever its data or objects change. ***/
+	
+	previousImage->imageFineHistogram = NULL;
+	previousImage->imageBandStatistics = NULL;
+	previousImage->imageBandCount = 0;
+	previousImage->imageObjectIndex = NULL;
+	previousImage->imageBackground = NULL;
+	
 	/*** Store a pointer to the previous image record in the image itself,
 	     then return a pointer to the previous image record. ***/
 	
@@ -1963,6 +2934,9 @@ int RestoreImagePreviousImage ( ImagePtr image )
 		image->imageFITSImage = previousImage.imageFITSImage;
 	}
 	
+	image->imageChangeState = IMAGE_CHANGED_ALL;
+	InvalidateImageBackground ( image );
+	
 	/*** Now release memory for the image's saved previous state record,
 	     and return a successful result code. ***/
 	
@@ -2011,6 +2985,15 @@ void DeleteImagePreviousImage ( ImagePtr image )
 	if ( previousImage->imageObjectList != image->imageObjectList )
 		DeleteImageObjectList ( previousImage );
 
+	if ( previousImage->imageObjectIndex != NULL )
+		DeleteImageObjectIndex ( previousImage->imageObjectIndex );
+
+	if ( previousImage->imageFineHistogram != image->imageFineHistogram )
+		free ( previousImage->imageFineHistogram );
+		
+	if ( previousImage->imageBandStatistics != image->imageBandStatistics )
+		free ( previousImage->imageBandStatistics );
+
 	/*** Now free the previous image record itself, and set the main image's
 	     previous image pointer to NULL. ***/
 	     
@@ -0,0 +1,834 @@
+/*** COPYRIGHT NOTICE AND PUBLIC SOURCE LICENSE ***************************************
+
+	Portions Copyright (c) 1992-2001 Southern Stars Systems.  All Rights Reserved.
+
+	This file contains Original Code and/or Modifications of Original Code as
+	defined in and that are subject to the Southern Stars Systems Public Source
+	License Version 1.0 (the 'License').  You may not use this file except in
+	compliance with the License.  Please obtain a copy of the License at
+
+	http://www.southernstars.com/opensource/
+
+	and read it before using this file.
+
+	The Original Code and all software distributed under the License are distributed
+	on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER EXPRESS OR IMPLIED, AND
+	SOUTHERN STARS SYSTEMS HEREBY DISCLAIMS ALL SUCH WARRANTIES, INCLUDING WITHOUT
+	LIMITATION, ANY WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE,
+	QUIET ENJOYMENT, OR NON-INFRINGEMENT.  Please see the License for the specific
+	language governing rights and limitations under the License.
+
+	MODIFICATION HISTORY:
+
+	1.0.0 - 17 Oct 2026 - Original code: mesh background maps.
+
+****************************************************************************************/
+
+#include "SkySight.h"
+
+/*** local constants ***/
+
+#define BACKGROUND_MESH_SIZE		64		/* nominal width and height of mesh cells, in pixels */
+#define BACKGROUND_FILTER_SIZE		3		/* width and height of median filter, in mesh cells */
+#define BACKGROUND_CLIP_SIGMA		3.0		/* background pixels lie within this many sigma of the median */
+#define BACKGROUND_CLIP_ITERATIONS	10		/* most iterations of sigma-clipping */
+#define BACKGROUND_BAND_ROWS		64		/* rows of image per background subtraction task */
+
+/*** local data types ***/
+
+/*** An ImageBackground holds the background map of one image frame: the
+     background level and noise in each cell of a mesh laid over the frame,
+     interpolated down each column of cells for every image row, and the
+     weights and cells which interpolate along each image row. ***/
+     
+struct ImageBackground
+{
+	PIXEL			**data;				/* image data frame the map was computed from */
+	short			frame;				/* number of that frame */
+	short			cols;				/* width of image, in pixels */
+	short			rows;				/* height of image, in pixels */
+	long			meshCols;			/* number of mesh cells horizontally */
+	long			meshRows;			/* number of mesh cells vertically */
+	double			cellWidth;			/* width of each mesh cell, in pixels */
+	double			cellHeight;			/* height of each mesh cell, in pixels */
+	float			*meshBackground;	/* background level of each mesh cell */
+	float			*meshNoise;			/* standard deviation of background in each mesh cell */
+	float			*rowBackground;		/* background level, interpolated to each row, of each column of cells */
+	float			*rowNoise;			/* noise, interpolated to each row, of each column of cells */
+	long			*colCells;			/* for each image column, the 4 columns of cells it is interpolated from */
+	float			*colWeights;		/* for each image column, the interpolation weights of those cells */
+};
+
+/*** BackgroundJob holds the parameters which the parallel tasks share. ***/
+
+typedef struct BackgroundJob
+{
+	ImageBackgroundPtr	background;		/* background map */
+	PIXEL				**data;			/* image data frame */
+	long				numTasks;		/* number of parallel tasks */
+	int					failed;			/* TRUE if any task ran out of memory */
+}
+BackgroundJob, *BackgroundJobPtr;
+
+/*** local functions ***/
+
+static void		SetBackgroundMeshSize ( ImageBackgroundPtr, short, short );
+static void		EstimateBackgroundCell ( ImageBackgroundPtr, PIXEL **, long, long, float * );
+static void		ComputeBackgroundMeshTask ( void *, long );
+static float	SelectBackgroundValue ( float *, long, long );
+static float	FilterBackgroundCell ( float *, long, long, long, long );
+static void		FilterBackgroundMesh ( float *, long, long );
+static int		IsImageBackgroundCurrent ( ImagePtr, short );
+static void		SubtractImageBackgroundTask ( void *, long );
+static void		GetCubicWeights ( double, float * );
+static int		CompareBackgroundValues ( const void *, const void * );
+
+/*** CompareBackgroundValues ***/
+
+static int CompareBackgroundValues ( const void *p1, const void *p2 )
+{
+	float	v1 = *(float *) p1;
+	float	v2 = *(float *) p2;
+	
+	return ( v1 < v2 ? -1 : v1 > v2 ? 1 : 0 );
+}
+
+/*** SelectBackgroundValue *******************************************************
+
+	Returns the (k)th smallest of (n) values, partially reordering them, using
+	Wirth's selection algorithm.
+
+************************************************************************************/
+
+static float SelectBackgroundValue ( float *values, long n, long k )
+{
+	long	i, j, left = 0, right = n - 1;
+	float	x, temp;
+	
+	while ( left < right )
+	{
+		x = values[k];
+		i = left;
+		j = right;
+		
+		do
+		{
+			while ( values[i] < x )
+				i++;
+			while ( x < values[j] )
+				j--;
+				
+			if ( i <= j )
+			{
+				temp = values[i];
+				values[i] = values[j];
+				values[j] = temp;
+				i++;
+				j--;
+			}
+		}
+		while ( i <= j );
+		
+		if ( j < k )
+			left = i;
+		if ( k < i )
+			right = j;
+	}
+	
+	return ( values[k] );
+}
+
+/*** SetBackgroundMeshSize *********************************************************
+
+	Lays a mesh of cells, about BACKGROUND_MESH_SIZE pixels square, over an image
+	of (cols) by (rows) pixels, and records its size in a background map.
+
+************************************************************************************/
+
+static void SetBackgroundMeshSize ( ImageBackgroundPtr background, short cols, short rows )
+{
+	background->cols = cols;
+	background->rows = rows;
+	background->meshCols = ( cols + BACKGROUND_MESH_SIZE / 2 ) / BACKGROUND_MESH_SIZE;
+	background->meshRows = ( rows + BACKGROUND_MESH_SIZE / 2 ) / BACKGROUND_MESH_SIZE;
+	
+	if ( background->meshCols < 1 )
+		background->meshCols = 1;
+		
+	if ( background->meshRows < 1 )
+		background->meshRows = 1;
+		
+	background->cellWidth = (double) cols / background->meshCols;
+	background->cellHeight = (double) rows / background->meshRows;
+}
+
+/*** EstimateBackgroundCell ********************************************************
+
+	Estimates the background level and noise of one mesh cell, and stores them
+	in the map's (meshBackground) and (meshNoise) arrays.  The cell's pixels are
+	clipped to those within BACKGROUND_CLIP_SIGMA standard deviations of their
+	median until none more are clipped.  In an uncrowded cell, the background
+	is estimated as the mode of the remaining pixels, 2.5 * median - 1.5 * mean,
+	which is less biased by faint stars than the mean; in a crowded cell, where
+	the mean and median differ by more than 0.3 sigma, the median is used
+	instead.  (values) must have room for all of the cell's pixels.
+
+************************************************************************************/
+
+static void EstimateBackgroundCell ( ImageBackgroundPtr background, PIXEL **data, long meshRow, long meshCol, float *values )
+{
+	long				left, top, right, bottom, row, col;
+	long				n, m, i, k;
+	double				mean, sigma, median, sum, sum2, mode, low, high;
+	
+	top = meshRow * background->cellHeight;
+	bottom = meshRow < background->meshRows - 1 ? ( meshRow + 1 ) * background->cellHeight : background->rows;
+	left = meshCol * background->cellWidth;
+	right = meshCol < background->meshCols - 1 ? ( meshCol + 1 ) * background->cellWidth : background->cols;
+	
+	for ( n = 0, row = top; row < bottom; row++ )
+		for ( col = left; col < right; col++ )
+			values[n++] = data[row][col];
+	
+	mean = sigma = median = 0.0;
+	
+	for ( k = 0; k < BACKGROUND_CLIP_ITERATIONS && n > 0; k++ )
+	{
+		for ( sum = sum2 = 0.0, i = 0; i < n; i++ )
+		{
+			sum += values[i];
+			sum2 += values[i] * values[i];
+		}
+		
+		mean = sum / n;
+		sigma = n > 1 ? ( sum2 - sum * mean ) / ( n - 1 ) : 0.0;
+		sigma = sigma > 0.0 ? sqrt ( sigma ) : 0.0;
+		median = SelectBackgroundValue ( values, n, n / 2 );
+		
+		/*** Pack the values which survive clipping into the start of
+		     the array; stop when none are clipped. ***/
+		     
+		low = median - BACKGROUND_CLIP_SIGMA * sigma;
+		high = median + BACKGROUND_CLIP_SIGMA * sigma;
+		
+		for ( m = i = 0; i < n; i++ )
+			if ( values[i] >= low && values[i] <= high )
+				values[m++] = values[i];
+		
+		if ( m == n )
+			break;
+			
+		n = m;
+	}
+	
+	if ( sigma > 0.0 && fabs ( mean - median ) < 0.3 * sigma )
+		mode = 2.5 * median - 1.5 * mean;
+	else
+		mode = median;
+		
+	background->meshBackground[ meshRow * background->meshCols + meshCol ] = mode;
+	background->meshNoise[ meshRow * background->meshCols + meshCol ] = sigma;
+}
+
+/*** ComputeBackgroundMeshTask *****************************************************
+
+	Performs one of the parallel tasks started by ComputeImageBackground(), which
+	estimates the background level and noise of every (numTasks)th row of mesh
+	cells with EstimateBackgroundCell().
+
+************************************************************************************/
+
+static void ComputeBackgroundMeshTask ( void *data, long task )
+{
+	BackgroundJobPtr	job = (BackgroundJobPtr) data;
+	ImageBackgroundPtr	background = job->background;
+	float				*values;
+	long				meshRow, meshCol;
+	
+	values = (float *) malloc ( ( (long) background->cellWidth + 2 ) * ( (long) background->cellHeight + 2 ) * sizeof ( float ) );
+	if ( values == NULL )
+	{
+		job->failed = TRUE;
+		return;
+	}
+	
+	for ( meshRow = task; meshRow < background->meshRows; meshRow += job->numTasks )
+		for ( meshCol = 0; meshCol < background->meshCols; meshCol++ )
+			EstimateBackgroundCell ( background, job->data, meshRow, meshCol, values );
+	
+	free ( values );
+}
+
+/*** FilterBackgroundCell **********************************************************
+
+	Returns the median of the cells of a background mesh in the
+	BACKGROUND_FILTER_SIZE x BACKGROUND_FILTER_SIZE square around one cell.  At
+	the edges of the mesh, only the cells inside it are used.
+
+************************************************************************************/
+
+static float FilterBackgroundCell ( float *mesh, long meshCols, long meshRows, long meshRow, long meshCol )
+{
+	float	window[ BACKGROUND_FILTER_SIZE * BACKGROUND_FILTER_SIZE ];
+	long	row, col, n = 0, half = BACKGROUND_FILTER_SIZE / 2;
+	
+	for ( row = meshRow - half; row <= meshRow + half; row++ )
+		for ( col = meshCol - half; col <= meshCol + half; col++ )
+			if ( row >= 0 && row < meshRows && col >= 0 && col < meshCols )
+				window[n++] = mesh[ row * meshCols + col ];
+	
+	qsort ( window, n, sizeof ( float ), CompareBackgroundValues );
+	return ( n % 2 ? window[ n / 2 ] : 0.5 * ( window[ n / 2 - 1 ] + window[ n / 2 ] ) );
+}
+
+/*** FilterBackgroundMesh **********************************************************
+
+	Replaces each cell of a background mesh with the median of the cells around
+	it (see FilterBackgroundCell()), which removes the cells spoiled by bright
+	stars or other large objects.
+
+************************************************************************************/
+
+static void FilterBackgroundMesh ( float *mesh, long meshCols, long meshRows )
+{
+	float	*copy;
+	long	meshRow, meshCol;
+	
+	copy = (float *) malloc ( meshCols * meshRows * sizeof ( float ) );
+	if ( copy == NULL )
+		return;
+		
+	memcpy ( copy, mesh, meshCols * meshRows * sizeof ( float ) );
+	
+	for ( meshRow = 0; meshRow < meshRows; meshRow++ )
+		for ( meshCol = 0; meshCol < meshCols; meshCol++ )
+			mesh[ meshRow * meshCols + meshCol ] = FilterBackgroundCell ( copy, meshCols, meshRows, meshRow, meshCol );
+	
+	free ( copy );
+}
+
+/*** GetCubicWeights ***************************************************************
+
+	Computes the weights of the four mesh cells around a point, a fraction (t)
+	of the way from the second cell to the third, for Catmull-Rom bicubic
+	interpolation between the cells' centers.
+
+************************************************************************************/
+
+static void GetCubicWeights ( double t, float *weights )
+{
+	double	t2 = t * t, t3 = t2 * t;
+	
+	weights[0] = 0.5 * ( -t3 + 2.0 * t2 - t );
+	weights[1] = 0.5 * ( 3.0 * t3 - 5.0 * t2 + 2.0 );
+	weights[2] = 0.5 * ( -3.0 * t3 + 4.0 * t2 + t );
+	weights[3] = 0.5 * ( t3 - t2 );
+}
+
+/*** ComputeImageBackground ********************************************************
+
+	Computes a map of the background level and noise across one frame of an image.
+	
+	ImageBackgroundPtr ComputeImageBackground ( PIXEL **data, short cols, short rows )
+	
+	(data): image data frame.
+	(cols): width of image, in pixels.
+	(rows): height of image, in pixels.
+	
+	The function returns a pointer to the background map, or NULL if it can't
+	allocate the memory it needs.  Release the map with DeleteImageBackground()
+	when no longer needed.  To find the background of an image which is shown in
+	a window, use GetImageBackground() instead, which keeps the map until the image
+	changes.
+	
+	As in SExtractor, the frame is divided into a mesh of cells, about
+	BACKGROUND_MESH_SIZE pixels square, and the background level and noise in each
+	cell are estimated from its sigma-clipped pixel values (see
+	EstimateBackgroundCell()).  The cells' estimates
+	are median-filtered to remove those spoiled by bright objects, and the
+	background at each pixel is interpolated between the cells' centers with a
+	bicubic spline; see GetImageBackgroundRow().  The cells are divided among all
+	of the system's processors.
+
+************************************************************************************/
+
+ImageBackgroundPtr ComputeImageBackground ( PIXEL **data, short cols, short rows )
+{
+	ImageBackgroundPtr	background;
+	BackgroundJob		job;
+	long				row, col, cell, meshRow, meshCol, i, k;
+	double				x, y, level, noise;
+	float				weights[4];
+	
+	background = (ImageBackgroundPtr) calloc ( 1, sizeof ( struct ImageBackground ) );
+	if ( background == NULL )
+		return ( NULL );
+	
+	background->data = data;
+	SetBackgroundMeshSize ( background, cols, rows );
+	
+	background->meshBackground = (float *) malloc ( background->meshCols * background->meshRows * sizeof ( float ) );
+	background->meshNoise = (float *) malloc ( background->meshCols * background->meshRows * sizeof ( float ) );
+	background->rowBackground = (float *) malloc ( rows * background->meshCols * sizeof ( float ) );
+	background->rowNoise = (float *) malloc ( rows * background->meshCols * sizeof ( float ) );
+	background->colCells = (long *) malloc ( cols * 4 * sizeof ( long ) );
+	background->colWeights = (float *) malloc ( cols * 4 * sizeof ( float ) );
+	
+	if ( background->meshBackground == NULL || background->meshNoise == NULL
+	  || background->rowBackground == NULL || background->rowNoise == NULL
+	  || background->colCells == NULL || background->colWeights == NULL )
+	{
+		DeleteImageBackground ( background );
+		return ( NULL );
+	}
+	
+	/*** Estimate the background in each mesh cell, in parallel, then
+	     median-filter the mesh. ***/
+	     
+	job.background = background;
+	job.data = data;
+	job.failed = FALSE;
+	job.numTasks = GGetProcessorCount();
+	if ( job.numTasks > background->meshRows )
+		job.numTasks = background->meshRows;
+	if ( job.numTasks < 1 )
+		job.numTasks = 1;
+		
+	GDoParallelTasks ( ComputeBackgroundMeshTask, &job, job.numTasks );
+	
+	if ( job.failed )
+	{
+		DeleteImageBackground ( background );
+		return ( NULL );
+	}
+	
+	FilterBackgroundMesh ( background->meshBackground, background->meshCols, background->meshRows );
+	FilterBackgroundMesh ( background->meshNoise, background->meshCols, background->meshRows );
+	
+	/*** Interpolate each column of cells to every image row.  Beyond the
+	     centers of the outermost cells, their values are extended unchanged. ***/
+	
+	for ( row = 0; row < rows; row++ )
+	{
+		y = ( row + 0.5 ) / background->cellHeight - 0.5;
+		if ( y < 0.0 )
+			y = 0.0;
+		if ( y > background->meshRows - 1 )
+			y = background->meshRows - 1;
+			
+		meshRow = y;
+		GetCubicWeights ( y - meshRow, weights );
+		
+		for ( meshCol = 0; meshCol < background->meshCols; meshCol++ )
+		{
+			level = noise = 0.0;
+			
+			for ( k = 0; k < 4; k++ )
+			{
+				i = meshRow - 1 + k;
+				i = i < 0 ? 0 : i >= background->meshRows ? background->meshRows - 1 : i;
+				cell = i * background->meshCols + meshCol;
+				
+				level += weights[k] * background->meshBackground[cell];
+				noise += weights[k] * background->meshNoise[cell];
+			}
+			
+			background->rowBackground[ row * background->meshCols + meshCol ] = level;
+			background->rowNoise[ row * background->meshCols + meshCol ] = noise;
+		}
+	}
+	
+	/*** Find the cells and weights which interpolate along each image row. ***/
+	
+	for ( col = 0; col < cols; col++ )
+	{
+		x = ( col + 0.5 ) / background->cellWidth - 0.5;
+		if ( x < 0.0 )
+			x = 0.0;
+		if ( x > background->meshCols - 1 )
+			x = background->meshCols - 1;
+			
+		meshCol = x;
+		GetCubicWeights ( x - meshCol, background->colWeights + col * 4 );
+		
+		for ( k = 0; k < 4; k++ )
+		{
+			i = meshCol - 1 + k;
+			background->colCells[ col * 4 + k ] = i < 0 ? 0 : i >= background->meshCols ? background->meshCols - 1 : i;
+		}
+	}
+	
+	return ( background );
+}
+
+/*** DeleteImageBackground *********************************************************
+
+	Releases the memory used by a background map.
+	
+	void DeleteImageBackground ( ImageBackgroundPtr background )
+	
+	(background): pointer to background map, from ComputeImageBackground().
+	
+	The function returns nothing.  Don't delete the maps returned by
+	GetImageBackground(), which belong to their images.
+	
+************************************************************************************/
+
+void DeleteImageBackground ( ImageBackgroundPtr background )
+{
+	if ( background == NULL )
+		return;
+		
+	free ( background->meshBackground );
+	free ( background->meshNoise );
+	free ( background->rowBackground );
+	free ( background->rowNoise );
+	free ( background->colCells );
+	free ( background->colWeights );
+	free ( background );
+}
+
+/*** GetImageBackgroundRow *********************************************************
+
+	Interpolates the background level and noise along one row of an image.
+	
+	void GetImageBackgroundRow ( ImageBackgroundPtr background, short row,
+	     float *level, float *noise )
+	
+	(background): pointer to background map.
+	(row):        image row.
+	(level):      if not NULL, receives background level at each pixel in the row.
+	(noise):      if not NULL, receives background noise at each pixel in the row.
+	
+	The function returns nothing.  Each of the arrays must have room for one value
+	per image column.  Since the map isn't changed, several threads may call this
+	function on the same map at once.
+	
+************************************************************************************/
+
+void GetImageBackgroundRow ( ImageBackgroundPtr background, short row, float *level, float *noise )
+{
+	long	col, meshCols = background->meshCols, *cells;
+	float	*weights, *rowBackground, *rowNoise;
+	
+	rowBackground = background->rowBackground + row * meshCols;
+	rowNoise = background->rowNoise + row * meshCols;
+	
+	for ( col = 0; col < background->cols; col++ )
+	{
+		cells = background->colCells + col * 4;
+		weights = background->colWeights + col * 4;
+		
+		if ( level != NULL )
+			level[col] = weights[0] * rowBackground[ cells[0] ] + weights[1] * rowBackground[ cells[1] ]
+			           + weights[2] * rowBackground[ cells[2] ] + weights[3] * rowBackground[ cells[3] ];
+		
+		if ( noise != NULL )
+			noise[col] = weights[0] * rowNoise[ cells[0] ] + weights[1] * rowNoise[ cells[1] ]
+			           + weights[2] * rowNoise[ cells[2] ] + weights[3] * rowNoise[ cells[3] ];
+	}
+}
+
+/*** GetImageBackgroundValue *******************************************************
+
+	Returns the background level at one pixel of an image.
+	
+	double GetImageBackgroundValue ( ImageBackgroundPtr background, short col,
+	       short row, double *noise )
+	
+	(background): pointer to background map.
+	(col):        image column.
+	(row):        image row.
+	(noise):      if not NULL, receives background noise at the pixel.
+	
+	Pixels outside the image are given the values at the nearest edge.
+	
+************************************************************************************/
+
+double GetImageBackgroundValue ( ImageBackgroundPtr background, short col, short row, double *noise )
+{
+	long	meshCols = background->meshCols, *cells;
+	float	*weights, *rowBackground, *rowNoise;
+	
+	col = col < 0 ? 0 : col >= background->cols ? background->cols - 1 : col;
+	row = row < 0 ? 0 : row >= background->rows ? background->rows - 1 : row;
+	
+	rowBackground = background->rowBackground + row * meshCols;
+	rowNoise = background->rowNoise + row * meshCols;
+	cells = background->colCells + col * 4;
+	weights = background->colWeights + col * 4;
+	
+	if ( noise != NULL )
+		*noise = weights[0] * rowNoise[ cells[0] ] + weights[1] * rowNoise[ cells[1] ]
+		       + weights[2] * rowNoise[ cells[2] ] + weights[3] * rowNoise[ cells[3] ];
+		       
+	return ( weights[0] * rowBackground[ cells[0] ] + weights[1] * rowBackground[ cells[1] ]
+	       + weights[2] * rowBackground[ cells[2] ] + weights[3] * rowBackground[ cells[3] ] );
+}
+
+/*** GetImageBackground ************************************************************
+
+	Returns the background map of one frame of an image, computing it if needed.
+	
+	ImageBackgroundPtr GetImageBackground ( ImagePtr image, short frame )
+	
+	(image): pointer to image.
+	(frame): frame of image.
+	
+	The function returns a pointer to the map, or NULL if it can't allocate the
+	memory needed to compute one.  The map belongs to the image, which keeps it
+	until its data changes (see InvalidateImageBackground()) or another frame's
+	map is requested, so it may be shared by object detection, photometry, and
+	background subtraction without being recomputed.
+	
+************************************************************************************/
+
+ImageBackgroundPtr GetImageBackground ( ImagePtr image, short frame )
+{
+	ImageBackgroundPtr	background;
+	
+	if ( IsImageBackgroundCurrent ( image, frame ) )
+		return ( image->imageBackground );
+		
+	InvalidateImageBackground ( image );
+	
+	background = ComputeImageBackground ( GetImageDataFrame ( image, frame ), GetImageColumns ( image ), GetImageRows ( image ) );
+	if ( background != NULL )
+		background->frame = frame;
+	
+	image->imageBackground = background;
+	return ( background );
+}
+
+/*** IsImageBackgroundCurrent ******************************************************
+
+	Returns TRUE if an image has a background map of one of its frames, which is
+	still current (i.e. the frame's data hasn't been replaced or resized since).
+
+************************************************************************************/
+
+static int IsImageBackgroundCurrent ( ImagePtr image, short frame )
+{
+	ImageBackgroundPtr	background = image->imageBackground;
+	
+	return ( background != NULL && background->frame == frame && background->data == GetImageDataFrame ( image, frame )
+	      && background->cols == GetImageColumns ( image ) && background->rows == GetImageRows ( image ) );
+}
+
+/*** EstimateImageBackground *******************************************************
+
+	Estimates the background level at one pixel of an image, without mapping the
+	background of the whole frame.
+	
+	int EstimateImageBackground ( ImagePtr image, short frame, short col, short row,
+	    double *level, double *noise )
+	
+	(image): pointer to image.
+	(frame): frame of image.
+	(col):   image column.
+	(row):   image row.
+	(level): receives background level at the pixel.
+	(noise): if not NULL, receives background noise at the pixel.
+	
+	The function returns TRUE if successful, or FALSE if it can't allocate the
+	memory it needs.  If the image already has a current map of the frame (see
+	GetImageBackground()), the values are taken from it.  Otherwise, only the
+	mesh cells which the map's median filter and interpolation would use at the
+	pixel are estimated, giving the same result at a small fraction of the cost
+	of mapping the frame; no map is kept.  Pixels outside the image are given
+	the values at the nearest edge.
+	
+************************************************************************************/
+
+int EstimateImageBackground ( ImagePtr image, short frame, short col, short row, double *level, double *noise )
+{
+	struct ImageBackground	mesh;
+	PIXEL					**data = GetImageDataFrame ( image, frame );
+	float					rowWeights[4], colWeights[4], *values;
+	long					meshRow, meshCol, i, j, k, l, half = BACKGROUND_FILTER_SIZE / 2;
+	double					x, y, rowLevel, rowNoise;
+	
+	if ( IsImageBackgroundCurrent ( image, frame ) )
+	{
+		*level = GetImageBackgroundValue ( image->imageBackground, col, row, noise );
+		return ( TRUE );
+	}
+	
+	memset ( &mesh, 0, sizeof ( mesh ) );
+	SetBackgroundMeshSize ( &mesh, GetImageColumns ( image ), GetImageRows ( image ) );
+	
+	col = col < 0 ? 0 : col >= mesh.cols ? mesh.cols - 1 : col;
+	row = row < 0 ? 0 : row >= mesh.rows ? mesh.rows - 1 : row;
+	
+	/*** Find the 4 x 4 cells, and their weights, which the map would interpolate
+	     the pixel from, as ComputeImageBackground() does. ***/
+	     
+	x = ( col + 0.5 ) / mesh.cellWidth - 0.5;
+	if ( x < 0.0 )
+		x = 0.0;
+	if ( x > mesh.meshCols - 1 )
+		x = mesh.meshCols - 1;
+	
+	y = ( row + 0.5 ) / mesh.cellHeight - 0.5;
+	if ( y < 0.0 )
+		y = 0.0;
+	if ( y > mesh.meshRows - 1 )
+		y = mesh.meshRows - 1;
+	
+	meshCol = x;
+	meshRow = y;
+	GetCubicWeights ( x - meshCol, colWeights );
+	GetCubicWeights ( y - meshRow, rowWeights );
+	
+	mesh.meshBackground = (float *) malloc ( mesh.meshCols * mesh.meshRows * sizeof ( float ) );
+	mesh.meshNoise = (float *) malloc ( mesh.meshCols * mesh.meshRows * sizeof ( float ) );
+	values = (float *) malloc ( ( (long) mesh.cellWidth + 2 ) * ( (long) mesh.cellHeight + 2 ) * sizeof ( float ) );
+	
+	if ( mesh.meshBackground == NULL || mesh.meshNoise == NULL || values == NULL )
+	{
+		free ( mesh.meshBackground );
+		free ( mesh.meshNoise );
+		free ( values );
+		return ( FALSE );
+	}
+	
+	/*** Estimate those cells, and the cells around them which the median
+	     filter needs, and then interpolate between the filtered cells. ***/
+	
+	for ( i = meshRow - 1 - half; i <= meshRow + 2 + half; i++ )
+		for ( j = meshCol - 1 - half; j <= meshCol + 2 + half; j++ )
+			if ( i >= 0 && i < mesh.meshRows && j >= 0 && j < mesh.meshCols )
+				EstimateBackgroundCell ( &mesh, data, i, j, values );
+	
+	*level = 0.0;
+	if ( noise != NULL )
+		*noise = 0.0;
+	
+	for ( k = 0; k < 4; k++ )
+	{
+		i = meshRow - 1 + k;
+		i = i < 0 ? 0 : i >= mesh.meshRows ? mesh.meshRows - 1 : i;
+		rowLevel = rowNoise = 0.0;
+		
+		for ( l = 0; l < 4; l++ )
+		{
+			j = meshCol - 1 + l;
+			j = j < 0 ? 0 : j >= mesh.meshCols ? mesh.meshCols - 1 : j;
+			
+			rowLevel += colWeights[l] * FilterBackgroundCell ( mesh.meshBackground, mesh.meshCols, mesh.meshRows, i, j );
+			if ( noise != NULL )
+				rowNoise += colWeights[l] * FilterBackgroundCell ( mesh.meshNoise, mesh.meshCols, mesh.meshRows, i, j );
+		}
+		
+		*level += rowWeights[k] * rowLevel;
+		if ( noise != NULL )
+			*noise += rowWeights[k] * rowNoise;
+	}
+	
+	free ( mesh.meshBackground );
+	free ( mesh.meshNoise );
+	free ( values );
+	
+	return ( TRUE );
+}
+
+/*** InvalidateImageBackground *****************************************************
+
+	Discards an image's background map, so that GetImageBackground() computes
+	a new one the next time it's called.
+	
+	void InvalidateImageBackground ( ImagePtr image )
+	
+	(image): pointer to image.
+	
+	The function returns nothing.  UpdateImage() calls it whenever the image's
+	data changes.
+	
+************************************************************************************/
+
+void InvalidateImageBackground ( ImagePtr image )
+{
+	if ( image->imageBackground != NULL )
+	{
+		DeleteImageBackground ( image->imageBackground );
+		image->imageBackground = NULL;
+	}
+}
+
+/*** SubtractImageBackgroundTask ***************************************************
+
+	Performs one of the parallel tasks started by SubtractImageBackground(),
+	which subtracts the background from every (numTasks)th band of image rows.
+
+************************************************************************************/
+
+static void SubtractImageBackgroundTask ( void *data, long task )
+{
+	BackgroundJobPtr	job = (BackgroundJobPtr) data;
+	ImageBackgroundPtr	background = job->background;
+	float				*level;
+	PIXEL				*pixels;
+	long				row, col, band, top, bottom, numBands;
+	
+	level = (float *) malloc ( background->cols * sizeof ( float ) );
+	if ( level == NULL )
+	{
+		job->failed = TRUE;
+		return;
+	}
+	
+	numBands = ( background->rows + BACKGROUND_BAND_ROWS - 1 ) / BACKGROUND_BAND_ROWS;
+	
+	for ( band = task; band < numBands; band += job->numTasks )
+	{
+		top = band * BACKGROUND_BAND_ROWS;
+		bottom = top + BACKGROUND_BAND_ROWS;
+		if ( bottom > background->rows )
+			bottom = background->rows;
+			
+		for ( row = top; row < bottom; row++ )
+		{
+			GetImageBackgroundRow ( background, row, level, NULL );
+			
+			pixels = job->data[row];
+			for ( col = 0; col < background->cols; col++ )
+				pixels[col] -= level[col];
+		}
+	}
+	
+	free ( level );
+}
+
+/*** SubtractImageBackground *******************************************************
+
+	Subtracts a background map from image data.
+	
+	int SubtractImageBackground ( ImageBackgroundPtr background, PIXEL **data )
+	
+	(background): pointer to background map.
+	(data):       image data frame, as large as the frame the map was computed from.
+	
+	The function returns TRUE if successful, or FALSE if it can't allocate the
+	memory it needs, in which case some rows may not have been changed.  The rows
+	are divided among all of the system's processors.
+	
+************************************************************************************/
+
+int SubtractImageBackground ( ImageBackgroundPtr background, PIXEL **data )
+{
+	BackgroundJob	job;
+	long			numBands = ( background->rows + BACKGROUND_BAND_ROWS - 1 ) / BACKGROUND_BAND_ROWS;
+	
+	job.background = background;
+	job.data = data;
+	job.failed = FALSE;
+	job.numTasks = GGetProcessorCount();
+	if ( job.numTasks > numBands )
+		job.numTasks = numBands;
+	if ( job.numTasks < 1 )
+		job.numTasks = 1;
+		
+	GDoParallelTasks ( SubtractImageBackgroundTask, &job, job.numTasks );
+	
+	return ( ! job.failed );
+}
@@ -0,0 +1,699 @@
+/*** COPYRIGHT NOTICE AND PUBLIC SOURCE LICENSE ***************************************
+
+	Portions Copyright (c) 1992-2001 Southern Stars Systems.  All Rights Reserved.
+
+	This file contains Original Code and/or Modifications of Original Code as
+	defined in and that are subject to the Southern Stars Systems Public Source
+	License Version 1.0 (the 'License').  You may not use this file except in
+	compliance with the License.  Please obtain a copy of the License at
+
+	http://www.southernstars.com/opensource/
+
+	and read it before using this file.
+
+	The Original Code and all software distributed under the License are distributed
+	on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER EXPRESS OR IMPLIED, AND
+	SOUTHERN STARS SYSTEMS HEREBY DISCLAIMS ALL SUCH WARRANTIES, INCLUDING WITHOUT
+	LIMITATION, ANY WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE,
+	QUIET ENJOYMENT, OR NON-INFRINGEMENT.  Please see the License for the specific
+	language governing rights and limitations under the License.
+
+	MODIFICATION HISTORY:
+
+	1.0.0 - 17 Oct 2026 - Original code: bias/dark/flat calibration and master frames.
+
+****************************************************************************************/
+
+#include "SkySight.h"
+
+/*** local data types ***/
+
+/*** ImageCalibration holds a set of master calibration frames.  The master
+     dark has the master bias subtracted from it, so that it contains only
+     thermal signal and can be scaled to any exposure; the master flat is
+     kept as the gain which corrects each pixel, i.e. the reciprocal of the
+     flat normalized to its mean.  Rows of zeros and ones stand in for any
+     master which has not been created. ***/
+
+struct ImageCalibration
+{
+	GPathPtr		cachePath;
+	FITSImagePtr	masters[3];
+	unsigned long	keys[3];
+	double			darkExposure;
+	long			cols;
+	long			rows;
+	PIXEL			*zeros;
+	PIXEL			*ones;
+};
+
+/*** CalibrateImageJob holds the parameters which CalibrateFITSImage() shares
+     with its parallel tasks. ***/
+
+typedef struct CalibrateImageJob
+{
+	ImageCalibrationPtr	calibration;
+	FITSImagePtr		fits;
+	double				exposure;
+	long				numTasks;
+}
+CalibrateImageJob, *CalibrateImageJobPtr;
+
+/*** local functions ***/
+
+static int CalibrateFITSImage ( ImageCalibrationPtr, FITSImagePtr, double );
+static void CalibrateImageTask ( void *, long );
+static void ComputeImageCalibrationGain ( FITSImagePtr );
+static void GetImageCalibrationKey ( FITSImagePtr, double *, double *, long * );
+static int GetImageCalibrationHeaderReal ( FITSImagePtr, char *, double * );
+static long GetImageCalibrationHeaderLine ( FITSImagePtr, char * );
+
+/*** NewImageCalibration ************************************************************
+
+	Creates a new, empty set of master calibration frames.
+	
+	ImageCalibrationPtr NewImageCalibration ( GPathPtr cachePath )
+	
+	(cachePath): path to directory in which master frames are cached, or NULL.
+	
+	The function returns a pointer to the new calibration record, or NULL on failure.
+	Until master frames are created for it with CreateImageCalibrationMaster(), it
+	leaves images unchanged.  Use DeleteImageCalibration() to free it.
+	
+*************************************************************************************/
+
+ImageCalibrationPtr NewImageCalibration ( GPathPtr cachePath )
+{
+	ImageCalibrationPtr	calibration;
+	
+	calibration = (ImageCalibrationPtr) calloc ( 1, sizeof ( struct ImageCalibration ) );
+	if ( calibration == NULL )
+		return ( NULL );
+		
+	if ( cachePath != NULL )
+	{
+		calibration->cachePath = GCreatePath ( cachePath );
+		if ( calibration->cachePath == NULL )
+		{
+			free ( calibration );
+			return ( NULL );
+		}
+	}
+	
+	return ( calibration );
+}
+
+/*** DeleteImageCalibration *********************************************************
+
+	Frees memory for a set of master calibration frames.
+	
+	void DeleteImageCalibration ( ImageCalibrationPtr calibration )
+	
+	(calibration): pointer to calibration record.
+	
+	The cached master frames on disk are left alone.
+	
+*************************************************************************************/
+
+void DeleteImageCalibration ( ImageCalibrationPtr calibration )
+{
+	short type;
+	
+	for ( type = IMAGE_CALIBRATION_BIAS; type <= IMAGE_CALIBRATION_FLAT; type++ )
+		if ( calibration->masters[type] != NULL )
+			FreeFITSImage ( calibration->masters[type] );
+			
+	if ( calibration->cachePath != NULL )
+		GDeletePath ( calibration->cachePath );
+		
+	if ( calibration->zeros != NULL )
+		free ( calibration->zeros );
+		
+	if ( calibration->ones != NULL )
+		free ( calibration->ones );
+		
+	free ( calibration );
+}
+
+/*** CreateImageCalibrationMaster ***************************************************
+
+	Creates a master bias, dark, or flat frame from a set of FITS files.
+	
+	int CreateImageCalibrationMaster ( ImageCalibrationPtr calibration, short type,
+	    GPathPtr paths[], long numFiles, short method, double kappa, short iterations )
+	
+	(calibration): pointer to calibration record.
+	(type):        IMAGE_CALIBRATION_BIAS, IMAGE_CALIBRATION_DARK, or IMAGE_CALIBRATION_FLAT.
+	(paths):       array of paths to FITS files containing bias, dark, or flat frames.
+	(numFiles):    number of files in the array.
+	(method):      combining method, as for StackImageFiles().
+	(kappa):       rejection limit for clipping methods, as for StackImageFiles().
+	(iterations):  most rejection passes for clipping methods, as for StackImageFiles().
+	
+	The function returns TRUE if successful, or FALSE on failure, i.e. if the files
+	can't be read, or aren't the same size as the masters which have already been
+	created, or if memory can't be allocated.  Any existing master of the same type
+	is replaced.
+	
+	The files are combined with StackImageFiles().  The master bias is subtracted
+	from the combined darks, and the master bias and the master dark (scaled to the
+	flats' exposure) from the combined flats; since these are the same for every file,
+	doing so after combining gives the same result as doing so before.  The masters
+	should therefore be created in that order: bias, dark, flat.
+	
+	If the calibration record has a cache directory, the finished master is saved
+	there as a FITS file, whose name is made from the type of frame, the exposure
+	time, CCD temperature and binning in the first file's FITS header (keywords
+	EXPTIME or EXPOSURE, CCD-TEMP or SET-TEMP, and XBINNING), the image size, and a
+	checksum of the files' names, sizes and modification times, and of the masters
+	subtracted from it.  The next time a master is wanted from the same files, it is
+	read from the cache instead of being combined all over again; if any of them has
+	been replaced or changed since, the checksum differs and a new master is made.
+	
+*************************************************************************************/
+
+int CreateImageCalibrationMaster ( ImageCalibrationPtr calibration, short type,
+GPathPtr paths[], long numFiles, short method, double kappa, short iterations )
+{
+	static char		*typeNames[3] = { "Bias", "Dark", "Flat" };
+	char			name[256], filename[256];
+	unsigned long	key;
+	long			i, binning, frame, row, col;
+	double			exposure, temperature, scale;
+	FILE			*file;
+	FITSImagePtr	fits, master = NULL;
+	GPathPtr		path = NULL;
+	ImagePtr		image;
+	PIXEL			*data, *bias, *dark;
+	
+	if ( numFiles < 1 || type < IMAGE_CALIBRATION_BIAS || type > IMAGE_CALIBRATION_FLAT )
+		return ( FALSE );
+		
+	/*** Get the exposure time, temperature and binning from the first file's
+	     header. ***/
+	     
+	file = GOpenFile ( paths[0], "rb", NULL, NULL );
+	if ( file == NULL )
+		return ( FALSE );
+		
+	fits = ReadFITSImageHeader ( file );
+	fclose ( file );
+	if ( fits == NULL )
+		return ( FALSE );
+		
+	GetImageCalibrationKey ( fits, &exposure, &temperature, &binning );
+	
+	if ( calibration->cols > 0 && ( fits->naxis1 != calibration->cols || fits->naxis2 != calibration->rows ) )
+	{
+		FreeFITSImage ( fits );
+		return ( FALSE );
+	}
+	
+	/*** Work out the checksum which identifies this master: the names, sizes
+	     and modification times of the files, and the keys of the masters which
+	     will be subtracted from it. ***/
+	
+	key = 5381;
+	for ( i = IMAGE_CALIBRATION_BIAS; i < type; i++ )
+		key = key * 33 + calibration->keys[i];
+		
+	for ( i = 0; i < numFiles; i++ )
+	{
+		GGetPathName ( paths[i], filename );
+		for ( col = 0; filename[col] != '\0'; col++ )
+			key = key * 33 + (unsigned char) filename[col];
+			
+		key = key * 33 + (unsigned long) GGetFileSize ( paths[i] );
+		key = key * 33 + GGetFileModificationTime ( paths[i] );
+	}
+	
+	/*** If there's a cache directory, look for the master in it. ***/
+	
+	if ( calibration->cachePath != NULL )
+	{
+		sprintf ( name, "%s_%ldx%ld_bin%ld", typeNames[type], fits->naxis1, fits->naxis2, binning );
+		if ( type != IMAGE_CALIBRATION_BIAS && exposure > 0.0 )
+			sprintf ( name + strlen ( name ), "_%.3fs", exposure );
+			
+		if ( type != IMAGE_CALIBRATION_FLAT && temperature > -274.0 )
+			sprintf ( name + strlen ( name ), "_%.0fC", temperature );
+			
+		sprintf ( name + strlen ( name ), "_%08lx.fit", key & 0xFFFFFFFFUL );
+		
+		path = GCreatePath ( calibration->cachePath );
+		if ( path != NULL && GAppendPathName ( path, name ) == FALSE )
+		{
+			GDeletePath ( path );
+			path = NULL;
+		}
+		
+		if ( path != NULL && GFileExists ( path ) )
+		{
+			file = GOpenFile ( path, "rb", NULL, NULL );
+			if ( file != NULL )
+			{
+				master = ReadFITSImage ( file );
+				fclose ( file );
+			}
+			
+			if ( master != NULL && ( master->naxis1 != fits->naxis1 || master->naxis2 != fits->naxis2 ) )
+			{
+				FreeFITSImage ( master );
+				master = NULL;
+			}
+		}
+	}
+	
+	/*** Otherwise combine the files, and subtract the masters we already have
+	     from the result.  Then record the key values in the master's header,
+	     and save it in the cache. ***/
+	
+	if ( master == NULL )
+	{
+		image = StackImageFiles ( paths, NULL, numFiles, method, kappa, iterations );
+		if ( image != NULL )
+		{
+			master = GetImageFITSImage ( image );
+			SetImageFITSImage ( image, NULL );
+			DeleteImage ( image );
+		}
+		
+		if ( master != NULL && type != IMAGE_CALIBRATION_BIAS )
+		{
+			scale = 0.0;
+			if ( type == IMAGE_CALIBRATION_FLAT && calibration->masters[IMAGE_CALIBRATION_DARK] != NULL )
+				scale = calibration->darkExposure > 0.0 && exposure > 0.0 ? exposure / calibration->darkExposure : 1.0;
+			
+			for ( frame = 0; frame < master->naxis3; frame++ )
+			{
+				for ( row = 0; row < master->naxis2; row++ )
+				{
+					data = master->data[frame][row];
+					bias = calibration->masters[IMAGE_CALIBRATION_BIAS] == NULL ? NULL :
+					       GetFITSImageDataRow ( calibration->masters[IMAGE_CALIBRATION_BIAS], frame % calibration->masters[IMAGE_CALIBRATION_BIAS]->naxis3, row );
+					dark = calibration->masters[IMAGE_CALIBRATION_DARK] == NULL ? NULL :
+					       GetFITSImageDataRow ( calibration->masters[IMAGE_CALIBRATION_DARK], frame % calibration->masters[IMAGE_CALIBRATION_DARK]->naxis3, row );
+					
+					for ( col = 0; col < master->naxis1; col++ )
+					{
+						if ( bias != NULL )
+							data[col] -= bias[col];
+							
+						if ( dark != NULL && scale != 0.0 )
+							data[col] -= scale * dark[col];
+					}
+				}
+			}
+		}
+		
+		if ( master != NULL )
+		{
+			if ( ( i = GetImageCalibrationHeaderLine ( master, "EXPTIME" ) ) >= 0 )
+				SetFITSHeaderLineKeywordReal ( &master->header, i, "EXPTIME", exposure );
+				
+			if ( temperature > -274.0 && ( i = GetImageCalibrationHeaderLine ( master, "CCD-TEMP" ) ) >= 0 )
+				SetFITSHeaderLineKeywordReal ( &master->header, i, "CCD-TEMP", temperature );
+				
+			if ( ( i = GetImageCalibrationHeaderLine ( master, "XBINNING" ) ) >= 0 )
+				SetFITSHeaderLineKeywordInteger ( &master->header, i, "XBINNING", binning );
+				
+			if ( ( i = GetImageCalibrationHeaderLine ( master, "NCOMBINE" ) ) >= 0 )
+				SetFITSHeaderLineKeywordInteger ( &master->header, i, "NCOMBINE", numFiles );
+			
+			if ( path != NULL )
+			{
+				file = GOpenFile ( path, "wb", "FITS", "SSky" );
+				if ( file != NULL )
+				{
+					if ( WriteFITSImage ( file, master ) == FALSE )
+					{
+						fclose ( file );
+						file = NULL;
+						GDeleteFile ( path );
+					}
+					else
+					{
+						fclose ( file );
+					}
+				}
+			}
+		}
+	}
+	
+	FreeFITSImage ( fits );
+	if ( path != NULL )
+		GDeletePath ( path );
+	
+	if ( master == NULL )
+		return ( FALSE );
+		
+	/*** Make sure we have rows of zeros and ones to stand in for missing masters. ***/
+	
+	if ( calibration->zeros == NULL )
+	{
+		calibration->zeros = (PIXEL *) calloc ( master->naxis1, sizeof ( PIXEL ) );
+		calibration->ones = (PIXEL *) malloc ( master->naxis1 * sizeof ( PIXEL ) );
+		if ( calibration->zeros == NULL || calibration->ones == NULL )
+		{
+			if ( calibration->zeros != NULL )
+				free ( calibration->zeros );
+				
+			if ( calibration->ones != NULL )
+				free ( calibration->ones );
+				
+			calibration->zeros = NULL;
+			calibration->ones = NULL;
+			FreeFITSImage ( master );
+			return ( FALSE );
+		}
+		
+		for ( col = 0; col < master->naxis1; col++ )
+			calibration->ones[col] = 1;
+	}
+	
+	/*** Install the new master.  The flat is turned into gain factors, and we
+	     take the dark's exposure time back from its header, since the master
+	     may have come from the cache. ***/
+	
+	if ( type == IMAGE_CALIBRATION_FLAT )
+		ComputeImageCalibrationGain ( master );
+		
+	if ( type == IMAGE_CALIBRATION_DARK )
+		if ( GetImageCalibrationHeaderReal ( master, "EXPTIME", &calibration->darkExposure ) == FALSE )
+			calibration->darkExposure = 0.0;
+		
+	if ( calibration->masters[type] != NULL )
+		FreeFITSImage ( calibration->masters[type] );
+		
+	calibration->masters[type] = master;
+	calibration->keys[type] = key;
+	calibration->cols = master->naxis1;
+	calibration->rows = master->naxis2;
+	
+	return ( TRUE );
+}
+
+/*** CalibrateImageRow **************************************************************
+
+	Calibrates one row of image data in place.
+	
+	int CalibrateImageRow ( ImageCalibrationPtr calibration, short frame, short row,
+	    short left, short right, PIXEL *data, double exposure )
+	
+	(calibration): pointer to calibration record.
+	(frame):       frame of image which contains the row.
+	(row):         row of image which contains the data.
+	(left):        leftmost column of data to calibrate.
+	(right):       rightmost column of data to calibrate.
+	(data):        row of image data, indexed by column.
+	(exposure):    exposure time of image, in seconds; zero if not known.
+	
+	The function returns TRUE if successful, or FALSE if the row and columns lie
+	outside the master frames, in which case the data is left alone.
+	
+	Each value has the master bias and the master dark subtracted from it, and is
+	then multiplied by the master flat's gain, all in one pass along the row.  The
+	dark is scaled by the ratio of (exposure) to the master dark's exposure time, if
+	both are known.  If the masters have fewer frames than the image, they are
+	applied to its frames in turn, e.g. a monochrome master to all three frames of
+	a color image.
+	
+	This function is safe to call for different rows from several threads at once.
+	
+*************************************************************************************/
+
+int CalibrateImageRow ( ImageCalibrationPtr calibration, short frame, short row,
+short left, short right, PIXEL *data, double exposure )
+{
+	PIXEL			*bias, *dark, *gain;
+	FITSImagePtr	master;
+	float			scale = 1.0;
+	long			col;
+#if SSE2 && BITPIX == -32
+	__m128			x, s;
+#endif
+
+	if ( left < 0 || right >= calibration->cols || row < 0 || row >= calibration->rows )
+		return ( FALSE );
+		
+	bias = dark = calibration->zeros;
+	gain = calibration->ones;
+	
+	if ( ( master = calibration->masters[IMAGE_CALIBRATION_BIAS] ) != NULL )
+		bias = GetFITSImageDataRow ( master, frame % master->naxis3, row );
+		
+	if ( ( master = calibration->masters[IMAGE_CALIBRATION_DARK] ) != NULL )
+		dark = GetFITSImageDataRow ( master, frame % master->naxis3, row );
+		
+	if ( ( master = calibration->masters[IMAGE_CALIBRATION_FLAT] ) != NULL )
+		gain = GetFITSImageDataRow ( master, frame % master->naxis3, row );
+	
+	if ( calibration->darkExposure > 0.0 && exposure > 0.0 )
+		scale = exposure / calibration->darkExposure;
+	
+	col = left;
+	
+#if SSE2 && BITPIX == -32
+	s = _mm_set1_ps ( scale );
+	
+	for ( ; col + 4 <= right + 1; col += 4 )
+	{
+		x = _mm_sub_ps ( _mm_loadu_ps ( data + col ), _mm_loadu_ps ( bias + col ) );
+		x = _mm_sub_ps ( x, _mm_mul_ps ( s, _mm_loadu_ps ( dark + col ) ) );
+		_mm_storeu_ps ( data + col, _mm_mul_ps ( x, _mm_loadu_ps ( gain + col ) ) );
+	}
+#endif
+
+	for ( ; col <= right; col++ )
+		data[col] = ( data[col] - bias[col] - scale * dark[col] ) * gain[col];
+		
+	return ( TRUE );
+}
+
+/*** CalibrateImage *****************************************************************
+
+	Calibrates all of an image's data in place.
+	
+	int CalibrateImage ( ImageCalibrationPtr calibration, ImagePtr image, double exposure )
+	
+	(calibration): pointer to calibration record.
+	(image):       pointer to image to calibrate.
+	(exposure):    exposure time of image, in seconds; zero if not known.
+	
+	The function returns TRUE if successful, or FALSE if the image is not the same
+	size as the master frames, in which case the image is left alone.  Each row is
+	calibrated as by CalibrateImageRow(); the rows are shared among all of the
+	system's processors.
+	
+*************************************************************************************/
+
+int CalibrateImage ( ImageCalibrationPtr calibration, ImagePtr image, double exposure )
+{
+	return ( CalibrateFITSImage ( calibration, GetImageFITSImage ( image ), exposure ) );
+}
+
+/*** CalibrateImageFile *************************************************************
+
+	Calibrates a FITS file, and saves the result as a new FITS file.
+	
+	int CalibrateImageFile ( ImageCalibrationPtr calibration, GPathPtr input,
+	    GPathPtr output )
+	
+	(calibration): pointer to calibration record.
+	(input):       path to FITS file to calibrate.
+	(output):      path to FITS file to create.
+	
+	The function returns TRUE if successful, or FALSE on failure.  The exposure time
+	of the image is taken from its header, and the result is saved as 32-bit floating
+	point data with the rest of the input file's header.  Only one image is in memory
+	at a time, so this is the way to calibrate a large set of files before stacking
+	them.
+	
+*************************************************************************************/
+
+int CalibrateImageFile ( ImageCalibrationPtr calibration, GPathPtr input, GPathPtr output )
+{
+	FILE			*file;
+	FITSImagePtr	fits;
+	double			exposure, temperature;
+	long			binning, line;
+	int				result;
+	
+	file = GOpenFile ( input, "rb", NULL, NULL );
+	if ( file == NULL )
+		return ( FALSE );
+		
+	fits = ReadFITSImage ( file );
+	fclose ( file );
+	if ( fits == NULL )
+		return ( FALSE );
+	
+	GetImageCalibrationKey ( fits, &exposure, &temperature, &binning );
+	result = CalibrateFITSImage ( calibration, fits, exposure );
+	
+	/*** Calibrated values are no longer whole numbers, so store them as
+	     floating point. ***/
+	     
+	if ( result )
+	{
+		fits->bitpix = -32;
+		fits->bzero = 0.0;
+		fits->bscale = 1.0;
+		
+		line = 0;
+		if ( FindFITSHeaderKeyword ( fits->header, "BITPIX", &line ) )
+			SetFITSHeaderLineKeywordInteger ( &fits->header, line, "BITPIX", fits->bitpix );
+			
+		line = 0;
+		if ( FindFITSHeaderKeyword ( fits->header, "BZERO", &line ) )
+			SetFITSHeaderLineKeywordReal ( &fits->header, line, "BZERO", fits->bzero );
+			
+		line = 0;
+		if ( FindFITSHeaderKeyword ( fits->header, "BSCALE", &line ) )
+			SetFITSHeaderLineKeywordReal ( &fits->header, line, "BSCALE", fits->bscale );
+		
+		file = GOpenFile ( output, "wb", "FITS", "SSky" );
+		if ( file == NULL )
+		{
+			result = FALSE;
+		}
+		else
+		{
+			result = WriteFITSImage ( file, fits );
+			fclose ( file );
+		}
+	}
+	
+	FreeFITSImage ( fits );
+	return ( result );
+}
+
+/*** CalibrateFITSImage ***/
+
+static int CalibrateFITSImage ( ImageCalibrationPtr calibration, FITSImagePtr fits, double exposure )
+{
+	CalibrateImageJob	job;
+	
+	if ( fits == NULL || fits->data == NULL || fits->naxis1 != calibration->cols || fits->naxis2 != calibration->rows )
+		return ( FALSE );
+		
+	job.calibration = calibration;
+	job.fits = fits;
+	job.exposure = exposure;
+	job.numTasks = GGetProcessorCount();
+	if ( job.numTasks < 1 )
+		job.numTasks = 1;
+		
+	GDoParallelTasks ( CalibrateImageTask, &job, job.numTasks );
+	
+	return ( TRUE );
+}
+
+/*** CalibrateImageTask ***********************************************************
+
+	Performs one of CalibrateFITSImage()'s parallel tasks, i.e. calibrates every
+	(numTasks)th row of each frame.
+	
+*************************************************************************************/
+
+static void CalibrateImageTask ( void *data, long task )
+{
+	CalibrateImageJobPtr	job = (CalibrateImageJobPtr) data;
+	long					frame, row;
+	
+	for ( frame = 0; frame < job->fits->naxis3; frame++ )
+		for ( row = task; row < job->fits->naxis2; row += job->numTasks )
+			CalibrateImageRow ( job->calibration, frame, row, 0, job->fits->naxis1 - 1,
+			                    job->fits->data[frame][row], job->exposure );
+}
+
+/*** ComputeImageCalibrationGain ****************************************************
+
+	Turns a master flat into the gain factor for each pixel, i.e. the mean value of
+	the frame divided by the pixel's value.  Pixels with no signal are left alone.
+	
+*************************************************************************************/
+
+static void ComputeImageCalibrationGain ( FITSImagePtr flat )
+{
+	long	frame, row, col;
+	double	sum;
+	PIXEL	*data;
+	
+	for ( frame = 0; frame < flat->naxis3; frame++ )
+	{
+		for ( sum = 0.0, row = 0; row < flat->naxis2; row++ )
+			for ( data = flat->data[frame][row], col = 0; col < flat->naxis1; col++ )
+				sum += data[col];
+				
+		sum /= flat->naxis1 * flat->naxis2;
+		
+		for ( row = 0; row < flat->naxis2; row++ )
+			for ( data = flat->data[frame][row], col = 0; col < flat->naxis1; col++ )
+				data[col] = data[col] > 0 && sum > 0.0 ? sum / data[col] : 1;
+	}
+}
+
+/*** GetImageCalibrationKey *********************************************************
+
+	Gets the exposure time, CCD temperature, and binning of an image from its FITS
+	header.  Missing values are returned as zero exposure, a temperature below
+	absolute zero, and no binning.
+	
+*************************************************************************************/
+
+static void GetImageCalibrationKey ( FITSImagePtr fits, double *exposure, double *temperature, long *binning )
+{
+	double value;
+	
+	if ( GetImageCalibrationHeaderReal ( fits, "EXPTIME", exposure ) == FALSE )
+		if ( GetImageCalibrationHeaderReal ( fits, "EXPOSURE", exposure ) == FALSE )
+			*exposure = 0.0;
+			
+	if ( GetImageCalibrationHeaderReal ( fits, "CCD-TEMP", temperature ) == FALSE )
+		if ( GetImageCalibrationHeaderReal ( fits, "SET-TEMP", temperature ) == FALSE )
+			*temperature = -999.0;
+	
+	if ( GetImageCalibrationHeaderReal ( fits, "XBINNING", &value ) && value >= 1.0 )
+		*binning = value;
+	else
+		*binning = 1;
+}
+
+/*** GetImageCalibrationHeaderReal ***/
+
+static int GetImageCalibrationHeaderReal ( FITSImagePtr fits, char *keyword, double *value )
+{
+	long line = 0;
+	
+	if ( fits->header == NULL || FindFITSHeaderKeyword ( fits->header, keyword, &line ) == FALSE )
+		return ( FALSE );
+		
+	GetFITSHeaderReal ( GetFITSHeaderLine ( fits->header, line ), value );
+	return ( TRUE );
+}
+
+/*** GetImageCalibrationHeaderLine ************************************************
+
+	Returns the number of the line on which to store a keyword in a FITS header:
+	the line which already has the keyword, or else the END line, in which case END
+	is moved down a line.  Returns -1 if the header has neither.
+	
+*************************************************************************************/
+
+static long GetImageCalibrationHeaderLine ( FITSImagePtr fits, char *keyword )
+{
+	long line = 0;
+	
+	if ( FindFITSHeaderKeyword ( fits->header, keyword, &line ) )
+		return ( line );
+	
+	line = 0;
+	if ( FindFITSHeaderKeyword ( fits->header, "END", &line ) == FALSE )
+		return ( -1 );
+		
+	if ( SetFITSHeaderLineKeyword ( &fits->header, line + 1, "END" ) == FALSE )
+		return ( -1 );
+	
+	return ( line );
+}
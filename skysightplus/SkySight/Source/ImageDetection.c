@@ -0,0 +1,482 @@
+/*** COPYRIGHT NOTICE AND PUBLIC SOURCE LICENSE ***************************************
+
+	Portions Copyright (c) 1992-2001 Southern Stars Systems.  All Rights Reserved.
+
+	This file contains Original Code and/or Modifications of Original Code as
+	defined in and that are subject to the Southern Stars Systems Public Source
+	License Version 1.0 (the 'License').  You may not use this file except in
+	compliance with the License.  Please obtain a copy of the License at
+
+	http://www.southernstars.com/opensource/
+
+	and read it before using this file.
+
+	The Original Code and all software distributed under the License are distributed
+	on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER EXPRESS OR IMPLIED, AND
+	SOUTHERN STARS SYSTEMS HEREBY DISCLAIMS ALL SUCH WARRANTIES, INCLUDING WITHOUT
+	LIMITATION, ANY WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE,
+	QUIET ENJOYMENT, OR NON-INFRINGEMENT.  Please see the License for the specific
+	language governing rights and limitations under the License.
+
+	MODIFICATION HISTORY:
+
+	1.0.0 - 17 Oct 2026 - Original code: local-maximum star detection.
+
+****************************************************************************************/
+
+#include "SkySight.h"
+
+/*** local constants ***/
+
+#define DETECT_BAND_ROWS			64		/* rows of image per peak-finding task */
+
+/*** local data types ***/
+
+/*** A DetectionPeak records one local maximum found by DetectImageObjects(),
+     with the background level interpolated at its position. ***/
+
+typedef struct DetectionPeak
+{
+	short	col;
+	short	row;
+	PIXEL	value;
+	float	background;
+}
+DetectionPeak, *DetectionPeakPtr;
+
+/*** DetectionJob holds the parameters and buffers which DetectImageObjects()
+     shares with its parallel tasks.  Each band of image rows gets its own list
+     of peaks, so the tasks never share one. ***/
+
+typedef struct DetectionJob
+{
+	PIXEL				**data;			/* image data frame */
+	short				cols;			/* width of image, in pixels */
+	short				rows;			/* height of image, in pixels */
+	double				threshold;		/* detection threshold, in standard deviations above background */
+	ImageBackgroundPtr	background;		/* background map of image frame */
+	long				numBands;		/* number of bands of image rows */
+	DetectionPeakPtr	*peaks;			/* list of peaks found in each band */
+	long				*numPeaks;		/* number of peaks found in each band */
+	long				numTasks;		/* number of parallel tasks */
+	float				**scratch;		/* per-task workspace */
+	int					failed;			/* TRUE if any task ran out of memory */
+}
+DetectionJob, *DetectionJobPtr;
+
+/*** local functions ***/
+
+static void		FindDetectionPeaksTask ( void *, long );
+static int		IsDetectionPeak ( PIXEL **, short, short, short, short );
+static int		AddDetectionPeak ( DetectionJobPtr, long, long *, short, short, PIXEL, float );
+static long		SuppressDetectionPeaks ( DetectionPeakPtr, long, double );
+static int		CompareDetectionPeaks ( const void *, const void * );
+
+/*** IsDetectionPeak ***************************************************************
+
+	Determines whether a pixel is a local maximum: none of its eight neighbors is
+	brighter than it, and those which come before it in the image are fainter.
+	The second condition usually means that only one pixel of a flat-topped peak,
+	such as a saturated star, is found: the first one in row order.  That isn't
+	always so, since the test only looks at the neighbors; a plateau whose outline
+	isn't convex (e.g. U-shaped) has a first pixel in each of its arms.  Those
+	extra peaks lie close together, and SuppressDetectionPeaks() normally keeps
+	only one of them.  Pixels beyond the edges of the image are ignored.
+
+************************************************************************************/
+
+static int IsDetectionPeak ( PIXEL **data, short cols, short rows, short col0, short row0 )
+{
+	short	left, top, right, bottom, row, col;
+	PIXEL	value = data[row0][col0];
+	
+	left = col0 > 0 ? col0 - 1 : 0;
+	top = row0 > 0 ? row0 - 1 : 0;
+	right = col0 < cols - 1 ? col0 + 1 : cols - 1;
+	bottom = row0 < rows - 1 ? row0 + 1 : rows - 1;
+	
+	for ( row = top; row <= bottom; row++ )
+	{
+		for ( col = left; col <= right; col++ )
+		{
+			if ( row < row0 || ( row == row0 && col < col0 ) )
+			{
+				if ( data[row][col] >= value )
+					return ( FALSE );
+			}
+			else
+			{
+				if ( data[row][col] > value )
+					return ( FALSE );
+			}
+		}
+	}
+	
+	return ( TRUE );
+}
+
+/*** AddDetectionPeak ***/
+
+static int AddDetectionPeak ( DetectionJobPtr job, long band, long *capacity, short col, short row, PIXEL value, float background )
+{
+	DetectionPeakPtr	peaks;
+	
+	if ( job->numPeaks[band] == *capacity )
+	{
+		peaks = (DetectionPeakPtr) realloc ( job->peaks[band], ( *capacity * 2 + 64 ) * sizeof ( DetectionPeak ) );
+		if ( peaks == NULL )
+			return ( FALSE );
+			
+		job->peaks[band] = peaks;
+		*capacity = *capacity * 2 + 64;
+	}
+	
+	peaks = job->peaks[band] + job->numPeaks[band]++;
+	peaks->col = col;
+	peaks->row = row;
+	peaks->value = value;
+	peaks->background = background;
+	
+	return ( TRUE );
+}
+
+/*** FindDetectionPeaksTask ********************************************************
+
+	Performs one of the parallel tasks started by DetectImageObjects(), which
+	finds the peaks above the detection threshold in every (numTasks)th band of
+	image rows.  The SSE2 version compares four pixels at a time with the maxima
+	of their 3 x 3 neighborhoods and with their thresholds; only those pixels
+	which pass both tests are checked with IsDetectionPeak().
+
+************************************************************************************/
+
+static void FindDetectionPeaksTask ( void *data, long task )
+{
+	DetectionJobPtr	job = (DetectionJobPtr) data;
+	float			*background = job->scratch[task];
+	float			*threshold = background + job->cols;
+	PIXEL			*above, *here, *below;
+	long			band, top, bottom, row, col, capacity;
+#if SSE2 && BITPIX == -32
+	__m128			max, value;
+	int				bits, i;
+#endif
+
+	for ( band = task; band < job->numBands && ! job->failed; band += job->numTasks )
+	{
+		top = band * DETECT_BAND_ROWS;
+		bottom = top + DETECT_BAND_ROWS;
+		if ( bottom > job->rows )
+			bottom = job->rows;
+			
+		capacity = 0;
+		
+		for ( row = top; row < bottom; row++ )
+		{
+			GetImageBackgroundRow ( job->background, row, background, threshold );
+			for ( col = 0; col < job->cols; col++ )
+				threshold[col] = background[col] + job->threshold * threshold[col];
+			
+			above = job->data[ row > 0 ? row - 1 : row ];
+			here = job->data[row];
+			below = job->data[ row < job->rows - 1 ? row + 1 : row ];
+			
+			col = 0;
+			
+#if SSE2 && BITPIX == -32
+			if ( here[0] > threshold[0] && IsDetectionPeak ( job->data, job->cols, job->rows, 0, row ) )
+				if ( ! AddDetectionPeak ( job, band, &capacity, 0, row, here[0], background[0] ) )
+					job->failed = TRUE;
+					
+			for ( col = 1; col + 4 < job->cols; col += 4 )
+			{
+				max = _mm_max_ps ( _mm_loadu_ps ( above + col - 1 ), _mm_loadu_ps ( above + col ) );
+				max = _mm_max_ps ( max, _mm_loadu_ps ( above + col + 1 ) );
+				max = _mm_max_ps ( max, _mm_loadu_ps ( here + col - 1 ) );
+				max = _mm_max_ps ( max, _mm_loadu_ps ( here + col + 1 ) );
+				max = _mm_max_ps ( max, _mm_loadu_ps ( below + col - 1 ) );
+				max = _mm_max_ps ( max, _mm_loadu_ps ( below + col ) );
+				max = _mm_max_ps ( max, _mm_loadu_ps ( below + col + 1 ) );
+				
+				value = _mm_loadu_ps ( here + col );
+				bits = _mm_movemask_ps ( _mm_and_ps ( _mm_cmpge_ps ( value, max ),
+				       _mm_cmpgt_ps ( value, _mm_loadu_ps ( threshold + col ) ) ) );
+				
+				for ( i = 0; bits != 0; i++, bits >>= 1 )
+					if ( ( bits & 1 ) && IsDetectionPeak ( job->data, job->cols, job->rows, col + i, row ) )
+						if ( ! AddDetectionPeak ( job, band, &capacity, col + i, row, here[col + i], background[col + i] ) )
+							job->failed = TRUE;
+			}
+#endif
+			for ( ; col < job->cols; col++ )
+				if ( here[col] > threshold[col] && IsDetectionPeak ( job->data, job->cols, job->rows, col, row ) )
+					if ( ! AddDetectionPeak ( job, band, &capacity, col, row, here[col], background[col] ) )
+						job->failed = TRUE;
+		}
+	}
+}
+
+
+/*** CompareDetectionPeaks ***/
+
+static int CompareDetectionPeaks ( const void *p1, const void *p2 )
+{
+	DetectionPeakPtr	peak1 = *(DetectionPeakPtr *) p1;
+	DetectionPeakPtr	peak2 = *(DetectionPeakPtr *) p2;
+	
+	if ( peak1->value > peak2->value )
+		return ( -1 );
+		
+	if ( peak1->value < peak2->value )
+		return ( 1 );
+		
+	return ( peak1 < peak2 ? -1 : peak1 > peak2 ? 1 : 0 );
+}
+
+/*** SuppressDetectionPeaks ********************************************************
+
+	Removes each peak which lies within a given distance of a brighter one, e.g.
+	noise bumps in the wings of a bright star.  Peaks are considered from the
+	brightest down, ties going to the one first in row order; the peaks which
+	are kept are looked up in a grid of cells as wide as the distance, so that
+	only the nine cells around each peak are searched.  The surviving peaks are
+	packed into the start of the array, still in row order.
+
+	The function returns the number of peaks kept, or -1 if it can't allocate
+	the memory it needs.
+
+************************************************************************************/
+
+static long SuppressDetectionPeaks ( DetectionPeakPtr peaks, long numPeaks, double distance )
+{
+	DetectionPeakPtr	*order = NULL, peak, other;
+	long				*head = NULL, *next = NULL, gridCols, gridRows, gridCol, gridRow;
+	long				cell, i, j, n, col, row, dx, dy, left, right, top, bottom;
+	double				distance2 = distance * distance;
+	int					keep;
+	
+	gridCols = 0;
+	gridRows = 0;
+	for ( i = 0; i < numPeaks; i++ )
+	{
+		if ( peaks[i].col / distance + 1 > gridCols )
+			gridCols = peaks[i].col / distance + 1;
+		if ( peaks[i].row / distance + 1 > gridRows )
+			gridRows = peaks[i].row / distance + 1;
+	}
+	
+	order = (DetectionPeakPtr *) malloc ( numPeaks * sizeof ( DetectionPeakPtr ) + 1 );
+	next = (long *) malloc ( numPeaks * sizeof ( long ) + 1 );
+	head = (long *) malloc ( gridCols * gridRows * sizeof ( long ) + 1 );
+	
+	if ( order == NULL || next == NULL || head == NULL )
+	{
+		free ( order );
+		free ( next );
+		free ( head );
+		return ( -1 );
+	}
+	
+	for ( i = 0; i < numPeaks; i++ )
+		order[i] = peaks + i;
+		
+	for ( cell = 0; cell < gridCols * gridRows; cell++ )
+		head[cell] = -1;
+		
+	qsort ( order, numPeaks, sizeof ( DetectionPeakPtr ), CompareDetectionPeaks );
+	
+	/*** Mark the suppressed peaks by setting their columns to -1. ***/
+	
+	for ( i = 0; i < numPeaks; i++ )
+	{
+		peak = order[i];
+		gridCol = peak->col / distance;
+		gridRow = peak->row / distance;
+		
+		left = gridCol > 0 ? gridCol - 1 : 0;
+		right = gridCol < gridCols - 1 ? gridCol + 1 : gridCols - 1;
+		top = gridRow > 0 ? gridRow - 1 : 0;
+		bottom = gridRow < gridRows - 1 ? gridRow + 1 : gridRows - 1;
+		
+		for ( keep = TRUE, row = top; row <= bottom && keep; row++ )
+		{
+			for ( col = left; col <= right && keep; col++ )
+			{
+				for ( j = head[ row * gridCols + col ]; j >= 0; j = next[j] )
+				{
+					other = peaks + j;
+					dx = other->col - peak->col;
+					dy = other->row - peak->row;
+					
+					if ( dx * dx + dy * dy < distance2 )
+					{
+						keep = FALSE;
+						break;
+					}
+				}
+			}
+		}
+		
+		if ( keep )
+		{
+			j = peak - peaks;
+			next[j] = head[ gridRow * gridCols + gridCol ];
+			head[ gridRow * gridCols + gridCol ] = j;
+		}
+		else
+		{
+			peak->col = -1;
+		}
+	}
+	
+	for ( n = i = 0; i < numPeaks; i++ )
+		if ( peaks[i].col >= 0 )
+			peaks[n++] = peaks[i];
+	
+	free ( order );
+	free ( next );
+	free ( head );
+	
+	return ( n );
+}
+
+/*** DetectImageObjects ************************************************************
+
+	Finds the stars and other point-like objects in one frame of an image, and
+	adds an image object for each one to the image.
+	
+	long DetectImageObjects ( ImagePtr image, short frame, double sigma,
+	     double threshold, ImageObjectPtr **objects )
+	
+	(image):     pointer to image.
+	(frame):     frame of image in which to find objects.
+	(sigma):     expected one-sigma radius of the objects, in pixels.
+	(threshold): detection threshold, in standard deviations of the background noise.
+	(objects):   if not NULL, receives an array of the objects found.
+	
+	The function returns the number of objects found, or -1 if it can't allocate
+	the memory it needs.  If (objects) is not NULL and objects are found, the
+	array it receives must be released with free() when no longer needed; the
+	objects themselves belong to the image.  Each object is centered on its peak
+	pixel, with a radius of (sigma), and is given the local background level and
+	the peak's amplitude above it, as starting values for FitImageObjects().
+	
+	An object is a pixel which is brighter than its eight neighbors (see
+	IsDetectionPeak()), and more than (threshold) standard deviations above the
+	local background, as given by the image's background map (see
+	GetImageBackground()).  Peaks are found by a 3 x 3 maximum filter; of the
+	peaks within 2 sigma of each other, only the brightest is kept.
+	
+	The work is shared among all of the system's processors, each of which
+	works through its share of bands of image rows.  Peaks are gathered per
+	band and merged in band order, so the result doesn't depend on the number
+	of processors: objects are always found in row order.
+	
+************************************************************************************/
+
+long DetectImageObjects ( ImagePtr image, short frame, double sigma, double threshold, ImageObjectPtr **objects )
+{
+	DetectionJob		job;
+	DetectionPeakPtr	peaks = NULL;
+	ImageObjectPtr		object, *list = NULL;
+	long				numTasks, numPeaks, band, i, n = -1;
+	
+	if ( objects != NULL )
+		*objects = NULL;
+		
+	memset ( &job, 0, sizeof ( job ) );
+	
+	job.data = GetImageDataFrame ( image, frame );
+	job.cols = GetImageColumns ( image );
+	job.rows = GetImageRows ( image );
+	job.threshold = threshold;
+	job.numBands = ( job.rows + DETECT_BAND_ROWS - 1 ) / DETECT_BAND_ROWS;
+	
+	if ( job.data == NULL || job.cols < 1 || job.rows < 1 )
+		return ( 0 );
+		
+	numTasks = GGetProcessorCount();
+	if ( numTasks < 1 )
+		numTasks = 1;
+		
+	job.background = GetImageBackground ( image, frame );
+	job.peaks = (DetectionPeakPtr *) calloc ( job.numBands, sizeof ( DetectionPeakPtr ) );
+	job.numPeaks = (long *) calloc ( job.numBands, sizeof ( long ) );
+	job.scratch = NMatrix ( float, numTasks, job.cols * 2 );
+	
+	if ( job.background == NULL || job.peaks == NULL || job.numPeaks == NULL || job.scratch == NULL )
+		goto done;
+		
+	/*** Find the peaks in each band of rows. ***/
+	
+	job.numTasks = numTasks < job.numBands ? numTasks : job.numBands;
+	GDoParallelTasks ( FindDetectionPeaksTask, &job, job.numTasks );
+	
+	if ( job.failed )
+		goto done;
+		
+	/*** Gather the peaks from all of the bands, in band order, and weed out
+	     those too close to brighter ones. ***/
+	     
+	for ( numPeaks = band = 0; band < job.numBands; band++ )
+		numPeaks += job.numPeaks[band];
+		
+	peaks = (DetectionPeakPtr) malloc ( numPeaks * sizeof ( DetectionPeak ) + 1 );
+	if ( peaks == NULL )
+		goto done;
+		
+	for ( numPeaks = band = 0; band < job.numBands; band++ )
+	{
+		if ( job.numPeaks[band] > 0 )
+			memcpy ( peaks + numPeaks, job.peaks[band], job.numPeaks[band] * sizeof ( DetectionPeak ) );
+			
+		numPeaks += job.numPeaks[band];
+	}
+	
+	if ( 2.0 * sigma > 1.5 )
+		numPeaks = SuppressDetectionPeaks ( peaks, numPeaks, 2.0 * sigma );
+		
+	if ( numPeaks < 0 )
+		goto done;
+		
+	/*** Create an object for each peak, and add it to the image. ***/
+	
+	if ( objects != NULL && numPeaks > 0 )
+	{
+		list = (ImageObjectPtr *) malloc ( numPeaks * sizeof ( ImageObjectPtr ) );
+		if ( list == NULL )
+			goto done;
+	}
+	
+	for ( n = i = 0; i < numPeaks; i++ )
+	{
+		object = CreateImageObject ( image, peaks[i].col, peaks[i].row, sigma );
+		if ( object == NULL )
+			break;
+			
+		SetImageObjectBackground ( object, peaks[i].background );
+		SetImageObjectAmplitude ( object, peaks[i].value - peaks[i].background );
+		AddImageObject ( image, object );
+		
+		if ( list != NULL )
+			list[n] = object;
+			
+		n++;
+	}
+	
+	if ( objects != NULL )
+		*objects = list;
+		
+done:
+	for ( band = 0; job.peaks != NULL && band < job.numBands; band++ )
+		free ( job.peaks[band] );
+		
+	if ( job.scratch != NULL )
+		NDestroyMatrix ( job.scratch );
+		
+	free ( job.peaks );
+	free ( job.numPeaks );
+	free ( peaks );
+	
+	return ( n );
+}
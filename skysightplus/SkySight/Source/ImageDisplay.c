@@ -32,8 +32,8 @@
 
 /*** local functions ***/
 
-static void DrawImageWindowMonochromeBitmap ( GWindowPtr );
-static void DrawImageWindowRGBColorBitmap ( GWindowPtr );
+static void DrawImageWindowMonochromeBitmap ( GWindowPtr, short, short, short, short );
+static void DrawImageWindowRGBColorBitmap ( GWindowPtr, short, short, short, short );
 
 /***  ImageToWindow  *************************************************************
 
@@ -409,6 +409,13 @@ void DrawImageWindowBitmap ( GWindowPtr window )
 			}
 		}
 	}
+	
+	InvalidateImageWindowPyramid ( window, 0, 0, image->naxis1 - 1, image->naxis2 - 1 );
+}
+
+void DrawImageWindowBitmapRect ( GWindowPtr window, short left, short top, short right, short bottom )
+{
+	DrawImageWindowBitmap ( window );
 }
 
 #else
@@ -416,167 +423,356 @@ void DrawImageWindowBitmap ( GWindowPtr window )
 void DrawImageWindowBitmap ( GWindowPtr window )
 {
 	ImagePtr		image = GetImageWindowImage ( window );
-	GImagePtr		bitmap = GetImageWindowBitmap ( window );
 	
+	DrawImageWindowBitmapRect ( window, 0, 0, GetImageColumns ( image ) - 1, GetImageRows ( image ) - 1 );
+}
+
+/*** DrawImageWindowBitmapRect ***************************************************
+
+	Redraws part of an image window's offscreen bitmap from the image data.
+	
+	void DrawImageWindowBitmapRect ( GWindowPtr window, short left, short top,
+	     short right, short bottom )
+	
+	(window): pointer to image window.
+	(left):   leftmost image column to redraw.
+	(top):    topmost image row to redraw.
+	(right):  rightmost image column to redraw.
+	(bottom): bottommost image row to redraw.
+	
+	The function returns nothing.  The rest of the bitmap is left alone, so
+	this is only useful when the image window's display range hasn't changed
+	since the bitmap was last drawn.
+	
+***************************************************************************/
+
+void DrawImageWindowBitmapRect ( GWindowPtr window, short left, short top, short right, short bottom )
+{
+	ImagePtr		image = GetImageWindowImage ( window );
+	
+	if ( left < 0 )
+		left = 0;
+		
+	if ( top < 0 )
+		top = 0;
+		
+	if ( right > GetImageColumns ( image ) - 1 )
+		right = GetImageColumns ( image ) - 1;
+		
+	if ( bottom > GetImageRows ( image ) - 1 )
+		bottom = GetImageRows ( image ) - 1;
+		
 	if ( GetImageType ( image ) == IMAGE_TYPE_RGB_COLOR )
-		DrawImageWindowRGBColorBitmap ( window );
+		DrawImageWindowRGBColorBitmap ( window, left, top, right, bottom );
 	else
-		DrawImageWindowMonochromeBitmap ( window );
+		DrawImageWindowMonochromeBitmap ( window, left, top, right, bottom );
+		
+	InvalidateImageWindowPyramid ( window, left, top, right, bottom );
 }
 
-void DrawImageWindowMonochromeBitmap ( GWindowPtr window )
+/*** ImageBitmapJob holds the parameters which DrawImageWindowMonochromeBitmap()
+     and DrawImageWindowRGBColorBitmap() share with their parallel tasks.  Each
+     channel's bitmap value is computed as in the original per-pixel code, i.e.
+     ( balance * value - min ) * scale, clamped to 0-255; or if the display
+     range is empty, 0 below the minimum and 255 otherwise.  With integer image
+     data, the bitmap value for every possible pixel value is looked up in a
+     table; with floating-point data, the SSE2 version computes four at once,
+     with the same results.  Each channel's table is kept between redraws, and
+     only recomputed when that channel's display range or balance changes. ***/
+
+#if BITPIX == 8
+#define IMAGE_BITMAP_LUT_SIZE	256
+#elif BITPIX == 16
+#define IMAGE_BITMAP_LUT_SIZE	65536
+#endif
+
+#define IMAGE_BITMAP_BAND_ROWS	16
+#define IMAGE_BITMAP_CHUNK		256
+
+typedef struct ImageBitmapJob
 {
-	PIXEL			*imageRow, min, max;
-	float			value, scale;
-	unsigned char	*bitmapRow;
-	short			row, col, rows, columns;
-	ImagePtr		image = GetImageWindowImage ( window );
-	GImagePtr		bitmap = GetImageWindowBitmap ( window );
+	ImagePtr		image;
+	GImagePtr		bitmap;
+	short			left, top, right, bottom;
+	long			numTasks;
+	PIXEL			min;
+	float			scale;
+	double			balance[3];
+	int				channel[3];
+#ifdef IMAGE_BITMAP_LUT_SIZE
+	unsigned char	*lut[3];
+#endif
+}
+ImageBitmapJob, *ImageBitmapJobPtr;
+
+#ifdef IMAGE_BITMAP_LUT_SIZE
+
+typedef struct ImageBitmapLUT
+{
+	int				valid;
+	PIXEL			min;
+	float			scale;
+	double			balance;
+	unsigned char	value[IMAGE_BITMAP_LUT_SIZE];
+}
+ImageBitmapLUT;
+
+static ImageBitmapLUT sImageBitmapLUT[3];
+
+#endif
+
+/*** ComputeImageBitmapValue *******************************************************
+
+	Returns the bitmap value for one image data value in one color channel.
+
+************************************************************************************/
+
+static unsigned char ComputeImageBitmapValue ( ImageBitmapJobPtr job, short channel, PIXEL data )
+{
+	float	value = job->balance[channel] * data;
 	
-	/*** Determine the image's dimensions. ***/ 
+	if ( job->scale == 0.0 )
+		return ( value < job->min ? 0 : 255 );
+		
+	value = ( value - job->min ) * job->scale;
 	
-	rows = GetImageRows ( image );
-	columns = GetImageColumns ( image );
+	if ( value < 0.0 )
+		value = 0.0;
+	if ( value > 255.0 )
+		value = 255.0;
+
+	return ( (unsigned char) value );
+}
+
+/*** ComputeImageBitmapValues ******************************************************
+
+	Converts a run of image data values to bitmap values for one color channel.
+	If the data pointer is NULL, the channel is turned off, and its values are
+	computed as if the data were zero.
+
+************************************************************************************/
+
+static void ComputeImageBitmapValues ( ImageBitmapJobPtr job, short channel, PIXEL *data, unsigned char *values, short n )
+{
+	short	col = 0;
+#if SSE2 && BITPIX == -32
+	__m128	x, min = _mm_set1_ps ( job->min ), scale = _mm_set1_ps ( job->scale );
+	__m128	zero = _mm_setzero_ps(), full = _mm_set1_ps ( 255.0 );
+	__m128d	balance = _mm_set1_pd ( job->balance[channel] );
+	__m128i	i;
+#endif
+	
+	if ( data == NULL )
+	{
+		memset ( values, ComputeImageBitmapValue ( job, channel, 0 ), n );
+		return;
+	}
+	
+#ifdef IMAGE_BITMAP_LUT_SIZE
+	for ( ; col < n; col++ )
+		values[col] = job->lut[channel][ (unsigned short) data[col] & ( IMAGE_BITMAP_LUT_SIZE - 1 ) ];
+#else
+#if SSE2 && BITPIX == -32
+	if ( job->scale != 0.0 )
+	{
+		for ( ; col + 4 <= n; col += 4 )
+		{
+			x = _mm_loadu_ps ( data + col );
+			
+			if ( job->balance[channel] != 1.0 )
+				x = _mm_movelh_ps ( _mm_cvtpd_ps ( _mm_mul_pd ( balance, _mm_cvtps_pd ( x ) ) ),
+				                    _mm_cvtpd_ps ( _mm_mul_pd ( balance, _mm_cvtps_pd ( _mm_movehl_ps ( x, x ) ) ) ) );
+	
+			x = _mm_mul_ps ( _mm_sub_ps ( x, min ), scale );
+			x = _mm_min_ps ( _mm_max_ps ( x, zero ), full );
+			
+			i = _mm_cvttps_epi32 ( x );
+			i = _mm_packs_epi32 ( i, i );
+			i = _mm_packus_epi16 ( i, i );
+			*(int *) ( values + col ) = _mm_cvtsi128_si32 ( i );
+		}
+	}
+#endif
+	for ( ; col < n; col++ )
+		values[col] = ComputeImageBitmapValue ( job, channel, data[col] );
+#endif
+}
+
+/*** DrawImageBitmapTask ***********************************************************
+
+	Performs one of the parallel tasks which draw an image window's bitmap.
+	Each task draws one band of rows.  Monochrome values are written straight
+	into the bitmap; RGB values are computed a chunk of each channel at a time,
+	then combined into 32-bit bitmap pixels.
+
+************************************************************************************/
+
+static void DrawImageBitmapTask ( void *data, long task )
+{
+	ImageBitmapJobPtr	job = (ImageBitmapJobPtr) data;
+	long				rows = job->bottom - job->top + 1;
+	short				row = job->top + rows * task / job->numTasks;
+	short				endRow = job->top + rows * ( task + 1 ) / job->numTasks;
+	short				left = job->left, n = job->right - job->left + 1;
+	short				col, i, m, channel;
+	unsigned char		*bitmapRow, values[3][IMAGE_BITMAP_CHUNK];
+	unsigned long		*pixels;
+	PIXEL				*imageRow;
+
+	for ( ; row < endRow; row++ )
+	{
+		bitmapRow = GGetImageDataRow ( job->bitmap, row );
+		
+		if ( GetImageType ( job->image ) != IMAGE_TYPE_RGB_COLOR )
+		{
+			imageRow = GetImageDataRow ( job->image, 0, row );
+			ComputeImageBitmapValues ( job, 0, imageRow + left, bitmapRow + left, n );
+			continue;
+		}
+		
+		pixels = (unsigned long *) bitmapRow + left;
+		
+		for ( col = 0; col < n; col += m )
+		{
+			m = n - col < IMAGE_BITMAP_CHUNK ? n - col : IMAGE_BITMAP_CHUNK;
+			
+			for ( channel = 0; channel < 3; channel++ )
+			{
+				if ( job->channel[channel] )
+					imageRow = GetImageDataRow ( job->image, channel, row ) + left + col;
+				else
+					imageRow = NULL;
+					
+				ComputeImageBitmapValues ( job, channel, imageRow, values[channel], m );
+			}
+			
+			for ( i = 0; i < m; i++ )
+				pixels[col + i] = ( (unsigned long) values[0][i] << 16 ) | ( (unsigned long) values[1][i] << 8 ) | values[2][i];
+		}
+	}
+}
+
+/*** DrawImageBitmap ***************************************************************
+
+	Draws part of an image window's bitmap, using all processors.
+
+************************************************************************************/
+
+static void DrawImageBitmap ( ImageBitmapJobPtr job )
+{
+#ifdef IMAGE_BITMAP_LUT_SIZE
+	long			i;
+	short			channel;
+	ImageBitmapLUT	*lut;
+	
+	/*** Recompute a channel's lookup table only if the display range or
+	     color balance has changed since it was last computed; an unchanged
+	     redraw, e.g. after scrolling, reuses the previous table. ***/
+	     
+	for ( channel = 0; channel < 3; channel++ )
+	{
+		lut = &sImageBitmapLUT[channel];
+		job->lut[channel] = lut->value;
+		
+		if ( job->channel[channel] == FALSE )
+			continue;
+			
+		if ( lut->valid && lut->min == job->min && lut->scale == job->scale && lut->balance == job->balance[channel] )
+			continue;
+			
+		for ( i = 0; i < IMAGE_BITMAP_LUT_SIZE; i++ )
+			lut->value[i] = ComputeImageBitmapValue ( job, channel, IMAGE_BITMAP_LUT_SIZE == 256 ? (PIXEL) i : (PIXEL) (short) i );
+			
+		lut->min = job->min;
+		lut->scale = job->scale;
+		lut->balance = job->balance[channel];
+		lut->valid = TRUE;
+	}
+#endif
+
+	job->numTasks = ( job->bottom - job->top + IMAGE_BITMAP_BAND_ROWS ) / IMAGE_BITMAP_BAND_ROWS;
+	if ( job->numTasks > GGetProcessorCount() )
+		job->numTasks = GGetProcessorCount();
+		
+	if ( job->numTasks > 0 )
+		GDoParallelTasks ( DrawImageBitmapTask, job, job->numTasks );
+}
+
+static void DrawImageWindowMonochromeBitmap ( GWindowPtr window, short left, short top, short right, short bottom )
+{
+	ImageBitmapJobPtr	job;
+	PIXEL				min, max;
 	
+	job = (ImageBitmapJobPtr) malloc ( sizeof ( ImageBitmapJob ) );
+	if ( job == NULL )
+		return;
+		
+	job->image = GetImageWindowImage ( window );
+	job->bitmap = GetImageWindowBitmap ( window );
+	job->left = left;
+	job->top = top;
+	job->right = right;
+	job->bottom = bottom;
+
 	/*** Determine the image display range, and the scaling factor from
 	     image data values to bitmap values. ***/
 	     
 	min = GetImageWindowDisplayMin ( window );
 	max = GetImageWindowDisplayMax ( window );
 
+	job->min = min;
 	if ( max == min )
-		scale = 0.0;
+		job->scale = 0.0;
 	else
-		scale = 255.0 / ( max - min );
-
-	for ( row = 0; row < rows; row++ )
-	{
-		imageRow = GetImageDataRow ( image, 0, row );
-		bitmapRow = GGetImageDataRow ( bitmap, row );
-
-		if ( scale != 0.0 )
-	    {
-			for ( col = 0; col < columns; col++ )
-			{
-				value = scale * ( imageRow[col] - min );
-
-				if ( value < 0.0 )
-					value = 0.0;
-		   		if ( value > 255.0 )
-					value = 255.0;
+		job->scale = 255.0 / ( max - min );
 
-				bitmapRow[col] = value;
-			}
-	    }
-	    else
-	    {
-			for ( col = 0; col < columns; col++ )
-			{
-            	if ( imageRow[col] < min )
-                	bitmapRow[col] = 0;
-                else
-                	bitmapRow[col] = 255;
-		    }
-        }
-    }
+	job->balance[0] = 1.0;
+	job->channel[0] = TRUE;
+	job->channel[1] = job->channel[2] = FALSE;
+	
+	DrawImageBitmap ( job );
+	free ( job );
 }
 
-void DrawImageWindowRGBColorBitmap ( GWindowPtr window )
+static void DrawImageWindowRGBColorBitmap ( GWindowPtr window, short left, short top, short right, short bottom )
 {
-	PIXEL			*redRow, *greenRow, *blueRow, min, max;
-	float			red, green, blue, scale;
-	double			balanceRed, balanceGreen, balanceBlue;
-	unsigned long	*bitmapRow;
-	short			row, col, rows, columns, frame;
-	GImagePtr		bitmap = GetImageWindowBitmap ( window );
-	ImagePtr		image = GetImageWindowImage ( window );
-	
-	/*** Determine the image's dimensions ***/ 
-	
-	rows = GetImageRows ( image );
-	columns = GetImageColumns ( image );
+	ImageBitmapJobPtr	job;
+	PIXEL				min, max;
+	short				frame;
 	
+	job = (ImageBitmapJobPtr) malloc ( sizeof ( ImageBitmapJob ) );
+	if ( job == NULL )
+		return;
+		
+	job->image = GetImageWindowImage ( window );
+	job->bitmap = GetImageWindowBitmap ( window );
+	job->left = left;
+	job->top = top;
+	job->right = right;
+	job->bottom = bottom;
+
 	min = GetImageWindowDisplayMin ( window );
 	max = GetImageWindowDisplayMax ( window );
 
+	job->min = min;
 	if ( max == min )
-		scale = 0.0;
+		job->scale = 0.0;
 	else
-		scale = 255.0 / ( max - min );
+		job->scale = 255.0 / ( max - min );
 
-	GetRGBBalance ( &balanceRed, &balanceGreen, &balanceBlue );
+	GetRGBBalance ( &job->balance[0], &job->balance[1], &job->balance[2] );
 	
+	/*** Work out which color channels are displayed once, rather than for
+	     every pixel. ***/
+	     
 	frame = GetImageWindowColorFrame ( window );
 	
-	for ( row = 0; row < rows; row++ )
-	{
-		redRow    = GetImageDataRow ( image, 0, row );
-		greenRow  = GetImageDataRow ( image, 1, row );
-		blueRow   = GetImageDataRow ( image, 2, row );
-		
-		bitmapRow = GGetImageDataRow ( bitmap, row );
-
-		for ( col = 0; col < columns; col++ )
-		{
-			if ( frame == COLOR_FRAME_RED || frame == COLOR_FRAME_ALL )
-				red = balanceRed * redRow[col];
-			else
-				red = 0;
-				
-			if ( frame == COLOR_FRAME_GREEN || frame == COLOR_FRAME_ALL )
-				green = balanceGreen * greenRow[col];
-			else
-				green = 0;
-				
-			if ( frame == COLOR_FRAME_BLUE || frame == COLOR_FRAME_ALL )
-				blue = balanceBlue * blueRow[col];
-			else
-				blue = 0;
-				
-			if ( scale != 0.0 )
-			{
-				red   = scale * ( red - min );
-				green = scale * ( green - min );
-				blue  = scale * ( blue - min );
-
-				if ( red < 0.0 )
-					red = 0.0;
-		   		if ( red > 255.0 )
-					red = 255.0;
-
-				if ( green < 0.0 )
-					green = 0.0;
-		   		if ( green > 255.0 )
-					green = 255.0;
-
-				if ( blue < 0.0 )
-					blue = 0.0;
-		   		if ( blue > 255.0 )
-					blue = 255.0;
-
-				bitmapRow[col] = ( ( (long) red ) << 16 ) | ( ( (long) green ) << 8 ) | ( (long) blue );
-			}
-			else
-			{
-            	if ( red < min )
-                	red = 0;
-                else
-                	red = 255;
-
-            	if ( green < min )
-                	green = 0;
-                else
-                	green = 255;
-
-            	if ( blue < min )
-                	blue = 0;
-                else
-                	blue = 255;
-
-				bitmapRow[col] = ( ( (long) red ) << 16 ) | ( ( (long) green ) << 8 ) | ( (long) blue );
-		    }
-		}
-    }
+	job->channel[0] = frame == COLOR_FRAME_RED || frame == COLOR_FRAME_ALL;
+	job->channel[1] = frame == COLOR_FRAME_GREEN || frame == COLOR_FRAME_ALL;
+	job->channel[2] = frame == COLOR_FRAME_BLUE || frame == COLOR_FRAME_ALL;
+	
+	DrawImageBitmap ( job );
+	free ( job );
 }
 
 #endif
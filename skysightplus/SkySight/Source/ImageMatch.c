@@ -0,0 +1,701 @@
+/*** COPYRIGHT NOTICE AND PUBLIC SOURCE LICENSE ***************************************
+
+	Portions Copyright (c) 1992-2001 Southern Stars Systems.  All Rights Reserved.
+
+	This file contains Original Code and/or Modifications of Original Code as
+	defined in and that are subject to the Southern Stars Systems Public Source
+	License Version 1.0 (the 'License').  You may not use this file except in
+	compliance with the License.  Please obtain a copy of the License at
+
+	http://www.southernstars.com/opensource/
+
+	and read it before using this file.
+
+	The Original Code and all software distributed under the License are distributed
+	on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER EXPRESS OR IMPLIED, AND
+	SOUTHERN STARS SYSTEMS HEREBY DISCLAIMS ALL SUCH WARRANTIES, INCLUDING WITHOUT
+	LIMITATION, ANY WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE,
+	QUIET ENJOYMENT, OR NON-INFRINGEMENT.  Please see the License for the specific
+	language governing rights and limitations under the License.
+
+	MODIFICATION HISTORY:
+
+	1.0.0 - 17 Oct 2026 - Original code: automatic star matching between images.
+
+****************************************************************************************/
+
+#include "SkySight.h"
+
+/*** local constants ***/
+
+#define MATCH_STARS				40		/*** number of brightest objects used to form triangles ***/
+#define MATCH_NEIGHBORS			6		/*** number of nearest neighbors each triangle is formed from ***/
+#define MATCH_MIN_SIDE			5.0		/*** shortest allowed triangle side, in pixels ***/
+#define MATCH_MIN_RATIO			0.1		/*** smallest allowed ratio of shortest to longest side ***/
+#define MATCH_BINS				50		/*** number of bins along each triangle shape axis ***/
+#define MATCH_SHAPE_TOLERANCE	0.02	/*** largest allowed difference in triangle shape ***/
+#define MATCH_TOLERANCE			3.0		/*** largest allowed distance between matched objects, in pixels ***/
+#define MATCH_MIN_TOLERANCE		1.0		/*** smallest distance allowed when pairing up all objects ***/
+#define MATCH_MAX_HYPOTHESES	5000	/*** most triangle pairs tried ***/
+#define MATCH_MIN_INLIERS		4		/*** fewest matches needed to accept a transformation ***/
+
+/*** local data types ***/
+
+/*** A MatchTriangle is a triangle formed from three objects.  Its vertices are
+     ordered so that vertex[0] is opposite the longest side, and vertex[2] is
+     opposite the shortest.  Its shape is given by the ratios of the middle and
+     shortest sides to the longest, which don't change when the triangle is
+     moved, rotated, or scaled. ***/
+
+typedef struct MatchTriangle
+{
+	long	vertex[3];
+	double	u;
+	double	v;
+}
+MatchTriangle;
+
+/*** A MatchTriangleList holds the triangles formed from one image's brightest
+     objects, binned by shape; the triangles in bin i are triangles[ binStart[i] ]
+     through triangles[ binStart[i+1] - 1 ]. ***/
+
+typedef struct MatchTriangleList
+{
+	long			numStars;
+	double			x[MATCH_STARS];
+	double			y[MATCH_STARS];
+	long			numTriangles;
+	MatchTriangle	*triangles;
+	long			binStart[ MATCH_BINS * MATCH_BINS + 1 ];
+}
+MatchTriangleList;
+
+/*** A MatchPair records the object in the second image which FindMatchPairs()
+     paired with its (index)th object in the first, and the squared distance
+     between them after transforming. ***/
+
+typedef struct MatchPair
+{
+	long			index;
+	ImageObjectPtr	object2;
+	double			d2;
+}
+MatchPair;
+
+/*** local functions ***/
+
+static int CompareObjectAmplitudes ( const void *, const void * );
+static int CompareMatchPairs ( const void *, const void * );
+static MatchTriangleList *NewMatchTriangleList ( ImagePtr );
+static long GetMatchTriangleBin ( double, double );
+static int SolveMatchTransform ( double [3][2], double [3][2], double [3][2] );
+static long CountMatchInliers ( MatchTriangleList *, MatchTriangleList *, double [3][2], double * );
+static long FindMatchPairs ( ImagePtr, ImagePtr, double [3][2], double, ImageObjectPtr *, ImageObjectPtr * );
+static long FindMatchTransform ( MatchTriangleList *, MatchTriangleList *, double [3][2], double * );
+static void DeleteMatchTriangleList ( MatchTriangleList * );
+
+/*** CompareObjectAmplitudes ***/
+
+static int CompareObjectAmplitudes ( const void *p1, const void *p2 )
+{
+	double a1 = GetImageObjectAmplitude ( *(ImageObjectPtr *) p1 );
+	double a2 = GetImageObjectAmplitude ( *(ImageObjectPtr *) p2 );
+
+	if ( a1 > a2 )
+		return ( -1 );
+	else if ( a1 < a2 )
+		return ( 1 );
+	else
+		return ( 0 );
+}
+
+/*** CompareMatchPairs ***/
+
+static int CompareMatchPairs ( const void *p1, const void *p2 )
+{
+	MatchPair *pair1 = (MatchPair *) p1;
+	MatchPair *pair2 = (MatchPair *) p2;
+
+	if ( pair1->object2 != pair2->object2 )
+		return ( pair1->object2 < pair2->object2 ? -1 : 1 );
+	else if ( pair1->d2 != pair2->d2 )
+		return ( pair1->d2 < pair2->d2 ? -1 : 1 );
+	else
+		return ( pair1->index < pair2->index ? -1 : 1 );
+}
+
+/*** GetMatchTriangleBin ***/
+
+static long GetMatchTriangleBin ( double u, double v )
+{
+	long	i = u * MATCH_BINS, j = v * MATCH_BINS;
+
+	if ( i >= MATCH_BINS )
+		i = MATCH_BINS - 1;
+
+	if ( j >= MATCH_BINS )
+		j = MATCH_BINS - 1;
+
+	return ( i * MATCH_BINS + j );
+}
+
+/*** NewMatchTriangleList ***********************************************************
+
+	Finds an image's brightest objects, forms triangles from each of them and
+	pairs of its nearest neighbors, and bins the triangles by shape.  Returns
+	a pointer to the list, or NULL if it can't allocate memory.  When you're
+	done with the list, pass it to DeleteMatchTriangleList().
+
+*************************************************************************************/
+
+static MatchTriangleList *NewMatchTriangleList ( ImagePtr image )
+{
+	long				i, j, k, n, t, bin, numObjects, near[MATCH_NEIGHBORS], vertex;
+	double				d2[MATCH_NEIGHBORS], dx, dy, d, side[3], temp;
+	ImageObjectPtr		*objects, object;
+	MatchTriangle		triangle, *triangles;
+	MatchTriangleList	*list;
+
+	list = (MatchTriangleList *) calloc ( 1, sizeof ( MatchTriangleList ) );
+	if ( list == NULL )
+		return ( NULL );
+
+	/*** Sort the image's objects by amplitude, and keep the brightest. ***/
+
+	numObjects = GetImageObjectCount ( image );
+	objects = (ImageObjectPtr *) malloc ( ( numObjects + 1 ) * sizeof ( ImageObjectPtr ) );
+	if ( objects == NULL )
+	{
+		DeleteMatchTriangleList ( list );
+		return ( NULL );
+	}
+
+	for ( n = 0, object = GetImageObjectList ( image ); object != NULL && n < numObjects; object = GetNextImageObject ( object ) )
+		objects[n++] = object;
+
+	qsort ( objects, n, sizeof ( ImageObjectPtr ), CompareObjectAmplitudes );
+
+	if ( n > MATCH_STARS )
+		n = MATCH_STARS;
+
+	for ( i = 0; i < n; i++ )
+	{
+		list->x[i] = GetImageObjectCentroidX ( objects[i] );
+		list->y[i] = GetImageObjectCentroidY ( objects[i] );
+	}
+
+	list->numStars = n;
+	free ( objects );
+
+	triangles = (MatchTriangle *) malloc ( ( n * MATCH_NEIGHBORS * ( MATCH_NEIGHBORS - 1 ) / 2 + 1 ) * sizeof ( MatchTriangle ) );
+	if ( triangles == NULL )
+	{
+		DeleteMatchTriangleList ( list );
+		return ( NULL );
+	}
+
+	for ( i = 0; i < n; i++ )
+	{
+		/*** Find this star's nearest neighbors, by insertion into a short
+		     list sorted by distance. ***/
+
+		for ( k = 0; k < MATCH_NEIGHBORS; k++ )
+		{
+			near[k] = -1;
+			d2[k] = HUGE_VAL;
+		}
+
+		for ( j = 0; j < n; j++ )
+		{
+			if ( j == i )
+				continue;
+
+			dx = list->x[j] - list->x[i];
+			dy = list->y[j] - list->y[i];
+			d = dx * dx + dy * dy;
+
+			for ( k = MATCH_NEIGHBORS - 1; k >= 0 && d < d2[k]; k-- )
+			{
+				if ( k < MATCH_NEIGHBORS - 1 )
+				{
+					near[k + 1] = near[k];
+					d2[k + 1] = d2[k];
+				}
+
+				near[k] = j;
+				d2[k] = d;
+			}
+		}
+
+		/*** Form a triangle from this star and each pair of its neighbors. ***/
+
+		for ( j = 0; j < MATCH_NEIGHBORS && near[j] >= 0; j++ )
+		{
+			for ( k = j + 1; k < MATCH_NEIGHBORS && near[k] >= 0; k++ )
+			{
+				triangle.vertex[0] = i;
+				triangle.vertex[1] = near[j];
+				triangle.vertex[2] = near[k];
+
+				/*** Compute the length of the side opposite each vertex, then
+				     sort the vertices by decreasing opposite side length. ***/
+
+				for ( t = 0; t < 3; t++ )
+				{
+					dx = list->x[ triangle.vertex[ ( t + 1 ) % 3 ] ] - list->x[ triangle.vertex[ ( t + 2 ) % 3 ] ];
+					dy = list->y[ triangle.vertex[ ( t + 1 ) % 3 ] ] - list->y[ triangle.vertex[ ( t + 2 ) % 3 ] ];
+					side[t] = sqrt ( dx * dx + dy * dy );
+				}
+
+				for ( t = 0; t < 2; t++ )
+				{
+					for ( bin = 2; bin > t; bin-- )
+					{
+						if ( side[bin] > side[bin - 1] )
+						{
+							temp = side[bin];
+							side[bin] = side[bin - 1];
+							side[bin - 1] = temp;
+
+							vertex = triangle.vertex[bin];
+							triangle.vertex[bin] = triangle.vertex[bin - 1];
+							triangle.vertex[bin - 1] = vertex;
+						}
+					}
+				}
+
+				/*** Skip triangles which are too small or too thin to have a
+				     well-defined shape. ***/
+
+				if ( side[2] < MATCH_MIN_SIDE || side[2] < MATCH_MIN_RATIO * side[0] )
+					continue;
+
+				triangle.u = side[1] / side[0];
+				triangle.v = side[2] / side[0];
+
+				triangles[ list->numTriangles++ ] = triangle;
+			}
+		}
+	}
+
+	/*** Bin the triangles by shape: count the triangles in each bin, convert
+	     the counts to the end of each bin's run, then fill each run from its
+	     end, leaving the start of each bin's run where its end was. ***/
+
+	list->triangles = (MatchTriangle *) malloc ( ( list->numTriangles + 1 ) * sizeof ( MatchTriangle ) );
+	if ( list->triangles == NULL )
+	{
+		free ( triangles );
+		DeleteMatchTriangleList ( list );
+		return ( NULL );
+	}
+
+	for ( t = 0; t < list->numTriangles; t++ )
+		list->binStart[ GetMatchTriangleBin ( triangles[t].u, triangles[t].v ) + 1 ]++;
+
+	for ( bin = 0; bin < MATCH_BINS * MATCH_BINS; bin++ )
+		list->binStart[ bin + 1 ] += list->binStart[ bin ];
+
+	for ( t = list->numTriangles - 1; t >= 0; t-- )
+	{
+		bin = GetMatchTriangleBin ( triangles[t].u, triangles[t].v );
+		list->triangles[ --list->binStart[ bin + 1 ] ] = triangles[t];
+	}
+
+	for ( bin = 0; bin < MATCH_BINS * MATCH_BINS; bin++ )
+		list->binStart[ bin ] = list->binStart[ bin + 1 ];
+
+	list->binStart[ MATCH_BINS * MATCH_BINS ] = list->numTriangles;
+
+	free ( triangles );
+	return ( list );
+}
+
+/*** DeleteMatchTriangleList ***/
+
+static void DeleteMatchTriangleList ( MatchTriangleList *list )
+{
+	if ( list->triangles != NULL )
+		free ( list->triangles );
+
+	free ( list );
+}
+
+/*** SolveMatchTransform ************************************************************
+
+	Finds the affine transformation which takes three points (p1) to three
+	others (p2), in the form of the 3-by-2 matrix (b) such that
+	x2 = x1 * b[0][0] + y1 * b[1][0] + b[2][0], and similarly for y2 with
+	b[0][1], b[1][1], b[2][1].  Returns FALSE if the first three points are
+	collinear.
+
+*************************************************************************************/
+
+static int SolveMatchTransform ( double p1[3][2], double p2[3][2], double b[3][2] )
+{
+	long	i, j;
+	double	det, x1, y1, x2, y2, inv[3][3];
+
+	x1 = p1[1][0] - p1[0][0];
+	y1 = p1[1][1] - p1[0][1];
+	x2 = p1[2][0] - p1[0][0];
+	y2 = p1[2][1] - p1[0][1];
+
+	det = x1 * y2 - x2 * y1;
+	if ( det == 0.0 )
+		return ( FALSE );
+
+	/*** Invert the matrix whose rows are ( x, y, 1 ) for each of the first
+	     three points, then multiply the second three points by it. ***/
+
+	inv[0][0] = ( p1[1][1] - p1[2][1] ) / det;
+	inv[0][1] = ( p1[2][1] - p1[0][1] ) / det;
+	inv[0][2] = ( p1[0][1] - p1[1][1] ) / det;
+	inv[1][0] = ( p1[2][0] - p1[1][0] ) / det;
+	inv[1][1] = ( p1[0][0] - p1[2][0] ) / det;
+	inv[1][2] = ( p1[1][0] - p1[0][0] ) / det;
+	inv[2][0] = ( p1[1][0] * p1[2][1] - p1[2][0] * p1[1][1] ) / det;
+	inv[2][1] = ( p1[2][0] * p1[0][1] - p1[0][0] * p1[2][1] ) / det;
+	inv[2][2] = ( p1[0][0] * p1[1][1] - p1[1][0] * p1[0][1] ) / det;
+
+	for ( i = 0; i < 3; i++ )
+		for ( j = 0; j < 2; j++ )
+			b[i][j] = inv[i][0] * p2[0][j] + inv[i][1] * p2[1][j] + inv[i][2] * p2[2][j];
+
+	return ( TRUE );
+}
+
+/*** CountMatchInliers **************************************************************
+
+	Counts the bright stars in the first triangle list which a transformation
+	takes to within the match tolerance of a bright star in the second, and
+	returns the sum of the squares of their distances in (sumSquares).  Only
+	bright stars are compared, so that chance coincidences with the many faint
+	objects in a crowded field don't count as matches.
+
+*************************************************************************************/
+
+static long CountMatchInliers ( MatchTriangleList *list1, MatchTriangleList *list2, double b[3][2], double *sumSquares )
+{
+	long	i, j, n = 0;
+	double	x, y, dx, dy, d2, minD2;
+
+	*sumSquares = 0.0;
+
+	for ( i = 0; i < list1->numStars; i++ )
+	{
+		x = list1->x[i] * b[0][0] + list1->y[i] * b[1][0] + b[2][0];
+		y = list1->x[i] * b[0][1] + list1->y[i] * b[1][1] + b[2][1];
+
+		minD2 = MATCH_TOLERANCE * MATCH_TOLERANCE;
+
+		for ( j = 0; j < list2->numStars; j++ )
+		{
+			dx = list2->x[j] - x;
+			dy = list2->y[j] - y;
+			d2 = dx * dx + dy * dy;
+
+			if ( d2 < minD2 )
+				minD2 = d2;
+		}
+
+		if ( minD2 < MATCH_TOLERANCE * MATCH_TOLERANCE )
+		{
+			*sumSquares += minD2;
+			n++;
+		}
+	}
+
+	return ( n );
+}
+
+/*** FindMatchPairs *****************************************************************
+
+	Pairs each object in the first image with the nearest object in the second
+	image to which a transformation takes it, if there is one within (tolerance).
+	Each object in the second image is paired at most once, with the object
+	that lands nearest it.  The pairs are returned in (objects1) and (objects2),
+	which must have room for as many objects as there are in the first image;
+	the function returns the number of pairs, or -1 if it can't allocate memory.
+
+*************************************************************************************/
+
+static long FindMatchPairs ( ImagePtr image1, ImagePtr image2, double b[3][2], double tolerance,
+ImageObjectPtr *objects1, ImageObjectPtr *objects2 )
+{
+	long			n = 0, i, j;
+	double			x1, y1, x, y, dx, dy;
+	ImageObjectPtr	object1, object2;
+	MatchPair		*pairs;
+
+	pairs = (MatchPair *) malloc ( ( GetImageObjectCount ( image1 ) + 1 ) * sizeof ( MatchPair ) );
+	if ( pairs == NULL )
+		return ( -1 );
+
+	for ( object1 = GetImageObjectList ( image1 ); object1 != NULL; object1 = GetNextImageObject ( object1 ) )
+	{
+		x1 = GetImageObjectCentroidX ( object1 );
+		y1 = GetImageObjectCentroidY ( object1 );
+
+		x = x1 * b[0][0] + y1 * b[1][0] + b[2][0];
+		y = x1 * b[0][1] + y1 * b[1][1] + b[2][1];
+
+		object2 = FindImageObject ( image2, x, y, tolerance );
+		if ( object2 != NULL )
+		{
+			dx = GetImageObjectCentroidX ( object2 ) - x;
+			dy = GetImageObjectCentroidY ( object2 ) - y;
+
+			pairs[n].index = n;
+			pairs[n].object2 = object2;
+			pairs[n].d2 = dx * dx + dy * dy;
+
+			objects1[n] = object1;
+			objects2[n] = object2;
+			n++;
+		}
+	}
+
+	/*** In a crowded field, one object in the second image may be the nearest
+	     to several in the first.  Sort the pairs by their second object, and
+	     then by distance, and drop all but the nearest pair for each. ***/
+
+	qsort ( pairs, n, sizeof ( MatchPair ), CompareMatchPairs );
+
+	for ( i = 1; i < n; i++ )
+		if ( pairs[i].object2 == pairs[i - 1].object2 )
+			objects2[ pairs[i].index ] = NULL;
+
+	free ( pairs );
+
+	for ( i = j = 0; i < n; i++ )
+	{
+		if ( objects2[i] != NULL )
+		{
+			objects1[j] = objects1[i];
+			objects2[j] = objects2[i];
+			j++;
+		}
+	}
+
+	return ( j );
+}
+
+/*** FindMatchTransform ***********************************************************
+
+	Tries the transformation given by each pair of similar triangles in two
+	triangle lists, and returns the one which takes the most of the first
+	list's bright stars onto those of the second in (best).  The function
+	returns the number of stars that transformation matches, and their RMS
+	distance from the stars they match in (rms).
+
+*************************************************************************************/
+
+static long FindMatchTransform ( MatchTriangleList *list1, MatchTriangleList *list2, double best[3][2], double *rms )
+{
+	long			t1, t2, i, j, bin, du, dv, u, v, k, numInliers, bestInliers = 0, numHypotheses = 0;
+	double			p1[3][2], p2[3][2], b[3][2], sumSquares;
+	MatchTriangle	*triangle1, *triangle2;
+
+	*rms = 0.0;
+
+	/*** For each triangle in the first image, look for triangles with similar
+	     shapes in the second, in its own and neighboring shape bins. ***/
+
+	for ( t1 = 0; t1 < list1->numTriangles && numHypotheses < MATCH_MAX_HYPOTHESES; t1++ )
+	{
+		triangle1 = &list1->triangles[t1];
+		bin = GetMatchTriangleBin ( triangle1->u, triangle1->v );
+
+		for ( du = -1; du <= 1; du++ )
+		{
+			for ( dv = -1; dv <= 1; dv++ )
+			{
+				u = bin / MATCH_BINS + du;
+				v = bin % MATCH_BINS + dv;
+
+				if ( u < 0 || u >= MATCH_BINS || v < 0 || v >= MATCH_BINS )
+					continue;
+
+				k = u * MATCH_BINS + v;
+
+				for ( t2 = list2->binStart[k]; t2 < list2->binStart[k + 1]; t2++ )
+				{
+					triangle2 = &list2->triangles[t2];
+
+					if ( fabs ( triangle1->u - triangle2->u ) > MATCH_SHAPE_TOLERANCE
+					||   fabs ( triangle1->v - triangle2->v ) > MATCH_SHAPE_TOLERANCE )
+						continue;
+
+					for ( i = 0; i < 3; i++ )
+					{
+						p1[i][0] = list1->x[ triangle1->vertex[i] ];
+						p1[i][1] = list1->y[ triangle1->vertex[i] ];
+						p2[i][0] = list2->x[ triangle2->vertex[i] ];
+						p2[i][1] = list2->y[ triangle2->vertex[i] ];
+					}
+
+					if ( SolveMatchTransform ( p1, p2, b ) == FALSE )
+						continue;
+
+					numHypotheses++;
+					numInliers = CountMatchInliers ( list1, list2, b, &sumSquares );
+
+					if ( numInliers > bestInliers )
+					{
+						bestInliers = numInliers;
+						*rms = sqrt ( sumSquares / numInliers );
+						for ( i = 0; i < 3; i++ )
+							for ( j = 0; j < 2; j++ )
+								best[i][j] = b[i][j];
+					}
+				}
+			}
+		}
+
+		/*** Stop looking once most of the bright stars have been matched. ***/
+
+		if ( bestInliers >= MATCH_MIN_INLIERS && bestInliers * 5 >= list1->numStars * 4 )
+			break;
+	}
+
+	return ( bestInliers );
+}
+
+/*** MatchImageObjects **************************************************************
+
+	Finds corresponding objects in two images by the patterns they form.
+
+	long MatchImageObjects ( ImagePtr image1, ImagePtr image2,
+	     ImageObjectPtr **objects1, ImageObjectPtr **objects2 )
+
+	(image1): pointer to the first image.
+	(image2): pointer to the second image.
+	(objects1): receives a pointer to an array of matched objects in the first image.
+	(objects2): receives a pointer to an array of the corresponding objects in the second.
+
+	The function returns the number of matched pairs of objects, or zero if it
+	can't find a consistent match (or -1 if it can't allocate memory).  If it
+	finds any pairs, (*objects1)[i] and (*objects2)[i] are the i-th pair; when
+	you're done with the arrays, free() them both.
+
+	The function works with the objects already in the images' object lists,
+	such as those found by FindImageWindowImageObjects(); it ignores their names.
+	It forms triangles from each of the brightest objects in each image and
+	pairs of that object's nearest neighbors.  The shape of a triangle doesn't
+	change when the image is shifted, rotated, or scaled, so triangles with the
+	same shape in both images are likely to be formed from the same stars.
+	Each such pair of triangles gives a trial transformation between the images
+	(the RANSAC method); the one which takes the most of the first image's
+	bright stars onto bright stars in the second image wins.  Finally, all of
+	the objects in the first image which the winning transformation takes close
+	to an object in the second are paired up, and the pairing is repeated with
+	a least-squares fit to those pairs.  "Close" here means within three times
+	the bright stars' RMS match distance, but no less than MATCH_MIN_TOLERANCE
+	and no more than MATCH_TOLERANCE pixels; in crowded fields, this keeps
+	down the number of chance pairings with unrelated faint objects.
+
+	Apart from sorting the objects by brightness, the work done depends only on
+	the number of bright stars used, not the total number of objects, except
+	for the final pairing, which uses the second image's spatial index.
+
+*************************************************************************************/
+
+long MatchImageObjects ( ImagePtr image1, ImagePtr image2, ImageObjectPtr **objects1, ImageObjectPtr **objects2 )
+{
+	long				i, j, n = 0;
+	double				best[3][2], **a = NULL, **c = NULL, x1[3], x2[2], rms, tolerance;
+	MatchTriangleList	*list1 = NULL, *list2 = NULL;
+
+	*objects1 = NULL;
+	*objects2 = NULL;
+
+	if ( GetImageObjectCount ( image1 ) < MATCH_MIN_INLIERS || GetImageObjectCount ( image2 ) < MATCH_MIN_INLIERS )
+		return ( 0 );
+
+	/*** Find the best trial transformation. ***/
+
+	list1 = NewMatchTriangleList ( image1 );
+	list2 = NewMatchTriangleList ( image2 );
+
+	if ( list1 == NULL || list2 == NULL )
+		n = -1;
+	else if ( FindMatchTransform ( list1, list2, best, &rms ) >= MATCH_MIN_INLIERS )
+		n = 1;
+
+	if ( list1 != NULL )
+		DeleteMatchTriangleList ( list1 );
+
+	if ( list2 != NULL )
+		DeleteMatchTriangleList ( list2 );
+
+	if ( n <= 0 )
+		return ( n );
+
+	tolerance = 3.0 * rms;
+	if ( tolerance < MATCH_MIN_TOLERANCE )
+		tolerance = MATCH_MIN_TOLERANCE;
+
+	if ( tolerance > MATCH_TOLERANCE )
+		tolerance = MATCH_TOLERANCE;
+
+	/*** Pair up all of the objects, using the best trial transformation.
+	     Then refine the transformation with a least-squares fit to all of
+	     the pairs, and pair the objects up again. ***/
+
+	*objects1 = (ImageObjectPtr *) malloc ( ( GetImageObjectCount ( image1 ) + 1 ) * sizeof ( ImageObjectPtr ) );
+	*objects2 = (ImageObjectPtr *) malloc ( ( GetImageObjectCount ( image1 ) + 1 ) * sizeof ( ImageObjectPtr ) );
+
+	if ( *objects1 != NULL && *objects2 != NULL )
+	{
+		n = FindMatchPairs ( image1, image2, best, tolerance, *objects1, *objects2 );
+
+		if ( n >= 3 && NCreateNormalEqns ( 3, 2, &a, &c ) )
+		{
+			for ( i = 0; i < n; i++ )
+			{
+				x1[0] = GetImageObjectCentroidX ( (*objects1)[i] );
+				x1[1] = GetImageObjectCentroidY ( (*objects1)[i] );
+				x1[2] = 1.0;
+
+				x2[0] = GetImageObjectCentroidX ( (*objects2)[i] );
+				x2[1] = GetImageObjectCentroidY ( (*objects2)[i] );
+
+				NAugmentNormalEqns ( 3, 2, x1, x2, a, c );
+			}
+
+			if ( NGaussJordanSolveMatrixEqn ( a, 3, c, 2 ) )
+			{
+				for ( i = 0; i < 3; i++ )
+					for ( j = 0; j < 2; j++ )
+						best[i][j] = c[i][j];
+
+				n = FindMatchPairs ( image1, image2, best, tolerance, *objects1, *objects2 );
+			}
+
+			NDestroyMatrix ( a );
+			NDestroyMatrix ( c );
+		}
+
+		if ( n >= 0 && n < MATCH_MIN_INLIERS )
+			n = 0;
+	}
+	else
+	{
+		n = -1;
+	}
+
+	if ( n <= 0 )
+	{
+		if ( *objects1 != NULL )
+			free ( *objects1 );
+
+		if ( *objects2 != NULL )
+			free ( *objects2 );
+
+		*objects1 = NULL;
+		*objects2 = NULL;
+	}
+
+	return ( n );
+}
@@ -30,6 +30,54 @@
 
 #include "SkySight.h"
 
+/*** local data types ***/
+
+/*** ImageModelFit holds the workspace for fitting a model to image data.
+     Each fit (or each thread fitting several models, one after another)
+     needs its own, so that fits can run at the same time. ***/
+
+struct ImageModelFit
+{
+	short	numParams;
+	PIXEL	min;
+	PIXEL	max;
+	double	**alpha;
+	double	*beta;
+	double	**trialAlpha;
+	double	*trialBeta;
+	double	**covariances;
+	double	**improvements;
+	double	*trialParameters;
+	double	*derivatives;
+	short	rowCols;
+	double	*rowDiffs;
+	double	**rowDerivatives;
+};
+
+/*** FitImageObjectsJob holds the parameters which FitImageObjects() shares with
+     its parallel tasks. ***/
+
+typedef struct FitImageObjectsJob
+{
+	PIXEL				**matrix;
+	ImageObjectPtr		*objects;
+	long				numObjects;
+	long				numTasks;
+	ImageModelFitPtr	*fits;
+	double				tolerance;
+	short				maxIterations;
+	long				*numFitted;
+}
+FitImageObjectsJob, *FitImageObjectsJobPtr;
+
+/*** local functions ***/
+
+static double ComputeImageModelCurvature ( ImageModelFitPtr, PIXEL **, ImageRegionPtr, ImageModelFunctionPtr, double *, double **, double * );
+static ImageModelRowFunctionPtr GetImageModelRowFunction ( ImageModelFunctionPtr );
+static int SetImageModelFitRowSize ( ImageModelFitPtr, short );
+static double SumImageModelRowProducts ( double *, double *, long );
+static void FitImageObjectsTask ( void *, long );
+
 /*** CreateImageObject ********************************************************/
 
 ImageObjectPtr CreateImageObject ( ImagePtr image, double x, double y, double sigma )
@@ -304,24 +352,151 @@ void GaussianSurface ( short x, short y, double terms[] )
 	terms[1] = exp ( - ( dx * dx + dy * dy ) / r2 );
 }
 
+/*** NewImageModelFit ***************************************************************
+
+	Allocates the workspace for fitting a model to image data.
+	
+	ImageModelFitPtr NewImageModelFit ( short numParams, PIXEL min, PIXEL max )
+	
+	(numParams): number of parameters in the model.
+	(min):       image data values below this are ignored.
+	(max):       image data values above this are ignored.
+	
+	The function returns a pointer to the workspace, or NULL on failure.  A
+	workspace may be used for any number of fits, one after another, of models
+	with (numParams) parameters; use a separate workspace for each fit which
+	runs at the same time as others.  When you're done with it, pass it to
+	DeleteImageModelFit().
+	
+*************************************************************************************/
+
+ImageModelFitPtr NewImageModelFit ( short numParams, PIXEL min, PIXEL max )
+{
+	ImageModelFitPtr	fit;
+	
+	fit = (ImageModelFitPtr) malloc ( sizeof ( struct ImageModelFit ) );
+	if ( fit == NULL )
+		return ( NULL );
+		
+	fit->numParams = numParams;
+	fit->min = min;
+	fit->max = max;
+	fit->alpha = NMatrix ( double, numParams, numParams );
+	fit->beta = NVector ( double, numParams );
+	fit->trialAlpha = NMatrix ( double, numParams, numParams );
+	fit->trialBeta = NVector ( double, numParams );
+	fit->covariances = NMatrix ( double, numParams, numParams );
+	fit->improvements = NMatrix ( double, numParams, 1 );
+	fit->trialParameters = NVector ( double, numParams );
+	fit->derivatives = NVector ( double, numParams );
+	fit->rowCols = 0;
+	fit->rowDiffs = NULL;
+	fit->rowDerivatives = NULL;
+	
+	if ( fit->alpha == NULL || fit->beta == NULL || fit->trialAlpha == NULL || fit->trialBeta == NULL
+	|| fit->covariances == NULL || fit->improvements == NULL || fit->trialParameters == NULL || fit->derivatives == NULL )
+	{
+		DeleteImageModelFit ( fit );
+		return ( NULL );
+	}
+	
+	return ( fit );
+}
+
+/*** DeleteImageModelFit ************************************************************
+
+	Frees a model-fitting workspace allocated by NewImageModelFit().
+	
+*************************************************************************************/
+
+void DeleteImageModelFit ( ImageModelFitPtr fit )
+{
+	if ( fit->alpha != NULL )
+		NDestroyMatrix ( fit->alpha );
+		
+	if ( fit->beta != NULL )
+		NDestroyVector ( fit->beta );
+		
+	if ( fit->trialAlpha != NULL )
+		NDestroyMatrix ( fit->trialAlpha );
+		
+	if ( fit->trialBeta != NULL )
+		NDestroyVector ( fit->trialBeta );
+		
+	if ( fit->covariances != NULL )
+		NDestroyMatrix ( fit->covariances );
+		
+	if ( fit->improvements != NULL )
+		NDestroyMatrix ( fit->improvements );
+		
+	if ( fit->trialParameters != NULL )
+		NDestroyVector ( fit->trialParameters );
+		
+	if ( fit->derivatives != NULL )
+		NDestroyVector ( fit->derivatives );
+		
+	SetImageModelFitRowSize ( fit, 0 );
+	free ( fit );
+}
+
 /***************************  FitImageModel  ************************************/
 
 int FitImageModel ( PIXEL **matrix, ImageRegionPtr region, PIXEL min, PIXEL max,
 ImageModelFunctionPtr model, short numParams, double params[], double errors[],
 double tolerance, short maxIterations )
+{
+	int					result = FALSE;
+	ImageModelFitPtr	fit;
+	
+	fit = NewImageModelFit ( numParams, min, max );
+	if ( fit == NULL )
+		return ( FALSE );
+		
+	result = SolveImageModelFit ( fit, matrix, region, model, params, errors, tolerance, maxIterations );
+
+	DeleteImageModelFit ( fit );
+	return ( result );
+}
+
+/*** SolveImageModelFit *************************************************************
+
+	Fits a model to image data, using a workspace allocated by NewImageModelFit().
+	
+	int SolveImageModelFit ( ImageModelFitPtr fit, PIXEL **matrix, ImageRegionPtr region,
+	    ImageModelFunctionPtr model, double params[], double errors[], double tolerance,
+	    short maxIterations )
+	
+	The arguments are the same as FitImageModel()'s, except that the number of
+	parameters and the range of image data values used come from the workspace.
+	The function returns TRUE if the fit converged within (maxIterations), or FALSE
+	otherwise.  This function keeps all of its working data in (fit), so several
+	fits may run at once on different threads, each with its own workspace.
+	
+*************************************************************************************/
+
+int SolveImageModelFit ( ImageModelFitPtr fit, PIXEL **matrix, ImageRegionPtr region,
+ImageModelFunctionPtr model, double params[], double errors[], double tolerance,
+short maxIterations )
 {
 	int		result = FALSE;
 	long	iteration;
 	double	oldResidual, residual = 0.0, lambda = -1.0;
 	
+	if ( ImproveImageModelFit ( fit, matrix, region, model, params, errors, &lambda, &residual ) == FALSE )
+		return ( FALSE );
+		
 	for ( iteration = 0; iteration < maxIterations; iteration++ )
 	{
 		oldResidual = residual;
 		
-		if ( ImproveImageModelFit ( matrix, region, model, params, errors, numParams, &lambda, &residual ) == FALSE )
+		if ( ImproveImageModelFit ( fit, matrix, region, model, params, errors, &lambda, &residual ) == FALSE )
 			break;
 
-		if ( ( fabs ( residual - oldResidual ) / residual ) < tolerance )
+		/*** A step which increased the residual was rejected, and doesn't tell
+		     us anything about convergence; the fit has converged when a step
+		     which was accepted decreases the residual by only a small fraction. ***/
+		     
+		if ( residual == 0.0 || ( residual < oldResidual && ( oldResidual - residual ) / residual < tolerance ) )
 		{
 			result = TRUE;
 			break;
@@ -329,155 +504,428 @@ double tolerance, short maxIterations )
 	}
 
 	lambda = 0.0;
-	ImproveImageModelFit ( region, matrix, model, params, errors, numParams, &lambda, &residual );
+	ImproveImageModelFit ( fit, matrix, region, model, params, errors, &lambda, &residual );
 	
 	return ( result );
 }
 
-/**********************************  improveFit  ************************************
-
-	Improves a fit of a surface to an image.  The image data used to fit the surface
-	is defined by (box); pixels above (max) and below (min) are ignored.  The
-	surface that gets fit to the image is defined by (function) and the array
-	(parameters).  Given integer (x,y) coordinates and the array of parameters,
-	(function) must return the value of the function at those coordinates AND its
-	first derivative w/ resp. to each to parameter in an array.  (function) must have
-	(numParams) parameters and derivative evaluations.
-		This function uses an adaptation of the Levenberg-Marqhardt method given in
-	"Numerical Recipes in C."  The value in (lambda) is used to keep parameter
-	improvements under control- the larger (lambda) is, the smaller the parameter
-	improvements will be.  The first time you call improveFit(), give your initial
-	guess at the parameters in (parameters) and set (lambda) < 0.  A set of trial
-	parameter improvements and the sum-squared residual will be calculated and
-	returned in (improvements) and (residual); (lambda) is set to 1000.0.
-		On subsequent iterations, the function generates a new set of trial parameters
-	and trial improvements by adding the (improvements) to the (parameters).
-	The residual for the new trial parameters is calculated, and compared to that
-	given in (residual).  If the trial parameters produce a lower residual than the
-	given one, (parameters) are replaced with the trial parameters, (residual)
-	is replaced with the trial residual, and (lambda) divided by 10.  If the fractional
-	decrease in (residual) is less than (tolerance), convergence is assumed and
-	(lambda) is set to zero so errors will be calculated properly.  Otherwise,
-	(lambda) is multiplied by 10, and the parameters and residual are not updated.
-	A new set of improvements are calculated and returned in (improvements).
-	
-		Stop calling improveFit() when the residual decreases by less than a tolerance
-	amount.	 The function returns FALSE if it cannot calculate the trial improvements;
-	otherwise it returns TRUE.
-	
-**************************************************************************************/
+/*** ComputeImageModelCurvature ******************************************************
 
-int ImproveImageModelFit ( PIXEL **matrix, ImageRegionPtr region, ImageModelFunctionPtr model,
-double parameters[], double errors[], short numParams, double *lambda, double *residual )
-{
-	short	i, j, row, col, left, right, result;
-	double	trialResidual, diff;
-
-	static double	**covariances;
-	static double	**improvements;
-	static double	*trialParameters;
-	static double	*derivatives;
-
-	/*** Initialization ***/
+	Computes the sum-squared residual of a model with a given set of parameters,
+	and the curvature matrix (alpha) and gradient vector (beta) used to improve
+	them.  Pixels outside the fit's range of image data values are ignored.
 	
-	if ( *lambda < 0.0 )
-	{	
-		covariances = NMatrix ( double, numParams, numParams );
-		if ( covariances == NULL )
-		{
-			return ( FALSE );
-		}
-		
-		improvements = NMatrix ( double, numParams, 1 );
-		if ( improvements == NULL )
-		{
-			NDestroyMatrix ( covariances );
-			return ( FALSE );
-		}
+	If the model has a row function (see GetImageModelRowFunction()), it is used
+	to evaluate the model and its derivatives for a whole region segment at once,
+	and the sums are then formed from the rows of values; otherwise, the model is
+	called once per pixel.
 	
-		derivatives = NVector ( double, numParams );
-		if ( derivatives == NULL )
-		{
-			NDestroyMatrix ( improvements );
-			NDestroyMatrix ( covariances );
-			return ( FALSE );
-		}
+*************************************************************************************/
+
+static double ComputeImageModelCurvature ( ImageModelFitPtr fit, PIXEL **matrix, ImageRegionPtr region,
+ImageModelFunctionPtr model, double parameters[], double **alpha, double *beta )
+{
+	short						i, j, row, col, left, right, numParams = fit->numParams;
+	long						n;
+	double						residual = 0.0, diff, *derivatives = fit->derivatives, *diffs;
+	PIXEL						value, *data;
+	ImageModelRowFunctionPtr	rowModel = GetImageModelRowFunction ( model );
 	
-		trialParameters = NVector ( double, numParams );
-		if ( trialParameters == NULL )
-		{
-			NDestroyVector ( derivatives );
-			NDestroyMatrix ( improvements );
-			NDestroyMatrix ( covariances );
-			return ( FALSE );
-		}
+	for ( i = 0; i < numParams; i++ )
+	{
+		beta[i] = 0.0;
+		for ( j = 0; j < numParams; j++ )
+			alpha[i][j] = 0.0;
 	}
 	
-	for ( i = 0; i < numParams; i++ )
-		trialParameters[i] = parameters[i] + improvements[i][0];
-
-	trialResidual = 0.0;
 	row = -1;
-	
 	while ( GetImageRegionSegment ( region, &row, &left, &right ) )
 	{
-		for ( col = left; col < right; col++ )
+		n = right - left + 1;
+		
+		if ( rowModel != NULL && ( n <= fit->rowCols || SetImageModelFitRowSize ( fit, right - left + 1 ) ) )
+		{
+			/*** Evaluate the model across the segment, then turn the model values
+			     into residuals.  Pixels outside the data range get zero residual
+			     and zero derivatives, so they drop out of all of the sums. ***/
+			     
+			diffs = fit->rowDiffs;
+			data = matrix[row] + left;
+			
+			(*rowModel) ( left, right, row, parameters, diffs, fit->rowDerivatives );
+			
+			for ( col = 0; col < n; col++ )
+			{
+				value = data[col];
+				if ( value < fit->min || value > fit->max )
+				{
+					diffs[col] = 0.0;
+					for ( i = 0; i < numParams; i++ )
+						fit->rowDerivatives[i][col] = 0.0;
+				}
+				else
+				{
+					diffs[col] = value - diffs[col];
+				}
+			}
+			
+			residual += SumImageModelRowProducts ( diffs, diffs, n );
+			
+			for ( i = 0; i < numParams; i++ )
+			{
+				for ( j = 0; j <= i; j++ )
+					alpha[i][j] += SumImageModelRowProducts ( fit->rowDerivatives[i], fit->rowDerivatives[j], n );
+					
+				beta[i] += SumImageModelRowProducts ( diffs, fit->rowDerivatives[i], n );
+			}
+			
+			continue;
+		}
+		
+		for ( col = left; col <= right; col++ )
 		{
-			diff = (*model) ( col, row, trialParameters, derivatives );
-			diff = matrix[row][col] - diff;
-			trialResidual += diff * diff;
+			value = matrix[row][col];
+			if ( value < fit->min || value > fit->max )
+				continue;
+				
+			diff = value - (*model) ( col, row, parameters, derivatives );
+			residual += diff * diff;
 			
 			for ( i = 0; i < numParams; i++ )
 			{
-				for ( j = 0; j < numParams; j++ )
-					covariances[i][j] += derivatives[i] * derivatives[j];
+				for ( j = 0; j <= i; j++ )
+					alpha[i][j] += derivatives[i] * derivatives[j];
 					
-				improvements[i][0] += diff * derivatives[i];
+				beta[i] += diff * derivatives[i];
 			}
 		}
-	}	
+	}
+	
+	for ( i = 0; i < numParams; i++ )
+		for ( j = 0; j < i; j++ )
+			alpha[j][i] = alpha[i][j];
+	
+	return ( residual );
+}
+
+/*** GetImageModelRowFunction ***/
+
+static ImageModelRowFunctionPtr GetImageModelRowFunction ( ImageModelFunctionPtr model )
+{
+	if ( model == GaussianStarModel )
+		return ( GaussianStarModelRow );
+		
+	return ( NULL );
+}
 
+/*** SetImageModelFitRowSize ********************************************************
+
+	Reallocates a model-fitting workspace's row buffers to hold (cols) values;
+	if (cols) is zero, they are just freed.  Returns TRUE if successful, or
+	FALSE on failure, in which case the workspace is left with no row buffers.
+	
+*************************************************************************************/
+
+static int SetImageModelFitRowSize ( ImageModelFitPtr fit, short cols )
+{
+	if ( fit->rowDiffs != NULL )
+		NDestroyVector ( fit->rowDiffs );
+		
+	if ( fit->rowDerivatives != NULL )
+		NDestroyMatrix ( fit->rowDerivatives );
+		
+	fit->rowCols = 0;
+	fit->rowDiffs = NULL;
+	fit->rowDerivatives = NULL;
+	
+	if ( cols < 1 )
+		return ( TRUE );
+		
+	fit->rowDiffs = NVector ( double, cols );
+	fit->rowDerivatives = NMatrix ( double, fit->numParams, cols );
+	
+	if ( fit->rowDiffs == NULL || fit->rowDerivatives == NULL )
+	{
+		SetImageModelFitRowSize ( fit, 0 );
+		return ( FALSE );
+	}
+	
+	fit->rowCols = cols;
+	return ( TRUE );
+}
+
+/*** SumImageModelRowProducts *******************************************************
+
+	Returns the sum of the products of corresponding elements of two rows of
+	(n) values.  The SSE2 version works on four values at a time, in two sets
+	of partial sums, so its result may differ from the scalar sum's in the
+	last bits.
+	
+*************************************************************************************/
+
+static double SumImageModelRowProducts ( double *a, double *b, long n )
+{
+	long	i = 0;
+	double	sum = 0.0;
+#if SSE2
+	__m128d	lo = _mm_setzero_pd(), hi = _mm_setzero_pd();
+	double	sums[2];
+	
+	for ( ; i + 4 <= n; i += 4 )
+	{
+		lo = _mm_add_pd ( lo, _mm_mul_pd ( _mm_loadu_pd ( a + i ), _mm_loadu_pd ( b + i ) ) );
+		hi = _mm_add_pd ( hi, _mm_mul_pd ( _mm_loadu_pd ( a + i + 2 ), _mm_loadu_pd ( b + i + 2 ) ) );
+	}
+	
+	_mm_storeu_pd ( sums, _mm_add_pd ( lo, hi ) );
+	sum = sums[0] + sums[1];
+#endif
+
+	for ( ; i < n; i++ )
+		sum += a[i] * b[i];
+		
+	return ( sum );
+}
+
+/**********************************  ImproveImageModelFit  **************************
+
+	Improves a fit of a model to an image.  The image data used to fit the model
+	is defined by (region); pixels above and below the workspace (fit)'s maximum
+	and minimum values are ignored.  The model that gets fit to the image is defined
+	by (model) and the array (parameters).  Given integer (x,y) coordinates and the
+	array of parameters, (model) must return the value of the function at those
+	coordinates AND its first derivative w/ resp. to each to parameter in an array.
+	(model) must have as many parameters and derivative evaluations as (fit).
+	
+		This function uses the Levenberg-Marquardt method given in "Numerical Recipes
+	in C."  The value in (lambda) is used to keep parameter improvements under
+	control- the larger (lambda) is, the smaller the parameter improvements will be.
+	The first time you call ImproveImageModelFit(), give your initial guess at the
+	parameters in (parameters) and set (lambda) < 0.  The sum-squared residual for
+	those parameters is returned in (residual), and (lambda) is set to 0.001.
+	
+		On subsequent calls, the function computes a trial improvement to the
+	parameters, and the residual for the improved parameters.  If the trial
+	parameters produce a lower residual than the one given in (residual),
+	(parameters) are replaced with the trial parameters, (residual) is replaced
+	with the trial residual, and (lambda) is divided by 10.  Otherwise, (lambda) is
+	multiplied by 10, and the parameters and residual are not updated.
+	
+		Stop calling ImproveImageModelFit() when the residual decreases by less than
+	a tolerance amount.  Then call it once more with (lambda) set to zero; this
+	leaves the parameters alone, and returns their formal errors in (errors).
+	The function returns FALSE if it cannot calculate the trial improvements;
+	otherwise it returns TRUE.
+	
+		All of the function's working data is kept in (fit), which must have been
+	allocated with NewImageModelFit(), and must not be used by two calls at once.
+	
+**************************************************************************************/
+
+int ImproveImageModelFit ( ImageModelFitPtr fit, PIXEL **matrix, ImageRegionPtr region,
+ImageModelFunctionPtr model, double parameters[], double errors[], double *lambda, double *residual )
+{
+	short	i, j, numParams = fit->numParams;
+	double	trialResidual, **temp, *tempVector;
+
+	/*** Initialization: compute the residual, curvature matrix and gradient
+	     for the initial parameters. ***/
+	
 	if ( *lambda < 0.0 )
+	{	
+		*residual = ComputeImageModelCurvature ( fit, matrix, region, model, parameters, fit->alpha, fit->beta );
+		*lambda = 0.001;
+	}
+	
+	/*** Solve the normal equations, with the diagonal of the curvature matrix
+	     scaled up by the factor ( 1 + lambda ), for the parameter improvements.
+	     With lambda zero, the inverted curvature matrix gives the parameters'
+	     covariances, from which we obtain their errors. ***/
+	     
+	for ( i = 0; i < numParams; i++ )
+	{
+		for ( j = 0; j < numParams; j++ )
+			fit->covariances[i][j] = fit->alpha[i][j];
+
+		fit->covariances[i][i] *= 1.0 + *lambda;
+		fit->improvements[i][0] = fit->beta[i];
+	}
+	
+	if ( NGaussJordanSolveMatrixEqn ( fit->covariances, numParams, fit->improvements, 1 ) == FALSE )
+		return ( FALSE );
+		
+	for ( i = 0; i < numParams; i++ )
+		errors[i] = sqrt ( fabs ( fit->covariances[i][i] ) );
+
+	if ( *lambda == 0.0 )
+		return ( TRUE );
+		
+	/*** Compute the residual for the trial parameters.  If it's lower, accept
+	     them, and keep the curvature matrix and gradient we computed for them;
+	     otherwise, try again next time with a smaller step. ***/
+	     
+	for ( i = 0; i < numParams; i++ )
+		fit->trialParameters[i] = parameters[i] + fit->improvements[i][0];
+
+	trialResidual = ComputeImageModelCurvature ( fit, matrix, region, model, fit->trialParameters, fit->trialAlpha, fit->trialBeta );
+
+	if ( trialResidual < *residual )
 	{
-		*lambda = 1000.0;
+		for ( i = 0; i < numParams; i++ )
+			parameters[i] = fit->trialParameters[i];
+			
+		temp = fit->alpha;
+		fit->alpha = fit->trialAlpha;
+		fit->trialAlpha = temp;
+		
+		tempVector = fit->beta;
+		fit->beta = fit->trialBeta;
+		fit->trialBeta = tempVector;
+		
+		*lambda /= 10.0;
 		*residual = trialResidual;
 	}
 	else
 	{
-		if ( trialResidual <= *residual )
+		*lambda *= 10.0;
+	}
+	
+	return ( TRUE );
+}
+
+/*** FitImageObjects ****************************************************************
+
+	Fits the Gaussian star model to a list of image objects, in parallel.
+	
+	long FitImageObjects ( PIXEL **matrix, ImageObjectPtr objects[], long numObjects,
+	     PIXEL min, PIXEL max, double tolerance, short maxIterations )
+	
+	(matrix):        image data matrix.
+	(objects):       array of pointers to image objects to fit.
+	(numObjects):    number of objects in the array.
+	(min):           image data values below this are ignored.
+	(max):           image data values above this are ignored.
+	(tolerance):     fractional decrease in the residual at which a fit has converged.
+	(maxIterations): most iterations allowed for each fit.
+	
+	The function returns the number of objects whose fits converged, or -1 if it
+	can't allocate memory.  Each object's current background, amplitude, centroid
+	and radius are the starting point for its fit; each object whose fit converges
+	is given the fitted values and their errors, and the others are left alone.
+	
+	The fits are shared among all of the system's processors, each of which works
+	through its share of the objects using one workspace allocated beforehand.
+	The objects must not overlap each other in memory, i.e. no object may appear
+	in the array twice.
+	
+*************************************************************************************/
+
+long FitImageObjects ( PIXEL **matrix, ImageObjectPtr objects[], long numObjects,
+PIXEL min, PIXEL max, double tolerance, short maxIterations )
+{
+	FitImageObjectsJob	job;
+	long				task, numFitted = 0;
+	
+	job.matrix = matrix;
+	job.objects = objects;
+	job.numObjects = numObjects;
+	job.tolerance = tolerance;
+	job.maxIterations = maxIterations;
+	
+	job.numTasks = GGetProcessorCount();
+	if ( job.numTasks > numObjects )
+		job.numTasks = numObjects;
+		
+	if ( job.numTasks < 1 )
+		return ( 0 );
+		
+	/*** Allocate one workspace, and one counter of converged fits, per task. ***/
+	
+	job.fits = (ImageModelFitPtr *) calloc ( job.numTasks, sizeof ( ImageModelFitPtr ) );
+	job.numFitted = (long *) calloc ( job.numTasks, sizeof ( long ) );
+	
+	if ( job.fits != NULL && job.numFitted != NULL )
+	{
+		for ( task = 0; task < job.numTasks; task++ )
 		{
-			for ( i = 0; i < numParams; i++ )
-				parameters[i] = trialParameters[i];
-				
-			*lambda /= 10.0;
-			*residual = trialResidual;
+			job.fits[task] = NewImageModelFit ( 5, min, max );
+			if ( job.fits[task] == NULL )
+				break;
 		}
-		
-		if ( trialResidual > *residual )
+			
+		if ( task == job.numTasks )
+		{
+			GDoParallelTasks ( FitImageObjectsTask, &job, job.numTasks );
+			
+			for ( task = 0; task < job.numTasks; task++ )
+				numFitted += job.numFitted[task];
+		}
+		else
 		{
-			*lambda *= 10.0;
+			numFitted = -1;
 		}
+		
+		for ( task = 0; task < job.numTasks; task++ )
+			if ( job.fits[task] != NULL )
+				DeleteImageModelFit ( job.fits[task] );
 	}
-	
-	for ( i = 0; i < numParams; i++ )
-		covariances[i][i] *= 1.0 + *lambda;
-	
-	result = NGaussJordanSolveMatrixEqn ( covariances, numParams, improvements, 1 );
-	if ( result )	
+	else
 	{
-		for ( i = 0; i < numParams; i++ )
-			errors[i] = sqrt ( covariances[i][i] );
+		numFitted = -1;
 	}
+	
+	if ( job.fits != NULL )
+		free ( job.fits );
+		
+	if ( job.numFitted != NULL )
+		free ( job.numFitted );
+		
+	return ( numFitted );
+}
 
-	if ( *lambda == 0.0 )
-	{	
-		NDestroyMatrix ( covariances );
-		NDestroyMatrix ( improvements );
-		NDestroyVector ( trialParameters );
-		NDestroyVector ( derivatives );
-	}
+/*** FitImageObjectsTask ************************************************************
+
+	Performs one of FitImageObjects()'s parallel tasks.  The objects are dealt out
+	to the tasks in turn, so that each task gets a similar mix of large and small
+	objects.
 	
-	return ( result );
+*************************************************************************************/
+
+static void FitImageObjectsTask ( void *data, long task )
+{
+	FitImageObjectsJobPtr	job = (FitImageObjectsJobPtr) data;
+	ImageObjectPtr			object;
+	double					params[5], errors[5];
+	long					i;
+	
+	for ( i = task; i < job->numObjects; i += job->numTasks )
+	{
+		object = job->objects[i];
+		
+		params[0] = GetImageObjectBackground ( object );
+		params[1] = GetImageObjectAmplitude ( object );
+		params[2] = GetImageObjectCentroidX ( object );
+		params[3] = GetImageObjectCentroidY ( object );
+		params[4] = GetImageObjectRadius ( object );
+		
+		if ( SolveImageModelFit ( job->fits[task], job->matrix, object, GaussianStarModel,
+		     params, errors, job->tolerance, job->maxIterations ) )
+		{
+			SetImageObjectBackground ( object, params[0] );
+			SetImageObjectAmplitude ( object, params[1] );
+			SetImageObjectCentroidX ( object, params[2] );
+			SetImageObjectCentroidY ( object, params[3] );
+			SetImageObjectRadius ( object, params[4] );
+			
+			SetImageRegionError ( object, IMAGE_REGION_PARAM_BACKGROUND, errors[0] );
+			SetImageRegionError ( object, IMAGE_REGION_PARAM_AMPLITUDE, errors[1] );
+			SetImageRegionError ( object, IMAGE_REGION_PARAM_CENTROID_X, errors[2] );
+			SetImageRegionError ( object, IMAGE_REGION_PARAM_CENTROID_Y, errors[3] );
+			SetImageRegionError ( object, IMAGE_REGION_PARAM_RADIUS, errors[4] );
+			
+			job->numFitted[task]++;
+		}
+	}
 }
 
 /***********************************  singleGaussian  ********************************
@@ -507,3 +955,90 @@ double GaussianStarModel ( short x, short y, double parameters[5], double deriva
 	return ( parameters[1] * exp1 + parameters[0] );
 }
 
+/*** GaussianStarModelRow ***********************************************************
+
+	Evaluates the 2D gaussian defined in (parameters), and its first derivatives
+	w/ respect to each parameter, at each pixel in row (y) from column (left) to
+	(right) inclusive.
+	
+	void GaussianStarModelRow ( short left, short right, short y, double parameters[5],
+	     double values[], double *derivatives[5] )
+	     
+	The model values are returned in (values), and the derivatives w/ respect to
+	parameter i in (derivatives[i]); each of these arrays must have room for
+	right - left + 1 values.  The results are the same as GaussianStarModel()'s
+	for each pixel, to within rounding error.
+	
+	The gaussian is separable, so the exponential at each pixel is the product
+	of an exponential in y, constant along the row, and one in x; successive
+	x exponentials differ by factors which are themselves in geometric
+	progression, so the whole row needs only four calls to exp().  The
+	exponentials are computed outward from the column nearest the centroid,
+	where they are largest, so that none is lost to underflow in the
+	progression before its true value is negligible.
+	
+*************************************************************************************/
+
+void GaussianStarModelRow ( short left, short right, short y, double parameters[5],
+double values[], double *derivatives[5] )
+{
+	short	col, center;
+	long	i;
+	double	dx, dy, dy2, a, r2, ratio, step, e, e0, temp;
+	
+	dy = y - parameters[3];
+	dy2 = dy * dy;
+	r2 = parameters[4] * parameters[4];
+	a = 1.0 / ( 2.0 * r2 );
+	step = exp ( -2.0 * a );
+	
+	/*** Find the column nearest the centroid, and compute the exponential there. ***/
+	
+	if ( parameters[2] <= left )
+		center = left;
+	else if ( parameters[2] >= right )
+		center = right;
+	else
+		center = floor ( parameters[2] + 0.5 );
+		
+	dx = center - parameters[2];
+	e0 = exp ( - ( dx * dx + dy2 ) * a );
+	
+	/*** Work rightward from there, then leftward.  Going from column dx to dx + 1,
+	     the exponential is multiplied by exp ( - ( 2 dx + 1 ) a ); going from dx to
+	     dx - 1, by exp ( - ( 1 - 2 dx ) a ).  Each step's ratio is exp ( -2 a ) times
+	     the last's. ***/
+	
+	e = e0;
+	ratio = exp ( - ( 2.0 * dx + 1.0 ) * a );
+	for ( col = center; col <= right; col++ )
+	{
+		derivatives[1][col - left] = e;
+		e *= ratio;
+		ratio *= step;
+	}
+	
+	e = e0;
+	ratio = exp ( - ( 1.0 - 2.0 * dx ) * a );
+	for ( col = center - 1; col >= left; col-- )
+	{
+		e *= ratio;
+		ratio *= step;
+		derivatives[1][col - left] = e;
+	}
+	
+	/*** Now compute the model and the remaining derivatives from the exponentials. ***/
+	
+	for ( i = 0, col = left; col <= right; i++, col++ )
+	{
+		dx = col - parameters[2];
+		e = derivatives[1][i];
+		temp = parameters[1] * e / r2;
+		
+		values[i] = parameters[1] * e + parameters[0];
+		derivatives[0][i] = 1.0;
+		derivatives[2][i] = temp * dx;
+		derivatives[3][i] = temp * dy;
+		derivatives[4][i] = ( dx * dx + dy2 ) * temp / parameters[4];
+	}
+}
@@ -0,0 +1,482 @@
+/*** COPYRIGHT NOTICE AND PUBLIC SOURCE LICENSE ***************************************
+
+	Portions Copyright (c) 1992-2001 Southern Stars Systems.  All Rights Reserved.
+
+	This file contains Original Code and/or Modifications of Original Code as
+	defined in and that are subject to the Southern Stars Systems Public Source
+	License Version 1.0 (the 'License').  You may not use this file except in
+	compliance with the License.  Please obtain a copy of the License at
+
+	http://www.southernstars.com/opensource/
+
+	and read it before using this file.
+
+	The Original Code and all software distributed under the License are distributed
+	on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER EXPRESS OR IMPLIED, AND
+	SOUTHERN STARS SYSTEMS HEREBY DISCLAIMS ALL SUCH WARRANTIES, INCLUDING WITHOUT
+	LIMITATION, ANY WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE,
+	QUIET ENJOYMENT, OR NON-INFRINGEMENT.  Please see the License for the specific
+	language governing rights and limitations under the License.
+
+	MODIFICATION HISTORY:
+
+	1.0.0 - 17 Oct 2026 - Original code: image object index by position and name.
+
+****************************************************************************************/
+
+#include "SkySight.h"
+
+/*** local data types ***/
+
+/*** An ImageObjectIndex lets us find an image's objects by position or by name
+     without walking the image's whole object list.  Objects are binned by
+     centroid into a grid of square cells; the objects in cell i are
+     cellObjects[ cellStart[i] ] through cellObjects[ cellStart[i+1] - 1 ].
+     Names are hashed into hashSize chains; hashHeads[h] is the position in
+     (objects) of the first object in chain h, and hashNext[i] the position of
+     the next object in the chain after objects[i], or -1 at the end.  Chains
+     list objects in the same order as the image's object list. ***/
+
+struct ImageObjectIndex
+{
+	long			numObjects;
+	ImageObjectPtr	*objects;
+	double			left;
+	double			top;
+	double			cellSize;
+	long			gridCols;
+	long			gridRows;
+	long			*cellStart;
+	ImageObjectPtr	*cellObjects;
+	long			hashSize;
+	long			*hashHeads;
+	long			*hashNext;
+};
+
+/*** local functions ***/
+
+static ImageObjectIndexPtr GetImageObjectIndex ( ImagePtr );
+static ImageObjectIndexPtr NewImageObjectIndex ( ImagePtr );
+static unsigned long HashImageObjectName ( char * );
+static void GetImageObjectIndexCells ( ImageObjectIndexPtr, double, double, double, double, long *, long *, long *, long * );
+
+/*** NewImageObjectIndex ************************************************************
+
+	Builds a position and name index of an image's current object list.
+	Returns a pointer to the index, or NULL on failure.
+
+*************************************************************************************/
+
+static ImageObjectIndexPtr NewImageObjectIndex ( ImagePtr image )
+{
+	long				i, cell, numCells, numObjects = GetImageObjectCount ( image );
+	double				x, y, right, bottom, area;
+	unsigned long		h;
+	ImageObjectPtr		object;
+	ImageObjectIndexPtr	index;
+
+	index = (ImageObjectIndexPtr) calloc ( 1, sizeof ( struct ImageObjectIndex ) );
+	if ( index == NULL )
+		return ( NULL );
+
+	/*** Make an array of the image's objects, in list order, and find the
+	     bounds of their centroids. ***/
+
+	index->objects = (ImageObjectPtr *) malloc ( ( numObjects + 1 ) * sizeof ( ImageObjectPtr ) );
+	if ( index->objects == NULL )
+	{
+		DeleteImageObjectIndex ( index );
+		return ( NULL );
+	}
+
+	index->left = index->top = right = bottom = 0.0;
+
+	for ( i = 0, object = GetImageObjectList ( image ); object != NULL && i < numObjects; i++, object = GetNextImageObject ( object ) )
+	{
+		x = GetImageObjectCentroidX ( object );
+		y = GetImageObjectCentroidY ( object );
+
+		if ( i == 0 || x < index->left )
+			index->left = x;
+
+		if ( i == 0 || x > right )
+			right = x;
+
+		if ( i == 0 || y < index->top )
+			index->top = y;
+
+		if ( i == 0 || y > bottom )
+			bottom = y;
+
+		index->objects[i] = object;
+	}
+
+	index->numObjects = numObjects = i;
+
+	/*** Size the grid cells so that there are about two objects per cell,
+	     but no cell is smaller than a pixel. ***/
+
+	area = ( right - index->left + 1.0 ) * ( bottom - index->top + 1.0 );
+	index->cellSize = sqrt ( 2.0 * area / ( numObjects > 0 ? numObjects : 1 ) );
+	if ( index->cellSize < 1.0 )
+		index->cellSize = 1.0;
+
+	index->gridCols = ( right - index->left ) / index->cellSize + 1;
+	index->gridRows = ( bottom - index->top ) / index->cellSize + 1;
+	numCells = index->gridCols * index->gridRows;
+
+	index->cellStart = (long *) calloc ( numCells + 1, sizeof ( long ) );
+	index->cellObjects = (ImageObjectPtr *) malloc ( ( numObjects + 1 ) * sizeof ( ImageObjectPtr ) );
+
+	/*** Use a power of two at least as large as the number of objects
+	     for the number of hash chains. ***/
+
+	for ( index->hashSize = 1; index->hashSize < numObjects; index->hashSize *= 2 )
+		;
+
+	index->hashHeads = (long *) malloc ( index->hashSize * sizeof ( long ) );
+	index->hashNext = (long *) malloc ( ( numObjects + 1 ) * sizeof ( long ) );
+
+	if ( index->cellStart == NULL || index->cellObjects == NULL || index->hashHeads == NULL || index->hashNext == NULL )
+	{
+		DeleteImageObjectIndex ( index );
+		return ( NULL );
+	}
+
+	/*** Count the objects in each cell, and turn the counts into the position
+	     of the end of each cell's run.  Then work backwards through the objects,
+	     filling in each cell's run from its end; that leaves each run's start
+	     where its end was, so shift the starts down one place. ***/
+
+	for ( i = 0; i < numObjects; i++ )
+	{
+		x = GetImageObjectCentroidX ( index->objects[i] );
+		y = GetImageObjectCentroidY ( index->objects[i] );
+		GetImageObjectIndexCells ( index, x, y, x, y, &cell, NULL, NULL, NULL );
+		index->cellStart[ cell + 1 ]++;
+	}
+
+	for ( cell = 0; cell < numCells; cell++ )
+		index->cellStart[ cell + 1 ] += index->cellStart[ cell ];
+
+	for ( i = numObjects - 1; i >= 0; i-- )
+	{
+		x = GetImageObjectCentroidX ( index->objects[i] );
+		y = GetImageObjectCentroidY ( index->objects[i] );
+		GetImageObjectIndexCells ( index, x, y, x, y, &cell, NULL, NULL, NULL );
+		index->cellObjects[ --index->cellStart[ cell + 1 ] ] = index->objects[i];
+	}
+
+	for ( cell = 0; cell < numCells; cell++ )
+		index->cellStart[ cell ] = index->cellStart[ cell + 1 ];
+
+	index->cellStart[ numCells ] = numObjects;
+
+	/*** Link the objects into their hash chains, working backwards so that
+	     each chain lists its objects in list order. ***/
+
+	for ( h = 0; h < (unsigned long) index->hashSize; h++ )
+		index->hashHeads[h] = -1;
+
+	for ( i = numObjects - 1; i >= 0; i-- )
+	{
+		h = HashImageObjectName ( GetImageRegionName ( index->objects[i] ) ) & ( index->hashSize - 1 );
+		index->hashNext[i] = index->hashHeads[h];
+		index->hashHeads[h] = i;
+	}
+
+	return ( index );
+}
+
+/*** DeleteImageObjectIndex *********************************************************
+
+	Frees memory for an image object index.
+
+*************************************************************************************/
+
+void DeleteImageObjectIndex ( ImageObjectIndexPtr index )
+{
+	if ( index->objects != NULL )
+		free ( index->objects );
+
+	if ( index->cellStart != NULL )
+		free ( index->cellStart );
+
+	if ( index->cellObjects != NULL )
+		free ( index->cellObjects );
+
+	if ( index->hashHeads != NULL )
+		free ( index->hashHeads );
+
+	if ( index->hashNext != NULL )
+		free ( index->hashNext );
+
+	free ( index );
+}
+
+/*** InvalidateImageObjectIndex *****************************************************
+
+	Discards an image's object index, so that it will be rebuilt the next time
+	it is needed.
+
+	void InvalidateImageObjectIndex ( ImagePtr image )
+
+	(image): pointer to an image.
+
+	The image's object list functions call this whenever they change the list.
+	If you change the centroid or name of an object which is already in an
+	image's object list, you must call it yourself.
+
+*************************************************************************************/
+
+void InvalidateImageObjectIndex ( ImagePtr image )
+{
+	if ( image->imageObjectIndex != NULL )
+	{
+		DeleteImageObjectIndex ( image->imageObjectIndex );
+		image->imageObjectIndex = NULL;
+	}
+}
+
+/*** GetImageObjectIndex ***/
+
+static ImageObjectIndexPtr GetImageObjectIndex ( ImagePtr image )
+{
+	if ( image->imageObjectIndex == NULL )
+		image->imageObjectIndex = NewImageObjectIndex ( image );
+
+	return ( image->imageObjectIndex );
+}
+
+/*** HashImageObjectName ***/
+
+static unsigned long HashImageObjectName ( char *name )
+{
+	unsigned long	h = 5381;
+
+	while ( *name )
+		h = h * 33 + (unsigned char) *name++;
+
+	return ( h );
+}
+
+/*** GetImageObjectIndexCells *******************************************************
+
+	Finds the range of grid cells which covers a rectangle, clipped to the grid.
+	Returns the first cell's number in (cell), and if the other pointers are
+	non-NULL, the range of cell columns and rows in them.
+
+*************************************************************************************/
+
+static void GetImageObjectIndexCells ( ImageObjectIndexPtr index, double left, double top, double right, double bottom,
+long *cell, long *cols, long *row0, long *row1 )
+{
+	long	col0, col1, r0, r1;
+
+	col0 = left > index->left ? ( left - index->left ) / index->cellSize : 0;
+	col1 = right > index->left ? ( right - index->left ) / index->cellSize : 0;
+	r0 = top > index->top ? ( top - index->top ) / index->cellSize : 0;
+	r1 = bottom > index->top ? ( bottom - index->top ) / index->cellSize : 0;
+
+	if ( col0 >= index->gridCols )
+		col0 = index->gridCols - 1;
+
+	if ( col1 >= index->gridCols )
+		col1 = index->gridCols - 1;
+
+	if ( r0 >= index->gridRows )
+		r0 = index->gridRows - 1;
+
+	if ( r1 >= index->gridRows )
+		r1 = index->gridRows - 1;
+
+	*cell = r0 * index->gridCols + col0;
+
+	if ( cols != NULL )
+		*cols = col1 - col0 + 1;
+
+	if ( row0 != NULL )
+		*row0 = r0;
+
+	if ( row1 != NULL )
+		*row1 = r1;
+}
+
+/*** FindImageObjectsInRect *********************************************************
+
+	Finds all of an image's objects whose centroids lie within a rectangle.
+
+	long FindImageObjectsInRect ( ImagePtr image, double left, double top,
+	     double right, double bottom, ImageObjectPtr **objects )
+
+	(image): pointer to an image.
+	(left,top,right,bottom): rectangle, in image coordinates.  Edges are inclusive.
+	(objects): receives a pointer to an array of the objects found.
+
+	The function returns the number of objects found, or -1 on failure.  If it
+	finds any, it allocates an array of pointers to them, which you should free()
+	when you're done with it; otherwise, it sets (*objects) to NULL.  The objects
+	are not in any particular order.
+
+*************************************************************************************/
+
+long FindImageObjectsInRect ( ImagePtr image, double left, double top, double right, double bottom,
+ImageObjectPtr **objects )
+{
+	long				pass, n, cell, cols, row, row0, row1, col, i;
+	double				x, y;
+	ImageObjectPtr		object;
+	ImageObjectIndexPtr	index;
+
+	*objects = NULL;
+
+	if ( GetImageObjectCount ( image ) == 0 || left > right || top > bottom )
+		return ( 0 );
+
+	index = GetImageObjectIndex ( image );
+	if ( index == NULL )
+		return ( -1 );
+
+	GetImageObjectIndexCells ( index, left, top, right, bottom, &cell, &cols, &row0, &row1 );
+
+	/*** Count the objects in the rectangle on the first pass, then allocate
+	     the array and fill it in on the second. ***/
+
+	for ( pass = 0; pass < 2; pass++ )
+	{
+		n = 0;
+
+		for ( row = row0; row <= row1; row++, cell += index->gridCols )
+		{
+			for ( col = 0; col < cols; col++ )
+			{
+				for ( i = index->cellStart[ cell + col ]; i < index->cellStart[ cell + col + 1 ]; i++ )
+				{
+					object = index->cellObjects[i];
+					x = GetImageObjectCentroidX ( object );
+					y = GetImageObjectCentroidY ( object );
+
+					if ( x >= left && x <= right && y >= top && y <= bottom )
+					{
+						if ( *objects != NULL )
+							(*objects)[n] = object;
+
+						n++;
+					}
+				}
+			}
+		}
+
+		if ( n == 0 || pass == 1 )
+			break;
+
+		*objects = (ImageObjectPtr *) malloc ( n * sizeof ( ImageObjectPtr ) );
+		if ( *objects == NULL )
+			return ( -1 );
+
+		cell -= ( row1 - row0 + 1 ) * index->gridCols;
+	}
+
+	return ( n );
+}
+
+/*** FindImageObject ****************************************************************
+
+	Finds the image object whose centroid is nearest a point.
+
+	ImageObjectPtr FindImageObject ( ImagePtr image, double x, double y, double radius )
+
+	(image): pointer to an image.
+	(x,y): position of the point, in image coordinates.
+	(radius): greatest distance from the point at which to look for objects.
+
+	The function returns a pointer to the nearest object whose centroid lies
+	within (radius) of (x,y), or NULL if there is none.
+
+*************************************************************************************/
+
+ImageObjectPtr FindImageObject ( ImagePtr image, double x, double y, double radius )
+{
+	long				cell, cols, row, row0, row1, col, i;
+	double				dx, dy, d2, minD2 = radius * radius;
+	ImageObjectPtr		object, nearest = NULL;
+	ImageObjectIndexPtr	index;
+
+	if ( GetImageObjectCount ( image ) == 0 || radius < 0.0 )
+		return ( NULL );
+
+	index = GetImageObjectIndex ( image );
+	if ( index == NULL )
+		return ( NULL );
+
+	GetImageObjectIndexCells ( index, x - radius, y - radius, x + radius, y + radius, &cell, &cols, &row0, &row1 );
+
+	for ( row = row0; row <= row1; row++, cell += index->gridCols )
+	{
+		for ( col = 0; col < cols; col++ )
+		{
+			for ( i = index->cellStart[ cell + col ]; i < index->cellStart[ cell + col + 1 ]; i++ )
+			{
+				object = index->cellObjects[i];
+				dx = GetImageObjectCentroidX ( object ) - x;
+				dy = GetImageObjectCentroidY ( object ) - y;
+				d2 = dx * dx + dy * dy;
+
+				if ( d2 <= minD2 )
+				{
+					minD2 = d2;
+					nearest = object;
+				}
+			}
+		}
+	}
+
+	return ( nearest );
+}
+
+/*** FindImageObjectByName **********************************************************
+
+	Finds the image objects with a particular name.
+
+	ImageObjectPtr FindImageObjectByName ( ImagePtr image, char *name, long *position )
+
+	(image): pointer to an image.
+	(name): name of the object(s) to find.
+	(position): receives the position from which to continue the search.
+
+	Before the first call, set (*position) to -1.  The function returns a pointer
+	to the first object with the given name, or NULL if there is none; after that,
+	calling it again with the value it returned in (*position) finds the next
+	object with the same name, if there is one.  Objects are found in the order
+	they appear in the image's object list.
+
+*************************************************************************************/
+
+ImageObjectPtr FindImageObjectByName ( ImagePtr image, char *name, long *position )
+{
+	long				i;
+	ImageObjectIndexPtr	index;
+
+	if ( GetImageObjectCount ( image ) == 0 )
+		return ( NULL );
+
+	index = GetImageObjectIndex ( image );
+	if ( index == NULL )
+		return ( NULL );
+
+	if ( *position < 0 )
+		i = index->hashHeads[ HashImageObjectName ( name ) & ( index->hashSize - 1 ) ];
+	else if ( *position < index->numObjects )
+		i = index->hashNext[ *position ];
+	else
+		i = -1;
+
+	while ( i >= 0 && strcmp ( GetImageRegionName ( index->objects[i] ), name ) != 0 )
+		i = index->hashNext[i];
+
+	if ( i < 0 )
+		return ( NULL );
+
+	*position = i;
+	return ( index->objects[i] );
+}
@@ -219,8 +219,8 @@ void PowerScaleImage ( PIXEL **matrix, double exponent, ImageRegionPtr region )
 
 void DoImageWindowArithmetic ( short operation, GWindowPtr window1, GWindowPtr window2, PIXEL constant )
 {
-	short		nframes, nrows, ncols;
-	short		frame, row = -1, col, left, right;
+	short		nframes, frame;
+	long		nrows, ncols, row, col, stride1, stride2 = 0;
 	ImagePtr	image1 = NULL, image2 = NULL;
 	PIXEL		*data1 = NULL, *data2 = NULL;
 	
@@ -231,6 +231,7 @@ void DoImageWindowArithmetic ( short operation, GWindowPtr window1, GWindowPtr w
 	nframes = GetImageFrames ( image1 );
 	nrows   = GetImageRows ( image1 );
 	ncols   = GetImageColumns ( image1 );
+	stride1 = GetImageDataStride ( image1 );
 	
 	/*** If there is a second image window invoved in this arithmetic operation,
 	     get pointers to its FITS image data and matrix.  Choose the dimensions
@@ -239,32 +240,46 @@ void DoImageWindowArithmetic ( short operation, GWindowPtr window1, GWindowPtr w
 	if ( window2 )
 	{
 		image2 = GetImageWindowImage ( window2 );
+		stride2 = GetImageDataStride ( image2 );
 
 		if ( GetImageColumns ( image2 ) < ncols )
 			ncols = GetImageColumns ( image2 );
 			
-		if ( GetImageRows ( image2 ) )
+		if ( GetImageRows ( image2 ) < nrows )
 			nrows = GetImageRows ( image2 );
 			
-		if ( GetImageFrames ( image2 ) )
+		if ( GetImageFrames ( image2 ) < nframes )
 			nframes = GetImageFrames ( image2 );
 	}
 	
+	/*** Image data rows are stored one after another, (stride) pixels apart.
+	     If we are operating on whole rows, and the rows of both images are
+	     laid out the same way, we can treat each frame as one long row and
+	     run through it in a single loop; the padding at the end of each row
+	     isn't part of the image, so it doesn't matter what happens to it. ***/
+	
+	if ( ncols == GetImageColumns ( image1 ) && ( window2 == NULL || stride2 == stride1 ) )
+	{
+		ncols = nrows * stride1;
+		nrows = 1;
+	}
+	
 	/*** For each pixel in the target image, perform the desired arithmetic
 	     operation with the corresponding pixel in the other image (if there
 	     is one) or with the specified constant (if there is none). ***/
 	
 	for ( frame = 0; frame < nframes; frame++ )
 	{
-		for ( row = 0; row < nrows; row++ )
+		data1 = GetImageDataRow ( image1, frame, 0 );
+		if ( window2 )
+			data2 = GetImageDataRow ( image2, frame, 0 );
+		
+		for ( row = 0; row < nrows; row++, data1 += stride1, data2 += stride2 )
 		{
-			data1 = GetImageDataRow ( image1, frame, row );
-			
 			if ( operation == IMAGE_ADDITION )
 			{
 				if ( window2 )
 				{
-					data2 = GetImageDataRow ( image2, frame, row );
 					for ( col = 0; col < ncols; col++ )
 						data1[col] += data2[col];
 				}
@@ -278,7 +293,6 @@ void DoImageWindowArithmetic ( short operation, GWindowPtr window1, GWindowPtr w
 			{
 				if ( window2 )
 				{
-					data2 = GetImageDataRow ( image2, frame, row );
 					for ( col = 0; col < ncols; col++ )
 						data1[col] -= data2[col];
 				}
@@ -292,7 +306,6 @@ void DoImageWindowArithmetic ( short operation, GWindowPtr window1, GWindowPtr w
 			{
 				if ( window2 )
 				{
-					data2 = GetImageDataRow ( image2, frame, row );
 					for ( col = 0; col < ncols; col++ )
 						data1[col] *= data2[col];
 				}
@@ -306,7 +319,6 @@ void DoImageWindowArithmetic ( short operation, GWindowPtr window1, GWindowPtr w
 			{
 				if ( window2 )
 				{
-					data2 = GetImageDataRow ( image2, frame, row );
 					for ( col = 0; col < ncols; col++ )
 						if ( data2[col] == 0.0 )
 							data1[col] = 0.0;
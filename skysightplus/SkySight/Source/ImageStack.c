@@ -0,0 +1,764 @@
+/*** COPYRIGHT NOTICE AND PUBLIC SOURCE LICENSE ***************************************
+
+	Portions Copyright (c) 1992-2001 Southern Stars Systems.  All Rights Reserved.
+
+	This file contains Original Code and/or Modifications of Original Code as
+	defined in and that are subject to the Southern Stars Systems Public Source
+	License Version 1.0 (the 'License').  You may not use this file except in
+	compliance with the License.  Please obtain a copy of the License at
+
+	http://www.southernstars.com/opensource/
+
+	and read it before using this file.
+
+	The Original Code and all software distributed under the License are distributed
+	on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER EXPRESS OR IMPLIED, AND
+	SOUTHERN STARS SYSTEMS HEREBY DISCLAIMS ALL SUCH WARRANTIES, INCLUDING WITHOUT
+	LIMITATION, ANY WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE,
+	QUIET ENJOYMENT, OR NON-INFRINGEMENT.  Please see the License for the specific
+	language governing rights and limitations under the License.
+
+	MODIFICATION HISTORY:
+
+	1.0.0 - 17 Oct 2026 - Original code: streaming multi-frame stacking.
+
+****************************************************************************************/
+
+#include "SkySight.h"
+
+/*** local constants ***/
+
+#define STACK_BAND_MEMORY			( 128L * 1024L * 1024L )
+#define STACK_MIN_BAND_ROWS			16
+#define WINSORIZED_SIGMA_LIMIT		1.5
+#define WINSORIZED_SIGMA_FACTOR		1.134
+#define WINSORIZED_SIGMA_TOLERANCE	0.0005
+#define WINSORIZED_SIGMA_ITERATIONS	10
+
+/*** local data types ***/
+
+/*** ImageStackJob holds the parameters and buffers which StackImageFiles()
+     shares with its parallel tasks.  For each file, it holds the band of the
+     output image being stacked (resampled onto the output image's pixel grid),
+     with a mask telling which of those pixels actually lie inside the file's
+     image.  A band is (bandRows) rows tall and (bandCols) columns wide, less
+     where it is cut off by the bottom or right edge of the image. ***/
+
+typedef struct ImageStackJob
+{
+	long			numFiles;
+	short			cols;
+	short			rows;
+	short			frame;
+	short			bandTop;
+	short			bandLeft;
+	short			bandRows;
+	short			bandCols;
+	FILE			**files;
+	FITSImagePtr	*fits;
+	double			***transforms;
+	PIXEL			***sourceRows;
+	PIXEL			**values;
+	unsigned char	**masks;
+	int				*failed;
+	short			method;
+	double			kappa;
+	short			iterations;
+	long			numTasks;
+	double			**scratch;
+	PIXEL			**output;
+}
+ImageStackJob, *ImageStackJobPtr;
+
+/*** local functions ***/
+
+static void DeleteImageStackJob ( ImageStackJobPtr );
+static void LoadImageStackTask ( void *, long );
+static void CombineImageStackTask ( void *, long );
+static double CombineImageStackValues ( double *, long, short, double, short );
+static double GetWinsorizedSigma ( double *, long, double, double );
+static void SortImageStackValues ( double *, long );
+static double SelectImageStackValue ( double *, long, long );
+
+/*** StackImageFiles ****************************************************************
+
+	Combines a list of FITS image files into a single image.
+	
+	ImagePtr StackImageFiles ( GPathPtr paths[], double **transforms[], long numFiles,
+	         short method, double kappa, short iterations )
+	
+	(paths):      array of paths to FITS image files.
+	(transforms): array of alignment matrices, one per file; may be NULL.
+	(numFiles):   number of files in the arrays.
+	(method):     combining method; see below.
+	(kappa):      rejection limit, in standard deviations, for clipping methods.
+	(iterations): most rejection passes for clipping methods.
+	
+	The function returns a pointer to a new image containing the combined data,
+	or NULL on failure (i.e. if any of the files can't be read, if they don't all
+	have the same dimensions, or if memory can't be allocated).  The new image has
+	the dimensions of the files, and as many frames as they do.
+	
+	If (transforms) is not NULL, each of its elements is either NULL (meaning that
+	the file is already aligned with the output image), or a 3 x 2 matrix, like the
+	one CreateImageAlignmentMatrix() returns, which converts a pixel's column and
+	row in the output image to the corresponding coordinates in the file's image.
+	Aligned data values are interpolated bilinearly.  Pixels which fall outside a
+	file's image are left out of the combination.
+	
+	(method) may be one of the following:
+	
+	IMAGE_STACK_MEAN: the mean of all values at each pixel.
+	IMAGE_STACK_MEDIAN: the median of all values at each pixel.
+	IMAGE_STACK_SIGMA_CLIP: the mean of the values which remain after rejecting,
+	    up to (iterations) times, those more than (kappa) standard deviations away
+	    from the median of the values remaining.
+	IMAGE_STACK_WINSORIZED_CLIP: as IMAGE_STACK_SIGMA_CLIP, but the standard
+	    deviation is estimated from the Winsorized values, which makes it much less
+	    sensitive to the very outliers (satellite trails, cosmic rays, hot pixels)
+	    that rejection is meant to remove.
+	
+	The files are never read into memory as a whole.  The output image is built
+	up in bands of rows, each sized so that one band of every file, together with
+	the rows of each file that the band maps onto, fits in about 128 MB; only
+	those rows are read.  If some files are rotated so far that even a few rows
+	of the output image need most of a file's rows, the bands are also cut into
+	narrower strips of columns, which need fewer of the file's rows each.  The
+	rows of all of the files are read in parallel, and then the combination of
+	each band is shared among all of the system's processors.  All of the files
+	are kept open until the stack is complete.
+	
+*************************************************************************************/
+
+ImagePtr StackImageFiles ( GPathPtr paths[], double **transforms[], long numFiles,
+short method, double kappa, short iterations )
+{
+	ImageStackJob	job;
+	FILE			*file;
+	FITSImagePtr	header;
+	ImagePtr		image = NULL;
+	long			i, task, frames = 0, cache;
+	double			**matrix, sumA, sumC, sumK, fit;
+	int				ok = TRUE;
+	
+	memset ( &job, 0, sizeof ( job ) );
+	
+	job.numFiles = numFiles;
+	job.transforms = transforms;
+	job.method = method;
+	job.kappa = kappa;
+	job.iterations = iterations;
+	
+	if ( numFiles < 1 )
+		return ( NULL );
+		
+	/*** Read the first file's header to find the size of the image, so we can
+	     decide how many rows to stack at once before we open the rest. ***/
+	
+	file = GOpenFile ( paths[0], "rb", NULL, NULL );
+	if ( file == NULL )
+		return ( NULL );
+	
+	header = ReadFITSImageHeader ( file );
+	if ( header != NULL )
+	{
+		if ( header->naxis1 > 1 && header->naxis1 < 32768 && header->naxis2 > 1 && header->naxis2 < 32768 && header->naxis3 < 32768 )
+		{
+			job.cols = header->naxis1;
+			job.rows = header->naxis2;
+			frames = header->naxis3;
+		}
+		
+		FreeFITSImage ( header );
+	}
+	
+	if ( frames < 1 || fseek ( file, 0, SEEK_SET ) != 0 )
+	{
+		fclose ( file );
+		return ( NULL );
+	}
+	
+	/*** Decide how big a band to stack at once.  For each file, a band of
+	     (h) rows by (w) columns takes the band's values and mask, plus a row
+	     cache holding the a * ( w - 1 ) + c * ( h - 1 ) + 5 rows of the file
+	     onto which it maps, where a and c are the absolute values of the file's
+	     transform's [0][1] and [1][1] elements (or just h rows, if the file
+	     has no transform).  Use the full width of the image if a band of
+	     a reasonable number of rows fits.  Otherwise, if that's because of
+	     the rows the files' rotation adds to the cache, halve the width until
+	     a band fits or the rotation no longer dominates. ***/
+	
+	sumA = sumC = sumK = 0.0;
+	for ( i = 0; i < numFiles; i++ )
+	{
+		matrix = transforms == NULL ? NULL : transforms[i];
+		if ( matrix == NULL )
+		{
+			sumC += 1.0;
+			sumK += 1.0;
+		}
+		else
+		{
+			sumA += fabs ( matrix[0][1] );
+			sumC += fabs ( matrix[1][1] );
+			sumK += 5.0;
+		}
+	}
+	
+	for ( job.bandCols = job.cols; ; job.bandCols = ( job.bandCols + 1 ) / 2 )
+	{
+		fit = ( STACK_BAND_MEMORY - (double) job.cols * sizeof ( PIXEL ) * ( sumA * ( job.bandCols - 1 ) - sumC + sumK ) )
+		    / ( (double) numFiles * job.bandCols * ( sizeof ( PIXEL ) + 1 ) + (double) job.cols * sizeof ( PIXEL ) * sumC );
+		
+		if ( fit >= job.rows || fit >= STACK_MIN_BAND_ROWS || sumA * ( job.bandCols - 1 ) <= sumC * STACK_MIN_BAND_ROWS )
+			break;
+	}
+	
+	if ( fit >= job.rows )
+		job.bandRows = job.rows;
+	else if ( fit >= 1.0 )
+		job.bandRows = fit;
+	else
+		job.bandRows = 1;
+		
+	job.numTasks = GGetProcessorCount();
+	if ( job.numTasks < 1 )
+		job.numTasks = 1;
+		
+	/*** Allocate the per-file and per-task arrays. ***/
+	
+	job.files = (FILE **) calloc ( numFiles, sizeof ( FILE * ) );
+	job.fits = (FITSImagePtr *) calloc ( numFiles, sizeof ( FITSImagePtr ) );
+	job.sourceRows = (PIXEL ***) calloc ( numFiles, sizeof ( PIXEL ** ) );
+	job.values = (PIXEL **) calloc ( numFiles, sizeof ( PIXEL * ) );
+	job.masks = (unsigned char **) calloc ( numFiles, sizeof ( unsigned char * ) );
+	job.failed = (int *) calloc ( numFiles, sizeof ( int ) );
+	job.scratch = (double **) calloc ( job.numTasks, sizeof ( double * ) );
+	
+	if ( job.files == NULL || job.fits == NULL || job.sourceRows == NULL || job.values == NULL
+	|| job.masks == NULL || job.failed == NULL || job.scratch == NULL )
+	{
+		fclose ( file );
+		DeleteImageStackJob ( &job );
+		return ( NULL );
+	}
+	
+	job.files[0] = file;
+	
+	/*** Open and map each file, with a row cache just big enough to hold the
+	     rows needed for one band, as counted above.  Since the alignment is an
+	     affine transform, every band needs the same number of rows from a given
+	     file. ***/
+	
+	for ( i = 0; i < numFiles && ok; i++ )
+	{
+		if ( i > 0 )
+			job.files[i] = GOpenFile ( paths[i], "rb", NULL, NULL );
+		
+		matrix = transforms == NULL ? NULL : transforms[i];
+		if ( matrix == NULL )
+			cache = job.bandRows;
+		else
+			cache = fabs ( matrix[0][1] ) * ( job.bandCols - 1 ) + fabs ( matrix[1][1] ) * ( job.bandRows - 1 ) + 5;
+		
+		if ( cache > job.rows )
+			cache = job.rows;
+			
+		if ( job.files[i] != NULL )
+			job.fits[i] = MapFITSImage ( job.files[i], cache );
+		
+		if ( job.fits[i] == NULL || job.fits[i]->naxis1 != job.cols || job.fits[i]->naxis2 != job.rows || job.fits[i]->naxis3 != frames )
+		{
+			ok = FALSE;
+			break;
+		}
+		
+		if ( matrix != NULL )
+		{
+			job.sourceRows[i] = (PIXEL **) malloc ( cache * sizeof ( PIXEL * ) );
+			if ( job.sourceRows[i] == NULL )
+				ok = FALSE;
+		}
+		
+		job.values[i] = (PIXEL *) malloc ( (long) job.bandRows * job.bandCols * sizeof ( PIXEL ) );
+		job.masks[i] = (unsigned char *) malloc ( (long) job.bandRows * job.bandCols );
+		if ( job.values[i] == NULL || job.masks[i] == NULL )
+			ok = FALSE;
+	}
+	
+	for ( task = 0; task < job.numTasks && ok; task++ )
+	{
+		job.scratch[task] = (double *) malloc ( numFiles * sizeof ( double ) );
+		if ( job.scratch[task] == NULL )
+			ok = FALSE;
+	}
+	
+	/*** Create the output image. ***/
+	
+	if ( ok )
+	{
+		if ( frames == 3 )
+			image = NewImage ( "Stack", IMAGE_TYPE_RGB_COLOR, frames, job.rows, job.cols );
+		else if ( frames == 2 )
+			image = NewImage ( "Stack", IMAGE_TYPE_COMPLEX, frames, job.rows, job.cols );
+		else
+			image = NewImage ( "Stack", IMAGE_TYPE_MONOCHROME, frames, job.rows, job.cols );
+		
+		if ( image == NULL )
+			ok = FALSE;
+	}
+	
+	/*** Now stack each frame, one band at a time, working down each strip of
+	     columns: first read the band from every file, then combine it. ***/
+	
+	for ( job.frame = 0; job.frame < frames && ok; job.frame++ )
+	{
+		job.output = GetImageDataFrame ( image, job.frame );
+		
+		for ( job.bandLeft = 0; job.bandLeft < job.cols && ok; job.bandLeft += job.bandCols )
+		{
+			for ( job.bandTop = 0; job.bandTop < job.rows && ok; job.bandTop += job.bandRows )
+			{
+				GDoParallelTasks ( LoadImageStackTask, &job, numFiles );
+				
+				for ( i = 0; i < numFiles; i++ )
+					if ( job.failed[i] )
+						ok = FALSE;
+				
+				if ( ok )
+					GDoParallelTasks ( CombineImageStackTask, &job, job.numTasks );
+			}
+		}
+	}
+	
+	DeleteImageStackJob ( &job );
+	
+	if ( ! ok && image != NULL )
+	{
+		DeleteImage ( image );
+		image = NULL;
+	}
+	
+	return ( image );
+}
+
+/*** DeleteImageStackJob ***/
+
+static void DeleteImageStackJob ( ImageStackJobPtr job )
+{
+	long i;
+	
+	for ( i = 0; i < job->numFiles; i++ )
+	{
+		if ( job->fits != NULL && job->fits[i] != NULL )
+			FreeFITSImage ( job->fits[i] );
+			
+		if ( job->files != NULL && job->files[i] != NULL )
+			fclose ( job->files[i] );
+			
+		if ( job->sourceRows != NULL && job->sourceRows[i] != NULL )
+			free ( job->sourceRows[i] );
+			
+		if ( job->values != NULL && job->values[i] != NULL )
+			free ( job->values[i] );
+			
+		if ( job->masks != NULL && job->masks[i] != NULL )
+			free ( job->masks[i] );
+	}
+	
+	for ( i = 0; i < job->numTasks; i++ )
+		if ( job->scratch != NULL && job->scratch[i] != NULL )
+			free ( job->scratch[i] );
+	
+	if ( job->files != NULL )
+		free ( job->files );
+		
+	if ( job->fits != NULL )
+		free ( job->fits );
+		
+	if ( job->sourceRows != NULL )
+		free ( job->sourceRows );
+		
+	if ( job->values != NULL )
+		free ( job->values );
+		
+	if ( job->masks != NULL )
+		free ( job->masks );
+		
+	if ( job->failed != NULL )
+		free ( job->failed );
+		
+	if ( job->scratch != NULL )
+		free ( job->scratch );
+}
+
+/*** LoadImageStackTask *************************************************************
+
+	Performs one of StackImageFiles()'s parallel reading tasks: reads the rows of
+	one file needed for the current band, and resamples them onto the output image's
+	pixel grid.  Each task has a file to itself, so no two tasks ever touch the same
+	mapped image's row cache.
+	
+*************************************************************************************/
+
+static void LoadImageStackTask ( void *data, long task )
+{
+	ImageStackJobPtr	job = (ImageStackJobPtr) data;
+	FITSImagePtr		fits = job->fits[task];
+	PIXEL				*values = job->values[task], *row, **rows = job->sourceRows[task];
+	PIXEL				*row0, *row1;
+	unsigned char		*mask = job->masks[task];
+	double				**b, x, y, dx, dy, top, bottom;
+	long				bandRows, bandCols, col, i, first, last, k, ix, iy;
+	
+	b = job->transforms == NULL ? NULL : job->transforms[task];
+	
+	bandRows = job->rows - job->bandTop;
+	if ( bandRows > job->bandRows )
+		bandRows = job->bandRows;
+	
+	bandCols = job->cols - job->bandLeft;
+	if ( bandCols > job->bandCols )
+		bandCols = job->bandCols;
+	
+	/*** If the file is already aligned, just copy its rows. ***/
+	
+	if ( b == NULL )
+	{
+		for ( i = 0; i < bandRows; i++ )
+		{
+			row = GetFITSImageDataRow ( fits, job->frame, job->bandTop + i );
+			if ( row == NULL )
+			{
+				job->failed[task] = TRUE;
+				return;
+			}
+			
+			memcpy ( values + i * bandCols, row + job->bandLeft, bandCols * sizeof ( PIXEL ) );
+			memset ( mask + i * bandCols, 1, bandCols );
+		}
+		
+		return;
+	}
+	
+	/*** Otherwise, find the range of the file's rows onto which the band maps,
+	     with a row's margin on either side for rounding, and fetch them all. ***/
+	
+	top = b[2][1] + job->bandLeft * b[0][1] + job->bandTop * b[1][1];
+	bottom = top + ( bandRows - 1 ) * b[1][1];
+	
+	y = top < bottom ? top : bottom;
+	if ( b[0][1] < 0.0 )
+		y += ( bandCols - 1 ) * b[0][1];
+	
+	first = floor ( y ) - 1;
+	
+	y = top > bottom ? top : bottom;
+	if ( b[0][1] > 0.0 )
+		y += ( bandCols - 1 ) * b[0][1];
+	
+	last = floor ( y ) + 2;
+
+	if ( first < 0 )
+		first = 0;
+	
+	if ( last > job->rows - 1 )
+		last = job->rows - 1;
+	
+	for ( k = first; k <= last; k++ )
+	{
+		rows[ k - first ] = GetFITSImageDataRow ( fits, job->frame, k );
+		if ( rows[ k - first ] == NULL )
+		{
+			job->failed[task] = TRUE;
+			return;
+		}
+	}
+	
+	/*** Interpolate each output pixel bilinearly from the four file pixels around
+	     it.  Pixels outside the file's image are masked out. ***/
+	
+	for ( i = 0; i < bandRows; i++ )
+	{
+		for ( col = job->bandLeft; col < job->bandLeft + bandCols; col++ )
+		{
+			k = i * bandCols + col - job->bandLeft;
+			x = col * b[0][0] + ( job->bandTop + i ) * b[1][0] + b[2][0];
+			y = col * b[0][1] + ( job->bandTop + i ) * b[1][1] + b[2][1];
+			
+			if ( x < 0.0 || y < 0.0 || x > job->cols - 1 || y > job->rows - 1 )
+			{
+				values[k] = 0;
+				mask[k] = 0;
+				continue;
+			}
+			
+			ix = x;
+			iy = y;
+			
+			if ( ix > job->cols - 2 )
+				ix = job->cols - 2;
+				
+			if ( iy > job->rows - 2 )
+				iy = job->rows - 2;
+			
+			if ( iy < first || iy + 1 > last )
+			{
+				values[k] = 0;
+				mask[k] = 0;
+				continue;
+			}
+			
+			dx = x - ix;
+			dy = y - iy;
+			row0 = rows[ iy - first ];
+			row1 = rows[ iy + 1 - first ];
+			
+			values[k] = ( 1.0 - dy ) * ( ( 1.0 - dx ) * row0[ix] + dx * row0[ix + 1] )
+			          + dy * ( ( 1.0 - dx ) * row1[ix] + dx * row1[ix + 1] );
+			mask[k] = 1;
+		}
+	}
+}
+
+/*** CombineImageStackTask **********************************************************
+
+	Performs one of StackImageFiles()'s parallel combining tasks: combines the
+	values of all files at each pixel in the task's share of the current band, and
+	writes the results into the output image.
+	
+*************************************************************************************/
+
+static void CombineImageStackTask ( void *data, long task )
+{
+	ImageStackJobPtr	job = (ImageStackJobPtr) data;
+	double				*scratch = job->scratch[task];
+	long				bandRows, bandCols, numPixels, start, end, k, i, n;
+	
+	bandRows = job->rows - job->bandTop;
+	if ( bandRows > job->bandRows )
+		bandRows = job->bandRows;
+	
+	bandCols = job->cols - job->bandLeft;
+	if ( bandCols > job->bandCols )
+		bandCols = job->bandCols;
+	
+	numPixels = bandRows * bandCols;
+	start = numPixels / job->numTasks * task;
+	end = task == job->numTasks - 1 ? numPixels : numPixels / job->numTasks * ( task + 1 );
+	
+	for ( k = start; k < end; k++ )
+	{
+		for ( n = i = 0; i < job->numFiles; i++ )
+			if ( job->masks[i][k] )
+				scratch[n++] = job->values[i][k];
+		
+		job->output[ job->bandTop + k / bandCols ][ job->bandLeft + k % bandCols ] =
+			(PIXEL) CombineImageStackValues ( scratch, n, job->method, job->kappa, job->iterations );
+	}
+}
+
+/*** CombineImageStackValues ********************************************************
+
+	Combines the values of all of the files at one pixel, as described for
+	StackImageFiles(), and returns the result.  The values are rearranged.
+	
+*************************************************************************************/
+
+static double CombineImageStackValues ( double *values, long n, short method, double kappa, short iterations )
+{
+	double	sum, sumsq, mean, median, sigma, low, high;
+	long	i, k, lo, hi, count;
+	short	iteration;
+	
+	if ( n < 1 )
+		return ( 0.0 );
+	
+	if ( method == IMAGE_STACK_MEDIAN )
+	{
+		/*** The selection leaves every value below the middle one in front of
+		     it; if there are an even number, the other middle value is the
+		     smallest of those behind it. ***/
+		     
+		k = ( n - 1 ) / 2;
+		median = SelectImageStackValue ( values, n, k );
+		if ( n % 2 == 0 )
+		{
+			high = values[k + 1];
+			for ( i = k + 2; i < n; i++ )
+				if ( values[i] < high )
+					high = values[i];
+					
+			median = ( median + high ) / 2.0;
+		}
+		
+		return ( median );
+	}
+	
+	/*** For the clipping methods, sort the values, so that rejection simply
+	     narrows the window [lo,hi) of the values we keep. ***/
+	
+	lo = 0;
+	hi = n;
+	
+	if ( method == IMAGE_STACK_SIGMA_CLIP || method == IMAGE_STACK_WINSORIZED_CLIP )
+	{
+		SortImageStackValues ( values, n );
+		
+		for ( iteration = 0; iteration < iterations; iteration++ )
+		{
+			count = hi - lo;
+			if ( count < 3 )
+				break;
+				
+			median = ( values[ lo + ( count - 1 ) / 2 ] + values[ lo + count / 2 ] ) / 2.0;
+			
+			for ( sum = sumsq = 0.0, i = lo; i < hi; i++ )
+			{
+				sum += values[i];
+				sumsq += values[i] * values[i];
+			}
+			
+			mean = sum / count;
+			sigma = sumsq / count - mean * mean;
+			sigma = sigma > 0.0 ? sqrt ( sigma ) : 0.0;
+			
+			if ( method == IMAGE_STACK_WINSORIZED_CLIP )
+				sigma = GetWinsorizedSigma ( values + lo, count, median, sigma );
+			
+			if ( sigma <= 0.0 )
+				break;
+				
+			low = median - kappa * sigma;
+			high = median + kappa * sigma;
+			
+			k = hi - lo;
+			while ( lo < hi && values[lo] < low )
+				lo++;
+				
+			while ( hi > lo && values[hi - 1] > high )
+				hi--;
+				
+			if ( hi - lo == k )
+				break;
+		}
+	}
+	
+	for ( sum = 0.0, i = lo; i < hi; i++ )
+		sum += values[i];
+		
+	return ( hi > lo ? sum / ( hi - lo ) : 0.0 );
+}
+
+/*** GetWinsorizedSigma *************************************************************
+
+	Estimates the standard deviation of a set of sorted values, starting from their
+	ordinary standard deviation (sigma), by repeatedly replacing values more than
+	1.5 sigma from the median with the values at that limit, and recomputing sigma
+	from the result (scaled to be unbiased for normally-distributed values), until
+	it stops changing.
+	
+*************************************************************************************/
+
+static double GetWinsorizedSigma ( double *values, long n, double median, double sigma )
+{
+	double	low, high, value, sum, sumsq, mean, newSigma;
+	long	i;
+	short	iteration;
+	
+	for ( iteration = 0; iteration < WINSORIZED_SIGMA_ITERATIONS && sigma > 0.0; iteration++ )
+	{
+		low = median - WINSORIZED_SIGMA_LIMIT * sigma;
+		high = median + WINSORIZED_SIGMA_LIMIT * sigma;
+		
+		for ( sum = sumsq = 0.0, i = 0; i < n; i++ )
+		{
+			value = values[i] < low ? low : values[i] > high ? high : values[i];
+			sum += value;
+			sumsq += value * value;
+		}
+		
+		mean = sum / n;
+		newSigma = sumsq / n - mean * mean;
+		newSigma = newSigma > 0.0 ? WINSORIZED_SIGMA_FACTOR * sqrt ( newSigma ) : 0.0;
+		
+		if ( fabs ( newSigma - sigma ) < WINSORIZED_SIGMA_TOLERANCE * sigma )
+			iteration = WINSORIZED_SIGMA_ITERATIONS;
+		
+		sigma = newSigma;
+	}
+	
+	return ( sigma );
+}
+
+/*** SortImageStackValues ***********************************************************
+
+	Sorts an array of values into ascending order with a Shell sort, which for the
+	few dozen or few hundred values at one pixel beats qsort()'s call overhead.
+	
+*************************************************************************************/
+
+static void SortImageStackValues ( double *values, long n )
+{
+	long	gap, i, j;
+	double	value;
+	
+	for ( gap = n / 2; gap > 0; gap = gap == 2 ? 1 : gap * 5 / 11 )
+	{
+		for ( i = gap; i < n; i++ )
+		{
+			value = values[i];
+			for ( j = i; j >= gap && values[j - gap] > value; j -= gap )
+				values[j] = values[j - gap];
+				
+			values[j] = value;
+		}
+	}
+}
+
+/*** SelectImageStackValue **********************************************************
+
+	Rearranges an array of values so that the (k)th smallest is at index (k), with
+	no larger values before it and no smaller values after it, and returns it.
+	
+*************************************************************************************/
+
+static double SelectImageStackValue ( double *values, long n, long k )
+{
+	long	left = 0, right = n - 1, i, j;
+	double	pivot, value;
+	
+	while ( left < right )
+	{
+		pivot = values[k];
+		i = left;
+		j = right;
+		
+		do
+		{
+			while ( values[i] < pivot )
+				i++;
+				
+			while ( pivot < values[j] )
+				j--;
+				
+			if ( i <= j )
+			{
+				value = values[i];
+				values[i] = values[j];
+				values[j] = value;
+				i++;
+				j--;
+			}
+		}
+		while ( i <= j );
+		
+		if ( j < k )
+			left = i;
+			
+		if ( k < i )
+			right = j;
+	}
+	
+	return ( values[k] );
+}
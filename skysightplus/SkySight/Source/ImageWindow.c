@@ -37,6 +37,13 @@
 
 #define IMAGE_HISTOGRAM_BINS			100
 
+/*** Number of reduced-resolution copies of an image window's bitmap which
+     we keep for zoomed-out display (one for each zoom level below 1X),
+     and the size in pixels of the square tiles in which they are computed. ***/
+
+#define IMAGE_PYRAMID_LEVELS			4
+#define IMAGE_PYRAMID_TILE_SIZE			128
+
 #define IMAGE_WINDOW_IMAGE_PART					1
 #define IMAGE_WINDOW_MAGNIFICATION_PART			2
 #define IMAGE_WINDOW_COLOR_TABLE_PART			3
@@ -52,12 +59,30 @@
 
 /*** Local data types ***/
 
+typedef struct ImagePyramidLevel
+{
+	GImagePtr		bitmap;
+	short			tileCols;
+	short			tileRows;
+	char			*tileValid;
+}
+ImagePyramidLevel, *ImagePyramidLevelPtr;
+
+typedef struct ImagePyramidJob
+{
+	GImagePtr		source;
+	GImagePtr		bitmap;
+	short			*tiles;
+}
+ImagePyramidJob, *ImagePyramidJobPtr;
+
 typedef struct ImageWindowData
 {
 	int				iwNeedsSave;
 	GWindowPtr		iwWindow;
 	GWindowPtr		iwNextImageWindow;
 	GImagePtr		iwBitmap;
+	ImagePyramidLevel	iwPyramid[IMAGE_PYRAMID_LEVELS];
 	ImagePtr		iwImage;
 	ImageRegionPtr	iwSelectedRegion;
 	short			iwSelectedFrame;
@@ -79,6 +104,8 @@ ImageWindowData, *ImageWindowDataPtr;
 
 static ImageWindowDataPtr	CreateImageWindowData ( void );
 static void					DeleteImageWindowData ( ImageWindowDataPtr );
+static void					DeleteImageWindowPyramid ( ImageWindowDataPtr );
+static void					ReduceImageWindowPyramidTile ( void *, long );
 
 static ImageWindowDataPtr	GetImageWindowData ( GWindowPtr );
 static void					SetActiveImageWindow ( GWindowPtr );
@@ -308,6 +335,8 @@ void DeleteImageWindowData ( ImageWindowDataPtr data )
 	if ( data->iwBitmap != NULL )
 		GDeleteImage ( data->iwBitmap );
 	
+	DeleteImageWindowPyramid ( data );
+	
 	if ( data->iwSelectedRegion != NULL )
 		DeleteImageRegion ( data->iwSelectedRegion );
 				
@@ -640,10 +669,271 @@ GImagePtr NewImageWindowBitmap ( GWindowPtr window )
 		GDeleteImage ( data->iwBitmap );
 		
 	data->iwBitmap = bitmap;
+	DeleteImageWindowPyramid ( data );
 	
 	return ( bitmap );
 }
 
+/*** DeleteImageWindowPyramid ***/
+
+void DeleteImageWindowPyramid ( ImageWindowDataPtr data )
+{
+	short	level;
+	
+	for ( level = 0; level < IMAGE_PYRAMID_LEVELS; level++ )
+	{
+		if ( data->iwPyramid[level].bitmap != NULL )
+			GDeleteImage ( data->iwPyramid[level].bitmap );
+			
+		if ( data->iwPyramid[level].tileValid != NULL )
+			free ( data->iwPyramid[level].tileValid );
+			
+		memset ( &data->iwPyramid[level], 0, sizeof ( ImagePyramidLevel ) );
+	}
+}
+
+/*** InvalidateImageWindowPyramid *************************************************
+
+	Marks part of an image window's reduced-resolution bitmaps as out of date.
+
+	void InvalidateImageWindowPyramid ( GWindowPtr window, short left, short top,
+	     short right, short bottom )
+
+	(window): pointer to image window.
+	(left):   leftmost image column which has changed.
+	(top):    topmost image row which has changed.
+	(right):  rightmost image column which has changed.
+	(bottom): bottommost image row which has changed.
+
+	The function returns nothing.  Call it whenever you redraw part of the window's
+	full-resolution bitmap; the tiles of each reduced-resolution bitmap covering
+	the changed rectangle will be recomputed the next time they are displayed.
+
+***********************************************************************************/
+
+void InvalidateImageWindowPyramid ( GWindowPtr window, short left, short top, short right, short bottom )
+{
+	ImageWindowDataPtr		data = GetImageWindowData ( window );
+	ImagePyramidLevelPtr	pyramid;
+	short					level, col, row, firstCol, firstRow, lastCol, lastRow;
+	long					size;
+	
+	if ( left < 0 )
+		left = 0;
+		
+	if ( top < 0 )
+		top = 0;
+		
+	for ( level = 1; level <= IMAGE_PYRAMID_LEVELS; level++ )
+	{
+		pyramid = &data->iwPyramid[ level - 1 ];
+		if ( pyramid->tileValid == NULL )
+			continue;
+			
+		/*** Each tile at this level covers this many full-resolution pixels
+		     on a side. ***/
+		     
+		size = (long) IMAGE_PYRAMID_TILE_SIZE << level;
+		
+		firstCol = left / size;
+		firstRow = top / size;
+		lastCol = right / size < pyramid->tileCols - 1 ? right / size : pyramid->tileCols - 1;
+		lastRow = bottom / size < pyramid->tileRows - 1 ? bottom / size : pyramid->tileRows - 1;
+		
+		for ( row = firstRow; row <= lastRow; row++ )
+			for ( col = firstCol; col <= lastCol; col++ )
+				pyramid->tileValid[ (long) row * pyramid->tileCols + col ] = FALSE;
+	}
+}
+
+/*** GetImageWindowPyramidBitmap **************************************************
+
+	Returns one of an image window's reduced-resolution bitmaps, bringing the
+	part of it which is about to be displayed up to date.
+
+	GImagePtr GetImageWindowPyramidBitmap ( GWindowPtr window, short level, GRectPtr rect )
+
+	(window): pointer to image window.
+	(level):  reduction level, from 1 (half size) to IMAGE_PYRAMID_LEVELS.
+	(rect):   rectangle, in the reduced bitmap's coordinates, which is required.
+
+	The function returns a pointer to the reduced bitmap, or NULL if the level is
+	out of range or memory can't be allocated; in that case, draw from the full-
+	resolution bitmap instead.
+
+	Each pixel at a given level is the mean of 2 x 2 pixels at the level above,
+	so an 8-bit bitmap holds the mean display value, mapped through the same
+	color table as the full-resolution bitmap.  The reduced bitmaps are created
+	when first needed, and only the tiles which intersect (rect) and have been
+	invalidated by InvalidateImageWindowPyramid() since they were last computed
+	are recomputed.  Displaying a zoomed-out image therefore costs time
+	proportional to the window's size, not the image's.  The reduced bitmaps
+	are discarded whenever the window's full-resolution bitmap is reallocated.
+
+***********************************************************************************/
+
+GImagePtr GetImageWindowPyramidBitmap ( GWindowPtr window, short level, GRectPtr rect )
+{
+	ImageWindowDataPtr		data = GetImageWindowData ( window );
+	ImagePyramidLevelPtr	pyramid;
+	ImagePyramidJob			job;
+	GRect					sourceRect;
+	short					width, height, i, col, row, firstCol, firstRow, lastCol, lastRow;
+	short					index;
+	unsigned char			red, green, blue;
+	long					numTiles;
+	
+	if ( level < 1 || level > IMAGE_PYRAMID_LEVELS || data->iwBitmap == NULL )
+		return ( NULL );
+		
+	pyramid = &data->iwPyramid[ level - 1 ];
+	
+	width = GGetImageWidth ( data->iwBitmap );
+	height = GGetImageHeight ( data->iwBitmap );
+	
+	for ( i = 0; i < level; i++ )
+	{
+		width = ( width + 1 ) / 2;
+		height = ( height + 1 ) / 2;
+	}
+	
+	/*** Create this level's bitmap if it doesn't exist yet, with all of its
+	     tiles marked as out of date. ***/
+	     
+	if ( pyramid->bitmap == NULL )
+	{
+		pyramid->tileCols = ( width + IMAGE_PYRAMID_TILE_SIZE - 1 ) / IMAGE_PYRAMID_TILE_SIZE;
+		pyramid->tileRows = ( height + IMAGE_PYRAMID_TILE_SIZE - 1 ) / IMAGE_PYRAMID_TILE_SIZE;
+		
+		pyramid->bitmap = GCreateImage ( width, height, GGetImageDepth ( data->iwBitmap ) );
+		pyramid->tileValid = (char *) calloc ( (long) pyramid->tileCols * pyramid->tileRows, 1 );
+		
+		if ( pyramid->bitmap == NULL || pyramid->tileValid == NULL )
+		{
+			if ( pyramid->bitmap != NULL )
+				GDeleteImage ( pyramid->bitmap );
+				
+			if ( pyramid->tileValid != NULL )
+				free ( pyramid->tileValid );
+				
+			memset ( pyramid, 0, sizeof ( ImagePyramidLevel ) );
+			return ( NULL );
+		}
+	}
+	
+	/*** An 8-bit bitmap's color table may have been changed since we last
+	     looked, so copy it from the full-resolution bitmap. ***/
+	     
+	if ( GGetImageDepth ( pyramid->bitmap ) == 8 )
+	{
+		for ( index = 0; index < 256; index++ )
+		{
+			GGetImageColorTableEntry ( data->iwBitmap, index, &red, &green, &blue );
+			GSetImageColorTableEntry ( pyramid->bitmap, index, red, green, blue );
+		}
+	}
+	
+	/*** Find the range of tiles which intersect the required rectangle,
+	     and count the ones which are out of date. ***/
+	     
+	firstCol = rect->left > 0 ? rect->left / IMAGE_PYRAMID_TILE_SIZE : 0;
+	firstRow = rect->top > 0 ? rect->top / IMAGE_PYRAMID_TILE_SIZE : 0;
+	lastCol = ( ( rect->right < width ? rect->right : width ) - 1 ) / IMAGE_PYRAMID_TILE_SIZE;
+	lastRow = ( ( rect->bottom < height ? rect->bottom : height ) - 1 ) / IMAGE_PYRAMID_TILE_SIZE;
+	
+	numTiles = 0;
+	for ( row = firstRow; row <= lastRow; row++ )
+		for ( col = firstCol; col <= lastCol; col++ )
+			if ( ! pyramid->tileValid[ (long) row * pyramid->tileCols + col ] )
+				numTiles++;
+				
+	if ( numTiles == 0 )
+		return ( pyramid->bitmap );
+		
+	/*** Bring the corresponding part of the level above up to date first;
+	     level 1 is reduced directly from the full-resolution bitmap. ***/
+	     
+	if ( level > 1 )
+	{
+		GSetRect ( &sourceRect, firstCol * IMAGE_PYRAMID_TILE_SIZE * 2, firstRow * IMAGE_PYRAMID_TILE_SIZE * 2,
+		           ( lastCol + 1 ) * IMAGE_PYRAMID_TILE_SIZE * 2, ( lastRow + 1 ) * IMAGE_PYRAMID_TILE_SIZE * 2 );
+		
+		job.source = GetImageWindowPyramidBitmap ( window, level - 1, &sourceRect );
+		if ( job.source == NULL )
+			return ( NULL );
+	}
+	else
+	{
+		job.source = data->iwBitmap;
+	}
+	
+	job.bitmap = pyramid->bitmap;
+	job.tiles = (short *) malloc ( numTiles * 2 * sizeof ( short ) );
+	if ( job.tiles == NULL )
+		return ( NULL );
+		
+	/*** Recompute the out-of-date tiles in parallel, then mark them as valid. ***/
+	
+	numTiles = 0;
+	for ( row = firstRow; row <= lastRow; row++ )
+		for ( col = firstCol; col <= lastCol; col++ )
+			if ( ! pyramid->tileValid[ (long) row * pyramid->tileCols + col ] )
+			{
+				job.tiles[ numTiles * 2 ] = col;
+				job.tiles[ numTiles * 2 + 1 ] = row;
+				pyramid->tileValid[ (long) row * pyramid->tileCols + col ] = TRUE;
+				numTiles++;
+			}
+	
+	GDoParallelTasks ( ReduceImageWindowPyramidTile, &job, numTiles );
+	free ( job.tiles );
+	
+	return ( pyramid->bitmap );
+}
+
+/*** ReduceImageWindowPyramidTile ***/
+
+void ReduceImageWindowPyramidTile ( void *data, long task )
+{
+	ImagePyramidJobPtr	job = (ImagePyramidJobPtr) data;
+	short				left = job->tiles[ task * 2 ] * IMAGE_PYRAMID_TILE_SIZE;
+	short				top = job->tiles[ task * 2 + 1 ] * IMAGE_PYRAMID_TILE_SIZE;
+	short				right = left + IMAGE_PYRAMID_TILE_SIZE;
+	short				bottom = top + IMAGE_PYRAMID_TILE_SIZE;
+	short				sourceCols = GGetImageWidth ( job->source );
+	short				sourceRows = GGetImageHeight ( job->source );
+	short				bytes = GGetImageDepth ( job->bitmap ) / 8;
+	short				col, row, byte;
+	long				col0, col1;
+	unsigned char		*bitmapRow, *sourceRow0, *sourceRow1;
+	
+	if ( right > GGetImageWidth ( job->bitmap ) )
+		right = GGetImageWidth ( job->bitmap );
+		
+	if ( bottom > GGetImageHeight ( job->bitmap ) )
+		bottom = GGetImageHeight ( job->bitmap );
+		
+	/*** At the right and bottom edges of a bitmap with an odd number of
+	     columns or rows, the last source column or row is used twice. ***/
+	     
+	for ( row = top; row < bottom; row++ )
+	{
+		bitmapRow = GGetImageDataRow ( job->bitmap, row );
+		sourceRow0 = GGetImageDataRow ( job->source, row * 2 );
+		sourceRow1 = GGetImageDataRow ( job->source, row * 2 + 1 < sourceRows ? row * 2 + 1 : row * 2 );
+		
+		for ( col = left; col < right; col++ )
+		{
+			col0 = (long) col * 2 * bytes;
+			col1 = col * 2 + 1 < sourceCols ? col0 + bytes : col0;
+			
+			for ( byte = 0; byte < bytes; byte++ )
+				bitmapRow[ col * bytes + byte ] = ( sourceRow0[ col0 + byte ] + sourceRow0[ col1 + byte ]
+				                                  + sourceRow1[ col0 + byte ] + sourceRow1[ col1 + byte ] + 2 ) >> 2;
+		}
+	}
+}
+
 /*** ResizeImageWindowImage *******************************************************
 
 	Reallocates an image window's display bitmap, as well as the underlying
@@ -716,6 +1006,35 @@ FITSImagePtr ResizeImageWindowImage ( GWindowPtr window, short cols, short rows,
 	return ( oldFITS );
 }
 
+/*** RestoreImageWindowImage ******************************************************
+
+	Undoes ResizeImageWindowImage(), e.g. when an operation fails part way
+	through filling the new image data matrix.
+
+	void RestoreImageWindowImage ( GWindowPtr window, FITSImagePtr oldFITS )
+	
+	(window):  pointer to image window
+	(oldFITS): previous FITS image record, as returned by ResizeImageWindowImage().
+	
+	The image window's current FITS image record is freed and replaced with
+	(oldFITS), and the display bitmap is given back the previous image's size
+	if it was changed.  The window is not updated; call UpdateImage() to do so.
+	The function returns nothing.
+	
+*************************************************************************************/
+
+void RestoreImageWindowImage ( GWindowPtr window, FITSImagePtr oldFITS )
+{
+	ImagePtr	image = GetImageWindowImage ( window );
+	GImagePtr	bitmap = GetImageWindowBitmap ( window );
+	
+	FreeFITSImage ( GetImageFITSImage ( image ) );
+	SetImageFITSImage ( image, oldFITS );
+	
+	if ( GetImageColumns ( image ) != GGetImageWidth ( bitmap ) || GetImageRows ( image ) != GGetImageHeight ( bitmap ) )
+		NewImageWindowBitmap ( window );
+}
+
 /*** SetImageWindowColorTable ***/
 
 void SetImageWindowColorTable ( GWindowPtr window, short item )
@@ -1281,7 +1600,8 @@ void UpdateImageWindow ( GWindowPtr window, GRectPtr rect )
 	ImagePtr		image;
 	ImageObjectPtr	object;
 	ImageRegionPtr	region;
-	short			col, row;
+	GImagePtr		pyramid = NULL;
+	short			col, row, zoom, scale;
 	
 	/*** Define the area of the window we wish to update: if we have been given
 	     a particular rectangle, update only that rectangle; otherwise update the
@@ -1310,14 +1630,42 @@ void UpdateImageWindow ( GWindowPtr window, GRectPtr rect )
 	GSetRect ( &bitmapRect, 0, 0, GGetImageWidth ( bitmap ), GGetImageHeight ( bitmap ) );
 	GClipRect ( &imageRect, &bitmapRect );
 
+	/*** If the image is zoomed out, draw from the reduced-resolution bitmap
+	     for the current zoom level, which maps one-to-one onto the window,
+	     rather than shrinking the full-resolution bitmap.  Convert the image
+	     rectangle to that bitmap's coordinates, rounding outwards, then
+	     bring that part of it up to date. ***/
+	
+	zoom = GetImageWindowDisplayZoom ( window );
+	if ( zoom < 0 )
+	{
+		scale = 1 << -zoom;
+		
+		GSetRect ( &bitmapRect, imageRect.left / scale, imageRect.top / scale,
+		           ( imageRect.right + scale - 1 ) / scale, ( imageRect.bottom + scale - 1 ) / scale );
+		           
+		pyramid = GetImageWindowPyramidBitmap ( window, -zoom, &bitmapRect );
+	}
+	
 	/*** Convert the resulting image rectangle to window coordinates, then
 	     draw the portion of the image bitmap inside the image rectangle
 	     into the portion of the window inside the window rectangle. ***/
 
-	windowRect = imageRect;
+	if ( pyramid != NULL )
+	{
+		GSetRect ( &windowRect, bitmapRect.left * scale, bitmapRect.top * scale,
+		           bitmapRect.right * scale, bitmapRect.bottom * scale );
+		
+		ImageToWindowRect ( window, &windowRect );
+		GDrawImage ( pyramid, &bitmapRect, &windowRect );
+	}
+	else
+	{
+		windowRect = imageRect;
 	
-	ImageToWindowRect ( window, &windowRect );
-	GDrawImage ( bitmap, &imageRect, &windowRect );
+		ImageToWindowRect ( window, &windowRect );
+		GDrawImage ( bitmap, &imageRect, &windowRect );
+	}
 	
 	/*** Now, paint the areas surrounding the image with black.  Note that
 	     there are up to 4 possible such areas, all rectangular in shape.
@@ -33,6 +33,7 @@
 /*** local functions ***/
 
 static void UpdateImageToolMenu ( void );
+static void UpdateProcessMenu ( int );
 static void UpdateMagnificationMenu ( GMenuPtr, GWindowPtr );
 static void UpdateMouseCoordinatesMenu ( GMenuPtr, GWindowPtr );
 
@@ -101,6 +102,10 @@ void DoMenuItem ( long menuID, long item )
 			DoMosaicMenuItem ( item );
 			break;
 			
+		case RESAMPLE_MENU_ID:
+			DoResampleMenuItem ( item );
+			break;
+			
 		case ANALYZE_MENU_ID:
 			DoAnalyzeMenuItem ( item );
 			break;
@@ -146,7 +151,7 @@ void UpdateMenus ( void )
         UpdateImageToolMenu();
         
         GEnableMainMenu ( DISPLAY_MENU, FALSE );
-        GEnableMainMenu ( PROCESS_MENU, FALSE );
+        UpdateProcessMenu ( FALSE );
 		GEnableMainMenu ( ANALYZE_MENU, FALSE );
 	}
 	else if ( GGetWindowClass ( window ) == IMAGE_WINDOW )
@@ -230,7 +235,7 @@ void UpdateMenus ( void )
 		
 		/*** Enable/disable "Process" menu items ***/
 		
-		GEnableMainMenu ( PROCESS_MENU, TRUE );
+		UpdateProcessMenu ( TRUE );
 		menu = GGetMainMenu ( PROCESS_MENU );
 		
 		if ( GetImageType ( image ) == IMAGE_TYPE_MONOCHROME )
@@ -281,7 +286,7 @@ void UpdateMenus ( void )
 
 		GEnableMainMenu ( EDIT_MENU, FALSE );
 		GEnableMainMenu ( DISPLAY_MENU, FALSE );
-		GEnableMainMenu ( PROCESS_MENU, FALSE );
+		UpdateProcessMenu ( FALSE );
 		GEnableMainMenu ( ANALYZE_MENU, FALSE );
 	}
 	else if ( GGetWindowClass ( window ) == HISTOGRAM_WINDOW )
@@ -309,7 +314,7 @@ void UpdateMenus ( void )
         GEnableMenuItem ( editMenu, EDIT_SELECT_NONE_ITEM, FALSE );
 		
 		GEnableMainMenu ( DISPLAY_MENU, FALSE );
-		GEnableMainMenu ( PROCESS_MENU, FALSE );
+		UpdateProcessMenu ( FALSE );
 		GEnableMainMenu ( ANALYZE_MENU, FALSE );
 	}
 	
@@ -358,6 +363,31 @@ void UpdateImageToolMenu ( void )
 }
 
 
+/*** UpdateProcessMenu **************************************************************
+
+	Enables the "Process" menu's items if an image window is active.  If not, only
+	the items which don't need one stay enabled: "Calibrate...", "Stack...", and
+	the "Resampling" sub-menu.  The menu itself is always enabled, so they can be
+	reached.  "Invert" is not implemented, so it is never enabled.
+
+*************************************************************************************/
+
+void UpdateProcessMenu ( int image )
+{
+	GMenuPtr	menu = GGetMainMenu ( PROCESS_MENU );
+	short		item, numItems = GGetNumMenuItems ( menu );
+	
+	GEnableMainMenu ( PROCESS_MENU, TRUE );
+	
+	for ( item = 1; item <= numItems; item++ )
+	{
+		if ( item == PROCESS_CALIBRATE_ITEM || item == PROCESS_STACK_ITEM || item == PROCESS_RESAMPLING_ITEM )
+			GEnableMenuItem ( menu, item, TRUE );
+		else
+			GEnableMenuItem ( menu, item, image && item != PROCESS_INVERT_ITEM );
+	}
+}
+
 /*** UpdateColorTableMenu ***/
 
 void UpdateColorTableMenu ( GWindowPtr window )
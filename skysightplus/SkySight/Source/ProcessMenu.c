@@ -82,6 +82,7 @@ static int DoClipDialogEvent ( short, GWindowPtr, long, long );
 
 static double **CreateImageAlignmentMatrix ( ImagePtr, ImagePtr );
 static int CreateImageAlignmentMatrices ( ImagePtr, ImagePtr, double ***, double *** );
+static long FindImageAlignmentPairs ( ImagePtr, ImagePtr, ImageObjectPtr **, ImageObjectPtr ** );
 static void TransformImageCoordinates ( double, double, double **, double *, double * );
 
 static void  SetPixelSliderValue ( GControlPtr, PIXEL, PIXEL, PIXEL );
@@ -112,6 +113,10 @@ static double		sScaleFactorVertical = 1.0;
 
 static double		sRotationAngle = 0.0;
 
+static short		sConvolveBorder = CONVOLVE_BORDER_MIRROR;
+
+static short		sResampleKernel = RESAMPLE_BICUBIC;
+
 /*** DoProcessMenuItem ***/
 
 void DoProcessMenuItem ( long item )
@@ -168,6 +173,18 @@ void DoProcessMenuItem ( long item )
 		case PROCESS_RGB_BALANCE_ITEM:
 			DoRGBBalance ( GetActiveImageWindow() );
 			break;
+			
+		case PROCESS_SUBTRACT_BACKGROUND_ITEM:
+			SubtractImageWindowBackground ( GetActiveImageWindow() );
+			break;
+			
+		case PROCESS_CALIBRATE_ITEM:
+			CalibrateImageWindow ( GetActiveImageWindow() );
+			break;
+			
+		case PROCESS_STACK_ITEM:
+			DoImageStacking();
+			break;
 	}
 }
 
@@ -255,16 +272,66 @@ void DoConvolveMenuItem ( long item )
 	short	width, height;
 	GWindowPtr window;
 	
+	/*** The items below the filters choose how the image is extended past its
+	     edges for all of the filters, until another is chosen.  Check the item
+	     chosen, and remember the choice. ***/
+	     
+	if ( item >= CONVOLVE_MIRROR_EDGES && item <= CONVOLVE_WRAP_EDGES )
+	{
+		GSetCheckedMenuItem ( GGetSubMenu ( GGetMainMenu ( PROCESS_MENU ), PROCESS_CONVOLVE_ITEM ),
+		CONVOLVE_MIRROR_EDGES, CONVOLVE_WRAP_EDGES, item );
+		
+		if ( item == CONVOLVE_EXTEND_EDGES )
+			sConvolveBorder = CONVOLVE_BORDER_EXTEND;
+		else if ( item == CONVOLVE_WRAP_EDGES )
+			sConvolveBorder = CONVOLVE_BORDER_WRAP;
+		else
+			sConvolveBorder = CONVOLVE_BORDER_MIRROR;
+			
+		return;
+	}
+	
 	window = GetActiveImageWindow();
 	filter = GetConvolutionFilter ( item, &width, &height );
 	
 	if ( window != NULL && filter != NULL )
 	{
-		ConvolveImageWindow ( window, filter, width, height );
+		ConvolveImageWindow ( window, filter, width, height, sConvolveBorder );
 		DeleteConvolutionFilter ( filter );
 	}
 }
 
+/*** DoResampleMenuItem ***/
+
+void DoResampleMenuItem ( long item )
+{
+	/*** The kernel chosen here is used to resample the image whenever it is
+	     shifted, scaled, rotated, aligned, or mosaicked, until another is
+	     chosen.  Check the item chosen, and remember the choice. ***/
+	     
+	GSetCheckedMenuItem ( GGetSubMenu ( GGetMainMenu ( PROCESS_MENU ), PROCESS_RESAMPLING_ITEM ),
+	RESAMPLE_NEAREST_ITEM, RESAMPLE_LANCZOS_ITEM, item );
+	
+	switch ( item )
+	{
+		case RESAMPLE_NEAREST_ITEM:
+			sResampleKernel = RESAMPLE_NEAREST;
+			break;
+			
+		case RESAMPLE_BILINEAR_ITEM:
+			sResampleKernel = RESAMPLE_BILINEAR;
+			break;
+			
+		case RESAMPLE_LANCZOS_ITEM:
+			sResampleKernel = RESAMPLE_LANCZOS;
+			break;
+			
+		default:
+			sResampleKernel = RESAMPLE_BICUBIC;
+			break;
+	}
+}
+
 /*** DoAlignMenuItem ***/
 
 void DoAlignMenuItem ( long item )
@@ -315,8 +382,9 @@ void FlipImageWindow ( GWindowPtr window, short item )
 {
 	ImagePtr		image = GetImageWindowImage ( window );
 	FITSImagePtr	oldFITS = NULL;
-	PIXEL			***oldMatrix, *data;
+	PIXEL			***oldMatrix, *data, *oldData;
 	short			cols, rows, frames, col, row, frame;
+	long			stride;
 	
 	/*** Determine the width, height, and number of frames in the image. ***/
 
@@ -337,19 +405,22 @@ void FlipImageWindow ( GWindowPtr window, short item )
 	     corresponding location in the previous image data matrix. ***/
 	
 	     
+	stride = GetImageDataStride ( image );
 	for ( frame = 0; frame < frames; frame++ )
 	{
-		for ( row = 0; row < rows; row++ )
+		data = GetImageDataRow ( image, frame, 0 );
+		oldData = oldMatrix[frame][0];
+		
+		for ( row = 0; row < rows; row++, data += stride )
 		{
-			data = GetImageDataRow ( image, frame, row );
-			for ( col = 0; col < cols; col++ )
+			if ( item == PROCESS_FLIP_HORIZONTALLY_ITEM )
 			{
-				if ( item == PROCESS_FLIP_HORIZONTALLY_ITEM )
-					data[col] = oldMatrix[frame][row][ cols - col - 1 ];
-					
-				if ( item == PROCESS_FLIP_VERTICALLY_ITEM )
-					data[col] = oldMatrix[frame][ rows - row - 1 ][col];
+				for ( col = 0; col < cols; col++ )
+					data[col] = oldData[ row * stride + cols - col - 1 ];
 			}
+			
+			if ( item == PROCESS_FLIP_VERTICALLY_ITEM )
+				memcpy ( data, oldData + ( rows - row - 1 ) * stride, cols * sizeof ( PIXEL ) );
 		}
 	}
 
@@ -570,10 +641,9 @@ void ShiftImageWindow ( GWindowPtr window, double right, double down, int wrap )
 {
 	ImagePtr		image = GetImageWindowImage ( window );
 	FITSImagePtr	oldFITS = NULL;
-	PIXEL			***oldMatrix = NULL, *data = NULL;
-	short			cols, rows, frame0, frame1;
-	double			oldRow, oldCol;
-	short			frame, row, col;
+	PIXEL			***oldMatrix = NULL;
+	short			cols, rows, frame0, frame1, frame;
+	double			**matrix = NULL;
 	
 //	PrepareUndo ( window );
 	
@@ -582,52 +652,47 @@ void ShiftImageWindow ( GWindowPtr window, double right, double down, int wrap )
 	cols = GetImageColumns ( image );
 	rows = GetImageRows ( image );
 	
+	/*** Create the matrix which transforms coordinates in the shifted image
+	     back to the original image.  On failure, return. ***/
+	     
+	matrix = NMatrix ( double, 3, 2 );
+	if ( matrix == NULL )
+		return;
+		
+	matrix[0][0] = 1.0;    matrix[0][1] = 0.0;
+	matrix[1][0] = 0.0;    matrix[1][1] = 1.0;
+	matrix[2][0] = -right; matrix[2][1] = -down;
+	
 	/*** Re-allocate the image window's image data matrix, and save a pointer
 	     to the previous image data matrix.  On failure, return. ***/
 
 	oldFITS = ResizeImageWindowImage ( window, cols, rows, TRUE );
 	if ( oldFITS == NULL )
+	{
+		NDestroyMatrix ( matrix );
 		return;
+	}
 	else
+	{
 		oldMatrix = oldFITS->data;
+	}
 			
-	/*** For each frame in the new image data matrix, copy the data from the
-	     corresponding location in the previous image data matrix. ***/
+	/*** Resample each selected frame of the previous image data matrix into
+	     the new one.  If we run out of memory, restore the previous image data
+	     matrix. ***/
 
 	GetImageWindowSelectedFrame ( window, &frame0, &frame1 );
 	
 	for ( frame = frame0; frame <= frame1; frame++ )
 	{
-		for ( row = 0; row < rows; row++ )
+		if ( ResampleImageFrame ( GetImageFITSImage ( image )->data[frame], NULL, cols, rows,
+		     oldMatrix[frame], cols, rows, matrix, sResampleKernel, wrap ? RESAMPLE_BORDER_WRAP : RESAMPLE_BORDER_ZERO ) == FALSE )
 		{
-			data = GetImageDataRow ( image, frame, row );
-			
-			oldRow = row - down;
-			
-			if ( wrap )
-			{
-				if ( oldRow < 0 )
-					oldRow = oldRow + rows;
-					
-				if ( oldRow >= rows )
-					oldRow = oldRow - rows;
-			}
-			
-			for ( col = 0; col < cols; col++ )
-			{
-				oldCol = col - right;
-				
-				if ( wrap )
-				{
-					if ( oldCol < 0 )
-						oldCol = oldCol + cols;
-						
-					if ( oldCol >= cols )
-						oldCol = oldCol - cols;
-				}
-
-				data[col] = InterpolatePixelValue ( oldMatrix[frame], cols, rows, oldCol, oldRow );
-			}
+			NDestroyMatrix ( matrix );
+			RestoreImageWindowImage ( window, oldFITS );
+			UpdateImage ( image );
+			WarningMessage ( G_OK_ALERT, CANT_ALLOCATE_MEMORY_STRING );
+			return;
 		}
 	}
 
@@ -635,6 +700,7 @@ void ShiftImageWindow ( GWindowPtr window, double right, double down, int wrap )
 	     any selected region of the image, since that region may no longer
 	     exist. ***/
 
+	NDestroyMatrix ( matrix );
 	FreeFITSImage ( oldFITS );
 	SetImageWindowSelectedRegion ( window, NULL );
 		
@@ -704,10 +770,10 @@ void ScaleImageWindow ( GWindowPtr window )
 {
 	ImagePtr		image = GetImageWindowImage ( window );
 	FITSImagePtr	oldFITS = NULL;
-	PIXEL			***oldMatrix = NULL, *data = NULL;
+	PIXEL			***oldMatrix = NULL;
 	short			oldRows, oldCols;
-	double			oldRow, oldCol;
-	short			frames, frame, row, col;
+	short			frames, frame;
+	double			**matrix = NULL;
 	
 	/*** Determine the image's current dimensions. ***/
 	
@@ -722,30 +788,49 @@ void ScaleImageWindow ( GWindowPtr window )
 	if ( GEnterModalDialog ( SCALE_DIALOG, 0, DoScaleDialogEvent ) == G_CANCEL_BUTTON )
 		return;
 		
+	/*** Create the matrix which transforms coordinates in the scaled image
+	     back to the original image.  The pixels' outer edges, rather than their
+	     centers, line up in both images.  On failure, return. ***/
+	     
+	matrix = NMatrix ( double, 3, 2 );
+	if ( matrix == NULL )
+		return;
+		
+	matrix[0][0] = 1.0 / sScaleFactorHorizontal;
+	matrix[0][1] = 0.0;
+	matrix[1][0] = 0.0;
+	matrix[1][1] = 1.0 / sScaleFactorVertical;
+	matrix[2][0] = 0.5 / sScaleFactorHorizontal - 0.5;
+	matrix[2][1] = 0.5 / sScaleFactorVertical - 0.5;
+	
 	/*** Re-allocate the image window's image data matrix, and save a pointer
 	     to the previous image data matrix.  On failure, return. ***/
 
 	oldFITS = ResizeImageWindowImage ( window, sScaleImageWidth, sScaleImageHeight, FALSE );
 	if ( oldFITS == NULL )
+	{
+		NDestroyMatrix ( matrix );
 		return;
+	}
 	else
+	{
 		oldMatrix = oldFITS->data;
+	}
 			
-	/*** For each frame in the new image data matrix, copy the data from the
-	     corresponding location in the previous image data matrix. ***/
+	/*** Resample each frame of the previous image data matrix into the new one.
+	     If we run out of memory, restore the previous image data matrix. ***/
 
 	frames = GetImageFrames ( image );
 	for ( frame = 0; frame < frames; frame++ )
 	{
-		for ( row = 0; row < sScaleImageHeight; row++ )
+		if ( ResampleImageFrame ( GetImageFITSImage ( image )->data[frame], NULL, sScaleImageWidth, sScaleImageHeight,
+		     oldMatrix[frame], oldCols, oldRows, matrix, sResampleKernel, RESAMPLE_BORDER_ZERO ) == FALSE )
 		{
-			oldRow = row / sScaleFactorVertical;
-			data = GetImageDataRow ( image, frame, row );
-			for ( col = 0; col < sScaleImageWidth; col++ )
-			{
-				oldCol = col / sScaleFactorHorizontal;
-				data[col] = InterpolatePixelValue ( oldMatrix[frame], oldCols, oldRows, oldCol, oldRow );
-			}
+			NDestroyMatrix ( matrix );
+			RestoreImageWindowImage ( window, oldFITS );
+			UpdateImage ( image );
+			WarningMessage ( G_OK_ALERT, CANT_ALLOCATE_MEMORY_STRING );
+			return;
 		}
 	}
 
@@ -753,6 +838,7 @@ void ScaleImageWindow ( GWindowPtr window )
 	     any selected region of the image, since that region may no longer
 	     exist. ***/
 
+	NDestroyMatrix ( matrix );
 	FreeFITSImageDataMatrix ( oldMatrix );
 	SetImageWindowSelectedRegion ( window, NULL );
 		
@@ -964,11 +1050,11 @@ int DoScaleDialogEvent ( short event, GWindowPtr dialog, long param1, long param
 void RotateImageWindow ( GWindowPtr window, double angle )
 {
 	double			rotation[3][3];
-	double			corners[4][3], vector[3], left, right, top, bottom;
-	short			oldCols, oldRows, frames, width, height, col, row, frame, i;
+	double			corners[4][3], vector[3], left, right, top, bottom, **matrix;
+	short			oldCols, oldRows, frames, width, height, frame, i;
 	ImagePtr		image = GetImageWindowImage ( window );
 	FITSImagePtr	oldFITS;
-	PIXEL			***oldMatrix, *data;
+	PIXEL			***oldMatrix;
 	
 	/*** Convert the angle to degree, then determine the image's current
 	     dimensions and number of frames. ***/
@@ -1029,38 +1115,67 @@ void RotateImageWindow ( GWindowPtr window, double angle )
 	width = right - left;
 	height = top - bottom;
 	
+	/*** Determine the rotation matrix which will transform coordinates
+	     from the image's new coordinate system into the old one (this is
+	     the opposite of the matrix we computed above). ***/
+
+	SetRotationMatrix ( rotation, 1, 2, -angle );
+	
+	/*** From it, build the matrix which transforms (col,row) in the new
+	     image to (col,row) in the old one, by transforming the centers of
+	     the new image's first pixel and its right and lower neighbors.  Pixel
+	     (col,row) has its center at (col + 0.5, row + 0.5) in the coordinate
+	     system used for the corners. ***/
+	
+	matrix = NMatrix ( double, 3, 2 );
+	if ( matrix == NULL )
+		return;
+		
+	for ( i = 0; i < 3; i++ )
+	{
+		vector[0] = left + 0.5 + ( i == 1 );
+		vector[1] = top - 0.5 - ( i == 2 );
+		vector[2] = 0;
+		
+		TransformVector ( rotation, vector );
+		corners[i][0] = vector[0] - 0.5;
+		corners[i][1] = -vector[1] - 0.5;
+	}
+	
+	matrix[0][0] = corners[1][0] - corners[0][0];
+	matrix[0][1] = corners[1][1] - corners[0][1];
+	matrix[1][0] = corners[2][0] - corners[0][0];
+	matrix[1][1] = corners[2][1] - corners[0][1];
+	matrix[2][0] = corners[0][0];
+	matrix[2][1] = corners[0][1];
+	
 	/*** Re-allocate the image window's image data matrix, and save a pointer
 	     to the previous image data matrix.  On failure, return. ***/
 
 	oldFITS = ResizeImageWindowImage ( window, width, height, FALSE );
 	if ( oldFITS == NULL )
+	{
+		NDestroyMatrix ( matrix );
 		return;
+	}
 	else
+	{
 		oldMatrix = oldFITS->data;
-		
-	/*** Determine the rotation matrix which will transform coordinates
-	     from the image's new coordinate system into the old one (this is
-	     the opposite of the matrix we computed above). ***/
-
-	SetRotationMatrix ( rotation, 1, 2, -angle );
+	}
 			
-	/*** For each frame in the new image data matrix, copy the data from the
-	     corresponding location in the previous image data matrix. ***/
+	/*** Resample each frame of the previous image data matrix into the new one.
+	     If we run out of memory, restore the previous image data matrix. ***/
 
 	for ( frame	= 0; frame < frames; frame++ )
 	{
-		for ( row = 0; row < height; row++ )
+		if ( ResampleImageFrame ( GetImageFITSImage ( image )->data[frame], NULL, width, height,
+		     oldMatrix[frame], oldCols, oldRows, matrix, sResampleKernel, RESAMPLE_BORDER_ZERO ) == FALSE )
 		{
-			data = GetImageDataRow ( image, frame, row );
-			for ( col = 0; col < width; col++ )
-			{
-				vector[0] = col + left;
-				vector[1] = top - row;
-				vector[2] = 0;
-				
-				TransformVector ( rotation, vector );
-				data[col] = InterpolatePixelValue ( oldMatrix[frame], oldCols, oldRows, vector[0], -vector[1] );
-			}
+			NDestroyMatrix ( matrix );
+			RestoreImageWindowImage ( window, oldFITS );
+			UpdateImage ( image );
+			WarningMessage ( G_OK_ALERT, CANT_ALLOCATE_MEMORY_STRING );
+			return;
 		}
 	}
 
@@ -1068,6 +1183,7 @@ void RotateImageWindow ( GWindowPtr window, double angle )
 	     any selected region of the image, since that region may no longer
 	     exist. ***/
 
+	NDestroyMatrix ( matrix );
 	FreeFITSImage ( oldFITS );
 	SetImageWindowSelectedRegion ( window, NULL );
 		
@@ -1078,17 +1194,29 @@ void RotateImageWindow ( GWindowPtr window, double angle )
 	UpdateImage ( image );
 }
 
-/*** ConvolveImageWindow **********************************************************/
+/*** ConvolveImageWindow **********************************************************
+
+	Convolves every frame of an image window's image with a filter.
+	
+	void ConvolveImageWindow ( GWindowPtr window, float **filter, short filterCols,
+	     short filterRows, short border )
+	
+	(window):     pointer to image window.
+	(filter):     matrix of filter coefficients.
+	(filterCols): width of filter matrix.
+	(filterRows): height of filter matrix.
+	(border):     how to treat pixels beyond the image edges; see ConvolveImageFrame().
+
+	The function returns nothing.
+	
+***********************************************************************************/
 
-void ConvolveImageWindow ( GWindowPtr window, float **filter, short filterCols, short filterRows )
+void ConvolveImageWindow ( GWindowPtr window, float **filter, short filterCols, short filterRows, short border )
 {
 	ImagePtr		image = GetImageWindowImage ( window );
-	PIXEL			***oldMatrix, *data;
+	PIXEL			***oldMatrix, ***newMatrix;
 	FITSImagePtr	oldFITS;
-	short			rows, cols, frames, row, col, frame;
-	short			oldLeft, oldTop, oldRight, oldBottom, oldRow, oldCol;
-	short			filterRow, filterCol, filterCtrRow, filterCtrCol;
-	float			value;
+	short			rows, cols, frames, frame;
 	
 	frames = GetImageFrames ( image );
 	rows   = GetImageRows ( image );
@@ -1103,46 +1231,24 @@ void ConvolveImageWindow ( GWindowPtr window, float **filter, short filterCols,
 	else
 		oldMatrix = oldFITS->data;
 		
-	/*** Locate the central pixel of the filter. ***/
+	/*** Filter each frame from the previous image data matrix into the new one.
+	     If we run out of memory, restore the previous image data matrix. ***/
 	
-	filterCtrRow = filterRows / 2;
-	filterCtrCol = filterCols / 2;
+	newMatrix = GetImageFITSImage ( image )->data;
 	
 	for ( frame = 0; frame < frames; frame++ )
 	{
-		for ( row = 0; row < rows; row++ )
+		if ( ConvolveImageFrame ( newMatrix[frame], oldMatrix[frame], cols, rows,
+		     filter, filterCols, filterRows, border ) == FALSE )
 		{
-			oldTop = row - filterCtrRow;
-			oldBottom = oldTop + filterRows;
-			
-			data = GetImageDataRow ( image, frame, row );
-			
-			for ( col = 0; col < cols; col++ )
-			{
-				oldLeft = col - filterCtrCol;
-				oldRight = oldLeft + filterCols;
-				
-				if ( oldLeft >= 0 && oldRight < cols && oldTop >= 0 && oldBottom < rows )
-				{
-					value = 0;
-					
-					for ( filterRow = 0, oldRow = oldTop; oldRow < oldBottom; filterRow++, oldRow++ )
-						for ( filterCol = 0, oldCol = oldLeft; oldCol < oldRight; filterCol++, oldCol++ )
-							value += filter[ filterRow ][ filterCol ] * oldMatrix[ frame ][ oldRow ][ oldCol ];
-
-					data[col] = value;
-				}
-				else
-				{
-					data[col] = oldMatrix[frame][row][col];
-				}		
-			}
+			FreeFITSImage ( GetImageFITSImage ( image ) );
+			SetImageFITSImage ( image, oldFITS );
+			WarningMessage ( G_OK_ALERT, CANT_ALLOCATE_MEMORY_STRING );
+			return;
 		}
 	}
 	
-	/*** Now release memory for the previous image data matrix.  De-select
-	     any selected region of the image, since that region may no longer
-	     exist. ***/
+	/*** Now release memory for the previous image data matrix. ***/
 
 	FreeFITSImage ( oldFITS );
 	
@@ -1152,6 +1258,317 @@ void ConvolveImageWindow ( GWindowPtr window, float **filter, short filterCols,
 	UpdateImage ( image );
 }
 
+/*** SubtractImageWindowBackground ************************************************
+
+	Subtracts the sky background from every frame of an image window's image,
+	leaving the background at zero.
+	
+	void SubtractImageWindowBackground ( GWindowPtr window )
+	
+	(window): pointer to image window.
+
+	The function returns nothing.  Each frame's background map is obtained with
+	GetImageBackground(), so the map already computed for finding objects in the
+	image is reused rather than computed again.
+	
+***********************************************************************************/
+
+void SubtractImageWindowBackground ( GWindowPtr window )
+{
+	ImagePtr			image = GetImageWindowImage ( window );
+	ImageBackgroundPtr	background;
+	short				frames, frame;
+	
+	frames = GetImageFrames ( image );
+	
+	for ( frame = 0; frame < frames; frame++ )
+	{
+		background = GetImageBackground ( image, frame );
+		if ( background == NULL || SubtractImageBackground ( background, GetImageDataFrame ( image, frame ) ) == FALSE )
+		{
+			WarningMessage ( G_OK_ALERT, CANT_ALLOCATE_MEMORY_STRING );
+			break;
+		}
+	}
+	
+	/*** Perform any window updating that needs to be done, now that the
+	     underlying image data has changed.  This also discards the
+	     background map, which no longer matches the image. ***/
+
+	UpdateImage ( image );
+}
+
+/*** CalibrateImageWindow *********************************************************
+
+	Lets the user select bias, dark and flat frames, combines each set into a
+	master frame, and calibrates an image window's image with the masters.
+	
+	void CalibrateImageWindow ( GWindowPtr window )
+	
+	(window): pointer to image window, or NULL for none.
+
+	The function returns nothing.  The user is asked for each type of frame in
+	turn, and may cancel any of them to go without that master.  Each set is
+	combined by CreateImageCalibrationMaster() with a winsorized clip, and the
+	masters are cached in the "Calibration" directory next to the application, so
+	choosing the same files again later doesn't mean combining them all over again.
+	
+	The masters are then given to the active camera, if it is idle, which applies
+	them to its light image exposures as they are downloaded from then on; see
+	SetCameraCalibration().
+	
+***********************************************************************************/
+
+void CalibrateImageWindow ( GWindowPtr window )
+{
+	static short		formats[3] = { 1, 1, 1 };
+	char				prompt[256], filter[256];
+	short				type;
+	long				numFiles, i;
+	int					result = TRUE, created = FALSE;
+	GPathPtr			cachePath, *paths;
+	ImageCalibrationPtr	calibration;
+	ImagePtr			image;
+	CameraPtr			camera;
+	
+	/*** Keep the master frames in a directory next to the application,
+	     creating it if needed; without one, they just aren't cached. ***/
+	     
+	if ( ( cachePath = GCreatePath ( NULL ) ) != NULL )
+	{
+		GGetApplicationFilePath ( cachePath );
+		GGetParentDirectory ( cachePath );
+		GAppendPathName ( cachePath, "Calibration" );
+		
+		if ( ! GDirectoryExists ( cachePath ) && ! GCreateDirectory ( cachePath ) )
+		{
+			GDeletePath ( cachePath );
+			cachePath = NULL;
+		}
+	}
+	
+	calibration = NewImageCalibration ( cachePath );
+	if ( cachePath != NULL )
+		GDeletePath ( cachePath );
+		
+	if ( calibration == NULL )
+	{
+		WarningMessage ( G_OK_ALERT, CANT_ALLOCATE_MEMORY_STRING );
+		return;
+	}
+	
+	/*** Ask for the bias, dark and flat frames in that order, since each
+	     master has the ones before it subtracted from it. ***/
+	     
+	GGetString ( CALIBRATION_FILE_FILTER_STRING, filter );
+	
+	for ( type = IMAGE_CALIBRATION_BIAS; type <= IMAGE_CALIBRATION_FLAT && result; type++ )
+	{
+		GGetString ( CALIBRATION_BIAS_PROMPT_STRING + type - IMAGE_CALIBRATION_BIAS, prompt );
+		
+		numFiles = GDoOpenFilesDialog ( prompt, filter, &formats[ type - IMAGE_CALIBRATION_BIAS ], &paths );
+		if ( numFiles < 1 )
+			continue;
+			
+		GSetWaitCursor();
+		result = CreateImageCalibrationMaster ( calibration, type, paths, numFiles, IMAGE_STACK_WINSORIZED_CLIP, 3.0, 5 );
+		GSetArrowCursor();
+		
+		if ( result )
+			created = TRUE;
+		else
+			GDoAlert ( G_ERROR_ALERT, G_OK_ALERT, "Can't combine the selected files into a master frame.  They must all be FITS images of the same size." );
+			
+		for ( i = 0; i < numFiles; i++ )
+			GDeletePath ( paths[i] );
+			
+		free ( paths );
+	}
+	
+	if ( result == FALSE || created == FALSE )
+	{
+		DeleteImageCalibration ( calibration );
+		return;
+	}
+	
+	/*** Calibrate the window's image, then perform any window updating that
+	     needs to be done, now that the underlying image data has changed. ***/
+	
+	if ( window != NULL )
+	{
+		image = GetImageWindowImage ( window );
+		
+		if ( CalibrateImage ( calibration, image, GetImageExposureLength ( image ) ) )
+			UpdateImage ( image );
+		else
+			GDoAlert ( G_ERROR_ALERT, G_OK_ALERT, "The image is not the same size as the master frames, so it has not been calibrated." );
+	}
+	
+	/*** Hand the masters over to the camera, for its downloads.  Don't swap
+	     them while it's exposing, since an image being downloaded may be
+	     using the old ones. ***/
+	     
+	camera = GetActiveCamera();
+	if ( camera != NULL && GetCameraExposure ( camera ) == NULL )
+	{
+		SetCameraCalibration ( camera, calibration );
+	}
+	else
+	{
+		if ( camera != NULL )
+			GDoAlert ( G_INFO_ALERT, G_OK_ALERT, "The camera is busy, so the master frames will not be applied to the images it downloads." );
+			
+		DeleteImageCalibration ( calibration );
+	}
+}
+
+/*** DoImageStacking *************************************************************
+
+	Lets the user select a set of images, aligns them with the first, and combines
+	them into a new image window.
+	
+	void DoImageStacking ( void )
+	
+	The function returns nothing.  Each file is read in turn, its stars are found
+	with DetectImageObjects() and fitted with FitImageObjects(), and the matrix
+	which carries the first image's coordinates to its own is worked out from the
+	stars they have in common by CreateImageAlignmentMatrix(); only the first
+	image and the one being aligned with it are kept in memory.  The files are
+	then combined by StackImageFiles() with a winsorized clip, through those
+	matrices, so the stack lines up with the first image.
+	
+	If a file can't be read, or can't be aligned with the first, nothing is
+	stacked.
+	
+***********************************************************************************/
+
+void DoImageStacking ( void )
+{
+	static short	format = 1;
+	char			prompt[256], filter[256];
+	long			numFiles, i, n;
+	int				result = TRUE;
+	double			***transforms;
+	GPathPtr		*paths;
+	GWindowPtr		window;
+	ImagePtr		image, reference = NULL;
+	ImageObjectPtr	*objects;
+	
+	GGetString ( STACK_PROMPT_STRING, prompt );
+	GGetString ( CALIBRATION_FILE_FILTER_STRING, filter );
+	
+	numFiles = GDoOpenFilesDialog ( prompt, filter, &format, &paths );
+	if ( numFiles < 1 )
+		return;
+		
+	transforms = (double ***) calloc ( numFiles, sizeof ( double ** ) );
+	if ( transforms == NULL )
+	{
+		for ( i = 0; i < numFiles; i++ )
+			GDeletePath ( paths[i] );
+			
+		free ( paths );
+		WarningMessage ( G_OK_ALERT, CANT_ALLOCATE_MEMORY_STRING );
+		return;
+	}
+	
+	GSetWaitCursor();
+	
+	/*** Find the stars in each image, and align each one after the first with
+	     it.  The first image's own matrix stays NULL, since the stack has its
+	     coordinates. ***/
+	     
+	for ( i = 0; i < numFiles && result; i++ )
+	{
+		image = ReadFITSImageFile ( paths[i] );
+		if ( image == NULL )
+		{
+			GSetArrowCursor();
+			GDoAlert ( G_ERROR_ALERT, G_OK_ALERT, "Can't read one of the selected files.  They must all be FITS images of the same size." );
+			result = FALSE;
+			break;
+		}
+		
+		objects = NULL;
+		n = DetectImageObjects ( image, 0, 1.3, 3.0, &objects );
+		if ( n < 0 )
+		{
+			GSetArrowCursor();
+			WarningMessage ( G_OK_ALERT, CANT_ALLOCATE_MEMORY_STRING );
+			DeleteImage ( image );
+			result = FALSE;
+			break;
+		}
+		
+		if ( objects != NULL )
+		{
+			FitImageObjects ( GetImageDataFrame ( image, 0 ), objects, n, PIXEL_MIN, PIXEL_MAX, 0.0001, 100 );
+			InvalidateImageObjectIndex ( image );
+			free ( objects );
+		}
+		
+		if ( reference == NULL )
+		{
+			reference = image;
+			continue;
+		}
+		
+		transforms[i] = CreateImageAlignmentMatrix ( reference, image );
+		if ( transforms[i] == NULL )
+		{
+			GSetArrowCursor();
+			result = FALSE;
+		}
+		
+		DeleteImage ( image );
+	}
+	
+	if ( reference != NULL )
+		DeleteImage ( reference );
+		
+	/*** Now combine the files through the matrices, and release them. ***/
+	
+	image = NULL;
+	if ( result )
+	{
+		image = StackImageFiles ( paths, transforms, numFiles, IMAGE_STACK_WINSORIZED_CLIP, 3.0, 5 );
+		GSetArrowCursor();
+		
+		if ( image == NULL )
+			GDoAlert ( G_ERROR_ALERT, G_OK_ALERT, "Can't combine the selected files.  They must all be FITS images of the same size." );
+	}
+	
+	for ( i = 0; i < numFiles; i++ )
+	{
+		if ( transforms[i] != NULL )
+			NDestroyMatrix ( transforms[i] );
+			
+		GDeletePath ( paths[i] );
+	}
+	
+	free ( transforms );
+	free ( paths );
+	
+	if ( image == NULL )
+		return;
+		
+	/*** Display the stack in a new image window. ***/
+	
+	window = NewImageWindow ( image );
+	if ( window == NULL )
+	{
+		DeleteImage ( image );
+		WarningMessage ( G_OK_ALERT, CANT_ALLOCATE_MEMORY_STRING );
+		return;
+	}
+	
+	ComputeImageDisplayRange ( window );
+	DrawImageWindowBitmap ( window );
+	SetImageWindowNeedsSave ( window, TRUE );
+	CropImageWindow ( window );
+	GSetActiveWindow ( window );
+}
+
 /*** GetConvolutionFilter ***/
 
 float **GetConvolutionFilter ( short item, short *width, short *height )
@@ -1551,18 +1968,22 @@ void ClipImageData ( FITSImagePtr oldFITS, FITSImagePtr newFITS, PIXEL oldMax, P
 {
 	PIXEL			*oldData, *newData;
 	short			rows, cols, frames, row, col, frame;
+	long			oldStride, newStride;
 	
 	frames = oldFITS->naxis3;
 	rows   = oldFITS->naxis2;
 	cols   = oldFITS->naxis1;
 	
+	oldStride = GetFITSImageDataStride ( oldFITS->data );
+	newStride = GetFITSImageDataStride ( newFITS->data );
+	
 	for ( frame = 0; frame < frames; frame++ )
 	{
-		for ( row = 0; row < rows; row++ )
-		{
-			oldData = oldFITS->data[frame][row];
-			newData = newFITS->data[frame][row];
+		oldData = oldFITS->data[frame][0];
+		newData = newFITS->data[frame][0];
 
+		for ( row = 0; row < rows; row++, oldData += oldStride, newData += newStride )
+		{
 			for ( col = 0; col < cols; col++ )
 			{
 				if ( oldData[col] > oldMax )
@@ -1592,9 +2013,9 @@ void ClipImageData ( FITSImagePtr oldFITS, FITSImagePtr newFITS, PIXEL oldMax, P
 	
 void AlignImageWindow ( GWindowPtr window1, GWindowPtr window2 )
 {
-	short			cols, rows, frames, col2, row2, frame2;
-	PIXEL			***oldMatrix, *newDataRow;
-	double			**matrix = NULL, x1, y1;
+	short			cols, rows, frames, frame;
+	PIXEL			***oldMatrix;
+	double			**matrix = NULL;
 	ImagePtr		image1 = GetImageWindowImage ( window1 );
 	ImagePtr		image2 = GetImageWindowImage ( window2 );
 	ImageObjectPtr	object1 = NULL, object2 = NULL;
@@ -1633,21 +2054,18 @@ void AlignImageWindow ( GWindowPtr window1, GWindowPtr window2 )
 		oldMatrix = oldFITS->data;
 	}
 	
-	/*** Copy the image data into the new matrix from the old one. ***/
+	/*** Resample the image data into the new matrix from the old one.  If we
+	     run out of memory, restore the previous image data matrix. ***/
 	
-	for ( frame2 = 0; frame2 < frames; frame2++ )
+	for ( frame = 0; frame < frames; frame++ )
 	{
-		for ( row2 = 0; row2 < rows; row2++ )
+		if ( ResampleImageFrame ( GetImageFITSImage ( image1 )->data[frame], NULL, cols, rows,
+		     oldMatrix[frame], cols, rows, matrix, sResampleKernel, RESAMPLE_BORDER_ZERO ) == FALSE )
 		{
-			newDataRow = GetImageDataRow ( image1, frame2, row2 );
-	
-			for ( col2 = 0; col2 < cols; col2++ )
-			{
-				x1 = col2 * matrix[0][0] + col2 * matrix[1][0] + matrix[2][0];
-				y1 = row2 * matrix[0][1] + row2 * matrix[1][1] + matrix[2][1];
-				
-				newDataRow[col2] = InterpolatePixelValue ( oldMatrix[frame2], cols, rows, x1, y1 );
-			}
+			NDestroyMatrix ( matrix );
+			RestoreImageWindowImage ( window1, oldFITS );
+			GDoAlert ( G_ERROR_ALERT, G_OK_ALERT, "Can't allocate memory to align image." );
+			return;
 		}
 	}
 	
@@ -1669,14 +2087,14 @@ void AlignImageWindow ( GWindowPtr window1, GWindowPtr window2 )
 
 void MosaicImageWindow ( GWindowPtr window1, GWindowPtr window2 )
 {
-	int				i, in1, in2;
+	int				i;
 	short			width1, height1, col1, row1;
-	short			width2, height2, col2, row2;
+	short			width2, height2;
 	short			left, top, right, bottom, width, height, col, row, frame;
 	PIXEL			***data = NULL, ***data1 = NULL, ***data2 = NULL;
-	PIXEL			value1, value2;
-	double			**transformation = NULL, x1, y1, x2, y2;
-	double			corners[4][2];
+	unsigned char	**in2 = NULL;
+	double			**transformation = NULL;
+	double			corners[4][3];
 	ImagePtr		image1 = GetImageWindowImage ( window1 );
 	ImagePtr		image2 = GetImageWindowImage ( window2 );
 	ImageObjectPtr	object1 = NULL, object2 = NULL;
@@ -1768,78 +2186,70 @@ void MosaicImageWindow ( GWindowPtr window1, GWindowPtr window2 )
 	transformation = CreateImageAlignmentMatrix ( image1, image2 );
 	if ( transformation == NULL )
 	{
+		RestoreImageWindowImage ( window1, oldFITS1 );
+		UpdateImage ( image1 );
 		GDoAlert ( G_ERROR_ALERT, G_OK_ALERT, "Can't create image alignment matrix!" );
 		return;
 	}
 
+	/*** Since the combined image's (col,row) is (col + left, row + top) in
+	     the first image, fold that offset into the transformation, so that it
+	     takes the combined image's coordinates to the second image's. ***/
+	     
+	transformation[2][0] += left * transformation[0][0] + top * transformation[1][0];
+	transformation[2][1] += left * transformation[0][1] + top * transformation[1][1];
+	
 	/*** Obtain pointers to the second image's data matrix, and to the first
-	     image's newly reallocated data matrix. ***/
+	     image's newly reallocated data matrix.  Allocate a matrix to record
+	     which pixels of the combined image the second image covers. ***/
 	     
 	data2 = GetImageFITSImage ( image2 )->data;
 	data  = GetImageFITSImage ( image1 )->data;
 	
-	/*** For each pixel in the new, combined image, copy the data from the
-	     corresponding location in the other, separate images.  Average the
-	     values from the other images where they overlap. ***/
+	in2 = NMatrix ( unsigned char, height, width );
+	if ( in2 == NULL )
+	{
+		NDestroyMatrix ( transformation );
+		RestoreImageWindowImage ( window1, oldFITS1 );
+		UpdateImage ( image1 );
+		GDoAlert ( G_ERROR_ALERT, G_OK_ALERT, "Can't allocate memory to align image." );
+		return;
+	}
+	
+	/*** For each frame, resample the second image into the new, combined
+	     image.  Then combine it with the data from the corresponding location
+	     in the first image.  Average the values from the two images where
+	     they overlap; pixels which lie in neither image are left at zero. ***/
 	
 	for ( frame = 0; frame < 1 /* deal with multi-frames later */; frame++ )
 	{
+		if ( ResampleImageFrame ( data[frame], in2, width, height, data2[frame], width2, height2,
+		     transformation, sResampleKernel, RESAMPLE_BORDER_ZERO ) == FALSE )
+		{
+			NDestroyMatrix ( in2 );
+			NDestroyMatrix ( transformation );
+			RestoreImageWindowImage ( window1, oldFITS1 );
+			UpdateImage ( image1 );
+			GDoAlert ( G_ERROR_ALERT, G_OK_ALERT, "Can't allocate memory to align image." );
+			return;
+		}
+		
 		for ( row = 0; row < height; row++ )
 		{
+			row1 = row + top;
+			if ( row1 < 0 || row1 >= height1 )
+				continue;
+				
 			for ( col = 0; col < width; col++ )
 			{
-				/*** Compute corresponding location in the first image.
-				     If it lies within the first image's boundaries, determine
-				     the first image's pixel value at that location. ***/
-				
-				row1 = row + top;
 				col1 = col + left;
-				
-				if ( col1 >= 0 && col1 < width1 && row1 >= 0 && row1 < height1 )
-				{
-					value1 = data1[frame][row1][col1];
-					in1 = TRUE;
-				}
-				else
-				{
-					in1 = FALSE;
-				}
-				
-				/*** Compute corresponding location in the second image.
-				     If it lies within the second image's boundaries, determine
-				     the second image's pixel value at that location. ***/
-								
-				TransformImageCoordinates ( col1, row1, transformation, &x2, &y2 );
-				
-				if ( x2 >= 0 && x2 < width2 && y2 < height2 && y2 >= 0 )
-				{
-					value2 = InterpolatePixelValue ( data2[frame], width2, height2, x2, y2 );
-					in2 = TRUE;
-				}
-				else
-				{
-					in2 = FALSE;
-				}	
-				
-				/*** If the pixel lies in both images, average the values from
-				     those images; otherwise, if the pixel lies in only one of the
-				     images, take the value from the image in which it lies.  If the
-				     pixel doesn't lie in either image, set its value to zero. ***/
-				    
-				if ( in1 )
-				{
-					if ( in2 )
-						data[frame][row][col] = ( value1 + value2 ) / 2;
-					else
-						data[frame][row][col] = value1;
-				}
+				if ( col1 < 0 || col1 >= width1 )
+					continue;
+					
+				if ( in2[row][col] )
+					data[frame][row][col] = ( data1[frame][row1][col1] + data[frame][row][col] ) / 2;
 				else
-				{
-					if ( in2 )
-						data[frame][row][col] = value2;
-					else
-						data[frame][row][col] = 0;
-				}
+					data[frame][row][col] = data1[frame][row1][col1];
 			}
 		}
 	}
@@ -1848,6 +2258,7 @@ void MosaicImageWindow ( GWindowPtr window1, GWindowPtr window2 )
 	     any selected region of the image, since that region may no longer
 	     exist. ***/
 
+	NDestroyMatrix ( in2 );
 	NDestroyMatrix ( transformation );
 	FreeFITSImage ( oldFITS1 );
 	SetImageWindowSelectedRegion ( window1, NULL );
@@ -1859,15 +2270,83 @@ void MosaicImageWindow ( GWindowPtr window1, GWindowPtr window2 )
 	UpdateImage ( image1 );
 }
 
+/*** FindImageAlignmentPairs *******************************************************
+
+	Finds pairs of corresponding objects in two images, for use in aligning them.
+	
+	long FindImageAlignmentPairs ( ImagePtr image1, ImagePtr image2,
+	     ImageObjectPtr **objects1, ImageObjectPtr **objects2 )
+
+	The function first tries to match the images' objects automatically by the
+	patterns they form, with MatchImageObjects().  If it can't, it pairs up
+	objects with the same name in both images, as marked by hand.  It returns
+	the number of pairs found, or -1 if it can't allocate memory.  If it finds
+	any, it allocates arrays of the objects in each pair, which you should free().
+	
+*************************************************************************************/
+
+static long FindImageAlignmentPairs ( ImagePtr image1, ImagePtr image2,
+ImageObjectPtr **objects1, ImageObjectPtr **objects2 )
+{
+	long			n, pass, position;
+	ImageObjectPtr	object1, object2;
+	
+	n = MatchImageObjects ( image1, image2, objects1, objects2 );
+	if ( n != 0 )
+		return ( n );
+		
+	/*** Count the pairs of objects with common names on the first pass,
+	     then allocate the arrays and fill them in on the second. ***/
+	     
+	for ( pass = 0; pass < 2; pass++ )
+	{
+		n = 0;
+		
+		for ( object1 = GetImageObjectList ( image1 ); object1 != NULL; object1 = GetNextImageObject ( object1 ) )
+		{
+			position = -1;
+			while ( ( object2 = FindImageObjectByName ( image2, GetImageRegionName ( object1 ), &position ) ) != NULL )
+			{
+				if ( pass == 1 )
+				{
+					(*objects1)[n] = object1;
+					(*objects2)[n] = object2;
+				}
+				
+				n++;
+			}
+		}
+		
+		if ( n == 0 || pass == 1 )
+			break;
+			
+		*objects1 = (ImageObjectPtr *) malloc ( n * sizeof ( ImageObjectPtr ) );
+		*objects2 = (ImageObjectPtr *) malloc ( n * sizeof ( ImageObjectPtr ) );
+		
+		if ( *objects1 == NULL || *objects2 == NULL )
+		{
+			if ( *objects1 != NULL )
+				free ( *objects1 );
+				
+			if ( *objects2 != NULL )
+				free ( *objects2 );
+				
+			*objects1 = *objects2 = NULL;
+			return ( -1 );
+		}
+	}
+	
+	return ( n );
+}
+
 /*** CreateImageAlignmentMatrices ***/
 
 int CreateImageAlignmentMatrices ( ImagePtr image1, ImagePtr image2, double ***b12, double ***b21 )
 {
-	char			*name1 = NULL, *name2 = NULL;
 	int				result = FALSE;
-	long			n = 0;
+	long			n = 0, i;
 	double			x1[3], x2[3], **a12 = NULL, **a21 = NULL;
-	ImageObjectPtr	object1 = NULL, object2 = NULL;
+	ImageObjectPtr	*objects1 = NULL, *objects2 = NULL;
 
 	/*** Allocate/initialize normal equation matrices.  On failure, display
 	     a warning message, and return. ***/
@@ -1886,45 +2365,39 @@ int CreateImageAlignmentMatrices ( ImagePtr image1, ImagePtr image2, double ***b
 		return ( result );
 	}
 
-	/*** Find objects with common names in both images.  For each common object,
+	/*** Find corresponding objects in both images.  For each pair of objects,
 	     augment the normal equation matrices. ***/
 	     
-	n = 0;
-	object1 = GetImageObjectList ( image1 );
-	while ( object1 != NULL )
+	n = FindImageAlignmentPairs ( image1, image2, &objects1, &objects2 );
+	
+	for ( i = 0; i < n; i++ )
 	{
-		object2 = GetImageObjectList ( image2 );
-		while ( object2 != NULL )
-		{
-			name1 = GetImageRegionName ( object1 );
-			name2 = GetImageRegionName ( object2 );
-			
-			if ( strcmp ( name1, name2 ) == 0 )
-			{
-				x1[0] = GetImageObjectCentroidX ( object1 );
-				x1[1] = GetImageObjectCentroidY ( object1 );
-				x1[2] = 1.0;
-				
-				x2[0] = GetImageObjectCentroidX ( object2 );
-				x2[1] = GetImageObjectCentroidY ( object2 );
-				x2[2] = 1.0;
-				
-				NAugmentNormalEqns ( 3, 2, x1, x2, a12, *b12 );
-				NAugmentNormalEqns ( 3, 2, x2, x1, a21, *b21 );
-				
-				n++;
-			}
-
-			object2 = GetNextImageObject ( object2 );
-		}
+		x1[0] = GetImageObjectCentroidX ( objects1[i] );
+		x1[1] = GetImageObjectCentroidY ( objects1[i] );
+		x1[2] = 1.0;
 		
-		object1 = GetNextImageObject ( object1 );
+		x2[0] = GetImageObjectCentroidX ( objects2[i] );
+		x2[1] = GetImageObjectCentroidY ( objects2[i] );
+		x2[2] = 1.0;
+		
+		NAugmentNormalEqns ( 3, 2, x1, x2, a12, *b12 );
+		NAugmentNormalEqns ( 3, 2, x2, x1, a21, *b21 );
+	}
+	
+	if ( n > 0 )
+	{
+		free ( objects1 );
+		free ( objects2 );
 	}
 	
 	/*** If we don't have any common objects, display a warning message and
 	     return an error code. ***/
 	     
-	if ( n == 0 )
+	if ( n < 0 )
+	{
+		WarningMessage ( G_OK_ALERT, CANT_ALLOCATE_MEMORY_STRING );
+	}
+	else if ( n == 0 )
 	{
 		GDoAlert ( G_WARNING_ALERT, G_OK_ALERT, "No common marked objects to align by!" );
 	}
@@ -1978,8 +2451,8 @@ int CreateImageAlignmentMatrices ( ImagePtr image1, ImagePtr image2, double ***b
 /*** CreateImageAlignmentMatrix *****************************************************
 
 	Creates a matrix that will transform (x,y) coordinates in one image to (x,y)
-	coordinates in another by using the centroid positions of objects with the
-	same names in both images.
+	coordinates in another by using the centroid positions of objects which
+	appear in both images.
 
 	double **CreateImageAlignmentMatrix ( ImagePtr image1, ImagePtr image2 )
 	
@@ -1990,9 +2463,9 @@ int CreateImageAlignmentMatrices ( ImagePtr image1, ImagePtr image2, double ***b
 	coordinates from the first image's coordinate system to the second.  On failure,
 	the function returns NULL.
 	
-	The function works by searching for objects that have the same name in both
-	images.  The type of matrix which the function creates depends on the number
-	of common objects.
+	The function works by searching for objects which appear in both images; see
+	FindImageAlignmentPairs().  The type of matrix which the function creates
+	depends on the number of common objects.
 	
 	If there is only one object with the same name, the function will create a
 	transformation matrix which simply represents a fixed translation from the
@@ -2005,11 +2478,12 @@ int CreateImageAlignmentMatrices ( ImagePtr image1, ImagePtr image2, double ***b
 	
 	If there are three or more objects with matching names, the function attempts
 	a least-squares best-fit solution of the matrix which transforms the positions
-	of the objects in the first image to their positions in the second.  The function
-	makes no attempt to determine the "correctness" of the result, i.e. if an
-	object has the same name in both images but is in fact a different object,
-	the funcion will still find a best-fit solution matrix, but that matrix will 
-	represent an incorrect transformation.  NEED TO FIX THIS.
+	of the objects in the first image to their positions in the second.  Objects
+	paired up by star-pattern matching are checked against each other for
+	consistency; objects paired up by name are not, i.e. if an object has the
+	same name in both images but is in fact a different object, the function
+	will still find a best-fit solution matrix, but that matrix will represent
+	an incorrect transformation.
 	
 	The matrix returned by this function should be used in calls to
 	TransformImageCoordinates().  When you are finished using the matrix, you
@@ -2019,11 +2493,10 @@ int CreateImageAlignmentMatrices ( ImagePtr image1, ImagePtr image2, double ***b
 
 double **CreateImageAlignmentMatrix ( ImagePtr image1, ImagePtr image2 )
 {
-	char			*name1 = NULL, *name2 = NULL;
 	int				result = FALSE;
-	long			n = 0;
+	long			n = 0, i;
 	double			x1[3], x2[3], **a = NULL, **b = NULL;
-	ImageObjectPtr	object1 = NULL, object2 = NULL;
+	ImageObjectPtr	*objects1 = NULL, *objects2 = NULL;
 
 	/*** Allocate/initialize normal equation matrices.  On failure, display
 	     a warning message, and return. ***/
@@ -2034,44 +2507,38 @@ double **CreateImageAlignmentMatrix ( ImagePtr image1, ImagePtr image2 )
 		return ( NULL );
 	}
 	
-	/*** Find objects with common names in both images.  For each common object,
+	/*** Find corresponding objects in both images.  For each pair of objects,
 	     augment the normal equation matrices. ***/
 	     
-	n = 0;
-	object1 = GetImageObjectList ( image1 );
-	while ( object1 != NULL )
+	n = FindImageAlignmentPairs ( image1, image2, &objects1, &objects2 );
+	
+	for ( i = 0; i < n; i++ )
 	{
-		object2 = GetImageObjectList ( image2 );
-		while ( object2 != NULL )
-		{
-			name1 = GetImageRegionName ( object1 );
-			name2 = GetImageRegionName ( object2 );
-			
-			if ( strcmp ( name1, name2 ) == 0 )
-			{
-				x1[0] = GetImageObjectCentroidX ( object1 );
-				x1[1] = GetImageObjectCentroidY ( object1 );
-				x1[2] = 1.0;
-				
-				x2[0] = GetImageObjectCentroidX ( object2 );
-				x2[1] = GetImageObjectCentroidY ( object2 );
-				x2[2] = 1.0;
-				
-				NAugmentNormalEqns ( 3, 2, x1, x2, a, b );
-				
-				n++;
-			}
-
-			object2 = GetNextImageObject ( object2 );
-		}
+		x1[0] = GetImageObjectCentroidX ( objects1[i] );
+		x1[1] = GetImageObjectCentroidY ( objects1[i] );
+		x1[2] = 1.0;
 		
-		object1 = GetNextImageObject ( object1 );
+		x2[0] = GetImageObjectCentroidX ( objects2[i] );
+		x2[1] = GetImageObjectCentroidY ( objects2[i] );
+		x2[2] = 1.0;
+		
+		NAugmentNormalEqns ( 3, 2, x1, x2, a, b );
+	}
+	
+	if ( n > 0 )
+	{
+		free ( objects1 );
+		free ( objects2 );
 	}
 	
 	/*** If we don't have any common objects, display a warning message and
 	     return an error code. ***/
 	     
-	if ( n == 0 )
+	if ( n < 0 )
+	{
+		WarningMessage ( G_OK_ALERT, CANT_ALLOCATE_MEMORY_STRING );
+	}
+	else if ( n == 0 )
 	{
 		GDoAlert ( G_WARNING_ALERT, G_OK_ALERT, "No common marked objects to align by!" );
 	}
@@ -2137,8 +2604,8 @@ double **CreateImageAlignmentMatrix ( ImagePtr image1, ImagePtr image2 )
 
 void TransformImageCoordinates ( double x1, double y1, double **matrix, double *x2, double *y2 )
 {
-	*x2 = x1 * matrix[0][0] + x1 * matrix[1][0] + matrix[2][0];
-	*y2 = y1 * matrix[0][1] + y1 * matrix[1][1] + matrix[2][1];
+	*x2 = x1 * matrix[0][0] + y1 * matrix[1][0] + matrix[2][0];
+	*y2 = x1 * matrix[0][1] + y1 * matrix[1][1] + matrix[2][1];
 }
 
 /*** DoRGBCombination ************************************************************/
@@ -2368,9 +2835,10 @@ static GWindowPtr	sRGBBalanceWindow;
 void DoRGBBalance ( GWindowPtr window )
 {
 	ImagePtr	image = GetImageWindowImage ( window );
-	short		cols, rows, frames, col, row, frame;
+	short		rows, frames, frame;
+	long		i, n;
 	PIXEL		*data = NULL;
-	double		redBalance, greenBalance, blueBalance;
+	double		redBalance, greenBalance, blueBalance, factor;
 	
 	/*** Save a pointer to the image window whose RGB color balance we are about
 	     to manipulate.  Initially, set the RGB adjustment factors to 1.0 so that
@@ -2398,47 +2866,39 @@ void DoRGBBalance ( GWindowPtr window )
 	GetRGBBalance ( &redBalance, &greenBalance, &blueBalance );
 	SetRGBBalance ( 1.0, 1.0, 1.0 );
 
-	/*** Determine the width, height, and number of frames in the image. ***/
+	/*** Determine the height and number of frames in the image, and the
+	     number of pixels in each frame including the padding at the end of
+	     each row. ***/
 	
-	cols = GetImageColumns ( image );
 	rows = GetImageRows ( image );
 	frames = GetImageFrames ( image );
+	n = rows * GetImageDataStride ( image );
 
 	/*** For each frame, scale the image data values by the appropriate factor. ***/
 	
 	for ( frame = 0; frame < frames; frame++ )
 	{
-		for ( row = 0; row < rows; row++ )
-		{
-			data = GetImageDataRow ( image, frame, row );
-			
-			/*** The 0th, 3rd, 6th, etc. frames contain the red component of the
-			     image.  Multiply them by the red balancing factor. ***/
-			     
-			if ( frame % 3 == 0 )
-			{
-				for ( col = 0; col < cols; col++ )
-					data[col] *= redBalance;
-			}
-
-			/*** The 1st, 4th, 7th, etc. frames contain the green component of the
-			     image.  Multiply them by the green balancing factor. ***/
-
-			else if ( frame % 3 == 1 )
-			{
-				for ( col = 0; col < cols; col++ )
-					data[col] *= greenBalance;
-			}
-
-			/*** The 2st, 5th, 8th, etc. frames contain the blue component of the
-			     image.  Multiply them by the blue balancing factor. ***/
-
-			else if ( frame % 3 == 2 )
-			{
-				for ( col = 0; col < cols; col++ )
-					data[col] *= blueBalance;
-			}			
-		}
+		data = GetImageDataRow ( image, frame, 0 );
+		
+		/*** The 0th, 3rd, 6th, etc. frames contain the red component of the
+		     image; the 1st, 4th, 7th, etc. frames contain the green component;
+		     and the 2nd, 5th, 8th, etc. frames contain the blue component.
+		     Pick the balancing factor for this frame's color. ***/
+		     
+		if ( frame % 3 == 0 )
+			factor = redBalance;
+		else if ( frame % 3 == 1 )
+			factor = greenBalance;
+		else
+			factor = blueBalance;
+		
+		/*** The frame's rows are contiguous, (stride) pixels apart, so we can
+		     scale the whole frame in one pass.  The padding at the end of each
+		     row isn't part of the image, so it doesn't matter that we scale
+		     that too. ***/
+		
+		for ( i = 0; i < n; i++ )
+			data[i] *= factor;
 	}
 
 	/*** Now redraw the image window's offscreen bitmap, and invalidate it so that
@@ -2574,50 +3034,44 @@ int DoRGBBalanceDialogEvent ( short event, GWindowPtr dialog, long param1, long
 void RGBBalanceImageWindow ( GWindowPtr window, double red, double grn, double blu )
 {
 	ImagePtr	image = GetImageWindowImage ( window );
-	short		cols, rows, frames, col, row, frame;
+	short		rows, frames, frame;
+	long		i, n;
 	PIXEL		*data = NULL;
+	double		factor;
 	
-	/*** Determine the width, height, and number of frames in the image. ***/
+	/*** Determine the height and number of frames in the image, and the
+	     number of pixels in each frame including the padding at the end of
+	     each row. ***/
 	
-	cols = GetImageColumns ( image );
 	rows = GetImageRows ( image );
 	frames = GetImageFrames ( image );
+	n = rows * GetImageDataStride ( image );
 
 	/*** For each frame, scale the image data values by the appropriate factor. ***/
 	
 	for ( frame = 0; frame < frames; frame++ )
 	{
-		for ( row = 0; row < rows; row++ )
-		{
-			data = GetImageDataRow ( image, frame, row );
-			
-			/*** The 0th, 3rd, 6th, etc. frames contain the red component of the
-			     image.  Multiply them by the red balancing factor. ***/
-			     
-			if ( frame % 3 == 0 )
-			{
-				for ( col = 0; col < cols; col++ )
-					data[col] *= red;
-			}
-
-			/*** The 1st, 4th, 7th, etc. frames contain the green component of the
-			     image.  Multiply them by the green balancing factor. ***/
-
-			else if ( frame % 3 == 1 )
-			{
-				for ( col = 0; col < cols; col++ )
-					data[col] *= grn;
-			}
-
-			/*** The 2st, 5th, 8th, etc. frames contain the blue component of the
-			     image.  Multiply them by the blue balancing factor. ***/
-
-			else if ( frame % 3 == 2 )
-			{
-				for ( col = 0; col < cols; col++ )
-					data[col] *= blu;
-			}			
-		}
+		data = GetImageDataRow ( image, frame, 0 );
+		
+		/*** The 0th, 3rd, 6th, etc. frames contain the red component of the
+		     image; the 1st, 4th, 7th, etc. frames contain the green component;
+		     and the 2nd, 5th, 8th, etc. frames contain the blue component.
+		     Pick the balancing factor for this frame's color. ***/
+		     
+		if ( frame % 3 == 0 )
+			factor = red;
+		else if ( frame % 3 == 1 )
+			factor = grn;
+		else
+			factor = blu;
+		
+		/*** The frame's rows are contiguous, (stride) pixels apart, so we can
+		     scale the whole frame in one pass.  The padding at the end of each
+		     row isn't part of the image, so it doesn't matter that we scale
+		     that too. ***/
+		
+		for ( i = 0; i < n; i++ )
+			data[i] *= factor;
 	}
 
 	/*** Perform any window updating that needs to be done, now that the
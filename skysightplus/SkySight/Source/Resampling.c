@@ -0,0 +1,425 @@
+/*** COPYRIGHT NOTICE AND PUBLIC SOURCE LICENSE ***************************************
+
+	Portions Copyright (c) 1992-2001 Southern Stars Systems.  All Rights Reserved.
+
+	This file contains Original Code and/or Modifications of Original Code as
+	defined in and that are subject to the Southern Stars Systems Public Source
+	License Version 1.0 (the 'License').  You may not use this file except in
+	compliance with the License.  Please obtain a copy of the License at
+
+	http://www.southernstars.com/opensource/
+
+	and read it before using this file.
+
+	The Original Code and all software distributed under the License are distributed
+	on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER EXPRESS OR IMPLIED, AND
+	SOUTHERN STARS SYSTEMS HEREBY DISCLAIMS ALL SUCH WARRANTIES, INCLUDING WITHOUT
+	LIMITATION, ANY WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE,
+	QUIET ENJOYMENT, OR NON-INFRINGEMENT.  Please see the License for the specific
+	language governing rights and limitations under the License.
+
+	MODIFICATION HISTORY:
+
+	1.0.0 - 17 Oct 2026 - Original code: affine image resampling.
+
+****************************************************************************************/
+
+#include "SkySight.h"
+
+/*** local constants ***/
+
+#define RESAMPLE_BAND_ROWS		32		/* rows of output per band */
+#define RESAMPLE_TILE_COLS		256		/* columns of output per tile within a band */
+#define RESAMPLE_MAX_TAPS		8		/* widest kernel, rounded up to a multiple of 4 */
+#define RESAMPLE_STEPS			256		/* kernel weights tabulated per pixel of offset */
+
+/*** local data types ***/
+
+typedef struct ResamplingJob
+{
+	PIXEL			**dest;			/* output frame rows */
+	unsigned char	**mask;			/* output coverage rows, or NULL */
+	long			destCols;		/* output frame width */
+	long			destRows;		/* output frame height */
+	PIXEL			**src;			/* input frame rows */
+	long			srcCols;		/* input frame width */
+	long			srcRows;		/* input frame height */
+	double			matrix[3][2];	/* transforms output to input coordinates */
+	short			border;			/* border mode */
+	long			taps;			/* kernel width, in pixels */
+	long			lead;			/* taps before the one at or left of the sample point */
+	float			*weights;		/* kernel weights, RESAMPLE_MAX_TAPS per step */
+	long			numBands;		/* number of bands of output rows */
+	long			numTasks;		/* number of parallel tasks */
+}
+ResamplingJob;
+
+/*** local function prototypes ***/
+
+static double	ComputeResamplingWeight ( short, double );
+static long		MapResamplingIndex ( long, long, short );
+static PIXEL	ResampleBorderPixel ( ResamplingJob *, double, double, unsigned char * );
+static void		ResampleBandTask ( void *, long );
+
+/*** ComputeResamplingWeight *******************************************************
+
+	Returns the weight which a kernel gives to a pixel at a distance (x) from
+	the sample point.
+
+************************************************************************************/
+
+static double ComputeResamplingWeight ( short kernel, double x )
+{
+	x = fabs ( x );
+	
+	switch ( kernel )
+	{
+		case RESAMPLE_BILINEAR:
+			return ( x < 1.0 ? 1.0 - x : 0.0 );
+			
+		/*** Catmull-Rom cubic, i.e. Keys' kernel with a = -0.5 ***/
+		
+		case RESAMPLE_BICUBIC:
+			if ( x < 1.0 )
+				return ( ( 1.5 * x - 2.5 ) * x * x + 1.0 );
+			if ( x < 2.0 )
+				return ( ( ( -0.5 * x + 2.5 ) * x - 4.0 ) * x + 2.0 );
+			return ( 0.0 );
+			
+		case RESAMPLE_LANCZOS:
+			if ( x < 1.0e-8 )
+				return ( 1.0 );
+			if ( x < 3.0 )
+				return ( 3.0 * sin ( PI * x ) * sin ( PI * x / 3.0 ) / ( PI * PI * x * x ) );
+			return ( 0.0 );
+	}
+	
+	return ( x < 0.5 ? 1.0 : 0.0 );
+}
+
+/*** MapResamplingIndex ************************************************************
+
+	Maps a row or column index which may lie outside a frame to the index of the
+	pixel whose value should be used there: the nearest edge pixel, or for the
+	RESAMPLE_BORDER_WRAP mode the pixel on the opposite side.
+
+************************************************************************************/
+
+static long MapResamplingIndex ( long i, long n, short border )
+{
+	if ( i >= 0 && i < n )
+		return ( i );
+
+	if ( border == RESAMPLE_BORDER_WRAP )
+	{
+		i = i % n;
+		return ( i < 0 ? i + n : i );
+	}
+
+	return ( i < 0 ? 0 : n - 1 );
+}
+
+/*** ResampleBorderPixel ***********************************************************
+
+	Computes the value of one output pixel whose kernel overhangs the edge of the
+	input frame, looking up each pixel under the kernel with MapResamplingIndex().
+	If the sample point itself lies outside the frame, the pixel is zero, unless
+	the image wraps around.
+
+************************************************************************************/
+
+static PIXEL ResampleBorderPixel ( ResamplingJob *job, double x, double y, unsigned char *inside )
+{
+	long	ix, iy, i, j, col, row;
+	float	*wx, *wy;
+	double	sum, rowSum;
+	
+	if ( job->border == RESAMPLE_BORDER_WRAP )
+	{
+		x = fmod ( x, job->srcCols );
+		if ( x < 0.0 )
+			x += job->srcCols;
+			
+		y = fmod ( y, job->srcRows );
+		if ( y < 0.0 )
+			y += job->srcRows;
+	}
+	else if ( x < -0.5 || y < -0.5 || x >= job->srcCols - 0.5 || y >= job->srcRows - 0.5 )
+	{
+		*inside = FALSE;
+		return ( 0 );
+	}
+	
+	*inside = TRUE;
+	
+	if ( job->taps == 1 )
+	{
+		col = MapResamplingIndex ( floor ( x + 0.5 ), job->srcCols, job->border );
+		row = MapResamplingIndex ( floor ( y + 0.5 ), job->srcRows, job->border );
+		return ( job->src[row][col] );
+	}
+	
+	ix = floor ( x );
+	iy = floor ( y );
+	wx = job->weights + (long) ( ( x - ix ) * RESAMPLE_STEPS + 0.5 ) * RESAMPLE_MAX_TAPS;
+	wy = job->weights + (long) ( ( y - iy ) * RESAMPLE_STEPS + 0.5 ) * RESAMPLE_MAX_TAPS;
+	ix -= job->lead;
+	iy -= job->lead;
+	
+	for ( sum = 0.0, j = 0; j < job->taps; j++ )
+	{
+		row = MapResamplingIndex ( iy + j, job->srcRows, job->border );
+		for ( rowSum = 0.0, i = 0; i < job->taps; i++ )
+		{
+			col = MapResamplingIndex ( ix + i, job->srcCols, job->border );
+			rowSum += wx[i] * job->src[row][col];
+		}
+		
+		sum += wy[j] * rowSum;
+	}
+	
+	return ( sum );
+}
+
+/*** ResampleBandTask **************************************************************
+
+	Performs one of the parallel tasks started by ResampleImageFrame().  Each task
+	works through every (numTasks)th band of output rows, a tile of columns at a
+	time, so that the input pixels under a tile stay in the cache even when the
+	transform rotates the image.  Along each row of a tile, the input coordinates
+	are stepped incrementally.  Pixels whose kernels lie wholly inside the input
+	frame are computed directly; for the four- and eight-tap kernels, the SSE2
+	version weights four input pixels at a time.
+
+************************************************************************************/
+
+static void ResampleBandTask ( void *data, long task )
+{
+	ResamplingJob	*job = (ResamplingJob *) data;
+	long			band, top, bottom, left, right, row, col, ix, iy, i, j;
+	long			span = ( job->taps + 3 ) & ~3L;
+	double			x, y, dx = job->matrix[0][0], dy = job->matrix[0][1];
+	double			sum, rowSum, maxX, maxY;
+	float			*wx, *wy;
+	PIXEL			*dest, **src = job->src;
+	unsigned char	*mask, inside;
+#if SSE2 && BITPIX == -32
+	__m128			acc0, acc1, w;
+#endif
+
+	/*** A kernel lies wholly inside the frame if its leftmost tap is at or
+	     right of column 0, and its rightmost loaded column (the loads cover a
+	     multiple of four) is inside; likewise for rows.  This also keeps the
+	     nearest pixel inside. ***/
+	     
+	maxX = job->srcCols - span + job->lead;
+	maxY = job->srcRows - job->taps + job->lead;
+	
+	for ( band = task; band < job->numBands; band += job->numTasks )
+	{
+		top = band * RESAMPLE_BAND_ROWS;
+		bottom = top + RESAMPLE_BAND_ROWS;
+		if ( bottom > job->destRows )
+			bottom = job->destRows;
+			
+		for ( left = 0; left < job->destCols; left += RESAMPLE_TILE_COLS )
+		{
+			right = left + RESAMPLE_TILE_COLS;
+			if ( right > job->destCols )
+				right = job->destCols;
+				
+			for ( row = top; row < bottom; row++ )
+			{
+				dest = job->dest[row];
+				mask = job->mask == NULL ? NULL : job->mask[row];
+				
+				x = left * dx + row * job->matrix[1][0] + job->matrix[2][0];
+				y = left * dy + row * job->matrix[1][1] + job->matrix[2][1];
+				
+				for ( col = left; col < right; col++, x += dx, y += dy )
+				{
+					if ( x < job->lead || y < job->lead || x >= maxX || y >= maxY )
+					{
+						dest[col] = ResampleBorderPixel ( job, x, y, &inside );
+						if ( mask != NULL )
+							mask[col] = inside;
+						continue;
+					}
+					
+					if ( job->taps == 1 )
+					{
+						dest[col] = src[ (long) ( y + 0.5 ) ][ (long) ( x + 0.5 ) ];
+						if ( mask != NULL )
+							mask[col] = TRUE;
+						continue;
+					}
+					
+					ix = x;
+					iy = y;
+					wx = job->weights + (long) ( ( x - ix ) * RESAMPLE_STEPS + 0.5 ) * RESAMPLE_MAX_TAPS;
+					wy = job->weights + (long) ( ( y - iy ) * RESAMPLE_STEPS + 0.5 ) * RESAMPLE_MAX_TAPS;
+					ix -= job->lead;
+					iy -= job->lead;
+					
+					if ( mask != NULL )
+						mask[col] = TRUE;
+					
+#if SSE2 && BITPIX == -32
+					if ( span == 4 )
+					{
+						acc0 = _mm_setzero_ps();
+						for ( j = 0; j < job->taps; j++ )
+							acc0 = _mm_add_ps ( acc0, _mm_mul_ps ( _mm_set1_ps ( wy[j] ), _mm_loadu_ps ( src[iy + j] + ix ) ) );
+						
+						acc0 = _mm_mul_ps ( acc0, _mm_loadu_ps ( wx ) );
+						acc0 = _mm_add_ps ( acc0, _mm_movehl_ps ( acc0, acc0 ) );
+						acc0 = _mm_add_ss ( acc0, _mm_shuffle_ps ( acc0, acc0, 1 ) );
+						_mm_store_ss ( dest + col, acc0 );
+						continue;
+					}
+					
+					if ( span == 8 )
+					{
+						acc0 = acc1 = _mm_setzero_ps();
+						for ( j = 0; j < job->taps; j++ )
+						{
+							w = _mm_set1_ps ( wy[j] );
+							acc0 = _mm_add_ps ( acc0, _mm_mul_ps ( w, _mm_loadu_ps ( src[iy + j] + ix ) ) );
+							acc1 = _mm_add_ps ( acc1, _mm_mul_ps ( w, _mm_loadu_ps ( src[iy + j] + ix + 4 ) ) );
+						}
+						
+						acc0 = _mm_add_ps ( _mm_mul_ps ( acc0, _mm_loadu_ps ( wx ) ), _mm_mul_ps ( acc1, _mm_loadu_ps ( wx + 4 ) ) );
+						acc0 = _mm_add_ps ( acc0, _mm_movehl_ps ( acc0, acc0 ) );
+						acc0 = _mm_add_ss ( acc0, _mm_shuffle_ps ( acc0, acc0, 1 ) );
+						_mm_store_ss ( dest + col, acc0 );
+						continue;
+					}
+#endif
+					for ( sum = 0.0, j = 0; j < job->taps; j++ )
+					{
+						for ( rowSum = 0.0, i = 0; i < job->taps; i++ )
+							rowSum += wx[i] * src[iy + j][ix + i];
+							
+						sum += wy[j] * rowSum;
+					}
+					
+					dest[col] = sum;
+				}
+			}
+		}
+	}
+}
+
+/*** ResampleImageFrame ************************************************************
+
+	Resamples one frame of image data through an affine transform, e.g. to shift,
+	scale, rotate, or align it.
+
+	int ResampleImageFrame ( PIXEL **dest, unsigned char **mask, short destCols,
+	    short destRows, PIXEL **src, short srcCols, short srcRows, double **matrix,
+	    short kernel, short border )
+
+	(dest):     receives resampled image data.
+	(mask):     if not NULL, receives TRUE for pixels inside the input frame.
+	(destCols): width of output image data, in pixels.
+	(destRows): height of output image data, in pixels.
+	(src):      image data to resample.
+	(srcCols):  width of input image data, in pixels.
+	(srcRows):  height of input image data, in pixels.
+	(matrix):   3 x 2 matrix transforming output to input coordinates; see below.
+	(kernel):   interpolation kernel; see below.
+	(border):   border mode; see below.
+
+	The function returns TRUE if successful, or FALSE if it can't allocate the
+	memory it needs.  (dest) and (src) must not be the same data.
+
+	Each output pixel (col,row) takes its value from the input frame at
+	
+	x = col * matrix[0][0] + row * matrix[1][0] + matrix[2][0]
+	y = col * matrix[0][1] + row * matrix[1][1] + matrix[2][1]
+	
+	where pixel centers lie at whole-number coordinates.  This is the same form as
+	the image alignment matrices used elsewhere.  The value is interpolated from
+	the input pixels around (x,y) with one of these kernels:
+
+	- RESAMPLE_NEAREST:  the nearest pixel.
+	- RESAMPLE_BILINEAR: the 2 x 2 pixels around the point.
+	- RESAMPLE_BICUBIC:  the 4 x 4 pixels around the point, with the Catmull-Rom
+	                     cubic, which keeps edges sharper than bilinear.
+	- RESAMPLE_LANCZOS:  the 6 x 6 pixels around the point, with the three-lobed
+	                     Lanczos kernel, which best keeps fine detail.
+
+	Where (x,y) lies outside the input frame, the output pixel is zero; where only
+	part of the kernel does, the edge pixels are repeated.  With the border mode
+	RESAMPLE_BORDER_WRAP, the input frame instead wraps around to its opposite edge
+	in both cases.
+	
+	The kernel weights are tabulated, at 1/256 pixel steps, and normalized to sum
+	to one.  The work is divided among all processors with GDoParallelTasks().
+
+************************************************************************************/
+
+int ResampleImageFrame ( PIXEL **dest, unsigned char **mask, short destCols, short destRows,
+PIXEL **src, short srcCols, short srcRows, double **matrix, short kernel, short border )
+{
+	ResamplingJob	job;
+	long			step, i;
+	double			sum, offset;
+
+	memset ( &job, 0, sizeof ( job ) );
+
+	job.dest = dest;
+	job.mask = mask;
+	job.destCols = destCols;
+	job.destRows = destRows;
+	job.src = src;
+	job.srcCols = srcCols;
+	job.srcRows = srcRows;
+	job.border = border;
+	
+	for ( i = 0; i < 3; i++ )
+	{
+		job.matrix[i][0] = matrix[i][0];
+		job.matrix[i][1] = matrix[i][1];
+	}
+
+	switch ( kernel )
+	{
+		case RESAMPLE_BILINEAR: job.taps = 2; break;
+		case RESAMPLE_BICUBIC:  job.taps = 4; break;
+		case RESAMPLE_LANCZOS:  job.taps = 6; break;
+		default:                job.taps = 1; kernel = RESAMPLE_NEAREST; break;
+	}
+	
+	job.lead = job.taps > 1 ? job.taps / 2 - 1 : 0;
+	
+	/*** Tabulate the kernel: for each fractional offset of the sample point from
+	     the pixel at or left of it, the weights of the (taps) pixels from (lead)
+	     pixels left of that one.  The nearest-pixel kernel needs no weights,
+	     since it just copies the pixel value. ***/
+	     
+	job.weights = (float *) calloc ( ( RESAMPLE_STEPS + 1 ) * RESAMPLE_MAX_TAPS, sizeof ( float ) );
+	if ( job.weights == NULL )
+		return ( FALSE );
+		
+	for ( step = 0; step <= RESAMPLE_STEPS && kernel != RESAMPLE_NEAREST; step++ )
+	{
+		offset = (double) step / RESAMPLE_STEPS;
+		for ( sum = 0.0, i = 0; i < job.taps; i++ )
+			sum += ComputeResamplingWeight ( kernel, offset + job.lead - i );
+		
+		for ( i = 0; i < job.taps; i++ )
+			job.weights[ step * RESAMPLE_MAX_TAPS + i ] = ComputeResamplingWeight ( kernel, offset + job.lead - i ) / sum;
+	}
+	
+	job.numBands = ( destRows + RESAMPLE_BAND_ROWS - 1 ) / RESAMPLE_BAND_ROWS;
+	job.numTasks = GGetProcessorCount();
+	if ( job.numTasks > job.numBands )
+		job.numTasks = job.numBands;
+		
+	if ( job.numTasks > 0 )
+		GDoParallelTasks ( ResampleBandTask, &job, job.numTasks );
+	
+	free ( job.weights );
+	return ( TRUE );
+}
@@ -94,6 +94,9 @@
 #define CONVOLVE_SHARPEN_SOFT		3
 #define CONVOLVE_SHARPEN_HARD		4
 #define CONVOLVE_GRADIENT			5
+#define CONVOLVE_MIRROR_EDGES		7
+#define CONVOLVE_EXTEND_EDGES		8
+#define CONVOLVE_WRAP_EDGES			9
 
 #define COLOR_FRAME_MENU_ID			136
 #define COLOR_FRAME_ALL				1
@@ -113,6 +116,12 @@
 
 #define MOSAIC_MENU_ID				140
 
+#define RESAMPLE_MENU_ID			141
+#define RESAMPLE_NEAREST_ITEM		1
+#define RESAMPLE_BILINEAR_ITEM		2
+#define RESAMPLE_BICUBIC_ITEM		3
+#define RESAMPLE_LANCZOS_ITEM		4
+
 /*** items for this menu same as "Color Frame" menu. ***/
 
 #define APPLE_MENU_ID				256
@@ -178,11 +187,16 @@
 #define PROCESS_RGB_COMBINE_ITEM		19
 #define PROCESS_RGB_SEPARATE_ITEM		20
 #define PROCESS_RGB_BALANCE_ITEM		21
+#define PROCESS_SUBTRACT_BACKGROUND_ITEM	23
+#define PROCESS_CALIBRATE_ITEM			24
+#define PROCESS_STACK_ITEM				25
+#define PROCESS_RESAMPLING_ITEM			27
 
 #define ANALYZE_MENU_ID					261
 #define ANALYZE_DEFINE_OBJECT_PSF		1
 #define ANALYZE_FIND_OBJECTS			2
 #define ANALYZE_DELETE_OBJECTS			3
+#define ANALYZE_FIND_PEAKS				4
 
 #ifdef GMAC
 
@@ -249,6 +263,12 @@
 #define OPEN_FILE_PROMPT_STRING		400
 #define OPEN_FILE_FILTER_STRING		401
 
+#define CALIBRATION_BIAS_PROMPT_STRING	410
+#define CALIBRATION_DARK_PROMPT_STRING	411
+#define CALIBRATION_FLAT_PROMPT_STRING	412
+#define CALIBRATION_FILE_FILTER_STRING	413
+#define STACK_PROMPT_STRING				414
+
 #define SAVE_IMAGE_PROMPT_STRING		500
 #define SAVE_IMAGE_FILTER_STRING		501
 
@@ -305,6 +325,8 @@
 #define IMAGE_REGION_TYPE_RECTANGULAR	2
 #define IMAGE_REGION_TYPE_ELLIPTICAL	3
 
+#define IMAGE_REGION_FLAG_MARKED		0x00000001
+
 #define IMAGE_REGION_PARAM_N			1
 #define IMAGE_REGION_PARAM_SUM			2
 #define IMAGE_REGION_PARAM_MIN			3
@@ -386,12 +408,17 @@
 typedef struct FITSImage		*FITSImagePtr;
 typedef struct Image			Image, *ImagePtr;
 typedef struct ImageRegion		ImageRegion, ImageObject, *ImageRegionPtr, *ImageObjectPtr;
+typedef struct ImageModelFit	*ImageModelFitPtr;
+typedef struct ImageObjectIndex	*ImageObjectIndexPtr;
+typedef struct ImageCalibration	*ImageCalibrationPtr;
+typedef struct ImageBackground	*ImageBackgroundPtr;
 typedef struct ImageHistogram	ImageHistogram, *ImageHistogramPtr;
 typedef struct Exposure			Exposure, *ExposurePtr, *ExposureList;
 typedef struct Camera			Camera, *CameraPtr;
 
 typedef void	(*ImageSurfaceFunctionPtr)	( short, short, double * );
 typedef double	(*ImageModelFunctionPtr)	( short, short, double *, double * );
+typedef void	(*ImageModelRowFunctionPtr)	( short, short, short, double *, double *, double ** );
 
 /*** Functions in Utilities.c ***/
 
@@ -470,6 +497,7 @@ void	DoRotateMenuItem ( long );
 void	DoConvolveMenuItem ( long );
 void	DoAlignMenuItem ( long );
 void	DoMosaicMenuItem ( long );
+void	DoResampleMenuItem ( long );
 void	DoRGBCombination ( void );
 void	DoRGBSeparation ( GWindowPtr );
 void	DoRGBBalance ( GWindowPtr );
@@ -479,7 +507,10 @@ void	TrimImageWindow ( GWindowPtr );
 void	ShiftImageWindow ( GWindowPtr, double, double, int );
 void	ScaleImageWindow ( GWindowPtr );
 void	RotateImageWindow ( GWindowPtr, double );
-void	ConvolveImageWindow ( GWindowPtr, float **, short, short );
+void	ConvolveImageWindow ( GWindowPtr, float **, short, short, short );
+void	SubtractImageWindowBackground ( GWindowPtr );
+void	CalibrateImageWindow ( GWindowPtr );
+void	DoImageStacking ( void );
 float	**GetConvolutionFilter ( short, short *, short * );
 void	DeleteConvolutionFilter ( float ** );
 void	AlignImageWindow ( GWindowPtr, GWindowPtr );
@@ -493,6 +524,7 @@ void	ClipImageData ( FITSImagePtr, FITSImagePtr, PIXEL, PIXEL, PIXEL, PIXEL );
 void	DoAnalyzeMenuItem ( long );
 void	DefineImageWindowImageObjectPSF ( GWindowPtr );
 void	FindImageWindowImageObjects ( GWindowPtr, PIXEL, PIXEL, double );
+void	FindImageWindowImagePeaks ( GWindowPtr, PIXEL, PIXEL, double );
 void	DeleteImageWindowImageObjects ( GWindowPtr );
 void	FindLocalMaximumPixel ( PIXEL **, short, short, short *, short *, short );
 
@@ -502,7 +534,27 @@ typedef	unsigned short	USHORT;			/* 0 to 65535 integers */
 
 /*** Image constants and macros ***/
 
-#define IMAGE_HISTOGRAM_BINS	100
+#define IMAGE_HISTOGRAM_BINS			100
+#define IMAGE_FINE_HISTOGRAM_BINS		65536
+#define IMAGE_STATISTICS_BAND_ROWS		32
+
+#define IMAGE_CHANGED_ALL				0
+#define IMAGE_CHANGED_RECT				1
+#define IMAGE_CHANGED_NONE				2
+
+/*** ImageBandStatistics holds the partial statistics of one band of
+     IMAGE_STATISTICS_BAND_ROWS rows of one image frame.  ComputeImageStatistics()
+     computes these in parallel, then merges them into the image totals. ***/
+
+typedef struct ImageBandStatistics
+{
+	long			count;
+	double			mean;
+	double			m2;
+	PIXEL			minimum;
+	PIXEL			maximum;
+}
+ImageBandStatistics, *ImageBandStatisticsPtr;
 
 struct Image
 {
@@ -521,8 +573,20 @@ struct Image
 	PIXEL			imageMaximum;
 	double			imageMean;
 	double			imageStdDev;
+	long			*imageFineHistogram;
+	ImageBandStatisticsPtr	imageBandStatistics;
+	long			imageBandCount;
+	short			imageChangeState;
+	short			imageChangeFirstFrame;
+	short			imageChangeLastFrame;
+	short			imageChangeLeft;
+	short			imageChangeTop;
+	short			imageChangeRight;
+	short			imageChangeBottom;
 	ImageObjectPtr	imageObjectList;
 	long			imageObjectCount;
+	ImageObjectIndexPtr	imageObjectIndex;
+	ImageBackgroundPtr	imageBackground;
 	ImagePtr		imagePreviousImage;
 };
 
@@ -577,6 +641,9 @@ int					CopyHistogramWindow ( GWindowPtr );
 ImagePtr		NewImage ( char *, short, short, short, short );
 void			DeleteImage ( ImagePtr );
 void			UpdateImage ( ImagePtr );
+void			BeginImageChange ( ImagePtr, short, short, short, short, short );
+void			SetImageChanged ( ImagePtr );
+int				GetImageChangedRect ( ImagePtr, short *, short *, short *, short * );
 
 ImagePtr		NewImageFromBitmap ( char *, GImagePtr );
 ImagePtr		ReadFITSImageFile ( GPathPtr );
@@ -595,6 +662,7 @@ short			GetImageColumns ( ImagePtr );
 short 			GetImageRows ( ImagePtr );
 PIXEL 			**GetImageDataFrame ( ImagePtr, short );
 PIXEL 			*GetImageDataRow ( ImagePtr, short, short );
+long			GetImageDataStride ( ImagePtr );
 PIXEL			GetImageDataValue ( ImagePtr, short, short, short );
 void			SetImageDataValue ( ImagePtr, short, short, short, PIXEL );
 
@@ -626,6 +694,8 @@ double			GetImageMeanValue ( ImagePtr );
 double			GetImageStandardDeviation ( ImagePtr );
 long			*GetImageHistogram ( ImagePtr, long * );
 PIXEL			GetImagePercentile ( ImagePtr, double );
+PIXEL			GetImageExactPercentile ( ImagePtr, double );
+PIXEL			GetImageMedian ( ImagePtr );
 
 float			GetImageTemperature ( ImagePtr );
 void			SetImageTemperature ( ImagePtr, float );
@@ -636,6 +706,7 @@ ImageObjectPtr	GetImageObjectList ( ImagePtr );
 long			GetImageObjectCount ( ImagePtr );
 void			AddImageObject ( ImagePtr, ImageObjectPtr );
 void			RemoveImageObject ( ImagePtr, ImageObjectPtr );
+void			RemoveImageObjects ( ImagePtr, ImageObjectPtr *, long );
 void			DeleteImageObjectList ( ImagePtr );
 
 ImagePtr		GetImagePreviousImage ( ImagePtr );
@@ -661,12 +732,15 @@ ImagePtr		GetImageWindowImage ( GWindowPtr );
 void			SetImageWindowImage ( GWindowPtr, ImagePtr );
 
 FITSImagePtr	ResizeImageWindowImage ( GWindowPtr, short, short, int );
+void			RestoreImageWindowImage ( GWindowPtr, FITSImagePtr );
 
 int				GetImageWindowNeedsSave ( GWindowPtr );
 void			SetImageWindowNeedsSave ( GWindowPtr, int );
 
 GImagePtr		GetImageWindowBitmap ( GWindowPtr );
 GImagePtr		NewImageWindowBitmap ( GWindowPtr );
+void			InvalidateImageWindowPyramid ( GWindowPtr, short, short, short, short );
+GImagePtr		GetImageWindowPyramidBitmap ( GWindowPtr, short, GRectPtr );
 
 GControlPtr		GetImageWindowVerticalScrollBar ( GWindowPtr );
 GControlPtr		GetImageWindowHorizontalScrollBar ( GWindowPtr );
@@ -731,6 +805,7 @@ void			ImageXYToWindow ( GWindowPtr, float, float, short *, short * );
 void			WindowToImageXY ( GWindowPtr, short, short, float *, float * );
 
 void			DrawImageWindowBitmap ( GWindowPtr );
+void			DrawImageWindowBitmapRect ( GWindowPtr, short, short, short, short );
 void			ComputeImageDisplayRange ( GWindowPtr );
 
 void			SetRGBBalance ( double, double, double );
@@ -791,10 +866,42 @@ void			GetImageObjectWindowRect ( ImageObjectPtr, GWindowPtr, GRectPtr );
 
 int				FitImageSurface ( PIXEL **, ImageRegionPtr, PIXEL, PIXEL, ImageSurfaceFunctionPtr, short, double *, double * );
 int				FitImageModel ( PIXEL **, ImageRegionPtr, PIXEL, PIXEL, ImageModelFunctionPtr, short, double *, double *, double, short );
-int				ImproveImageModelFit ( PIXEL **, ImageRegionPtr, ImageModelFunctionPtr, double *, double *, short, double *, double * );
+ImageModelFitPtr	NewImageModelFit ( short, PIXEL, PIXEL );
+void			DeleteImageModelFit ( ImageModelFitPtr );
+int				SolveImageModelFit ( ImageModelFitPtr, PIXEL **, ImageRegionPtr, ImageModelFunctionPtr, double *, double *, double, short );
+int				ImproveImageModelFit ( ImageModelFitPtr, PIXEL **, ImageRegionPtr, ImageModelFunctionPtr, double *, double *, double *, double * );
+long			FitImageObjects ( PIXEL **, ImageObjectPtr *, long, PIXEL, PIXEL, double, short );
 
 void			GaussianSurface ( short, short, double * );
 double			GaussianStarModel ( short, short, double *, double * );
+void			GaussianStarModelRow ( short, short, short, double *, double *, double ** );
+
+/*** Functions in ImageObjectIndex.c ***/
+
+void			DeleteImageObjectIndex ( ImageObjectIndexPtr );
+void			InvalidateImageObjectIndex ( ImagePtr );
+long			FindImageObjectsInRect ( ImagePtr, double, double, double, double, ImageObjectPtr ** );
+ImageObjectPtr	FindImageObject ( ImagePtr, double, double, double );
+ImageObjectPtr	FindImageObjectByName ( ImagePtr, char *, long * );
+
+/*** Functions in ImageMatch.c ***/
+
+long			MatchImageObjects ( ImagePtr, ImagePtr, ImageObjectPtr **, ImageObjectPtr ** );
+
+/*** Functions in ImageBackground.c ***/
+
+ImageBackgroundPtr	ComputeImageBackground ( PIXEL **, short, short );
+void			DeleteImageBackground ( ImageBackgroundPtr );
+void			GetImageBackgroundRow ( ImageBackgroundPtr, short, float *, float * );
+double			GetImageBackgroundValue ( ImageBackgroundPtr, short, short, double * );
+ImageBackgroundPtr	GetImageBackground ( ImagePtr, short );
+int				EstimateImageBackground ( ImagePtr, short, short, short, double *, double * );
+void			InvalidateImageBackground ( ImagePtr );
+int				SubtractImageBackground ( ImageBackgroundPtr, PIXEL ** );
+
+/*** Functions in ImageDetection.c ***/
+
+long			DetectImageObjects ( ImagePtr, short, double, double, ImageObjectPtr ** );
 
 /*** Functions in ImageHistogram.c ***/
 
@@ -830,6 +937,26 @@ void				HistogramValueCountToColRow ( ImageHistogramPtr, PIXEL, long, short *, s
 void				ComputeImageRegionHistogram ( ImagePtr, ImageRegionPtr, ImageHistogramPtr );
 void				DrawImageHistogram ( ImageHistogramPtr );
 
+/*** Functions in Convolution.c ***/
+
+#define CONVOLVE_BORDER_MIRROR		0
+#define CONVOLVE_BORDER_EXTEND		1
+#define CONVOLVE_BORDER_WRAP		2
+
+int				ConvolveImageFrame ( PIXEL **, PIXEL **, short, short, float **, short, short, short );
+
+/*** Functions in Resampling.c ***/
+
+#define RESAMPLE_NEAREST			0
+#define RESAMPLE_BILINEAR			1
+#define RESAMPLE_BICUBIC			2
+#define RESAMPLE_LANCZOS			3
+
+#define RESAMPLE_BORDER_ZERO		0
+#define RESAMPLE_BORDER_WRAP		1
+
+int				ResampleImageFrame ( PIXEL **, unsigned char **, short, short, PIXEL **, short, short, double **, short, short );
+
 /*** Functions in ImageProcessing.c ***/
 
 void			DuplicateImage ( PIXEL **, PIXEL **, ImageRegionPtr );
@@ -853,6 +980,28 @@ PIXEL			InterpolatePixelValue ( PIXEL **, short, short, double, double );
 
 void			DoImageWindowArithmetic ( short, GWindowPtr, GWindowPtr, PIXEL );
 
+/*** Functions in ImageStack.c ***/
+
+#define IMAGE_STACK_MEAN				0
+#define IMAGE_STACK_MEDIAN				1
+#define IMAGE_STACK_SIGMA_CLIP			2
+#define IMAGE_STACK_WINSORIZED_CLIP		3
+
+ImagePtr		StackImageFiles ( GPathPtr *, double ***, long, short, double, short );
+
+/*** Functions in ImageCalibration.c ***/
+
+#define IMAGE_CALIBRATION_BIAS			0
+#define IMAGE_CALIBRATION_DARK			1
+#define IMAGE_CALIBRATION_FLAT			2
+
+ImageCalibrationPtr	NewImageCalibration ( GPathPtr );
+void				DeleteImageCalibration ( ImageCalibrationPtr );
+int					CreateImageCalibrationMaster ( ImageCalibrationPtr, short, GPathPtr *, long, short, double, short );
+int					CalibrateImageRow ( ImageCalibrationPtr, short, short, short, short, PIXEL *, double );
+int					CalibrateImage ( ImageCalibrationPtr, ImagePtr, double );
+int					CalibrateImageFile ( ImageCalibrationPtr, GPathPtr, GPathPtr );
+
 /*** Functions in CameraDialog.c ***/
 
 int				DoCameraControlDialogEvent ( short, GWindowPtr, long, long );
@@ -927,6 +1076,8 @@ FITSImagePtr	NewCameraDarkFrame ( CameraPtr, short, short );
 FITSImagePtr	GetCameraDarkFrame ( CameraPtr );
 short			GetCameraDarkFrameMode ( CameraPtr );
 void			SetCameraDarkFrameMode ( CameraPtr, short );
+ImageCalibrationPtr	GetCameraCalibration ( CameraPtr );
+void			SetCameraCalibration ( CameraPtr, ImageCalibrationPtr );
 
 void			SetCameraExposureMode ( CameraPtr, short );
 short			GetCameraExposureMode ( CameraPtr );
@@ -979,6 +1130,8 @@ short			EndCameraExposure ( CameraPtr );
 short			EndCameraDownload ( CameraPtr );
 short			DiscardCameraImageRows ( CameraPtr, short );
 short			DownloadCameraImageRow ( CameraPtr, short, short, PIXEL * );
+short			DownloadCameraImageRowData ( CameraPtr, short, short, unsigned short * );
+short			DownloadCameraImageRowsData ( CameraPtr, short, short, short, unsigned short * );
 
 /*** Functions in Exposure.c ***/
 
@@ -0,0 +1,348 @@
+/*** COPYRIGHT NOTICE AND PUBLIC SOURCE LICENSE ***************************************
+
+	Portions Copyright (c) 1992-2001 Southern Stars Systems.  All Rights Reserved.
+
+	This file contains Original Code and/or Modifications of Original Code as
+	defined in and that are subject to the Southern Stars Systems Public Source
+	License Version 1.0 (the 'License').  You may not use this file except in
+	compliance with the License.  Please obtain a copy of the License at
+
+	http://www.southernstars.com/opensource/
+
+	and read it before using this file.
+
+	The Original Code and all software distributed under the License are distributed
+	on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER EXPRESS OR IMPLIED, AND
+	SOUTHERN STARS SYSTEMS HEREBY DISCLAIMS ALL SUCH WARRANTIES, INCLUDING WITHOUT
+	LIMITATION, ANY WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE,
+	QUIET ENJOYMENT, OR NON-INFRINGEMENT.  Please see the License for the specific
+	language governing rights and limitations under the License.
+
+	MODIFICATION HISTORY:
+
+	1.0.0 - 17 Oct 2026 - Original code: benchmark of block row downloads.
+
+****************************************************************************************/
+
+/*** A stand-alone console program, which is not part of SkySight.  Build it from
+     this file, DemoCameraInterface.c, GThreads.c, and AstroLib's FITS.c and
+     Matrix.c, e.g.
+
+         downloadbench 320 240
+
+     downloads a 320 x 240 frame from the demo camera three ways: one row per
+     CAMERA_DOWNLOAD_ROW call; as many rows per CAMERA_DOWNLOAD_ROWS call as the
+     camera allows; and through a reader thread and ring of row buffers like the
+     one in CameraExposureDialog.c, with blocks of 1, 2, 4, 8 and 16 rows.  It
+     prints the time each takes, and checks that they all give the same data.
+
+     The demo camera takes one tick per call, plus the time needed to read out
+     its pixels at 50,000 per second, so the difference between the first two
+     shows the per-call overhead which reading blocks of rows saves. ***/
+
+#include "SkySight.h"
+
+/*** The same number of row buffers as DOWNLOAD_RING_ROWS in CameraExposureDialog.c ***/
+
+#define BENCH_RING_ROWS		16
+
+typedef struct BenchRow
+{
+	short			row;
+	short			result;
+	unsigned short	*data;
+}
+BenchRow, *BenchRowPtr;
+
+typedef struct BenchPipeline
+{
+	CameraInterfaceDataPtr	camera;
+	short					width;
+	short					height;
+	short					blockRows;
+	unsigned short			*buffer;
+	BenchRow				ring[BENCH_RING_ROWS];
+	GSemaphorePtr			freeRows;
+	GSemaphorePtr			readyRows;
+}
+BenchPipeline, *BenchPipelinePtr;
+
+static long	BenchDownload ( CameraInterfaceDataPtr, unsigned short *, short );
+static long	BenchPipelineDownload ( CameraInterfaceDataPtr, unsigned short *, short );
+static void	BenchReadRows ( void * );
+
+/*** main ***/
+
+int main ( int argc, char *argv[] )
+{
+	static short			blocks[] = { 1, 2, 4, 8, BENCH_RING_ROWS };
+	CameraInterfaceData		camera;
+	FITSImagePtr			image;
+	unsigned short			*frame[2];
+	short					width = 320, height = 240, row, col, i;
+	long					size, ticks;
+	int						same = TRUE, equal;
+
+	if ( argc > 2 )
+	{
+		width = atoi ( argv[1] );
+		height = atoi ( argv[2] );
+	}
+
+	/*** Open the demo camera, and give it an image of the size we want to
+	     read out, filled with values which differ from row to row. ***/
+
+	memset ( &camera, 0, sizeof ( camera ) );
+
+	image = NewFITSImage ( 16, 2, width, height, 1, 32768.0, 1.0 );
+	size = (long) width * height;
+	frame[0] = (unsigned short *) malloc ( sizeof ( unsigned short ) * size );
+	frame[1] = (unsigned short *) malloc ( sizeof ( unsigned short ) * size );
+
+	if ( image == NULL || frame[0] == NULL || frame[1] == NULL
+	|| DemoCameraInterface ( CAMERA_OPEN_CONNECTION, &camera ) == FALSE )
+	{
+		fprintf ( stderr, "Can't open the demo camera!\n" );
+		return ( EXIT_FAILURE );
+	}
+
+	for ( row = 0; row < height; row++ )
+		for ( col = 0; col < width; col++ )
+			image->data[0][row][col] = ( row * 251L + col * 31L ) % 65536L;
+
+	if ( camera.cameraPrivateData != NULL )
+		FreeFITSImage ( (FITSImagePtr) camera.cameraPrivateData );
+
+	camera.cameraPrivateData = image;
+	camera.cameraImageWidth = width;
+	camera.cameraImageHeight = height;
+
+	if ( DemoCameraInterface ( CAMERA_GET_DOWNLOAD_INFO, &camera ) == FALSE )
+		camera.cameraDownloadRowsMax = 1;
+
+	/*** Read out the frame one row at a time, then in the biggest blocks
+	     the camera can send. ***/
+
+	ticks = BenchDownload ( &camera, frame[0], 1 );
+	printf ( "%4d row(s) per call:    %8.3f s\n", 1, (double) ticks / G_TICKS_PER_SECOND );
+
+	ticks = BenchDownload ( &camera, frame[1], camera.cameraDownloadRowsMax );
+	same = memcmp ( frame[0], frame[1], sizeof ( unsigned short ) * size ) == 0;
+	printf ( "%4d row(s) per call:    %8.3f s  %s\n", camera.cameraDownloadRowsMax,
+	         (double) ticks / G_TICKS_PER_SECOND, same ? "same data" : "DATA DIFFER" );
+
+	/*** Now through the pipeline, with blocks of different sizes. ***/
+
+	for ( i = 0; i < sizeof ( blocks ) / sizeof ( blocks[0] ); i++ )
+	{
+		if ( blocks[i] > camera.cameraDownloadRowsMax )
+			break;
+
+		memset ( frame[1], 0, sizeof ( unsigned short ) * size );
+		ticks = BenchPipelineDownload ( &camera, frame[1], blocks[i] );
+		if ( ticks < 0 )
+		{
+			fprintf ( stderr, "Can't start the pipeline!\n" );
+			return ( EXIT_FAILURE );
+		}
+
+		equal = memcmp ( frame[0], frame[1], sizeof ( unsigned short ) * size ) == 0;
+		if ( ! equal )
+			same = FALSE;
+
+		printf ( "pipeline, %2d-row blocks: %8.3f s  %s\n", blocks[i],
+		         (double) ticks / G_TICKS_PER_SECOND, equal ? "same data" : "DATA DIFFER" );
+	}
+
+	DemoCameraInterface ( CAMERA_CLOSE_CONNECTION, &camera );
+	free ( frame[0] );
+	free ( frame[1] );
+
+	return ( same ? EXIT_SUCCESS : EXIT_FAILURE );
+}
+
+/*** BenchDownload ******************************************************************
+
+	Downloads a whole frame from the camera, a given number of rows per call, and
+	returns the number of ticks it took.  One row per call uses CAMERA_DOWNLOAD_ROW,
+	as DownloadCameraImageRowsData() does for cameras which can only send one;
+	otherwise, CAMERA_DOWNLOAD_ROWS.
+
+*************************************************************************************/
+
+long BenchDownload ( CameraInterfaceDataPtr camera, unsigned short *frame, short rows )
+{
+	short	row, count;
+	long	start = GGetTickCount();
+
+	DemoCameraInterface ( CAMERA_START_DOWNLOAD, camera );
+
+	camera->cameraDownloadStart = 0;
+	camera->cameraDownloadWidth = camera->cameraImageWidth;
+
+	for ( row = 0; row < camera->cameraImageHeight; row += count )
+	{
+		count = camera->cameraImageHeight - row < rows ? camera->cameraImageHeight - row : rows;
+
+		camera->cameraDownloadRows = count;
+		camera->cameraDownloadBuffer = frame + (long) camera->cameraImageWidth * row;
+
+		if ( rows > 1 )
+			DemoCameraInterface ( CAMERA_DOWNLOAD_ROWS, camera );
+		else
+			DemoCameraInterface ( CAMERA_DOWNLOAD_ROW, camera );
+	}
+
+	DemoCameraInterface ( CAMERA_END_DOWNLOAD, camera );
+
+	return ( GGetTickCount() - start );
+}
+
+/*** BenchPipelineDownload **********************************************************
+
+	Downloads a whole frame from the camera through a reader thread and a ring of
+	row buffers, as DownloadImage() in CameraExposureDialog.c does: the reader
+	downloads blocks of up to (blockRows) rows into adjacent ring buffers, and this
+	thread takes all of the rows which are ready at once, copies them into the frame,
+	and hands their buffers back.  Returns the number of ticks it took, or -1 if the
+	pipeline can't be started.
+
+*************************************************************************************/
+
+long BenchPipelineDownload ( CameraInterfaceDataPtr camera, unsigned short *frame, short blockRows )
+{
+	BenchPipeline	pipeline;
+	BenchRowPtr		entry;
+	GThreadPtr		reader;
+	long			start = GGetTickCount(), first = 0, count, i;
+	int				done = FALSE;
+
+	pipeline.camera = camera;
+	pipeline.width = camera->cameraImageWidth;
+	pipeline.height = camera->cameraImageHeight;
+	pipeline.blockRows = blockRows;
+	pipeline.buffer = (unsigned short *) malloc ( sizeof ( unsigned short ) * pipeline.width * BENCH_RING_ROWS );
+	pipeline.freeRows = GCreateSemaphore ( BENCH_RING_ROWS, 2 * BENCH_RING_ROWS );
+	pipeline.readyRows = GCreateSemaphore ( 0, 2 * BENCH_RING_ROWS );
+
+	if ( pipeline.buffer == NULL || pipeline.freeRows == NULL || pipeline.readyRows == NULL )
+		return ( -1 );
+
+	DemoCameraInterface ( CAMERA_START_DOWNLOAD, camera );
+
+	reader = GCreateThread ( BenchReadRows, &pipeline );
+	if ( reader == NULL )
+		return ( -1 );
+
+	while ( ! done )
+	{
+		if ( GWaitSemaphore ( pipeline.readyRows, 100 ) )
+		{
+			for ( count = 1; count < BENCH_RING_ROWS; count++ )
+				if ( ! GWaitSemaphore ( pipeline.readyRows, 0 ) )
+					break;
+
+			for ( i = 0; i < count; i++ )
+			{
+				entry = &pipeline.ring[ ( first + i ) % BENCH_RING_ROWS ];
+				if ( entry->row < 0 || entry->result == FALSE )
+				{
+					done = TRUE;
+					break;
+				}
+
+				memcpy ( frame + (long) pipeline.width * entry->row, entry->data, sizeof ( unsigned short ) * pipeline.width );
+			}
+
+			first += count;
+			for ( i = 0; i < count; i++ )
+				GSignalSemaphore ( pipeline.freeRows );
+		}
+	}
+
+	GWaitThread ( reader );
+	DemoCameraInterface ( CAMERA_END_DOWNLOAD, camera );
+
+	GDeleteSemaphore ( pipeline.freeRows );
+	GDeleteSemaphore ( pipeline.readyRows );
+	free ( pipeline.buffer );
+
+	return ( GGetTickCount() - start );
+}
+
+/*** BenchReadRows ******************************************************************
+
+	The pipeline's reader thread; see ReadDownloadRows() in CameraExposureDialog.c.
+	A block must not wrap around the end of the ring.
+
+*************************************************************************************/
+
+void BenchReadRows ( void *data )
+{
+	BenchPipelinePtr	pipeline = (BenchPipelinePtr) data;
+	CameraInterfaceDataPtr	camera = pipeline->camera;
+	BenchRowPtr			entry;
+	short				result = TRUE;
+	long				row, count, j;
+
+	for ( row = 0; row <= pipeline->height; row += count )
+	{
+		count = 1;
+		if ( row < pipeline->height )
+			while ( row + count < pipeline->height && count < pipeline->blockRows
+			&& ( row + count ) % BENCH_RING_ROWS != 0 )
+				count++;
+
+		for ( j = 0; j < count; j++ )
+			GWaitSemaphore ( pipeline->freeRows, -1 );
+
+		if ( row == pipeline->height )
+		{
+			entry = &pipeline->ring[ row % BENCH_RING_ROWS ];
+			entry->row = -1;
+			entry->result = TRUE;
+		}
+		else
+		{
+			camera->cameraDownloadStart = 0;
+			camera->cameraDownloadWidth = pipeline->width;
+			camera->cameraDownloadRows = count;
+			camera->cameraDownloadBuffer = pipeline->buffer + (long) pipeline->width * ( row % BENCH_RING_ROWS );
+
+			result = DemoCameraInterface ( CAMERA_DOWNLOAD_ROWS, camera );
+
+			for ( j = 0; j < count; j++ )
+			{
+				entry = &pipeline->ring[ ( row + j ) % BENCH_RING_ROWS ];
+				entry->row = row + j;
+				entry->result = result;
+				entry->data = pipeline->buffer + (long) pipeline->width * ( ( row + j ) % BENCH_RING_ROWS );
+			}
+		}
+
+		for ( j = 0; j < count; j++ )
+			GSignalSemaphore ( pipeline->readyRows );
+
+		if ( result == FALSE )
+			return;
+	}
+}
+
+/*** GWait, GGetTickCount ***********************************************************
+
+	The same as GUILib's, which come with its windowing code.
+
+*************************************************************************************/
+
+void GWait ( long ticks )
+{
+	long	start = GGetTickCount();
+
+	while ( GGetTickCount() - start < ticks )
+		;
+}
+
+long GGetTickCount ( void )
+{
+	return ( GetTickCount() );
+}
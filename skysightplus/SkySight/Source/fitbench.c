@@ -0,0 +1,224 @@
+/*** COPYRIGHT NOTICE AND PUBLIC SOURCE LICENSE ***************************************
+
+	Portions Copyright (c) 1992-2001 Southern Stars Systems.  All Rights Reserved.
+
+	This file contains Original Code and/or Modifications of Original Code as
+	defined in and that are subject to the Southern Stars Systems Public Source
+	License Version 1.0 (the 'License').  You may not use this file except in
+	compliance with the License.  Please obtain a copy of the License at
+
+	http://www.southernstars.com/opensource/
+
+	and read it before using this file.
+
+	The Original Code and all software distributed under the License are distributed
+	on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER EXPRESS OR IMPLIED, AND
+	SOUTHERN STARS SYSTEMS HEREBY DISCLAIMS ALL SUCH WARRANTIES, INCLUDING WITHOUT
+	LIMITATION, ANY WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE,
+	QUIET ENJOYMENT, OR NON-INFRINGEMENT.  Please see the License for the specific
+	language governing rights and limitations under the License.
+
+	MODIFICATION HISTORY:
+
+	1.0.0 - 17 Oct 2026 - Original code: benchmark of Gaussian star model fits.
+
+****************************************************************************************/
+
+/*** A stand-alone console program, which is not part of SkySight.  Build it as a
+     console program from this file and the same sources as SkySight, so that its
+     main() is the entry point rather than GUILib's WinMain(); e.g.
+
+         fitbench 2000
+
+     makes 2000 noisy Gaussian stars in boxes of 9x9, 17x17, 25x25 and 33x33 pixels,
+     and fits the star model to each of them twice with SolveImageModelFit(): once
+     through GaussianStarModel(), called pixel by pixel, and once through
+     GaussianStarModelRow(), a row at a time.  It prints the fits per second of
+     each way, and the largest difference between the parameters they find.
+
+     The fit only uses the row function for GaussianStarModel() itself, so the
+     pixel-by-pixel fits are made through BenchStarModel(), which just calls it. ***/
+
+#include "SkySight.h"
+
+#define BENCH_PARAMS		5
+#define BENCH_TOLERANCE		1.0e-6
+#define BENCH_ITERATIONS	50
+
+static unsigned long	sBenchSeed = 3;
+
+static double	BenchStarModel ( short, short, double *, double * );
+static double	BenchFitStars ( PIXEL **, ImageRegionPtr *, long, short, ImageModelFunctionPtr, double ** );
+static double	BenchRandom ( void );
+static double	BenchGaussian ( void );
+
+/*** main ***/
+
+int main ( int argc, char *argv[] )
+{
+	static short		sizes[] = { 9, 17, 25, 33 };
+	long				numStars = 2000, grid, star, i, j;
+	short				size, row, col, left, top;
+	double				x, y, radius, amplitude, diff, maxDiff, seconds[2];
+	double				**params[2];
+	PIXEL				**matrix;
+	ImageRegionPtr		*regions;
+
+	if ( argc > 1 )
+		numStars = atol ( argv[1] );
+
+	if ( numStars < 1 )
+		numStars = 1;
+
+	grid = (long) ceil ( sqrt ( (double) numStars ) );
+
+	for ( i = 0; i < sizeof ( sizes ) / sizeof ( sizes[0] ); i++ )
+	{
+		/*** Lay out the stars' boxes in a square grid, and draw a star with a
+		     random amplitude, radius and centroid in each, on a noisy sky. ***/
+
+		size = sizes[i];
+		matrix = NMatrix ( PIXEL, grid * size, grid * size );
+		regions = (ImageRegionPtr *) calloc ( numStars, sizeof ( ImageRegionPtr ) );
+		params[0] = NMatrix ( double, numStars, BENCH_PARAMS );
+		params[1] = NMatrix ( double, numStars, BENCH_PARAMS );
+
+		if ( matrix == NULL || regions == NULL || params[0] == NULL || params[1] == NULL )
+		{
+			fprintf ( stderr, "Not enough memory!\n" );
+			return ( EXIT_FAILURE );
+		}
+
+		for ( row = 0; row < grid * size; row++ )
+			for ( col = 0; col < grid * size; col++ )
+				matrix[row][col] = 100.0 + 5.0 * BenchGaussian();
+
+		for ( star = 0; star < numStars; star++ )
+		{
+			left = ( star % grid ) * size;
+			top = ( star / grid ) * size;
+
+			x = left + size / 2 + BenchRandom() - 0.5;
+			y = top + size / 2 + BenchRandom() - 0.5;
+			radius = 1.2 + 1.3 * BenchRandom();
+			amplitude = 500.0 + 4500.0 * BenchRandom();
+
+			for ( row = top; row < top + size; row++ )
+				for ( col = left; col < left + size; col++ )
+					matrix[row][col] += amplitude * exp ( - ( ( col - x ) * ( col - x ) + ( row - y ) * ( row - y ) ) / ( 2.0 * radius * radius ) );
+
+			regions[star] = NewImageRegion ( IMAGE_REGION_TYPE_RECTANGULAR, left, top, left + size - 1, top + size - 1 );
+			if ( regions[star] == NULL )
+			{
+				fprintf ( stderr, "Not enough memory!\n" );
+				return ( EXIT_FAILURE );
+			}
+		}
+
+		/*** Fit the stars both ways, then compare the parameters. ***/
+
+		seconds[0] = BenchFitStars ( matrix, regions, numStars, size, BenchStarModel, params[0] );
+		seconds[1] = BenchFitStars ( matrix, regions, numStars, size, GaussianStarModel, params[1] );
+
+		maxDiff = 0.0;
+		for ( star = 0; star < numStars; star++ )
+		{
+			for ( j = 0; j < BENCH_PARAMS; j++ )
+			{
+				diff = fabs ( params[1][star][j] - params[0][star][j] ) / ( fabs ( params[0][star][j] ) + 1.0 );
+				if ( diff > maxDiff )
+					maxDiff = diff;
+			}
+		}
+
+		printf ( "box %2hdx%-2hd: pixels %8.0f fits/s, rows %8.0f fits/s (%.2fx), largest difference %.1e\n",
+		         size, size, numStars / seconds[0], numStars / seconds[1], seconds[0] / seconds[1], maxDiff );
+
+		for ( star = 0; star < numStars; star++ )
+			DeleteImageRegion ( regions[star] );
+
+		free ( regions );
+		NDestroyMatrix ( params[0] );
+		NDestroyMatrix ( params[1] );
+		NDestroyMatrix ( matrix );
+	}
+
+	return ( EXIT_SUCCESS );
+}
+
+/*** BenchFitStars ******************************************************************
+
+	Fits a model to each of a list of stars, with one workspace, starting from a
+	rough guess: the background from the corner of the box, the peak above it, the
+	centre of the box, and a radius of 2.  Each star's fitted parameters go in a row
+	of (params).  Returns the processor time the fits took, in seconds.
+
+*************************************************************************************/
+
+double BenchFitStars ( PIXEL **matrix, ImageRegionPtr *regions, long numStars, short size,
+ImageModelFunctionPtr model, double **params )
+{
+	double				errors[BENCH_PARAMS];
+	short				left, top;
+	long				star;
+	clock_t				start;
+	ImageModelFitPtr	fit;
+
+	fit = NewImageModelFit ( BENCH_PARAMS, 0, 65535 );
+	if ( fit == NULL )
+		return ( 0.0 );
+
+	start = clock();
+
+	for ( star = 0; star < numStars; star++ )
+	{
+		left = GetImageRegionLeft ( regions[star] );
+		top = GetImageRegionTop ( regions[star] );
+
+		params[star][0] = matrix[top][left];
+		params[star][1] = matrix[top + size / 2][left + size / 2] - params[star][0];
+		params[star][2] = left + size / 2;
+		params[star][3] = top + size / 2;
+		params[star][4] = 2.0;
+
+		SolveImageModelFit ( fit, matrix, regions[star], model, params[star], errors, BENCH_TOLERANCE, BENCH_ITERATIONS );
+	}
+
+	start = clock() - start;
+	DeleteImageModelFit ( fit );
+
+	return ( (double) ( start > 0 ? start : 1 ) / CLOCKS_PER_SEC );
+}
+
+/*** BenchStarModel ***/
+
+double BenchStarModel ( short x, short y, double parameters[5], double derivatives[5] )
+{
+	return ( GaussianStarModel ( x, y, parameters, derivatives ) );
+}
+
+/*** BenchRandom ********************************************************************
+
+	Returns a uniform random deviate in [0,1), the same on every platform.
+
+*************************************************************************************/
+
+double BenchRandom ( void )
+{
+	sBenchSeed = ( sBenchSeed * 1103515245UL + 12345UL ) & 0xFFFFFFFFUL;
+
+	return ( ( ( sBenchSeed >> 8 ) & 0xFFFFFF ) / 16777216.0 );
+}
+
+/*** BenchGaussian ******************************************************************
+
+	Returns a Gaussian random deviate with zero mean and unit variance.
+
+*************************************************************************************/
+
+double BenchGaussian ( void )
+{
+	double	u = BenchRandom() + 1.0e-9, v = BenchRandom();
+
+	return ( sqrt ( -2.0 * log ( u ) ) * cos ( 2.0 * PI * v ) );
+}
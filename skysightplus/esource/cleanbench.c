@@ -0,0 +1,227 @@
+ /*
+ 				cleanbench.c
+
+*%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+*
+*	Part of:	SExtractor
+*
+*	Contents:	benchmark of the CLEANing of a crowded field: the
+*			clean-list index against a search of the whole list.
+*
+*	Last modify:	17/10/26
+*
+*%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+*/
+
+/*
+A stand-alone program, which is not part of SkySight.  Build it from this file,
+the source files of the SExtractor group of the SkySight project, and
+GThreads.c, e.g.
+
+	cleanbench 2048 2048 30000 30000
+
+makes a 2048x2048 field holding a globular cluster of 30000 stars, extracts it
+with a CLEAN stack of 30000 objects, once searching the whole clean-list for
+the neighbours of each object (as SExtractor used to) and once with the
+index, then prints both times and checks that the catalogs are the same.
+*/
+
+#include	<math.h>
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<time.h>
+
+#include	"define.h"
+#include	"globals.h"
+
+static unsigned long	benchseed = 3;
+
+static double	benchrand(void),
+		benchgauss(void),
+		benchextract(sexstruct *, PIXTYPE **, int, int, int, int);
+static int	benchsame(sexstruct *, sexstruct *);
+
+
+/********************************** main ************************************/
+
+int	main(int argc, char *argv[])
+
+  {
+   sexstruct	*sex[2];
+   PIXTYPE	**data, *pix;
+   double	t[2], cx,cy, amp, sig, r,th;
+   int		width, height, nstar, stack, i, k, x,y, size;
+
+  if (argc<5)
+    {
+    fprintf(stderr, "SYNTAX: cleanbench <width> <height> <nb of stars>"
+	" <CLEAN stack size>\n");
+    return EXIT_FAILURE;
+    }
+  width = atoi(argv[1]);
+  height = atoi(argv[2]);
+  nstar = atoi(argv[3]);
+  stack = atoi(argv[4]);
+
+  if (!(data = (PIXTYPE **)malloc(height*sizeof(PIXTYPE *)))
+	|| !(pix = (PIXTYPE *)malloc((size_t)width*height*sizeof(PIXTYPE))))
+    {
+    fprintf(stderr, "Not enough memory\n");
+    return EXIT_FAILURE;
+    }
+  for (y=0; y<height; y++)
+    data[y] = pix + (size_t)y*width;
+
+/*A noisy sky, half the stars in a cluster and half spread over the field */
+  for (i=0; i<width*height; i++)
+    pix[i] = (PIXTYPE)(100.0 + 5.0*benchgauss());
+  for (k=0; k<nstar; k++)
+    {
+    amp = 20.0 + pow(benchrand(), 3.0)*20000.0;
+    sig = 1.0 + 0.6*benchrand();
+    if (k%2)
+      {
+      r = 0.3*width/8.0*sqrt(1.0/(benchrand()+0.02)-1.0);
+      th = 2*PI*benchrand();
+      cx = width/2 + r*cos(th);
+      cy = height/2 + r*sin(th);
+      }
+    else
+      {
+      cx = width*benchrand();
+      cy = height*benchrand();
+      }
+    size = (int)(5.0*sig) + 2;
+    for (y=(int)cy-size; y<=(int)cy+size; y++)
+      for (x=(int)cx-size; x<=(int)cx+size; x++)
+        if (x>=0 && y>=0 && x<width && y<height)
+          data[y][x] += (PIXTYPE)(amp*exp(-((x-cx)*(x-cx)+(y-cy)*(y-cy))
+			/(2*sig*sig)));
+    }
+
+/*The same extraction, first without and then with the index */
+  for (i=0; i<2; i++)
+    {
+    if (!(sex[i] = sexnew()))
+      {
+      fprintf(stderr, "Not enough memory\n");
+      return EXIT_FAILURE;
+      }
+    t[i] = benchextract(sex[i], data, width, height, stack, !i);
+    if (t[i] < 0.0)
+      {
+      fprintf(stderr, "Error: %s\n", sex[i]->errmsg);
+      return EXIT_FAILURE;
+      }
+    printf("%-12s %6d objects  %8.2f s\n", i? "index:" : "whole list:",
+	sex[i]->nobj, t[i]);
+    }
+
+  if (!benchsame(sex[0], sex[1]))
+    {
+    printf("The catalogs differ!\n");
+    return EXIT_FAILURE;
+    }
+
+  printf("The catalogs are the same; the index is %.1f times faster.\n",
+	t[1]>0.0? t[0]/t[1] : 0.0);
+
+  sexdelete(sex[0]);
+  sexdelete(sex[1]);
+  free(pix);
+  free(data);
+
+  return EXIT_SUCCESS;
+  }
+
+
+/******************************* benchextract *******************************/
+/*
+Extract the field on one thread, and return the processor time it took, or
+-1 on error.
+*/
+static double	benchextract(sexstruct *sex, PIXTYPE **data, int width,
+			int height, int stack, int linear)
+
+  {
+   sexstruct	*old;
+   clock_t	t;
+
+  old = sexbind(sex);
+  prefs.nthreads = 1;
+  prefs.clean_stacksize = stack;
+  prefs.mem_pixstack = 1000000;
+  sex->cleanlinear = linear;
+  sexbind(old);
+
+  t = clock();
+  if (sexextract(sex, data, width, height) < 0)
+    return -1.0;
+
+  return (double)(clock()-t)/CLOCKS_PER_SEC;
+  }
+
+
+/********************************* benchsame ********************************/
+/*
+Return 1 if two extractions found the same objects, with the same
+measurements, in the same order; 0 otherwise.
+*/
+static int	benchsame(sexstruct *sex1, sexstruct *sex2)
+
+  {
+   objstruct	*obj1, *obj2;
+   int		i;
+
+  if (sex1->nobj != sex2->nobj)
+    return 0;
+
+  for (i=0; i<sex1->nobj; i++)
+    {
+    obj1 = &sex1->obj[i];
+    obj2 = &sex2->obj[i];
+    if (obj1->number != obj2->number
+	|| obj1->pixnb != obj2->pixnb
+	|| obj1->rawvalue != obj2->rawvalue
+	|| obj1->mx != obj2->mx || obj1->my != obj2->my
+	|| obj1->a != obj2->a || obj1->b != obj2->b
+	|| obj1->theta != obj2->theta
+	|| obj1->flag != obj2->flag
+	|| obj1->apermag != obj2->apermag
+	|| obj1->automag != obj2->automag
+	|| memcmp(&sex1->obj2[i], &sex2->obj2[i], sizeof(obj2struct)))
+      return 0;
+    }
+
+  return 1;
+  }
+
+
+/********************************* benchrand ********************************/
+/*
+Uniform random deviate in [0,1), the same on every platform.
+*/
+static double	benchrand()
+
+  {
+  benchseed = (benchseed*1103515245UL + 12345UL) & 0xffffffffUL;
+
+  return ((benchseed>>8)&0xffffff)/16777216.0;
+  }
+
+
+/******************************** benchgauss ********************************/
+/*
+Gaussian random deviate with zero mean and unit variance.
+*/
+static double	benchgauss()
+
+  {
+   double	u, v;
+
+  u = benchrand() + 1e-9;
+  v = benchrand();
+
+  return sqrt(-2.0*log(u))*cos(2*PI*v);
+  }
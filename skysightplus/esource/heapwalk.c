@@ -212,18 +212,27 @@ size_t mspace_max_footprint(mspace msp);
 
 void* dlrealloc(void*, size_t);
 
-static jmp_buf mark;              // Address for long jump to jump to
+/* Each extraction allocates from its own heap, sexctx->heap, so that several
+extractions can run at once, and everything an extraction allocated can be
+released in one go when it ends, even after an error. */
 
-static PROCESS_HEAP_ENTRY entry;
-static unsigned int nBlocks;
-static unsigned int nFreeBlocks;
-static unsigned int nSize;
+void *newheap(void)
+{
+#ifdef WINHEAP_ALLOCATOR
+return HeapCreate(0, 10000000, 100000000);
+#else
+return create_mspace(0, 0);
+#endif
+}
 
+void freeheap(void *heap)
+{
 #ifdef WINHEAP_ALLOCATOR
-static HANDLE g_hHeap;
+HeapDestroy((HANDLE)heap);
 #else
-static mspace gspace;
+destroy_mspace((mspace)heap);
 #endif
+}
 
 void heapwalk(void)
 {
@@ -232,12 +241,15 @@ void heapwalk(void)
     int		nResult;
     UINT    fuStyle = 0;
 #ifdef WINHEAP_ALLOCATOR
+PROCESS_HEAP_ENTRY entry;
+unsigned int nBlocks, nFreeBlocks, nSize;
+
 entry.lpData = NULL;
 nBlocks = nFreeBlocks = 0;
 nSize = 0;
 
 /* Walk the heap and get info. */
-while(HeapWalk(g_hHeap, &entry) != 0)
+while(HeapWalk((HANDLE)sexctx->heap, &entry) != 0)
 {
 if(entry.wFlags == 0)
 {
@@ -248,24 +260,22 @@ nBlocks++;
 nSize += entry.cbData;
 }
 sprintf(heapbuf, "Blocks %d, Free Blocks %d, used %d\n", nBlocks, nFreeBlocks, nSize);
-HeapDestroy(g_hHeap);
-g_hHeap = NULL;
 #else
-sprintf(heapbuf, "Peak Memory Used for Object Detection %d bytes\n", mspace_max_footprint(gspace));
+sprintf(heapbuf, "Peak Memory Used for Object Detection %d bytes\n", mspace_max_footprint((mspace)sexctx->heap));
   fuStyle = MB_ICONINFORMATION|MB_OK;
   GetWindowText ( GetActiveWindow(), szTitle, 63 );
   nResult = MessageBox ( GetActiveWindow(), heapbuf, szTitle, fuStyle );
-destroy_mspace(gspace);
-gspace = NULL;
 #endif
+freeheap(sexctx->heap);
+sexctx->heap = NULL;
 }
 
 void *myalloc(unsigned siz)
 {
 #ifdef WINHEAP_ALLOCATOR
-return HeapAlloc(g_hHeap, 0, siz);
+return HeapAlloc((HANDLE)sexctx->heap, 0, siz);
 #else
-return mspace_malloc(gspace, siz);
+return mspace_malloc((mspace)sexctx->heap, siz);
 #endif
 }
 
@@ -273,55 +283,35 @@ void *mycalloc(unsigned siz1, unsigned siz2)
 {
 #ifdef WINHEAP_ALLOCATOR
 LPTSTR pStr;
-pStr = HeapAlloc(g_hHeap, 0, siz1*siz2);
+pStr = HeapAlloc((HANDLE)sexctx->heap, 0, siz1*siz2);
 memset(pStr, 0, siz1*siz2);
 return pStr;
 #else
-return mspace_calloc(gspace, siz1, siz2);
+return mspace_calloc((mspace)sexctx->heap, siz1, siz2);
 #endif	
 }
 
 void *myrealloc(void *ptr, unsigned siz)
 {
 #ifdef WINHEAP_ALLOCATOR
-return HeapReAlloc(g_hHeap, 0, ptr, siz);
+return HeapReAlloc((HANDLE)sexctx->heap, 0, ptr, siz);
 #else
-return mspace_realloc(gspace, ptr, siz);
+return mspace_realloc((mspace)sexctx->heap, ptr, siz);
 #endif	
 }
 
 void myfree(void *ptr)
 {
 #ifdef WINHEAP_ALLOCATOR
-BOOL retval = HeapFree(g_hHeap, 0, ptr);
-HeapCompact(g_hHeap, 0);
+BOOL retval = HeapFree((HANDLE)sexctx->heap, 0, ptr);
+HeapCompact((HANDLE)sexctx->heap, 0);
 #else
-mspace_free(gspace, ptr);
+mspace_free((mspace)sexctx->heap, ptr);
 #endif
 }
 
 void sexit(int retval)
 {
-    heapwalk();
-	longjmp(mark, retval);
-}
-
-int protected_sextract_main(char *path)
-{
-	int jmpret;
-	char l_name[ MAX_PATH + 1 ];
-	l_name[ sizeof( l_name ) -1] = 0;
-    GetModuleFileName( NULL, l_name, sizeof( l_name ) -1 );
-    jmpret = setjmp( mark );
-    if( jmpret == 0 )
-	{
- 	   char *argv[] = {l_name, path};
-#ifdef WINHEAP_ALLOCATOR
-	   g_hHeap = HeapCreate(0, 10000000, 100000000);
-#else
-	   gspace = create_mspace(0, 0);
-#endif
-	   sexit(unprotected_sextract_main(sizeof(argv)/sizeof(*argv), argv));
-	}
-   return jmpret;
+	endingest();	/* stop the read-ahead thread before leaving */
+	longjmp(sexctx->mark, retval);
 }